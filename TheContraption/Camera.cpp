@@ -10,24 +10,22 @@ Camera::Camera(
 	float nearClip,
 	float farClip)
 	:
-	moveSpeed(std::make_shared<float>(moveSpeed)),
-	sprintMoveSpeed(std::make_shared<float>(sprintMoveSpeed)),
-	mouseLookSpeed(std::make_shared<float>(mouseLookSpeed)),
-	nearClip(std::make_shared<float>(nearClip)),
-	farClip(std::make_shared<float>(farClip))
+	moveSpeed(moveSpeed),
+	sprintMoveSpeed(sprintMoveSpeed),
+	mouseLookSpeed(mouseLookSpeed),
+	nearClip(nearClip),
+	farClip(farClip),
+	transform(Transform::Create())
 {
-	transform = new Transform();
-	transform->SetPosition(x, y, z);
-
-	viewMatrix = std::make_shared<DirectX::XMFLOAT4X4>();
-	projMatrix = std::make_shared<DirectX::XMFLOAT4X4>();
+	transform.SetPosition(x, y, z);
 
+	UpdateViewMatrix();
 	UpdateProjMatrix(fov, aspectRatio);
 }
 
 Camera::~Camera()
 {
-	delete transform;
+	transform.Destroy();
 }
 
 void Camera::Update(float dt)
@@ -35,50 +33,50 @@ void Camera::Update(float dt)
 	Input& input = Input::GetInstance();
 
 	// On left shift sprint speed 
-	float speed = input.KeyDown(16) ? *sprintMoveSpeed.get() : *moveSpeed.get();
+	float speed = input.KeyDown(16) ? sprintMoveSpeed : moveSpeed;
 
 	if (input.KeyDown('W')) 
 	{
-		transform->MoveRelative(0, 0, speed * dt);
+		transform.MoveRelative(0, 0, speed * dt);
 	}
 	else if (input.KeyDown('S')) 
 	{
-		transform->MoveRelative(0, 0, -speed * dt);
+		transform.MoveRelative(0, 0, -speed * dt);
 	}
 
 	if (input.KeyDown('E'))
 	{
-		transform->MoveRelative(0, speed * dt, 0);
+		transform.MoveRelative(0, speed * dt, 0);
 	}
 	else if (input.KeyDown('Q'))
 	{
-		transform->MoveRelative(0, -speed * dt, 0);
+		transform.MoveRelative(0, -speed * dt, 0);
 	}
 
 	if (input.KeyDown('A'))
 	{
-		transform->MoveRelative(-speed * dt, 0, 0);
+		transform.MoveRelative(-speed * dt, 0, 0);
 	}
 	else if (input.KeyDown('D'))
 	{
-		transform->MoveRelative(speed * dt, 0, 0);
+		transform.MoveRelative(speed * dt, 0, 0);
 	}
 
 
 	if (input.MouseLeftDown())
 	{
-		float xDiff = *mouseLookSpeed.get() * input.GetMouseXDelta();
-		float yDiff = *mouseLookSpeed.get() * input.GetMouseYDelta();
+		float xDiff = mouseLookSpeed * input.GetMouseXDelta();
+		float yDiff = mouseLookSpeed * input.GetMouseYDelta();
 		// roate camera 
 
-		transform->RotateEuler( yDiff * *mouseLookSpeed.get(), 0, 0);
-		transform->RotateEuler(0, xDiff * *mouseLookSpeed.get(), 0);
+		transform.RotateEuler( yDiff * mouseLookSpeed, 0, 0);
+		transform.RotateEuler(0, xDiff * mouseLookSpeed, 0);
 	}
 
 	// Reset position 
 	if (input.KeyDown(VK_SPACE))
 	{
-		transform->SetPosition(0, 0, -5);
+		transform.SetPosition(0, 0, -5);
 	}
 
 	UpdateViewMatrix();
@@ -87,8 +85,8 @@ void Camera::Update(float dt)
 void Camera::UpdateViewMatrix()
 {
 	// Setup
-	DirectX::XMFLOAT3 pos = *(transform->GetPosition().get());
-	DirectX::XMFLOAT3 fwd = transform->GetForward();
+	DirectX::XMFLOAT3 pos = transform.GetPosition();
+	DirectX::XMFLOAT3 fwd = transform.GetForward();
 
 	// Build view and store 
 	DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(
@@ -97,36 +95,89 @@ void Camera::UpdateViewMatrix()
 		DirectX::XMVectorSet(0, 1, 0, 0)
 	);
 
-	DirectX::XMStoreFloat4x4(viewMatrix.get(), view);
+	DirectX::XMStoreFloat4x4(&viewMatrix, view);
+	UpdateFrustum();
 }
 
 void Camera::UpdateProjMatrix(float fov, float aspectRatio)
 {
 	// Change clip planes to be paramters of constructor 
-	DirectX::XMMATRIX proj = DirectX::XMMatrixPerspectiveFovLH(fov, aspectRatio, *nearClip.get(), *farClip.get());
-	DirectX::XMStoreFloat4x4(projMatrix.get(), proj);
+	DirectX::XMMATRIX proj = DirectX::XMMatrixPerspectiveFovLH(fov, aspectRatio, nearClip, farClip);
+	DirectX::XMStoreFloat4x4(&projMatrix, proj);
+	UpdateFrustum();
+}
+
+void Camera::UpdateFrustum()
+{
+	DirectX::XMFLOAT4X4 viewProj;
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(
+		DirectX::XMLoadFloat4x4(&viewMatrix),
+		DirectX::XMLoadFloat4x4(&projMatrix)));
+	frustum = Frustum::FromViewProjection(viewProj);
+}
+
+void Camera::GetPickRay(float screenX, float screenY, float screenWidth, float screenHeight, DirectX::XMFLOAT3& origin, DirectX::XMFLOAT3& direction)
+{
+	// Pixels to normalized device coordinates, which have y up
+	float x = screenX / screenWidth * 2.0f - 1.0f;
+	float y = 1.0f - screenY / screenHeight * 2.0f;
+
+	// Then back through the projection and view to the near and far planes
+	DirectX::XMMATRIX invViewProj = DirectX::XMMatrixInverse(nullptr, DirectX::XMMatrixMultiply(
+		DirectX::XMLoadFloat4x4(&viewMatrix),
+		DirectX::XMLoadFloat4x4(&projMatrix)));
+	DirectX::XMVECTOR nearPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(x, y, 0.0f, 1.0f), invViewProj);
+	DirectX::XMVECTOR farPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(x, y, 1.0f, 1.0f), invViewProj);
+
+	DirectX::XMStoreFloat3(&origin, nearPoint);
+	DirectX::XMStoreFloat3(&direction, DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(farPoint, nearPoint)));
 }
 
 #pragma region Getters
 
 Transform* Camera::GetTransform()
 {
-	return transform;
+	return &transform;
 }
 
-std::shared_ptr<DirectX::XMFLOAT4X4> Camera::GetViewMatrix()
+const DirectX::XMFLOAT4X4& Camera::GetViewMatrix()
 {
 	return viewMatrix;
 }
 
-std::shared_ptr<DirectX::XMFLOAT4X4> Camera::GetProjMatrix()
+const DirectX::XMFLOAT4X4& Camera::GetProjMatrix()
 {
 	return projMatrix;
 }
 
+const Frustum& Camera::GetFrustum()
+{
+	return frustum;
+}
+
 float Camera::GetCommonMoveSpeed()
 {
-	return *moveSpeed.get();
+	return moveSpeed;
+}
+
+float Camera::GetSprintMoveSpeed()
+{
+	return sprintMoveSpeed;
+}
+
+float Camera::GetMouseLookSpeed()
+{
+	return mouseLookSpeed;
+}
+
+float Camera::GetNearClip()
+{
+	return nearClip;
+}
+
+float Camera::GetFarClip()
+{
+	return farClip;
 }
 
 #pragma endregion
@@ -134,5 +185,25 @@ float Camera::GetCommonMoveSpeed()
 
 void Camera::SetCommonMoveSpeed(float next)
 {
-	*moveSpeed.get() = next;
+	moveSpeed = next;
+}
+
+void Camera::SetSprintMoveSpeed(float next)
+{
+	sprintMoveSpeed = next;
+}
+
+void Camera::SetMouseLookSpeed(float next)
+{
+	mouseLookSpeed = next;
+}
+
+void Camera::SetNearClip(float next)
+{
+	nearClip = next;
+}
+
+void Camera::SetFarClip(float next)
+{
+	farClip = next;
 }
\ No newline at end of file
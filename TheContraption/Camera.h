@@ -1,7 +1,8 @@
 #pragma once
 #include "Transform.h"
 #include "Input.h"
-#include <memory>
+#include "Frustum.h"
+#include "Pool.h"
 
 class Camera
 {
@@ -18,6 +19,10 @@ public:
 
 	~Camera();
 
+	// Owns its transform, so it can't be copied
+	Camera(const Camera&) = delete;
+	Camera& operator=(const Camera&) = delete;
+
 	// Have constructor for strating orientation 
 
 	void Update(float dt);
@@ -25,16 +30,23 @@ public:
 	void UpdateProjMatrix(float fov, float aspectRatio);
 	Transform* GetTransform();
 
+	/// <summary>
+	/// Get the world space ray through a point on the screen, in pixels from
+	/// the top left. It starts on the near plane and has a unit direction
+	/// </summary>
+	void GetPickRay(float screenX, float screenY, float screenWidth, float screenHeight, DirectX::XMFLOAT3& origin, DirectX::XMFLOAT3& direction);
+
 	// Getters 
-	std::shared_ptr<DirectX::XMFLOAT4X4> GetViewMatrix();
-	std::shared_ptr<DirectX::XMFLOAT4X4> GetProjMatrix();
+	const DirectX::XMFLOAT4X4& GetViewMatrix();
+	const DirectX::XMFLOAT4X4& GetProjMatrix();
+	const Frustum& GetFrustum();
 	float GetCommonMoveSpeed();
 	float GetSprintMoveSpeed();
 	float GetMouseLookSpeed();
 	float GetNearClip();
 	float GetFarClip();
 
-	// Setters 
+	// Setters. Clip planes take effect at the next UpdateProjMatrix()
 	void SetCommonMoveSpeed(float nextSpeed);
 	void SetSprintMoveSpeed(float nextSpeed);
 	void SetMouseLookSpeed(float nextSpeed);
@@ -43,14 +55,20 @@ public:
 
 private:
 	// Primary matrices 
-	std::shared_ptr<DirectX::XMFLOAT4X4> viewMatrix;
-	std::shared_ptr<DirectX::XMFLOAT4X4> projMatrix;
+	DirectX::XMFLOAT4X4 viewMatrix;
+	DirectX::XMFLOAT4X4 projMatrix;
+
+	// World space view volume, kept in sync with the matrices
+	Frustum frustum;
+	void UpdateFrustum();
+
 
+	float moveSpeed;
+	float sprintMoveSpeed;
+	float mouseLookSpeed;
+	float nearClip;
+	float farClip;
+	Transform transform;
+};
 
-	std::shared_ptr<float> moveSpeed;
-	std::shared_ptr<float> sprintMoveSpeed;
-	std::shared_ptr<float> mouseLookSpeed;
-	std::shared_ptr<float> nearClip;
-	std::shared_ptr<float> farClip;
-	Transform* transform;
-};
\ No newline at end of file
+typedef PoolHandle<Camera> CameraHandle;
\ No newline at end of file
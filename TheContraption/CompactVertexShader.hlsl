@@ -0,0 +1,39 @@
+#include "ShaderInclude.hlsli"
+
+cbuffer ExternalData : register(b0)
+{
+	matrix world;
+	matrix viewMatrix;
+	matrix projMatrix;
+	matrix worldInvTranspose;
+
+	// Undoes quantization, see VertexDequantization in VertexCompression.h
+	float3 positionRangeOffset;
+	float3 positionRangeScale;
+	float2 uvRangeOffset;
+	float2 uvRangeScale;
+}
+
+
+// --------------------------------------------------------
+// Same as VertexShader.hlsl, but for meshes stored in one
+// of the compact vertex formats
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput_Compact input)
+{
+	VertexToPixel output;
+
+	float3 localPosition = positionRangeOffset + input.localPosition * positionRangeScale;
+
+	matrix wvp = mul(projMatrix, mul(viewMatrix, world));
+	output.screenPosition = mul(wvp, float4(localPosition, 1.0f));
+
+	output.uv = uvRangeOffset + input.uv * uvRangeScale;
+
+	output.normal = mul((float3x3)worldInvTranspose, OctDecode(input.normal));
+	float4 tangent = OctDecodeTangent(input.tangent);
+	output.tangent = float4(mul((float3x3)world, tangent.xyz), tangent.w);
+	output.worldPosition = mul(world, float4(localPosition, 1.0f)).xyz;
+
+	return output;
+}
@@ -24,5 +24,5 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float rB = gnoise(input.uv + float2(time / 0.5, -time));
 
 	float col = rA + rB - 0.5f;
-	return float4(col, col, col, 1.0);
+	return float4(col, col, col, colorTint.a);
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "DXCore.h"
 #include "Input.h"
+#include "GeometryArena.h"
+#include "TransformSystem.h"
 
 #include <dxgi1_5.h>
 #include <WindowsX.h>
@@ -86,6 +88,12 @@ DXCore::~DXCore()
 
 	// Delete input manager singleton
 	delete& Input::GetInstance();
+
+	// Every mesh is gone along with the game's members by now
+	delete& GeometryArena::GetInstance();
+
+	// As is every entity and camera, which release their transforms
+	delete& TransformSystem::GetInstance();
 }
 
 // --------------------------------------------------------
@@ -1,11 +1,30 @@
 #include "Entity.h"
+#include "MeshLoader.h"
+#include "MaterialLibrary.h"
+
+#include <algorithm>
+#include <cmath>
 
 #include <time.h> // TEMPORARY FOR NOISE
 
 Entity::Entity(std::shared_ptr<Mesh> model, std::shared_ptr<Material> mat) :
-	model(model), mat(mat)
+	Entity(model, mat, Transform::Create())
+{
+	ownsTransform = true;
+}
+
+Entity::Entity(std::shared_ptr<Mesh> model, std::shared_ptr<Material> mat, Transform transform) :
+	transform(transform), ownsTransform(false), model(model), mat(mat), lod(0), occluder(false)
+{
+	// Anything but the transform's version, so the first call builds them
+	boundsVersion = transform.GetVersion() - 1;
+	boundsModelReady = false;
+}
+
+Entity::~Entity()
 {
-	transform = Transform();
+	if (ownsTransform)
+		transform.Destroy();
 }
 
 std::shared_ptr<Mesh> Entity::GetModel()
@@ -28,42 +47,196 @@ void Entity::SetMat(std::shared_ptr<Material> nextMat)
 	mat = nextMat;
 }
 
+std::shared_ptr<Material> Entity::GetSubmeshMat(unsigned int slot)
+{
+	if (slot < submeshMatOverrides.size() && submeshMatOverrides[slot])
+		return submeshMatOverrides[slot];
+
+	// Looked up once, since the library compares whole definitions
+	if (libraryMats.size() != model->GetMaterialCount())
+	{
+		libraryMats.resize(model->GetMaterialCount());
+		for (unsigned int i = 0; i < libraryMats.size(); i++)
+		{
+			const MaterialDefinition& definition = model->GetMaterialDefinition(i);
+			libraryMats[i] = definition.defined ? MaterialLibrary::GetInstance().GetMaterial(definition) : nullptr;
+		}
+	}
+
+	if (slot < libraryMats.size() && libraryMats[slot])
+		return libraryMats[slot];
+
+	return mat;
+}
+
+void Entity::SetSubmeshMat(unsigned int slot, std::shared_ptr<Material> nextMat)
+{
+	if (slot >= submeshMatOverrides.size())
+		submeshMatOverrides.resize(slot + 1);
+
+	submeshMatOverrides[slot] = nextMat;
+}
+
+unsigned int Entity::GetLod()
+{
+	return lod;
+}
+
+void Entity::SetLod(unsigned int nextLod)
+{
+	lod = nextLod;
+}
+
+void Entity::SetOccluder(bool isOccluder)
+{
+	occluder = isOccluder;
+}
+
+bool Entity::IsOccluder()
+{
+	return occluder;
+}
+
+const WorldBounds& Entity::GetWorldBounds()
+{
+	// The model's bounds only become known once it has loaded
+	if (boundsVersion != transform.GetVersion() || boundsModelReady != model->IsReady())
+		UpdateWorldBounds();
+
+	return worldBounds;
+}
+
+void Entity::UpdateWorldBounds()
+{
+	DirectX::XMFLOAT4X4 world = transform.GetWorldMatrix();
+	DirectX::XMMATRIX worldMatrix = DirectX::XMLoadFloat4x4(&world);
+
+	// Box: move the center, then the new half size on each axis is the
+	// sum of the old half sizes through the absolute rotation and scale
+	// (Arvo, "Transforming Axis-Aligned Bounding Boxes", Graphics Gems)
+	DirectX::XMFLOAT3 localMin = model->GetBoundsMin();
+	DirectX::XMFLOAT3 localMax = model->GetBoundsMax();
+	DirectX::XMVECTOR center = DirectX::XMVectorScale(
+		DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&localMin), DirectX::XMLoadFloat3(&localMax)), 0.5f);
+	DirectX::XMVECTOR extents = DirectX::XMVectorScale(
+		DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&localMax), DirectX::XMLoadFloat3(&localMin)), 0.5f);
+
+	DirectX::XMVECTOR worldCenter = DirectX::XMVector3Transform(center, worldMatrix);
+	DirectX::XMVECTOR worldExtents = DirectX::XMVectorAdd(DirectX::XMVectorAdd(
+		DirectX::XMVectorMultiply(DirectX::XMVectorSplatX(extents), DirectX::XMVectorAbs(worldMatrix.r[0])),
+		DirectX::XMVectorMultiply(DirectX::XMVectorSplatY(extents), DirectX::XMVectorAbs(worldMatrix.r[1]))),
+		DirectX::XMVectorMultiply(DirectX::XMVectorSplatZ(extents), DirectX::XMVectorAbs(worldMatrix.r[2])));
+
+	DirectX::XMStoreFloat3(&worldBounds.boxMin, DirectX::XMVectorSubtract(worldCenter, worldExtents));
+	DirectX::XMStoreFloat3(&worldBounds.boxMax, DirectX::XMVectorAdd(worldCenter, worldExtents));
+
+	// Sphere: move the center and grow the radius by the largest scale
+	float maxScaleSq = DirectX::XMVectorGetX(DirectX::XMVectorMax(
+		DirectX::XMVector3LengthSq(worldMatrix.r[0]), DirectX::XMVectorMax(
+		DirectX::XMVector3LengthSq(worldMatrix.r[1]),
+		DirectX::XMVector3LengthSq(worldMatrix.r[2]))));
+
+	DirectX::XMFLOAT3 sphereCenter = model->GetBoundsCenter();
+	DirectX::XMStoreFloat3(&worldBounds.sphereCenter,
+		DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&sphereCenter), worldMatrix));
+	worldBounds.sphereRadius = model->GetBoundsRadius() * sqrtf(maxScaleSq);
+
+	boundsVersion = transform.GetVersion();
+	boundsModelReady = model->IsReady();
+}
+
+bool Entity::Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, RayHit& hit)
+{
+	// Reject against the bounding sphere before touching any triangles
+	const WorldBounds& bounds = GetWorldBounds();
+	DirectX::XMVECTOR rayOrigin = DirectX::XMLoadFloat3(&origin);
+	DirectX::XMVECTOR rayDirection = DirectX::XMLoadFloat3(&direction);
+	DirectX::XMVECTOR toOrigin = DirectX::XMVectorSubtract(rayOrigin, DirectX::XMLoadFloat3(&bounds.sphereCenter));
+	float a = DirectX::XMVectorGetX(DirectX::XMVector3Dot(rayDirection, rayDirection));
+	float b = DirectX::XMVectorGetX(DirectX::XMVector3Dot(toOrigin, rayDirection));
+	float c = DirectX::XMVectorGetX(DirectX::XMVector3Dot(toOrigin, toOrigin)) - bounds.sphereRadius * bounds.sphereRadius;
+	float discriminant = b * b - a * c;
+	if (a <= 0.0f || discriminant < 0.0f || (c > 0.0f && b > 0.0f))
+		return false;
+
+	float sphereDistance = std::max(0.0f, (-b - sqrtf(discriminant)) / a);
+	if (sphereDistance > maxDistance)
+		return false;
+
+	if (!model->IsReady() || !model->HasBvh())
+	{
+		hit.distance = sphereDistance;
+		hit.u = 0.0f;
+		hit.v = 0.0f;
+		hit.triangle = RAY_HIT_NO_TRIANGLE;
+		return true;
+	}
+
+	// Into the model's space, leaving the direction unnormalized
+	// so distances along it are the same as in world space
+	// The inverse transpose is already kept up to date, so just flip it back
+	DirectX::XMFLOAT4X4 worldInverseTranspose = transform.GetWorldInverseTransposeMatrix();
+	DirectX::XMMATRIX invWorld = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&worldInverseTranspose));
+	DirectX::XMFLOAT3 localOrigin;
+	DirectX::XMFLOAT3 localDirection;
+	DirectX::XMStoreFloat3(&localOrigin, DirectX::XMVector3TransformCoord(rayOrigin, invWorld));
+	DirectX::XMStoreFloat3(&localDirection, DirectX::XMVector3TransformNormal(rayDirection, invWorld));
+
+	return model->Raycast(localOrigin, localDirection, maxDistance, hit);
+}
+
 void Entity::Draw(
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, 
-	std::shared_ptr<Camera> camera)
+	Camera* camera)
 {
-	mat->GetVertexShader()->SetShader();
-	mat->GetPixelShader()->SetShader();
+	// Each material's part of the model, all out of the same buffers
+	if (model->IsReady() && model->GetSubmeshCount() > 1)
+	{
+		for (unsigned int i = 0; i < model->GetSubmeshCount(); i++)
+		{
+			PrepareShaders(GetSubmeshMat(model->GetSubmesh(i).material), camera);
+			model->DrawSubmesh(i);
+		}
+		return;
+	}
 
+	PrepareShaders(mat, camera);
+	DrawModel(camera);
+}
 
-	std::shared_ptr<SimpleVertexShader> vs = mat->GetVertexShader();
-	vs->SetFloat4("colorTint", mat->GetTint()); // Strings here MUST
+void Entity::PrepareShaders(std::shared_ptr<Material> drawMat, Camera* camera)
+{
+	drawMat->GetVertexShader()->SetShader();
+	drawMat->GetPixelShader()->SetShader();
+
+
+	std::shared_ptr<SimpleVertexShader> vs = drawMat->GetVertexShader();
+	vs->SetFloat4("colorTint", drawMat->GetTint()); // Strings here MUST
 	vs->SetMatrix4x4("world", transform.GetWorldMatrix()); // match variable
-	vs->SetMatrix4x4("viewMatrix", *camera->GetViewMatrix().get()); // names in your
-	vs->SetMatrix4x4("projMatrix", *camera->GetProjMatrix().get()); // shaders cbuffer!
+	vs->SetMatrix4x4("viewMatrix", camera->GetViewMatrix()); // names in your
+	vs->SetMatrix4x4("projMatrix", camera->GetProjMatrix()); // shaders cbuffer!
 	vs->SetMatrix4x4("worldInvTranspose", transform.GetWorldInverseTransposeMatrix());
+	SetDequantization(vs.get());
 
 	vs->CopyAllBufferData();
 
-	std::shared_ptr<SimplePixelShader> ps = mat->GetPixelShader();
-	ps->SetFloat4("colorTint", mat->GetTint());
+	std::shared_ptr<SimplePixelShader> ps = drawMat->GetPixelShader();
+	ps->SetFloat4("colorTint", drawMat->GetTint());
 
 	//Transform* trans = camera->GetTransform();
 	//DirectX::XMFLOAT3 pos = trans->GetPosition();
-	ps->SetFloat3("camPos", *(camera->GetTransform()->GetPosition().get()));
-	ps->SetFloat("roughness", mat->GetRoughness());
-	ps->SetFloat2("uvOffset", mat->GetUVOffset());
+	ps->SetFloat3("camPos", camera->GetTransform()->GetPosition());
+	ps->SetFloat("roughness", drawMat->GetRoughness());
+	ps->SetFloat2("uvOffset", drawMat->GetUVOffset());
 
 	ps->CopyAllBufferData();
 
-	mat->PrepareMaterial();
-
-	model->Draw();
+	drawMat->PrepareMaterial();
 }
 
 void Entity::Draw(
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, 
-	std::shared_ptr<Camera> camera, float time)
+	Camera* camera, float time)
 {
 	mat->GetVertexShader()->SetShader();
 	mat->GetPixelShader()->SetShader();
@@ -72,8 +245,9 @@ void Entity::Draw(
 	std::shared_ptr<SimpleVertexShader> vs = mat->GetVertexShader();
 	//vs->SetFloat4("colorTint", mat->GetTint()); // Strings here MUST
 	vs->SetMatrix4x4("world", transform.GetWorldMatrix()); // match variable
-	vs->SetMatrix4x4("viewMatrix", *camera->GetViewMatrix().get()); // names in your
-	vs->SetMatrix4x4("projMatrix", *camera->GetProjMatrix().get()); // shaders cbuffer!
+	vs->SetMatrix4x4("viewMatrix", camera->GetViewMatrix()); // names in your
+	vs->SetMatrix4x4("projMatrix", camera->GetProjMatrix()); // shaders cbuffer!
+	SetDequantization(vs.get());
 
 	vs->CopyAllBufferData();
 
@@ -83,5 +257,67 @@ void Entity::Draw(
 
 	ps->CopyAllBufferData();
 
-	model->Draw();
+	DrawModel(camera);
+}
+
+void Entity::DrawQueued(const DrawPacket& packet, Camera* camera)
+{
+	SimpleVertexShader* vs = packet.vertexShader;
+	vs->SetMatrix4x4("world", transform.GetWorldMatrix());
+	vs->SetMatrix4x4("worldInvTranspose", transform.GetWorldInverseTransposeMatrix());
+	SetDequantization(vs);
+	vs->CopyAllBufferData();
+
+	if (packet.submesh == RENDER_QUEUE_WHOLE_MESH)
+		DrawModel(camera);
+	else
+		model->DrawSubmesh(packet.submesh);
 }
+
+void Entity::SetDequantization(SimpleVertexShader* vs)
+{
+	// Full vertices have nothing to undo, and their shader has no room for it
+	std::shared_ptr<Mesh> drawn = GetDrawnModel();
+	if (!drawn || drawn->GetVertexFormat() == VERTEX_FORMAT_FULL)
+		return;
+
+	VertexDequantization dq = drawn->GetDequantization();
+	vs->SetFloat3("positionRangeOffset", dq.positionOffset);
+	vs->SetFloat3("positionRangeScale", dq.positionScale);
+	vs->SetFloat2("uvRangeOffset", dq.uvOffset);
+	vs->SetFloat2("uvRangeScale", dq.uvScale);
+}
+
+std::shared_ptr<Mesh> Entity::GetDrawnModel()
+{
+	if (model->IsReady())
+		return model;
+
+	return MeshLoader::GetInstance().GetPlaceholder(model->GetVertexFormat());
+}
+
+void Entity::DrawModel(Camera* camera)
+{
+	// Still loading, so draw the stand in
+	if (!model->IsReady())
+	{
+		std::shared_ptr<Mesh> placeholder = GetDrawnModel();
+		if (placeholder)
+			placeholder->Draw();
+		return;
+	}
+
+	// Clustered meshes only draw the parts the camera can see
+	if (lod == 0 && model->HasMeshlets())
+	{
+		model->CullMeshlets(
+			camera->GetFrustum(),
+			camera->GetTransform()->GetPosition(),
+			transform.GetWorldMatrix(),
+			visibleRanges);
+		model->DrawRanges(visibleRanges);
+		return;
+	}
+
+	model->Draw(lod);
+}
\ No newline at end of file
@@ -5,28 +5,121 @@
 #include "Transform.h"
 #include "Mesh.h"
 #include "Camera.h"
+#include "Pool.h"
+#include "RenderQueue.h"
 
 #include "Material.h"
 
 
+/*
+	World space bounding volumes of an entity's mesh
+*/
+struct WorldBounds
+{
+	DirectX::XMFLOAT3 boxMin;
+	DirectX::XMFLOAT3 boxMax;
+	DirectX::XMFLOAT3 sphereCenter;
+	float sphereRadius;
+};
+
 class Entity
 {
 private:
 	Transform transform;
+	// False when the transform came from elsewhere, like an imported hierarchy
+	bool ownsTransform;
 	std::shared_ptr<Mesh> model;
 	std::shared_ptr<Material> mat;
+
+	// Per material slot, for models with several submeshes. Overrides win,
+	// then materials from the model's libraries, then the entity's own
+	std::vector<std::shared_ptr<Material>> submeshMatOverrides;
+	std::vector<std::shared_ptr<Material>> libraryMats;
+
+	// Which of the model's levels of detail gets drawn
+	unsigned int lod;
+
+	// Whether the model's occluder shape hides what's behind it
+	bool occluder;
+
+	// Meshlets that survived culling, kept to reuse the allocation
+	std::vector<IndexRange> visibleRanges;
+
+	// Cached world bounds and the transform version they were built from
+	WorldBounds worldBounds;
+	unsigned int boundsVersion;
+	bool boundsModelReady;
+	void UpdateWorldBounds();
+
+	// Set a material's shaders and send them this entity's per draw data
+	void PrepareShaders(std::shared_ptr<Material> drawMat, Camera* camera);
+	// Compact vertex formats need their ranges sent to the vertex shader
+	void SetDequantization(SimpleVertexShader* vs);
+	// Draw the model's current LOD, or just its visible meshlets
+	void DrawModel(Camera* camera);
+	// The model, or the loader's placeholder while the model is still loading
+	std::shared_ptr<Mesh> GetDrawnModel();
 	
 public:
 	Entity(std::shared_ptr<Mesh> model, std::shared_ptr<Material> mat);
+	/// <summary>
+	/// Create an entity that uses an existing transform, like a node of
+	/// an imported hierarchy. Entities may share a transform, and whoever
+	/// created it still has to destroy it
+	/// </summary>
+	Entity(std::shared_ptr<Mesh> model, std::shared_ptr<Material> mat, Transform transform);
+	~Entity();
+
+	// May own its transform, so it can't be copied
+	Entity(const Entity&) = delete;
+	Entity& operator=(const Entity&) = delete;
 
 	std::shared_ptr<Mesh> GetModel();
 	Transform* GetTransform();
 	std::shared_ptr<Material> GetMat();
 	void SetMat(std::shared_ptr<Material> nextMat);
+	/// <summary>
+	/// Get the material one of the model's material slots is drawn with.
+	/// Only used when the model has more than one submesh
+	/// </summary>
+	std::shared_ptr<Material> GetSubmeshMat(unsigned int slot);
+	/// <summary>
+	/// Draw one of the model's material slots with the given material instead
+	/// of the one from its library. Null goes back to the library's
+	/// </summary>
+	void SetSubmeshMat(unsigned int slot, std::shared_ptr<Material> nextMat);
+	unsigned int GetLod();
+	void SetLod(unsigned int nextLod);
+	/// <summary>
+	/// Mark the entity as something big and solid, so the scene rasterizes
+	/// its model's occluder shape and skips whatever ends up behind it
+	/// </summary>
+	void SetOccluder(bool isOccluder);
+	bool IsOccluder();
+
+	/// <summary>
+	/// Get the model's bounds in world space. Only recalculated
+	/// when the transform has changed since the last call
+	/// </summary>
+	const WorldBounds& GetWorldBounds();
+
+	/// <summary>
+	/// Cast a world space ray against the model. Models with a BVH report
+	/// the exact triangle hit, any others only their bounding sphere
+	/// </summary>
+	bool Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, RayHit& hit);
 
 	// In the future this could be allocated to a rendering class that holds all drawing data intstead
 	// of objects drawing themselves 
-	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera>);
-	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera>, float time); // FOR NOISE DEMO 
+	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* camera);
+	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* camera, float time); // FOR NOISE DEMO 
+	/// <summary>
+	/// Draw one of this entity's packets from a RenderQueue. Whoever walks
+	/// the queue has already set the packet's shaders and material, so
+	/// only the entity's own data is sent
+	/// </summary>
+	void DrawQueued(const DrawPacket& packet, Camera* camera);
 };
 
+typedef PoolHandle<Entity> EntityHandle;
+
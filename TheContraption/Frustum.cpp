@@ -0,0 +1,182 @@
+#include "Frustum.h"
+
+#include <cmath>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// Every plane with each component splatted across a register, so four
+	// bounds can be tested against one plane at once
+	struct SplatPlanes
+	{
+		__m128 x[FRUSTUM_PLANE_COUNT];
+		__m128 y[FRUSTUM_PLANE_COUNT];
+		__m128 z[FRUSTUM_PLANE_COUNT];
+		__m128 w[FRUSTUM_PLANE_COUNT];
+	};
+
+	inline SplatPlanes Splat(const XMFLOAT4* planes, bool absoluteNormals)
+	{
+		SplatPlanes splat;
+		for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+		{
+			const XMFLOAT4& p = planes[i];
+			splat.x[i] = _mm_set1_ps(absoluteNormals ? fabsf(p.x) : p.x);
+			splat.y[i] = _mm_set1_ps(absoluteNormals ? fabsf(p.y) : p.y);
+			splat.z[i] = _mm_set1_ps(absoluteNormals ? fabsf(p.z) : p.z);
+			splat.w[i] = _mm_set1_ps(p.w);
+		}
+		return splat;
+	}
+
+	// Summed in the same order as the scalar tests, so every lane agrees with them exactly
+	inline __m128 PlaneDistances(const SplatPlanes& planes, int i, __m128 x, __m128 y, __m128 z)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(planes.x[i], x), _mm_mul_ps(planes.y[i], y)),
+			_mm_mul_ps(planes.z[i], z)), planes.w[i]);
+	}
+
+	// Append the four indices from first on whose bits are set, without
+	// branching. Every index is written, but only kept ones move the end
+	inline size_t Compact(int mask, unsigned int first, unsigned int* visible, size_t visibleCount)
+	{
+		visible[visibleCount] = first;
+		visibleCount += mask & 1;
+		visible[visibleCount] = first + 1;
+		visibleCount += (mask >> 1) & 1;
+		visible[visibleCount] = first + 2;
+		visibleCount += (mask >> 2) & 1;
+		visible[visibleCount] = first + 3;
+		visibleCount += (mask >> 3) & 1;
+		return visibleCount;
+	}
+}
+
+Frustum Frustum::FromViewProjection(const XMFLOAT4X4& m)
+{
+	// Row vectors are multiplied on the left, so each plane is a sum
+	// of the matrix's columns. D3D clips z to [0, w], so near is just z
+	Frustum frustum;
+	frustum.planes[FRUSTUM_PLANE_LEFT] = XMFLOAT4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);
+	frustum.planes[FRUSTUM_PLANE_RIGHT] = XMFLOAT4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);
+	frustum.planes[FRUSTUM_PLANE_BOTTOM] = XMFLOAT4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);
+	frustum.planes[FRUSTUM_PLANE_TOP] = XMFLOAT4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);
+	frustum.planes[FRUSTUM_PLANE_NEAR] = XMFLOAT4(m._13, m._23, m._33, m._43);
+	frustum.planes[FRUSTUM_PLANE_FAR] = XMFLOAT4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);
+
+	// Unit normals so plane distances are real distances
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+	{
+		XMVECTOR plane = XMPlaneNormalize(XMLoadFloat4(&frustum.planes[i]));
+		XMStoreFloat4(&frustum.planes[i], plane);
+	}
+
+	return frustum;
+}
+
+bool Frustum::IntersectsSphere(const XMFLOAT3& center, float radius) const
+{
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+	{
+		const XMFLOAT4& p = planes[i];
+		if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::IntersectsBox(const XMFLOAT3& center, const XMFLOAT3& extents) const
+{
+	// The box reaches toward a plane by its extents along the plane's normal
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+	{
+		const XMFLOAT4& p = planes[i];
+		float reach = fabsf(p.x) * extents.x + fabsf(p.y) * extents.y + fabsf(p.z) * extents.z;
+		if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -reach)
+			return false;
+	}
+	return true;
+}
+
+size_t Frustum::CullSpheres(const XMFLOAT4* spheres, size_t count, unsigned int* visible) const
+{
+	SplatPlanes splat = Splat(planes, false);
+
+	// Turned sideways like TransformMath's batches, so each register
+	// holds one component of four spheres
+	size_t visibleCount = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&spheres[i].x);
+		__m128 y = _mm_loadu_ps(&spheres[i + 1].x);
+		__m128 z = _mm_loadu_ps(&spheres[i + 2].x);
+		__m128 radius = _mm_loadu_ps(&spheres[i + 3].x);
+		_MM_TRANSPOSE4_PS(x, y, z, radius);
+
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(PlaneDistances(splat, p, x, y, z), negativeRadius));
+
+		visibleCount = Compact(~_mm_movemask_ps(outside), (unsigned int)i, visible, visibleCount);
+	}
+
+	for (; i < count; i++)
+	{
+		XMFLOAT3 center(spheres[i].x, spheres[i].y, spheres[i].z);
+		if (IntersectsSphere(center, spheres[i].w))
+			visible[visibleCount++] = (unsigned int)i;
+	}
+
+	return visibleCount;
+}
+
+size_t Frustum::CullBoxes(const XMFLOAT4* centers, const XMFLOAT4* extents, size_t count, unsigned int* visible) const
+{
+	SplatPlanes splat = Splat(planes, false);
+	SplatPlanes absolute = Splat(planes, true);
+
+	size_t visibleCount = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&centers[i].x);
+		__m128 cy = _mm_loadu_ps(&centers[i + 1].x);
+		__m128 cz = _mm_loadu_ps(&centers[i + 2].x);
+		__m128 cw = _mm_loadu_ps(&centers[i + 3].x);
+		_MM_TRANSPOSE4_PS(cx, cy, cz, cw);
+
+		__m128 ex = _mm_loadu_ps(&extents[i].x);
+		__m128 ey = _mm_loadu_ps(&extents[i + 1].x);
+		__m128 ez = _mm_loadu_ps(&extents[i + 2].x);
+		__m128 ew = _mm_loadu_ps(&extents[i + 3].x);
+		_MM_TRANSPOSE4_PS(ex, ey, ez, ew);
+
+		// The corner furthest along each plane's normal decides it, which
+		// is the center pushed out by the extents over the absolute normal
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+		{
+			__m128 reach = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(absolute.x[p], ex), _mm_mul_ps(absolute.y[p], ey)), _mm_mul_ps(absolute.z[p], ez));
+			__m128 negativeReach = _mm_sub_ps(_mm_setzero_ps(), reach);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(PlaneDistances(splat, p, cx, cy, cz), negativeReach));
+		}
+
+		visibleCount = Compact(~_mm_movemask_ps(outside), (unsigned int)i, visible, visibleCount);
+	}
+
+	for (; i < count; i++)
+	{
+		XMFLOAT3 center(centers[i].x, centers[i].y, centers[i].z);
+		XMFLOAT3 extent(extents[i].x, extents[i].y, extents[i].z);
+		if (IntersectsBox(center, extent))
+			visible[visibleCount++] = (unsigned int)i;
+	}
+
+	return visibleCount;
+}
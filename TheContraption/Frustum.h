@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <DirectXMath.h>
+
+// Order of the planes in Frustum::planes
+enum FrustumPlane
+{
+	FRUSTUM_PLANE_LEFT,
+	FRUSTUM_PLANE_RIGHT,
+	FRUSTUM_PLANE_BOTTOM,
+	FRUSTUM_PLANE_TOP,
+	FRUSTUM_PLANE_NEAR,
+	FRUSTUM_PLANE_FAR,
+	FRUSTUM_PLANE_COUNT
+};
+
+/*
+	The six planes of a camera's view volume in world space. Each plane
+	is (normal, d) with a unit normal pointing into the volume, so a
+	point p is inside a plane when dot(normal, p) + d >= 0
+*/
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[FRUSTUM_PLANE_COUNT];
+
+	/// <summary>
+	/// Pull the planes out of a combined view * projection matrix
+	/// (Gribb & Hartmann, "Fast Extraction of Viewing Frustum Planes")
+	/// </summary>
+	static Frustum FromViewProjection(const DirectX::XMFLOAT4X4& viewProj);
+
+	/// <summary>
+	/// False only if the sphere is entirely outside one of the planes
+	/// </summary>
+	bool IntersectsSphere(const DirectX::XMFLOAT3& center, float radius) const;
+	/// <summary>
+	/// False only if the box is entirely outside one of the planes
+	/// </summary>
+	bool IntersectsBox(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents) const;
+
+	/// <summary>
+	/// Test spheres, each a center with the radius in w, four at a time.
+	/// Writes the indices of the ones that aren't culled to the front of
+	/// visible, which needs room for count, and returns how many there are
+	/// </summary>
+	size_t CullSpheres(const DirectX::XMFLOAT4* spheres, size_t count, unsigned int* visible) const;
+	/// <summary>
+	/// Test axis aligned boxes, given as centers and half sizes with w
+	/// unused, four at a time. Writes the indices of the ones that aren't
+	/// culled to the front of visible, which needs room for count, and
+	/// returns how many there are
+	/// </summary>
+	size_t CullBoxes(const DirectX::XMFLOAT4* centers, const DirectX::XMFLOAT4* extents, size_t count, unsigned int* visible) const;
+};
@@ -5,7 +5,12 @@
 
 #include <memory>
 #include "Mesh.h"
+#include "MeshLoader.h"
+#include "GeometryArena.h"
+#include "MaterialLibrary.h"
 #include "Transform.h"
+#include "TransformSystem.h"
+#include "JobSystem.h"
 
 
 // Assumes files are in "ImGui" subfolder!
@@ -65,6 +70,11 @@ Game::~Game()
 	// Call Release() on any Direct3D objects made within this class
 	// - Note: this is unnecessary for D3D objects stored in ComPtrs
 	
+	// Stop the loader threads before anything they use goes away
+	delete& MeshLoader::GetInstance();
+	delete& MaterialLibrary::GetInstance();
+	delete& JobSystem::GetInstance();
+
 	// ImGui clean up
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
@@ -78,6 +88,10 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	JobSystem::GetInstance().Initialize();
+	GeometryArena::GetInstance().Initialize(device, context);
+	MeshLoader::GetInstance().Initialize(device, context);
+
 	LoadLights();
 	LoadShaders();
 	CreateGeometry();
@@ -245,11 +259,14 @@ void Game::CreateGeometry()
 
 	
 
-	std::shared_ptr<Mesh> sphere = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/sphere.obj").c_str());
-	std::shared_ptr<Mesh> helix = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/helix.obj").c_str());
-	std::shared_ptr<Mesh> cube = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/cube.obj").c_str());
-	std::shared_ptr<Mesh> torus = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/torus.obj").c_str());
-	std::shared_ptr<Mesh> lightGUIModel = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/LightGUIModel.obj").c_str());
+	// Meshes load in the background and show a placeholder until they're ready
+	MeshLoader& meshLoader = MeshLoader::GetInstance();
+	// Scene models keep a BVH so they can be picked precisely
+	std::shared_ptr<Mesh> sphere = meshLoader.Load(FixPath(L"../../Assets/Models/sphere.obj").c_str(), VERTEX_FORMAT_FULL, TANGENT_MODE_FAST, false, true);
+	std::shared_ptr<Mesh> helix = meshLoader.Load(FixPath(L"../../Assets/Models/helix.obj").c_str(), VERTEX_FORMAT_FULL, TANGENT_MODE_FAST, true, true);
+	std::shared_ptr<Mesh> cube = meshLoader.Load(FixPath(L"../../Assets/Models/cube.obj").c_str(), VERTEX_FORMAT_FULL, TANGENT_MODE_FAST, false, true);
+	std::shared_ptr<Mesh> torus = meshLoader.Load(FixPath(L"../../Assets/Models/torus.obj").c_str(), VERTEX_FORMAT_FULL, TANGENT_MODE_FAST, false, true);
+	std::shared_ptr<Mesh> lightGUIModel = meshLoader.Load(FixPath(L"../../Assets/Models/LightGUIModel.obj").c_str());
 
 	std::shared_ptr<Sky> sky = std::make_shared<Sky>(
 		device,
@@ -274,6 +291,9 @@ void Game::CreateGeometry()
 		L"../../Assets/Textures/original.png"
 	);
 
+	// Materials from .MTL libraries are drawn with the lit shader too
+	MaterialLibrary::GetInstance().Initialize(device, context, vertexShader, litShader, sampler);
+
 	SetupLitMaterial(
 		schlickBricks,
 		L"../../Assets/Textures/ass9/cobblestone.png",
@@ -290,65 +310,59 @@ void Game::CreateGeometry()
 	);
 	schlickCushions->AddTextureSRV("Environment", sky->GetCubeSRV());
 	
-	std::vector<std::shared_ptr<Entity>> entities = std::vector<std::shared_ptr<Entity>>();
+	// Add all entites to the scene's pool 
+	EntityHandle helixEntity = scene->CreateEntity(helix, lit);
+	scene->GetEntity(helixEntity)->GetTransform()->SetPosition(1.0f, 0.0f, 0.0f);
 
-	// Add all entites to the primary vector 
-	entities.push_back(std::shared_ptr<Entity>(new Entity(helix, lit)));
-	entities[0]->GetTransform()->SetPosition(1.0f, 0.0f, 0.0f);
+	EntityHandle sphereEntity = scene->CreateEntity(sphere, schlickBricks);
+	scene->GetEntity(sphereEntity)->GetTransform()->MoveRelative(5.0f, 0.0f, 0.0f);
 
-	entities.push_back(std::shared_ptr<Entity>(new Entity(sphere, schlickBricks)));
-	entities[1]->GetTransform()->MoveRelative(5.0f, 0.0f, 0.0f);
+	EntityHandle cubeEntity = scene->CreateEntity(cube, schlickCushions);
+	scene->GetEntity(cubeEntity)->GetTransform()->MoveRelative(-5.0f, 0.0f, 0.0f);
+	scene->GetEntity(cubeEntity)->SetOccluder(true);
 
-	entities.push_back(std::shared_ptr<Entity>(new Entity(cube, schlickCushions)));
-	entities[2]->GetTransform()->MoveRelative(-5.0f, 0.0f, 0.0f);
-
-	scene->SetEntities(entities);
 	scene->GenerateLightGizmos(lightGUIModel, vertexShader, pixelShader);
 }
 
 
 void Game::CreateCameras()
 {
-	std::vector<std::shared_ptr<Camera>> cameras = std::vector<std::shared_ptr<Camera>>();
-
 	// Create the cameras 
-	cameras.push_back(std::make_shared<Camera>(
+	scene->CreateCamera(
 		0.0f, 0.0f, -5.0f,						// Pos
 		1.0f,									// Move speed
 		10.0f,									// Sprint speed (hold left shift)
 		0.1f,									// Mouse look speed 
 		XM_PIDIV4,								// FOV 
 		this->windowWidth / this->windowHeight	// Aspect ratio 
-		));
+		);
 
-	cameras.push_back(std::make_shared<Camera>(
+	scene->CreateCamera(
 		0.0f, 0.0f, -20.0f,						// Pos
 		3.0f,									// Move speed
 		10.0f,									// Sprint speed (hold left shift)
 		0.1f,									// Mouse look speed 
 		XM_PIDIV4,								// FOV 
 		this->windowWidth / this->windowHeight	// Aspect ratio 
-		));
+		);
 
-	cameras.push_back(std::make_shared<Camera>(
+	scene->CreateCamera(
 		2.0f, 1.5f, -15.0f,						// Pos
 		1.0f,									// Move speed
 		10.0f,									// Sprint speed (hold left shift)
 		0.1f,									// Mouse look speed 
 		XM_PI / 8,								// FOV 
 		this->windowWidth / this->windowHeight	// Aspect ratio 
-		));
+		);
 
-	cameras.push_back(std::make_shared<Camera>(
+	scene->CreateCamera(
 		-1.0f, 1.0f, -5.0f,						// Pos
 		1.0f,									// Move speed
 		10.0f,									// Sprint speed (hold left shift)
 		0.1f,									// Mouse look speed 
 		XM_PIDIV2,								// FOV 
 		this->windowWidth / this->windowHeight	// Aspect ratio 
-		));
-
-	scene->SetCameras(cameras);
+		);
 }
 
 // --------------------------------------------------------
@@ -406,7 +420,7 @@ void Game::UpdateImGui(float deltaTime)
 		sceneGui->UpdateLightGUI(scene->GetLights(), scene->GetLightToGizmos());
 		break;
 	case SHOW_GUI_CAMERA:
-		sceneGui->UpdateCameraGUI(scene->GetAllCams(), scene.get(), (float)this->windowWidth, (float)this->windowHeight);
+		sceneGui->UpdateCameraGUI(scene.get(), (float)this->windowWidth, (float)this->windowHeight);
 		break;
 	default:
 		break;
@@ -420,11 +434,35 @@ void Game::UpdateImGui(float deltaTime)
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	// Upload any meshes that finished loading
+	MeshLoader::GetInstance().Update();
+	GeometryArena::GetInstance().Update();
+
 	UpdateImGui(deltaTime);
 	float mouseLookSpeed = 2.0f; 
 
 	scene->GetCurrentCam()->Update(deltaTime);
 
+	// Clicking in the scene selects whatever is under the mouse
+	Input& input = Input::GetInstance();
+	if (input.MouseLeftPress())
+	{
+		Camera* cam = scene->GetCurrentCam();
+		XMFLOAT3 origin;
+		XMFLOAT3 direction;
+		cam->GetPickRay((float)input.GetMouseX(), (float)input.GetMouseY(), (float)windowWidth, (float)windowHeight, origin, direction);
+
+		RayHit hit = {};
+		EntityHandle picked = scene->Pick(origin, direction, cam->GetFarClip(), hit);
+		sceneGui->SelectEntity(picked, hit);
+		if (scene->GetEntity(picked))
+			currentGUI = SHOW_GUI_ENTITIES;
+	}
+
+	// Everything has moved for this frame, so rebuild the matrices together,
+	// spread across every core
+	TransformSystem::GetInstance().UpdateTransforms();
+
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::GetInstance().KeyDown(VK_ESCAPE))
 		Quit();
@@ -445,6 +483,9 @@ void Game::Draw(float deltaTime, float totalTime)
 
 		// Clear the depth buffer (resets per-pixel occlusion information)
 		context->ClearDepthStencilView(depthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+		// Last frame's UI bound its own buffers
+		GeometryArena::GetInstance().InvalidateBindings();
 	}
 
 	scene->DrawEntities(context);
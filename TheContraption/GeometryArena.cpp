@@ -0,0 +1,311 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <climits>
+
+// Singleton requirement
+GeometryArena* GeometryArena::instance;
+
+GeometryArena::GeometryArena() :
+	boundFormat(-1), indexBound(false), bindCount(0)
+{
+	for (int format = 0; format < VERTEX_FORMAT_COUNT; format++)
+	{
+		vertexPools[format].stride = VertexCompression::GetStride((VertexFormat)format);
+		vertexPools[format].bindFlags = D3D11_BIND_VERTEX_BUFFER;
+	}
+
+	indexPool.stride = sizeof(unsigned int);
+	indexPool.bindFlags = D3D11_BIND_INDEX_BUFFER;
+}
+
+void GeometryArena::Initialize(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	this->device = device;
+	this->context = context;
+}
+
+unsigned int GeometryArena::Allocate(VertexFormat format, const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+{
+	if (vertexCount == 0 || indexCount == 0)
+		return GEOMETRY_ARENA_INVALID;
+
+	Pool& vertexPool = GetVertexPool(format);
+
+	// Both pools make room before either range is taken. Making room can
+	// compact, which only moves allocations it knows about, so a range
+	// taken before that would end up pointing at someone else's data
+	if (!MakeRoom(vertexPool, vertexCount, GEOMETRY_ARENA_INITIAL_VERTICES) ||
+		!MakeRoom(indexPool, indexCount, GEOMETRY_ARENA_INITIAL_INDICES))
+		return GEOMETRY_ARENA_INVALID;
+
+	GeometryAllocation allocation;
+	allocation.format = format;
+	allocation.vertexCount = vertexCount;
+	allocation.indexCount = indexCount;
+	allocation.baseVertex = vertexPool.allocator.Allocate(vertexCount);
+	allocation.firstIndex = indexPool.allocator.Allocate(indexCount);
+
+	Write(vertexPool, allocation.baseVertex, vertices, vertexCount);
+	Write(indexPool, allocation.firstIndex, indices, indexCount);
+
+	unsigned int handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		allocations[handle] = allocation;
+		live[handle] = true;
+	}
+	else
+	{
+		handle = (unsigned int)allocations.size();
+		allocations.push_back(allocation);
+		live.push_back(true);
+	}
+
+	return handle;
+}
+
+void GeometryArena::Free(unsigned int handle)
+{
+	if (handle >= allocations.size() || !live[handle])
+		return;
+
+	const GeometryAllocation& allocation = allocations[handle];
+	GetVertexPool(allocation.format).allocator.Free(allocation.baseVertex, allocation.vertexCount);
+	indexPool.allocator.Free(allocation.firstIndex, allocation.indexCount);
+
+	live[handle] = false;
+	freeHandles.push_back(handle);
+}
+
+void GeometryArena::Update()
+{
+	// Waiting until here means freeing a batch of meshes packs things once
+	if (GetFragmentation() > GEOMETRY_ARENA_COMPACT_THRESHOLD)
+		Compact();
+}
+
+const GeometryAllocation& GeometryArena::GetAllocation(unsigned int handle)
+{
+	static const GeometryAllocation empty = { VERTEX_FORMAT_FULL, 0, 0, 0, 0 };
+	if (handle >= allocations.size() || !live[handle])
+		return empty;
+
+	return allocations[handle];
+}
+
+void GeometryArena::Bind(VertexFormat format)
+{
+	if (boundFormat != (int)format)
+	{
+		Pool& pool = GetVertexPool(format);
+		UINT stride = pool.stride;
+		UINT offset = 0;
+		if (context)
+			context->IASetVertexBuffers(0, 1, pool.buffer.GetAddressOf(), &stride, &offset);
+
+		boundFormat = (int)format;
+		bindCount++;
+	}
+
+	if (!indexBound)
+	{
+		if (context)
+			context->IASetIndexBuffer(indexPool.buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+
+		indexBound = true;
+		bindCount++;
+	}
+}
+
+void GeometryArena::InvalidateBindings()
+{
+	boundFormat = -1;
+	indexBound = false;
+}
+
+// --------------------------------------------------------
+// Rebuilds each buffer with its live allocations packed to
+// the front, in their current order. D3D11 can't copy
+// within a single buffer, so each one gets a new buffer
+// --------------------------------------------------------
+void GeometryArena::Compact()
+{
+	// Live allocations in the order they sit in each buffer
+	std::vector<unsigned int> byVertex;
+	for (unsigned int handle = 0; handle < allocations.size(); handle++)
+	{
+		if (live[handle])
+			byVertex.push_back(handle);
+	}
+	std::vector<unsigned int> byIndex(byVertex);
+
+	std::sort(byVertex.begin(), byVertex.end(), [this](unsigned int a, unsigned int b)
+		{ return allocations[a].baseVertex < allocations[b].baseVertex; });
+	std::sort(byIndex.begin(), byIndex.end(), [this](unsigned int a, unsigned int b)
+		{ return allocations[a].firstIndex < allocations[b].firstIndex; });
+
+	for (int format = 0; format < VERTEX_FORMAT_COUNT; format++)
+	{
+		Pool& pool = vertexPools[format];
+		if (pool.allocator.GetCapacity() == 0)
+			continue;
+
+		// Without a new buffer this format just stays as it is
+		Microsoft::WRL::ComPtr<ID3D11Buffer> packed;
+		if (!CreateBuffer(pool, pool.allocator.GetCapacity(), packed))
+			continue;
+		pool.allocator.Reset(pool.allocator.GetCapacity());
+
+		for (unsigned int handle : byVertex)
+		{
+			GeometryAllocation& allocation = allocations[handle];
+			if (allocation.format != format)
+				continue;
+
+			unsigned int offset = pool.allocator.Allocate(allocation.vertexCount);
+			Copy(pool, packed, offset, allocation.baseVertex, allocation.vertexCount);
+			allocation.baseVertex = offset;
+		}
+		pool.buffer = packed;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> packed;
+	if (indexPool.allocator.GetCapacity() > 0 && CreateBuffer(indexPool, indexPool.allocator.GetCapacity(), packed))
+	{
+		indexPool.allocator.Reset(indexPool.allocator.GetCapacity());
+
+		for (unsigned int handle : byIndex)
+		{
+			GeometryAllocation& allocation = allocations[handle];
+			unsigned int offset = indexPool.allocator.Allocate(allocation.indexCount);
+			Copy(indexPool, packed, offset, allocation.firstIndex, allocation.indexCount);
+			allocation.firstIndex = offset;
+		}
+		indexPool.buffer = packed;
+	}
+
+	InvalidateBindings();
+}
+
+float GeometryArena::GetFragmentation()
+{
+	float worst = indexPool.allocator.GetFragmentation();
+	for (int format = 0; format < VERTEX_FORMAT_COUNT; format++)
+		worst = std::max(worst, vertexPools[format].allocator.GetFragmentation());
+	return worst;
+}
+
+unsigned int GeometryArena::GetBindCount()
+{
+	return bindCount;
+}
+
+unsigned int GeometryArena::GetVertexCapacity(VertexFormat format)
+{
+	return GetVertexPool(format).allocator.GetCapacity();
+}
+
+unsigned int GeometryArena::GetIndexCapacity()
+{
+	return indexPool.allocator.GetCapacity();
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> GeometryArena::GetVertexBuffer(VertexFormat format)
+{
+	return GetVertexPool(format).buffer;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> GeometryArena::GetIndexBuffer()
+{
+	return indexPool.buffer;
+}
+
+GeometryArena::Pool& GeometryArena::GetVertexPool(VertexFormat format)
+{
+	return vertexPools[format];
+}
+
+bool GeometryArena::MakeRoom(Pool& pool, unsigned int count, unsigned int initialCapacity)
+{
+	if (pool.allocator.GetLargestFreeRange() >= count)
+		return true;
+
+	// Out of room, so double until it fits and move everything over.
+	// Offsets don't change, so nothing else needs to know
+	unsigned int oldCapacity = pool.allocator.GetCapacity();
+	unsigned int newCapacity = std::max(oldCapacity, initialCapacity);
+	while (newCapacity - pool.allocator.GetUsed() < count || newCapacity == oldCapacity)
+	{
+		// Past this the buffer's size in bytes wouldn't fit in a UINT
+		if (newCapacity > UINT_MAX / 2 / pool.stride)
+			return false;
+		newCapacity *= 2;
+	}
+
+	// If the bigger buffer can't be made, everything stays where it was
+	Microsoft::WRL::ComPtr<ID3D11Buffer> grown;
+	if (!CreateBuffer(pool, newCapacity, grown))
+		return false;
+
+	if (oldCapacity > 0)
+		Copy(pool, grown, 0, 0, oldCapacity);
+	pool.buffer = grown;
+	pool.allocator.Grow(newCapacity);
+	InvalidateBindings();
+
+	// Still fragmented enough that nothing fits, so pack it first
+	if (pool.allocator.GetLargestFreeRange() < count)
+		Compact();
+	return pool.allocator.GetLargestFreeRange() >= count;
+}
+
+bool GeometryArena::CreateBuffer(Pool& pool, unsigned int capacity, Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer)
+{
+	// Nothing to create, but the bookkeeping carries on as if there were
+	if (!device)
+		return true;
+
+	// Default usage rather than immutable, since meshes are written
+	// into it over time and it gets copied when growing or compacting
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = capacity * pool.stride;
+	desc.BindFlags = pool.bindFlags;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+	return SUCCEEDED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf()));
+}
+
+void GeometryArena::Write(Pool& pool, unsigned int offset, const void* data, unsigned int count)
+{
+	if (!context || !pool.buffer)
+		return;
+
+	D3D11_BOX box = {};
+	box.left = offset * pool.stride;
+	box.right = (offset + count) * pool.stride;
+	box.top = 0;
+	box.bottom = 1;
+	box.front = 0;
+	box.back = 1;
+	context->UpdateSubresource(pool.buffer.Get(), 0, &box, data, 0, 0);
+}
+
+void GeometryArena::Copy(Pool& pool, Microsoft::WRL::ComPtr<ID3D11Buffer> destination, unsigned int destinationOffset, unsigned int sourceOffset, unsigned int count)
+{
+	if (!context || !pool.buffer || !destination || count == 0)
+		return;
+
+	D3D11_BOX box = {};
+	box.left = sourceOffset * pool.stride;
+	box.right = (sourceOffset + count) * pool.stride;
+	box.top = 0;
+	box.bottom = 1;
+	box.front = 0;
+	box.back = 1;
+	context->CopySubresourceRegion(destination.Get(), 0, destinationOffset * pool.stride, 0, 0, pool.buffer.Get(), 0, &box);
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "RangeAllocator.h"
+#include "VertexCompression.h"
+
+// Returned for allocations that couldn't be made
+#define GEOMETRY_ARENA_INVALID 0xFFFFFFFFu
+// Starting size of each buffer, in vertices and indices. They double when full
+#define GEOMETRY_ARENA_INITIAL_VERTICES (1 << 16)
+#define GEOMETRY_ARENA_INITIAL_INDICES (1 << 18)
+// Free space this broken up gets compacted on the next update
+#define GEOMETRY_ARENA_COMPACT_THRESHOLD 0.5f
+
+// --------------------------------------------------------
+// Where a mesh's geometry lives inside the arena
+// --------------------------------------------------------
+struct GeometryAllocation
+{
+	VertexFormat format;
+	unsigned int baseVertex;	// Added to every index, so indices stay mesh local
+	unsigned int vertexCount;
+	unsigned int firstIndex;
+	unsigned int indexCount;
+};
+
+/*
+	Every mesh's vertices and indices suballocated from a few big buffers:
+	one vertex buffer per vertex format, and one shared index buffer.
+
+	Meshes hold a handle rather than offsets, since offsets change when
+	the arena is compacted. Draws between meshes of the same format then
+	need no input assembler changes at all, so Bind() only touches the
+	IA when the format changes or something else has bound buffers.
+
+	The buffers grow by doubling. When freeing leaves the free space too
+	broken up, every allocation is packed to the front of a fresh buffer.
+
+	With a null device nothing is created on the GPU, but all of the
+	bookkeeping still runs.
+*/
+class GeometryArena
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static GeometryArena& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new GeometryArena();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	GeometryArena(GeometryArena const&) = delete;
+	void operator=(GeometryArena const&) = delete;
+
+private:
+	static GeometryArena* instance;
+	GeometryArena();
+#pragma endregion
+
+public:
+	/// <summary>
+	/// Set the device and context the buffers are created with. Either may be null
+	/// </summary>
+	void Initialize(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	/// <summary>
+	/// Copy a mesh's already encoded vertices and its indices into the arena.
+	/// Returns a handle for the allocation, or GEOMETRY_ARENA_INVALID if
+	/// the buffers couldn't grow to fit it
+	/// </summary>
+	unsigned int Allocate(VertexFormat format, const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+	/// <summary>
+	/// Release an allocation. Invalid handles are ignored
+	/// </summary>
+	void Free(unsigned int handle);
+	/// <summary>
+	/// Compact the arena if freeing has left it too fragmented. Call once per frame
+	/// </summary>
+	void Update();
+	/// <summary>
+	/// Get where an allocation currently lives
+	/// </summary>
+	const GeometryAllocation& GetAllocation(unsigned int handle);
+
+	/// <summary>
+	/// Bind the buffers for the given format, unless they already are
+	/// </summary>
+	void Bind(VertexFormat format);
+	/// <summary>
+	/// Forget what's bound. Call whenever something else may have set
+	/// vertex or index buffers, like once at the start of each frame
+	/// </summary>
+	void InvalidateBindings();
+
+	/// <summary>
+	/// Pack every allocation to the front of its buffer
+	/// </summary>
+	void Compact();
+
+	/// <summary>
+	/// Worst fragmentation of any of the buffers, from 0 to nearly 1
+	/// </summary>
+	float GetFragmentation();
+	/// <summary>
+	/// Get how many times the input assembler has actually been changed
+	/// </summary>
+	unsigned int GetBindCount();
+	/// <summary>
+	/// Get how many vertices of the format, or indices, the buffers have room for
+	/// </summary>
+	unsigned int GetVertexCapacity(VertexFormat format);
+	unsigned int GetIndexCapacity();
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer(VertexFormat format);
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
+
+private:
+	// One buffer and the bookkeeping for its elements
+	struct Pool
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		RangeAllocator allocator;
+		unsigned int stride;
+		UINT bindFlags;
+	};
+
+	Pool& GetVertexPool(VertexFormat format);
+	// Grow or compact until count elements fit in one free range. False if they can't
+	bool MakeRoom(Pool& pool, unsigned int count, unsigned int initialCapacity);
+	// False if the device couldn't make the buffer. Always true without a device
+	bool CreateBuffer(Pool& pool, unsigned int capacity, Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer);
+	void Write(Pool& pool, unsigned int offset, const void* data, unsigned int count);
+	void Copy(Pool& pool, Microsoft::WRL::ComPtr<ID3D11Buffer> destination, unsigned int destinationOffset, unsigned int sourceOffset, unsigned int count);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	Pool vertexPools[VERTEX_FORMAT_COUNT];
+	Pool indexPool;
+
+	// Indexed by handle. Freed handles are reused
+	std::vector<GeometryAllocation> allocations;
+	std::vector<bool> live;
+	std::vector<unsigned int> freeHandles;
+
+	// What the input assembler has bound, -1 when unknown
+	int boundFormat;
+	bool indexBound;
+	unsigned int bindCount;
+};
@@ -0,0 +1,69 @@
+#include "GltfLoader.h"
+#include "GltfParser.h"
+#include "MaterialLibrary.h"
+#include "Mesh.h"
+
+Transform GltfLoader::Load(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	const wchar_t* file,
+	std::shared_ptr<Material> defaultMat,
+	Pool<Entity>& entities,
+	VertexFormat format,
+	bool buildBvh)
+{
+	// Meshes upload from the mapping, so the asset only has to live through this call
+	GltfAsset asset(file);
+	if (!asset.IsValid())
+		return Transform();
+
+	const std::vector<GltfMesh>& sourceMeshes = asset.GetMeshes();
+	const std::vector<GltfNode>& nodes = asset.GetNodes();
+	const std::vector<MaterialDefinition>& definitions = asset.GetMaterials();
+
+	// A mesh and its material per primitive, shared by every node that uses the mesh
+	std::vector<std::vector<std::shared_ptr<Mesh>>> meshes(sourceMeshes.size());
+	std::vector<std::vector<std::shared_ptr<Material>>> materials(sourceMeshes.size());
+	for (size_t m = 0; m < sourceMeshes.size(); m++)
+	{
+		for (const GltfPrimitive& primitive : sourceMeshes[m].primitives)
+		{
+			meshes[m].push_back(std::make_shared<Mesh>(device, context, primitive, format, buildBvh));
+
+			bool hasMaterial = primitive.material >= 0 && primitive.material < (int)definitions.size();
+			materials[m].push_back(hasMaterial ? MaterialLibrary::GetInstance().GetMaterial(definitions[primitive.material]) : defaultMat);
+		}
+	}
+
+	std::vector<Transform> transforms(nodes.size());
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		transforms[n] = Transform::Create();
+		transforms[n].SetPosition(nodes[n].translation);
+		transforms[n].SetRotation(nodes[n].rotation);
+		transforms[n].SetScale(nodes[n].scale);
+	}
+
+	// Linked once they all exist, since parents can come after their children.
+	// Anything that would make a loop is left under the root instead
+	Transform root = Transform::Create();
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		if (nodes[n].parent >= 0)
+			transforms[nodes[n].parent].AddChild(transforms[n]);
+		if (!transforms[n].GetParent().IsValid())
+			root.AddChild(transforms[n]);
+	}
+
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		int mesh = nodes[n].mesh;
+		if (mesh < 0)
+			continue;
+
+		for (size_t p = 0; p < meshes[mesh].size(); p++)
+			entities.Create(meshes[mesh][p], materials[mesh][p], transforms[n]);
+	}
+
+	return root;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "Entity.h"
+#include "Material.h"
+#include "Pool.h"
+#include "Transform.h"
+#include "VertexCompression.h"
+
+/*
+	Turns a binary glTF file into entities.
+
+	Each glTF node becomes a Transform, linked to its parent's, and every
+	node with a mesh gets an entity per primitive sharing the node's
+	transform. All of the asset's root nodes are parented to one root
+	transform, which places the asset. Destroy the entities first, then
+	call DestroyHierarchy() on the root to free every node's transform.
+
+	Primitives with a material use one from the MaterialLibrary, so it
+	must be initialized first. The rest use the default material.
+*/
+class GltfLoader
+{
+public:
+	/// <summary>
+	/// Load a .glb, creating its entities in the given pool. Returns the
+	/// asset's root transform, or an invalid one if the file couldn't be loaded
+	/// </summary>
+	static Transform Load(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		const wchar_t* file,
+		std::shared_ptr<Material> defaultMat,
+		Pool<Entity>& entities,
+		VertexFormat format = VERTEX_FORMAT_FULL,
+		bool buildBvh = false);
+};
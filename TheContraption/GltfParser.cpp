@@ -0,0 +1,696 @@
+#include "GltfParser.h"
+#include "TangentGenerator.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+	// glTF accessor component types
+	const int componentByte = 5120;
+	const int componentUnsignedByte = 5121;
+	const int componentShort = 5122;
+	const int componentUnsignedShort = 5123;
+	const int componentUnsignedInt = 5125;
+	const int componentFloat = 5126;
+
+	// Primitive mode for triangle lists, the default
+	const int modeTriangles = 4;
+
+	struct JsonValue
+	{
+		enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+		Type type;
+		bool boolean;
+		double number;
+		std::string string;
+		std::vector<JsonValue> items;
+		std::vector<std::pair<std::string, JsonValue>> members;
+
+		JsonValue() : type(JSON_NULL), boolean(false), number(0) {}
+
+		const JsonValue* Find(const char* key) const
+		{
+			for (const std::pair<std::string, JsonValue>& member : members)
+			{
+				if (member.first == key)
+					return &member.second;
+			}
+			return nullptr;
+		}
+
+		int GetInt(const char* key, int fallback) const
+		{
+			const JsonValue* value = Find(key);
+			return value && value->type == JSON_NUMBER ? static_cast<int>(value->number) : fallback;
+		}
+
+		float GetFloat(const char* key, float fallback) const
+		{
+			const JsonValue* value = Find(key);
+			return value && value->type == JSON_NUMBER ? static_cast<float>(value->number) : fallback;
+		}
+
+		// Reads up to count numbers out of an array member, leaving the rest as they were
+		void GetFloats(const char* key, float* out, size_t count) const
+		{
+			const JsonValue* value = Find(key);
+			if (!value || value->type != JSON_ARRAY)
+				return;
+
+			for (size_t i = 0; i < count && i < value->items.size(); i++)
+			{
+				if (value->items[i].type == JSON_NUMBER)
+					out[i] = static_cast<float>(value->items[i].number);
+			}
+		}
+	};
+
+	/*
+		Just enough JSON for a glTF chunk. Strings keep their escapes
+		decoded only for the common single character ones, since names
+		are the only strings used
+	*/
+	class JsonReader
+	{
+	public:
+		JsonReader(const char* data, size_t size) : c(data), end(data + size), failed(false) {}
+
+		bool Read(JsonValue& out)
+		{
+			ReadValue(out, 0);
+			SkipSpaces();
+			return !failed;
+		}
+
+	private:
+		void SkipSpaces()
+		{
+			while (c < end && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')) c++;
+		}
+
+		bool Expect(char expected)
+		{
+			SkipSpaces();
+			if (c < end && *c == expected)
+			{
+				c++;
+				return true;
+			}
+			failed = true;
+			return false;
+		}
+
+		void ReadValue(JsonValue& out, int depth)
+		{
+			SkipSpaces();
+			if (c >= end || depth > GLTF_MAX_JSON_DEPTH)
+			{
+				failed = true;
+				return;
+			}
+
+			switch (*c)
+			{
+			case '{': ReadObject(out, depth); break;
+			case '[': ReadArray(out, depth); break;
+			case '"': out.type = JsonValue::JSON_STRING; ReadString(out.string); break;
+			case 't': out.type = JsonValue::JSON_BOOL; out.boolean = true; ReadWord("true"); break;
+			case 'f': out.type = JsonValue::JSON_BOOL; out.boolean = false; ReadWord("false"); break;
+			case 'n': out.type = JsonValue::JSON_NULL; ReadWord("null"); break;
+			default: ReadNumber(out); break;
+			}
+		}
+
+		void ReadObject(JsonValue& out, int depth)
+		{
+			out.type = JsonValue::JSON_OBJECT;
+			c++;
+			SkipSpaces();
+			if (c < end && *c == '}')
+			{
+				c++;
+				return;
+			}
+
+			while (!failed)
+			{
+				SkipSpaces();
+				out.members.push_back(std::pair<std::string, JsonValue>());
+				ReadString(out.members.back().first);
+				if (!Expect(':'))
+					return;
+				ReadValue(out.members.back().second, depth + 1);
+
+				SkipSpaces();
+				if (c < end && *c == ',')
+				{
+					c++;
+					continue;
+				}
+				Expect('}');
+				return;
+			}
+		}
+
+		void ReadArray(JsonValue& out, int depth)
+		{
+			out.type = JsonValue::JSON_ARRAY;
+			c++;
+			SkipSpaces();
+			if (c < end && *c == ']')
+			{
+				c++;
+				return;
+			}
+
+			while (!failed)
+			{
+				out.items.push_back(JsonValue());
+				ReadValue(out.items.back(), depth + 1);
+
+				SkipSpaces();
+				if (c < end && *c == ',')
+				{
+					c++;
+					continue;
+				}
+				Expect(']');
+				return;
+			}
+		}
+
+		void ReadString(std::string& out)
+		{
+			if (c >= end || *c != '"')
+			{
+				failed = true;
+				return;
+			}
+			c++;
+
+			while (c < end && *c != '"')
+			{
+				if (*c == '\\' && c + 1 < end)
+				{
+					c++;
+					switch (*c)
+					{
+					case 'n': out.push_back('\n'); break;
+					case 't': out.push_back('\t'); break;
+					case 'u': c += std::min<size_t>(4, end - c - 1); out.push_back('?'); break;
+					default: out.push_back(*c); break;
+					}
+					c++;
+					continue;
+				}
+				out.push_back(*c++);
+			}
+
+			if (c >= end)
+				failed = true;
+			else
+				c++;
+		}
+
+		void ReadWord(const char* word)
+		{
+			size_t length = strlen(word);
+			if (static_cast<size_t>(end - c) < length || strncmp(c, word, length) != 0)
+				failed = true;
+			else
+				c += length;
+		}
+
+		void ReadNumber(JsonValue& out)
+		{
+			// The chunk isn't null terminated, so copy the number out before strtod sees it
+			char buffer[64];
+			size_t length = 0;
+			while (c < end && length < sizeof(buffer) - 1 && (isdigit(static_cast<unsigned char>(*c)) || *c == '-' || *c == '+' || *c == '.' || *c == 'e' || *c == 'E'))
+				buffer[length++] = *c++;
+			buffer[length] = '\0';
+
+			char* parsedEnd = nullptr;
+			out.type = JsonValue::JSON_NUMBER;
+			out.number = strtod(buffer, &parsedEnd);
+			if (length == 0 || parsedEnd != buffer + length)
+				failed = true;
+		}
+
+		const char* c;
+		const char* end;
+		bool failed;
+	};
+
+	// Where an accessor's elements are in the binary chunk
+	struct AccessorView
+	{
+		const uint8_t* data;
+		size_t count;
+		size_t stride;
+		int componentType;
+		int components;
+		bool normalized;
+		float min[3];
+		float max[3];
+		bool hasBounds;
+	};
+
+	size_t ComponentSize(int componentType)
+	{
+		switch (componentType)
+		{
+		case componentByte:
+		case componentUnsignedByte: return 1;
+		case componentShort:
+		case componentUnsignedShort: return 2;
+		case componentUnsignedInt:
+		case componentFloat: return 4;
+		default: return 0;
+		}
+	}
+
+	int ComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	// Finds an accessor in the binary chunk and checks every element is inside it
+	bool GetAccessor(const JsonValue& root, int index, const uint8_t* bin, size_t binSize, AccessorView& out)
+	{
+		const JsonValue* accessors = root.Find("accessors");
+		const JsonValue* bufferViews = root.Find("bufferViews");
+		if (!accessors || !bufferViews || index < 0 || index >= (int)accessors->items.size())
+			return false;
+
+		const JsonValue& accessor = accessors->items[index];
+		int viewIndex = accessor.GetInt("bufferView", -1);
+		if (viewIndex < 0 || viewIndex >= (int)bufferViews->items.size() || accessor.Find("sparse"))
+			return false;
+
+		// Only the .glb's own chunk, which is always buffer 0
+		const JsonValue& view = bufferViews->items[viewIndex];
+		if (view.GetInt("buffer", 0) != 0)
+			return false;
+
+		const JsonValue* type = accessor.Find("type");
+		out.componentType = accessor.GetInt("componentType", 0);
+		out.components = type ? ComponentCount(type->string) : 0;
+		out.count = static_cast<size_t>(std::max(accessor.GetInt("count", 0), 0));
+		const JsonValue* normalized = accessor.Find("normalized");
+		out.normalized = normalized && normalized->boolean;
+
+		size_t elementSize = ComponentSize(out.componentType) * out.components;
+		if (elementSize == 0)
+			return false;
+
+		size_t stride = static_cast<size_t>(view.GetInt("byteStride", 0));
+		out.stride = stride > 0 ? stride : elementSize;
+
+		size_t viewOffset = static_cast<size_t>(std::max(view.GetInt("byteOffset", 0), 0));
+		size_t viewLength = static_cast<size_t>(std::max(view.GetInt("byteLength", 0), 0));
+		size_t offset = static_cast<size_t>(std::max(accessor.GetInt("byteOffset", 0), 0));
+		if (viewOffset + viewLength > binSize || offset > viewLength)
+			return false;
+
+		if (out.count > 0 && offset + (out.count - 1) * out.stride + elementSize > viewLength)
+			return false;
+
+		out.data = bin + viewOffset + offset;
+
+		const JsonValue* minValue = accessor.Find("min");
+		const JsonValue* maxValue = accessor.Find("max");
+		out.hasBounds = minValue && maxValue && minValue->items.size() >= 3 && maxValue->items.size() >= 3;
+		for (int i = 0; i < 3; i++)
+		{
+			out.min[i] = out.hasBounds ? static_cast<float>(minValue->items[i].number) : 0.0f;
+			out.max[i] = out.hasBounds ? static_cast<float>(maxValue->items[i].number) : 0.0f;
+		}
+		return true;
+	}
+
+	// Reads one component as a float, undoing normalization if the accessor uses it
+	float ReadComponent(const uint8_t* element, int componentType, int component, bool normalized)
+	{
+		switch (componentType)
+		{
+		case componentFloat:
+		{
+			float value;
+			memcpy(&value, element + component * 4, sizeof(value));
+			return value;
+		}
+		case componentUnsignedByte:
+			return normalized ? element[component] / 255.0f : element[component];
+		case componentUnsignedShort:
+		{
+			uint16_t value;
+			memcpy(&value, element + component * 2, sizeof(value));
+			return normalized ? value / 65535.0f : value;
+		}
+		case componentByte:
+		{
+			int8_t value = static_cast<int8_t>(element[component]);
+			return normalized ? std::max(value / 127.0f, -1.0f) : value;
+		}
+		case componentShort:
+		{
+			int16_t value;
+			memcpy(&value, element + component * 2, sizeof(value));
+			return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+		}
+		default:
+			return 0.0f;
+		}
+	}
+
+	// Gathers an attribute into one member of every vertex. The Z
+	// component is mirrored when flipZ is set
+	void GatherAttribute(const AccessorView& view, std::vector<Vertex>& vertices, size_t memberOffset, int components, bool flipZ)
+	{
+		size_t count = std::min(view.count, vertices.size());
+		int read = std::min(components, view.components);
+
+		// Tightly typed floats are the common case, so they're just copied
+		if (view.componentType == componentFloat)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				float* member = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(&vertices[i]) + memberOffset);
+				memcpy(member, view.data + i * view.stride, read * sizeof(float));
+				if (flipZ)
+					member[2] = -member[2];
+			}
+			return;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			float* member = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(&vertices[i]) + memberOffset);
+			const uint8_t* element = view.data + i * view.stride;
+			for (int component = 0; component < read; component++)
+				member[component] = ReadComponent(element, view.componentType, component, view.normalized);
+			if (flipZ)
+				member[2] = -member[2];
+		}
+	}
+
+	bool ReadPrimitive(const JsonValue& root, const JsonValue& source, const uint8_t* bin, size_t binSize, GltfPrimitive& out)
+	{
+		if (source.GetInt("mode", modeTriangles) != modeTriangles)
+			return false;
+
+		const JsonValue* attributes = source.Find("attributes");
+		if (!attributes)
+			return false;
+
+		AccessorView positions;
+		if (!GetAccessor(root, attributes->GetInt("POSITION", -1), bin, binSize, positions) ||
+			positions.components != 3 || positions.count == 0)
+			return false;
+
+		// Anything missing stays zeroed, and tangents are generated below
+		std::vector<Vertex>& vertices = out.data.vertices;
+		vertices.assign(positions.count, Vertex());
+		GatherAttribute(positions, vertices, offsetof(Vertex, Position), 3, true);
+
+		AccessorView normals;
+		if (GetAccessor(root, attributes->GetInt("NORMAL", -1), bin, binSize, normals) && normals.components == 3)
+			GatherAttribute(normals, vertices, offsetof(Vertex, Normal), 3, true);
+
+		// Mirroring Z flips the handedness of every frame, but shaders build
+		// the bitangent as cross(T, N) * w, the other way around from glTF's
+		// cross(N, T) * w, which flips it back. So w is kept as it is
+		AccessorView tangents;
+		bool hasTangents = GetAccessor(root, attributes->GetInt("TANGENT", -1), bin, binSize, tangents) && tangents.components == 4;
+		if (hasTangents)
+			GatherAttribute(tangents, vertices, offsetof(Vertex, Tangent), 4, true);
+
+		AccessorView uvs;
+		if (GetAccessor(root, attributes->GetInt("TEXCOORD_0", -1), bin, binSize, uvs) && uvs.components == 2)
+			GatherAttribute(uvs, vertices, offsetof(Vertex, UV), 2, false);
+
+		// An indices accessor that can't be read fails the primitive. Drawing
+		// it unindexed instead would only make garbage triangles
+		AccessorView indices;
+		if (source.Find("indices"))
+		{
+			if (!GetAccessor(root, source.GetInt("indices", -1), bin, binSize, indices) || indices.components != 1)
+				return false;
+
+			out.indexCount = static_cast<unsigned int>(indices.count);
+
+			// Already exactly what the index buffer wants, so hand it on as is
+			if (indices.componentType == componentUnsignedInt &&
+				indices.stride == sizeof(unsigned int) &&
+				reinterpret_cast<uintptr_t>(indices.data) % alignof(unsigned int) == 0)
+			{
+				out.mappedIndices = reinterpret_cast<const unsigned int*>(indices.data);
+			}
+			else
+			{
+				out.data.indices.resize(indices.count);
+				for (size_t i = 0; i < indices.count; i++)
+					out.data.indices[i] = static_cast<unsigned int>(ReadComponent(indices.data + i * indices.stride, indices.componentType, 0, false));
+			}
+		}
+		else
+		{
+			// Unindexed, so every three vertices are a triangle
+			out.indexCount = static_cast<unsigned int>(vertices.size());
+			out.data.indices.resize(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+				out.data.indices[i] = static_cast<unsigned int>(i);
+		}
+
+		out.indexCount -= out.indexCount % 3;
+		const unsigned int* indexData = out.GetIndices();
+		for (unsigned int i = 0; i < out.indexCount; i++)
+		{
+			if (indexData[i] >= vertices.size())
+				return false;
+		}
+
+		if (!hasTangents && out.indexCount > 0)
+			TangentGenerator::GenerateFast(&vertices[0], vertices.size(), indexData, out.indexCount);
+
+		// POSITION has to have its bounds in the file, which saves a pass
+		if (positions.hasBounds)
+		{
+			out.data.boundsMin = DirectX::XMFLOAT3(positions.min[0], positions.min[1], -positions.max[2]);
+			out.data.boundsMax = DirectX::XMFLOAT3(positions.max[0], positions.max[1], -positions.min[2]);
+		}
+		else
+		{
+			MeshData::CalculateBounds(vertices.data(), vertices.size(), out.data.boundsMin, out.data.boundsMax);
+		}
+		MeshData::CalculateBoundingSphere(vertices.data(), vertices.size(), out.data.boundsCenter, out.data.boundsRadius);
+
+		out.material = source.GetInt("material", -1);
+		return true;
+	}
+
+	void ReadNode(const JsonValue& source, GltfNode& out)
+	{
+		const JsonValue* name = source.Find("name");
+		out.name = name ? name->string : "";
+		out.mesh = source.GetInt("mesh", -1);
+
+		float translation[3] = { 0, 0, 0 };
+		float rotation[4] = { 0, 0, 0, 1 };
+		float scale[3] = { 1, 1, 1 };
+
+		const JsonValue* matrix = source.Find("matrix");
+		if (matrix && matrix->items.size() == 16)
+		{
+			// Column major for column vectors, which is the same 16 floats
+			// as DirectXMath's row major for row vectors
+			float values[16];
+			source.GetFloats("matrix", values, 16);
+			DirectX::XMFLOAT4X4 m;
+			memcpy(&m, values, sizeof(values));
+
+			DirectX::XMVECTOR s, r, t;
+			if (DirectX::XMMatrixDecompose(&s, &r, &t, DirectX::XMLoadFloat4x4(&m)))
+			{
+				DirectX::XMStoreFloat3(reinterpret_cast<DirectX::XMFLOAT3*>(translation), t);
+				DirectX::XMStoreFloat4(reinterpret_cast<DirectX::XMFLOAT4*>(rotation), r);
+				DirectX::XMStoreFloat3(reinterpret_cast<DirectX::XMFLOAT3*>(scale), s);
+			}
+		}
+		else
+		{
+			source.GetFloats("translation", translation, 3);
+			source.GetFloats("rotation", rotation, 4);
+			source.GetFloats("scale", scale, 3);
+		}
+
+		// Mirroring along Z negates the translation's Z and the
+		// rotation's X and Y, which reverses the sense of the angle
+		out.translation = DirectX::XMFLOAT3(translation[0], translation[1], -translation[2]);
+		out.rotation = DirectX::XMFLOAT4(-rotation[0], -rotation[1], rotation[2], rotation[3]);
+		out.scale = DirectX::XMFLOAT3(scale[0], scale[1], scale[2]);
+	}
+
+	void ReadMaterial(const JsonValue& source, MaterialDefinition& out)
+	{
+		const JsonValue* name = source.Find("name");
+		out.name = name ? name->string : "";
+		out.defined = true;
+
+		float baseColor[4] = { 1, 1, 1, 1 };
+		float roughness = 1.0f;
+		const JsonValue* pbr = source.Find("pbrMetallicRoughness");
+		if (pbr)
+		{
+			pbr->GetFloats("baseColorFactor", baseColor, 4);
+			roughness = pbr->GetFloat("roughnessFactor", 1.0f);
+		}
+
+		out.diffuse = DirectX::XMFLOAT3(baseColor[0], baseColor[1], baseColor[2]);
+		out.opacity = baseColor[3];
+
+		// The inverse of how MaterialLibrary turns an exponent into roughness
+		roughness = std::max(roughness, 0.05f);
+		out.specularExponent = 2.0f / (roughness * roughness) - 2.0f;
+	}
+}
+
+GltfAsset::GltfAsset(const wchar_t* path) :
+	file(path), valid(false)
+{
+	if (file.IsOpen())
+		valid = Parse();
+}
+
+bool GltfAsset::Parse()
+{
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(file.GetData());
+	size_t size = file.GetSize();
+
+	// 12 byte header, then the JSON chunk's own 8 byte header
+	uint32_t header[5];
+	if (size < sizeof(header))
+		return false;
+	memcpy(header, data, sizeof(header));
+	if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > size || header[4] != GLB_CHUNK_JSON)
+		return false;
+
+	size_t length = header[2];
+	size_t jsonLength = header[3];
+	const char* json = reinterpret_cast<const char*>(data + 20);
+	if (20 + jsonLength > length)
+		return false;
+
+	// The binary chunk is optional, and starts 4 byte aligned
+	const uint8_t* bin = nullptr;
+	size_t binSize = 0;
+	size_t binHeader = 20 + ((jsonLength + 3) & ~static_cast<size_t>(3));
+	if (binHeader + 8 <= length)
+	{
+		uint32_t chunk[2];
+		memcpy(chunk, data + binHeader, sizeof(chunk));
+		if (chunk[1] == GLB_CHUNK_BIN && binHeader + 8 + chunk[0] <= length)
+		{
+			bin = data + binHeader + 8;
+			binSize = chunk[0];
+		}
+	}
+
+	JsonValue root;
+	JsonReader reader(json, jsonLength);
+	if (!reader.Read(root) || root.type != JsonValue::JSON_OBJECT)
+		return false;
+
+	const JsonValue* sourceMeshes = root.Find("meshes");
+	if (sourceMeshes)
+	{
+		meshes.resize(sourceMeshes->items.size());
+		for (size_t m = 0; m < meshes.size(); m++)
+		{
+			const JsonValue& sourceMesh = sourceMeshes->items[m];
+			const JsonValue* name = sourceMesh.Find("name");
+			meshes[m].name = name ? name->string : "";
+
+			const JsonValue* primitives = sourceMesh.Find("primitives");
+			if (!primitives)
+				continue;
+
+			for (const JsonValue& sourcePrimitive : primitives->items)
+			{
+				GltfPrimitive primitive;
+				if (ReadPrimitive(root, sourcePrimitive, bin, binSize, primitive))
+					meshes[m].primitives.push_back(std::move(primitive));
+			}
+		}
+	}
+
+	const JsonValue* sourceNodes = root.Find("nodes");
+	if (sourceNodes)
+	{
+		nodes.resize(sourceNodes->items.size());
+		for (size_t n = 0; n < nodes.size(); n++)
+		{
+			nodes[n].parent = -1;
+			ReadNode(sourceNodes->items[n], nodes[n]);
+			if (nodes[n].mesh >= (int)meshes.size())
+				nodes[n].mesh = -1;
+		}
+
+		// Children are listed on the parent, so flip that around.
+		// A node claimed twice keeps its first parent
+		for (size_t n = 0; n < nodes.size(); n++)
+		{
+			const JsonValue* children = sourceNodes->items[n].Find("children");
+			if (!children)
+				continue;
+
+			for (const JsonValue& child : children->items)
+			{
+				int c = static_cast<int>(child.number);
+				if (child.type == JsonValue::JSON_NUMBER && c >= 0 && c < (int)nodes.size() && c != (int)n && nodes[c].parent < 0)
+					nodes[c].parent = static_cast<int>(n);
+			}
+		}
+	}
+
+	const JsonValue* sourceMaterials = root.Find("materials");
+	if (sourceMaterials)
+	{
+		materials.resize(sourceMaterials->items.size());
+		for (size_t m = 0; m < materials.size(); m++)
+			ReadMaterial(sourceMaterials->items[m], materials[m]);
+	}
+
+	return true;
+}
+
+bool GltfAsset::IsValid()
+{
+	return valid;
+}
+
+const std::vector<GltfMesh>& GltfAsset::GetMeshes()
+{
+	return meshes;
+}
+
+const std::vector<GltfNode>& GltfAsset::GetNodes()
+{
+	return nodes;
+}
+
+const std::vector<MaterialDefinition>& GltfAsset::GetMaterials()
+{
+	return materials;
+}
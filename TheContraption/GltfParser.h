@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "MappedFile.h"
+#include "MeshData.h"
+
+// Chunk tags of a binary glTF file
+#define GLB_MAGIC 0x46546C67u		// "glTF"
+#define GLB_CHUNK_JSON 0x4E4F534Au	// "JSON"
+#define GLB_CHUNK_BIN 0x004E4942u	// "BIN\0"
+// Deepest the JSON chunk may nest before it's rejected
+#define GLTF_MAX_JSON_DEPTH 64
+
+/*
+	One draw of a glTF mesh, already converted to a left-handed space.
+
+	Index data that is already 32 bit points straight into the mapped
+	file, and is only copied into data.indices when it has to be
+	widened. Vertices are always gathered into data.vertices, since
+	glTF keeps each attribute in an accessor of its own.
+*/
+struct GltfPrimitive
+{
+	MeshData data;						// Vertices and bounds, and indices when converted
+	const unsigned int* mappedIndices;	// Indices in the file, or null if converted
+	unsigned int indexCount;
+	int material;						// Into the asset's materials, -1 for none
+
+	GltfPrimitive() : mappedIndices(nullptr), indexCount(0), material(-1) {}
+
+	/// <summary>
+	/// Get the indices, wherever they ended up
+	/// </summary>
+	const unsigned int* GetIndices() const { return mappedIndices ? mappedIndices : data.indices.data(); }
+};
+
+struct GltfMesh
+{
+	std::string name;
+	std::vector<GltfPrimitive> primitives;
+};
+
+/*
+	A node's local transform, already converted to a left-handed space
+*/
+struct GltfNode
+{
+	std::string name;
+	int parent;		// -1 for roots
+	int mesh;		// -1 for nodes that only group others
+	DirectX::XMFLOAT3 translation;
+	DirectX::XMFLOAT4 rotation;	// Quaternion
+	DirectX::XMFLOAT3 scale;
+};
+
+/*
+	Parses binary glTF (.glb) files without touching D3D.
+
+	The file is memory mapped. Only the small JSON chunk is parsed as
+	text; accessors are read straight out of the binary chunk, with
+	32 bit index buffers handed on without being copied at all.
+
+	glTF is right-handed with counter-clockwise front faces. Positions,
+	normals, tangents and node transforms are mirrored along Z like the
+	obj loader does, but the winding is left alone so the indices never
+	need rewriting. Meshes from here draw with counter-clockwise front
+	faces instead. UVs already start at the top left, as D3D expects.
+
+	Only buffers stored in the .glb itself are supported, not external
+	.bin files or sparse accessors. Primitives that aren't triangle
+	lists are skipped.
+*/
+class GltfAsset
+{
+public:
+	/// <summary>
+	/// Map and parse a .glb file. Check IsValid() before using anything
+	/// </summary>
+	GltfAsset(const wchar_t* file);
+
+	// Primitives may point into the mapping, so it can't be copied
+	GltfAsset(const GltfAsset&) = delete;
+	GltfAsset& operator=(const GltfAsset&) = delete;
+
+	/// <summary>
+	/// False if the file is missing, not a version 2 .glb, or malformed
+	/// </summary>
+	bool IsValid();
+
+	/// <summary>
+	/// Meshes, in file order so node mesh indices refer to them
+	/// </summary>
+	const std::vector<GltfMesh>& GetMeshes();
+	/// <summary>
+	/// Every node, in file order
+	/// </summary>
+	const std::vector<GltfNode>& GetNodes();
+	/// <summary>
+	/// Materials, from each material's base color and roughness factors
+	/// </summary>
+	const std::vector<MaterialDefinition>& GetMaterials();
+
+private:
+	bool Parse();
+
+	MappedFile file;
+	bool valid;
+
+	std::vector<GltfMesh> meshes;
+	std::vector<GltfNode> nodes;
+	std::vector<MaterialDefinition> materials;
+};
@@ -0,0 +1,170 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// Singleton requirement
+JobSystem* JobSystem::instance;
+
+namespace
+{
+	// Which queue the current thread owns. Workers set it when they start
+	thread_local unsigned int currentQueue = 0;
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void JobSystem::Initialize()
+{
+	if (!queues.empty())
+		return;
+
+	// The calling thread takes part too, so it counts as one of the cores
+	unsigned int workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	for (unsigned int i = 0; i <= workerCount; i++)
+		queues.push_back(std::unique_ptr<Queue>(new Queue()));
+
+	for (unsigned int i = 1; i <= workerCount; i++)
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+}
+
+unsigned int JobSystem::GetThreadCount()
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+void JobSystem::SetDeterministic(bool deterministic)
+{
+	this->deterministic = deterministic;
+}
+
+bool JobSystem::IsDeterministic()
+{
+	return deterministic;
+}
+
+void JobSystem::Run(size_t count, size_t grain, RangeFunction function, void* context)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max(grain, (size_t)1);
+	if (deterministic || workers.empty() || count <= grain)
+	{
+		for (size_t begin = 0; begin < count; begin += grain)
+			function(context, begin, std::min(begin + grain, count));
+		return;
+	}
+
+	size_t jobCount = (count + grain - 1) / grain;
+	std::atomic<size_t> remaining(jobCount);
+
+	// Counted before they're queued, so the count is never below the real number
+	queuedCount.fetch_add((unsigned int)jobCount);
+	{
+		Queue& queue = *queues[currentQueue];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (size_t begin = 0; begin < count; begin += grain)
+		{
+			Job job = { function, context, begin, std::min(begin + grain, count), &remaining };
+			queue.jobs.push_back(job);
+		}
+	}
+
+	{
+		// Taken so a worker can't check for jobs and then miss this wake up
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_all();
+
+	// Help out until every range is done. Once there's nothing left to
+	// take, the last ranges are running elsewhere, so sleep until one of
+	// them finishes the lot or more work shows up
+	while (remaining.load(std::memory_order_acquire) > 0)
+	{
+		Job job;
+		if (TryTake(currentQueue, job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this, &remaining]() {
+			return remaining.load(std::memory_order_acquire) == 0 || queuedCount.load() > 0;
+		});
+	}
+}
+
+bool JobSystem::TryTake(unsigned int queue, Job& job)
+{
+	{
+		Queue& own = *queues[queue];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty())
+		{
+			job = own.jobs.back();
+			own.jobs.pop_back();
+			queuedCount.fetch_sub(1);
+			return true;
+		}
+	}
+
+	unsigned int queueCount = (unsigned int)queues.size();
+	for (unsigned int i = 1; i < queueCount; i++)
+	{
+		Queue& victim = *queues[(queue + i) % queueCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty())
+		{
+			job = victim.jobs.front();
+			victim.jobs.pop_front();
+			queuedCount.fetch_sub(1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	job.function(job.context, job.begin, job.end);
+
+	// The waiter may return as soon as the count hits zero, taking the
+	// count with it, so it can't be touched after this
+	if (job.remaining->fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		// Taken so the waiter can't check the count and then miss this wake up
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wake.notify_all();
+	}
+}
+
+void JobSystem::WorkerLoop(unsigned int queue)
+{
+	currentQueue = queue;
+	while (true)
+	{
+		Job job;
+		if (TryTake(queue, job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this]() { return stopping || queuedCount.load() > 0; });
+		if (stopping)
+			return;
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Short lived jobs spread across a thread per core.
+
+	Every worker has its own queue, and every other thread shares one
+	more, so the main thread and MeshLoader's can all call ParallelFor at
+	once. A thread adds work to the back of its queue and takes from the
+	back too, so it keeps working on what it just touched, while idle
+	threads steal from the front of someone else's. A thread waiting on
+	a ParallelFor runs jobs itself, anyone's, and only sleeps once there
+	are none left to take, so nesting them is fine.
+
+	Deterministic mode runs every ParallelFor on the calling thread in
+	order, so results can be compared exactly against the threaded path.
+*/
+class JobSystem
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static JobSystem& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new JobSystem();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	JobSystem(JobSystem const&) = delete;
+	void operator=(JobSystem const&) = delete;
+
+private:
+	static JobSystem* instance;
+	JobSystem() : queuedCount(0), stopping(false), deterministic(false) {};
+#pragma endregion
+
+public:
+	/// <summary>
+	/// Stops the workers. Nothing may be running on them
+	/// </summary>
+	~JobSystem();
+
+	/// <summary>
+	/// Start a worker for every core but the calling thread's. Until this
+	/// is called everything runs on the calling thread. Call it before
+	/// starting any other thread that uses the JobSystem
+	/// </summary>
+	void Initialize();
+
+	/// <summary>
+	/// Run work(begin, end) over [0, count) in ranges of about grain items,
+	/// spread across the workers, and wait for all of them
+	/// </summary>
+	template<typename Work>
+	void ParallelFor(size_t count, size_t grain, Work& work)
+	{
+		Run(count, grain, &Invoke<Work>, &work);
+	}
+
+	/// <summary>
+	/// Get how many threads run jobs, counting the calling one
+	/// </summary>
+	unsigned int GetThreadCount();
+
+	/// <summary>
+	/// Run every ParallelFor in order on the calling thread instead
+	/// </summary>
+	void SetDeterministic(bool deterministic);
+	bool IsDeterministic();
+
+private:
+	typedef void (*RangeFunction)(void* context, size_t begin, size_t end);
+
+	struct Job
+	{
+		RangeFunction function;
+		void* context;
+		size_t begin;
+		size_t end;
+		std::atomic<size_t>* remaining;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	template<typename Work>
+	static void Invoke(void* context, size_t begin, size_t end)
+	{
+		(*static_cast<Work*>(context))(begin, end);
+	}
+
+	void Run(size_t count, size_t grain, RangeFunction function, void* context);
+	// Take a job from the back of this thread's queue, or steal one from the front of another's
+	bool TryTake(unsigned int queue, Job& job);
+	void Execute(const Job& job);
+	void WorkerLoop(unsigned int queue);
+
+	// Queue 0 is shared by every thread that isn't a worker. Like the
+	// others it's only ever touched under its lock
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<unsigned int> queuedCount;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool stopping;
+	bool deterministic;
+};
@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+#endif
+
+MappedFile::MappedFile(const wchar_t* path) :
+	data(nullptr), size(0)
+{
+#ifdef _WIN32
+	mapping = nullptr;
+	file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	// Empty files can't be mapped, which is handled above
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+		return;
+
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data != nullptr)
+		size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	// Non-windows builds are only used for headless tools, so
+	// a plain wide to narrow conversion of the path is enough.
+	// Paths the locale can't represent just fail to open
+	file = -1;
+	size_t length = wcstombs(nullptr, path, 0);
+	if (length == static_cast<size_t>(-1))
+		return;
+
+	std::string narrow(length, '\0');
+	wcstombs(&narrow[0], path, length);
+
+	file = open(narrow.c_str(), O_RDONLY);
+	if (file < 0)
+		return;
+
+	struct stat info = {};
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+		return;
+
+	void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED)
+		return;
+
+	// We read front to back, so let the OS read ahead aggressively
+	madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+	data = static_cast<const char*>(view);
+	size = static_cast<size_t>(info.st_size);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+	if (data != nullptr) munmap(const_cast<char*>(data), size);
+	if (file >= 0) close(file);
+#endif
+}
+
+bool MappedFile::IsOpen()
+{
+	return data != nullptr;
+}
+
+const char* MappedFile::GetData()
+{
+	return data;
+}
+
+size_t MappedFile::GetSize()
+{
+	return size;
+}
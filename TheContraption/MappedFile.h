@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+/*
+	Read-only view of an entire file mapped into memory. The OS pages
+	the file in as it is touched, so parsers can walk the bytes directly
+	without copying them through a stream buffer first.
+*/
+class MappedFile
+{
+public:
+	/// <summary>
+	/// Map the given file for reading. Check IsOpen() before using the data
+	/// </summary>
+	MappedFile(const wchar_t* file);
+	~MappedFile();
+
+	// A mapping owns OS handles so it should never be copied
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// <summary>
+	/// Was the file found and successfully mapped
+	/// </summary>
+	/// <returns></returns>
+	bool IsOpen();
+	/// <summary>
+	/// Get the first byte of the mapped file. Nullptr if not open
+	/// </summary>
+	/// <returns></returns>
+	const char* GetData();
+	/// <summary>
+	/// Get the size of the mapped file in bytes
+	/// </summary>
+	/// <returns></returns>
+	size_t GetSize();
+
+private:
+	const char* data;
+	size_t size;
+
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int file;
+#endif
+};
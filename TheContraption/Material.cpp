@@ -28,6 +28,11 @@ DirectX::XMFLOAT2 Material::GetUVOffset()
 	return uvOffset;
 }
 
+bool Material::IsTransparent()
+{
+	return tint.w < 1.0f;
+}
+
 
 
 void Material::SetTint(DirectX::XMFLOAT4 nextTint)
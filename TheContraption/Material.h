@@ -36,6 +36,13 @@ public:
 	/// </summary>
 	/// <returns></returns>
 	DirectX::XMFLOAT2 GetUVOffset();
+	/// <summary>
+	/// Whether the tint's alpha lets what's behind show through,
+	/// which puts the material in the transparent pass. Every pixel
+	/// shader a material can use outputs that alpha for blending
+	/// </summary>
+	/// <returns></returns>
+	bool IsTransparent();
 
 	/// <summary>
 	/// Set this material's current color tint 
@@ -0,0 +1,135 @@
+#include "MaterialLibrary.h"
+#include "packages/directxtk_desktop_win10.2023.9.6.1/include/WICTextureLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Singleton requirement
+MaterialLibrary* MaterialLibrary::instance;
+
+namespace
+{
+	unsigned char ToByte(float value)
+	{
+		return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+MaterialLibrary::MaterialLibrary()
+{
+}
+
+void MaterialLibrary::Initialize(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	std::shared_ptr<SimpleVertexShader> vertexShader,
+	std::shared_ptr<SimplePixelShader> pixelShader,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
+{
+	this->device = device;
+	this->context = context;
+	this->vertexShader = vertexShader;
+	this->pixelShader = pixelShader;
+	this->sampler = sampler;
+}
+
+std::shared_ptr<Material> MaterialLibrary::GetMaterial(const MaterialDefinition& definition)
+{
+	// Only a handful of materials are ever loaded, so a linear search is plenty
+	for (size_t i = 0; i < definitions.size(); i++)
+	{
+		if (definitions[i].SameAs(definition))
+			return materials[i];
+	}
+
+	// The lit shader has no specular power, so Ns becomes the roughness
+	// that gives a similar highlight (the Blinn-Phong to Beckmann fit)
+	float roughness = sqrtf(2.0f / (std::max(definition.specularExponent, 0.0f) + 2.0f));
+	std::shared_ptr<Material> material = std::make_shared<Material>(
+		DirectX::XMFLOAT4(definition.diffuse.x, definition.diffuse.y, definition.diffuse.z, definition.opacity),
+		roughness,
+		DirectX::XMFLOAT2(0, 0),
+		vertexShader,
+		pixelShader);
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> albedo = LoadTexture(definition.diffuseMap);
+	if (!albedo)
+		albedo = GetSolidTexture(1, 1, 1, 1);
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normal = LoadTexture(definition.normalMap);
+	if (!normal)
+		normal = GetSolidTexture(0.5f, 0.5f, 1, 1);
+
+	float specular = (definition.specular.x + definition.specular.y + definition.specular.z) / 3.0f;
+
+	// Apply to shader registers
+	material->AddSampler("BasicSampler", sampler);
+	material->AddTextureSRV("SurfaceTexture", albedo);
+	material->AddTextureSRV("NormalMap", normal);
+	material->AddTextureSRV("SpeculuarTexture", GetSolidTexture(specular, specular, specular, 1));
+
+	definitions.push_back(definition);
+	materials.push_back(material);
+	return material;
+}
+
+const std::vector<std::shared_ptr<Material>>& MaterialLibrary::GetMaterials()
+{
+	return materials;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> MaterialLibrary::LoadTexture(const std::wstring& file)
+{
+	if (file.empty())
+		return nullptr;
+
+	auto found = textures.find(file);
+	if (found != textures.end())
+		return found->second;
+
+	// Failures are remembered too, so a missing file is only tried once
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(DirectX::CreateWICTextureFromFile(device.Get(), context.Get(), file.c_str(), nullptr, srv.GetAddressOf())))
+	{
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("Missing material texture %ls\n", file.c_str());
+#endif
+		srv = nullptr;
+	}
+
+	textures[file] = srv;
+	return srv;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> MaterialLibrary::GetSolidTexture(float r, float g, float b, float a)
+{
+	unsigned char texel[4] = { ToByte(r), ToByte(g), ToByte(b), ToByte(a) };
+	unsigned int key = texel[0] | (texel[1] << 8) | (texel[2] << 16) | (texel[3] << 24);
+
+	auto found = solidTextures.find(key);
+	if (found != solidTextures.end())
+		return found->second;
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = texel;
+	data.SysMemPitch = sizeof(texel);
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (SUCCEEDED(device->CreateTexture2D(&desc, &data, texture.GetAddressOf())))
+		device->CreateShaderResourceView(texture.Get(), nullptr, srv.GetAddressOf());
+
+	solidTextures[key] = srv;
+	return srv;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "Material.h"
+#include "MeshData.h"
+#include "SimpleShader.h"
+
+/*
+	Turns material definitions from .MTL libraries into Materials for
+	the lit shader.
+
+	Every mesh's definitions go through here, so two slots that describe
+	the same material (even from different objs and libraries) share one
+	Material, and every texture is only ever loaded once.
+
+	Definitions without a diffuse or normal map get a 1x1 texture in its
+	place (white or a flat normal), and the specular map is always a 1x1
+	texture of Ks, so the lit shader can draw any of them.
+*/
+class MaterialLibrary
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static MaterialLibrary& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new MaterialLibrary();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	MaterialLibrary(MaterialLibrary const&) = delete;
+	void operator=(MaterialLibrary const&) = delete;
+
+private:
+	static MaterialLibrary* instance;
+	MaterialLibrary();
+#pragma endregion
+
+public:
+	/// <summary>
+	/// Set what materials are created with. Must be called before GetMaterial
+	/// </summary>
+	void Initialize(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		std::shared_ptr<SimpleVertexShader> vertexShader,
+		std::shared_ptr<SimplePixelShader> pixelShader,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
+
+	/// <summary>
+	/// Get the material for a definition, creating it the first time
+	/// an identical definition is seen
+	/// </summary>
+	std::shared_ptr<Material> GetMaterial(const MaterialDefinition& definition);
+
+	/// <summary>
+	/// Get every material created so far, for passing per frame shader data
+	/// </summary>
+	const std::vector<std::shared_ptr<Material>>& GetMaterials();
+
+private:
+	/// <summary>
+	/// Load a texture file, or reuse it if it was loaded before. Null if it couldn't be loaded
+	/// </summary>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> LoadTexture(const std::wstring& file);
+	/// <summary>
+	/// Get a 1x1 texture of a single color, creating it the first time
+	/// </summary>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSolidTexture(float r, float g, float b, float a);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	std::shared_ptr<SimpleVertexShader> vertexShader;
+	std::shared_ptr<SimplePixelShader> pixelShader;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
+
+	// Created materials, and the definition each one was made from
+	std::vector<MaterialDefinition> definitions;
+	std::vector<std::shared_ptr<Material>> materials;
+
+	// Textures by file name, and solid textures by packed color
+	std::unordered_map<std::wstring, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textures;
+	std::unordered_map<unsigned int, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> solidTextures;
+};
@@ -1,370 +1,259 @@
 #include "Mesh.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "VertexCompression.h"
+#include "TangentGenerator.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "GeometryArena.h"
+#include "MtlParser.h"
+#include "GltfParser.h"
+
+#include <algorithm>
 using namespace DirectX;
 
-Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Vertex vertices[], unsigned int indices[], int vertexCount, int indexCount)
-	:device(device), deviceContext(deviceContext), indicesCount(indexCount), vertexCount(vertexCount)
+Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Vertex vertices[], unsigned int indices[], int vertexCount, int indexCount, VertexFormat format, TangentMode tangentMode, bool buildMeshlets, bool buildBvh)
+	:device(device), deviceContext(deviceContext), indicesCount(0), vertexCount(0), buildMeshlets(buildMeshlets), buildBvh(buildBvh), boundsMin(0, 0, 0), boundsMax(0, 0, 0), boundsCenter(0, 0, 0), boundsRadius(0), format(format), tangentMode(tangentMode), ready(false), geometry(GEOMETRY_ARENA_INVALID)
 {
-	CalculateTangents(&vertices[0], vertexCount, &indices[0], indexCount);
-	ContructVIBuffers(device, deviceContext, vertices, indices);
+	// Copy so the optimizer can reorder without touching the caller's arrays
+	MeshData data;
+	data.vertices.assign(vertices, vertices + vertexCount);
+	data.indices.assign(indices, indices + indexCount);
+	if (data.indices.empty())
+		return;
+
+	ProcessMeshData(data, tangentMode, buildMeshlets);
+	Upload(data);
 }
 
-Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const wchar_t* objFile):
-	device(device), deviceContext(deviceContext)
+Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const wchar_t* objFile, VertexFormat format, TangentMode tangentMode, bool buildMeshlets, bool buildBvh):
+	device(device), deviceContext(deviceContext), indicesCount(0), vertexCount(0), buildMeshlets(buildMeshlets), buildBvh(buildBvh), boundsMin(0, 0, 0), boundsMax(0, 0, 0), boundsCenter(0, 0, 0), boundsRadius(0), format(format), tangentMode(tangentMode), ready(false), geometry(GEOMETRY_ARENA_INVALID)
 {
-	// Author: Chris Cascioli
-// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-//
-// - NOTE: You'll need to #include <fstream>
+	// The hash ties the cooked file to the exact obj it came from,
+	// so any edit to the obj makes the cache stale
+	uint64_t sourceHash = 0;
+	bool hasSource = MeshCache::HashFile(objFile, sourceHash);
+	std::wstring cacheFile = MeshCache::GetCachePath(objFile);
+
+	if (hasSource && LoadFromCache(objFile, cacheFile.c_str(), sourceHash))
+		return;
 
+	MeshData data;
+	if (!ImportFile(objFile, sourceHash, tangentMode, buildMeshlets, data))
+		return;
 
-// File input object
-	std::ifstream obj(objFile);
+	Upload(data);
+}
 
-	// Check for successful open
-	if (!obj.is_open())
+Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const GltfPrimitive& primitive, VertexFormat format, bool buildBvh) :
+	device(device), deviceContext(deviceContext), indicesCount(0), vertexCount(0), buildMeshlets(false), buildBvh(buildBvh), boundsMin(0, 0, 0), boundsMax(0, 0, 0), boundsCenter(0, 0, 0), boundsRadius(0), format(format), tangentMode(TANGENT_MODE_FAST), ready(false), geometry(GEOMETRY_ARENA_INVALID)
+{
+	if (primitive.indexCount == 0 || primitive.data.vertices.empty())
 		return;
 
-	// Variables used while reading the file
-	std::vector<DirectX::XMFLOAT3> positions;	// Positions from the file
-	std::vector<DirectX::XMFLOAT3> normals;		// Normals from the file
-	std::vector<DirectX::XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+	indicesCount = (int)primitive.indexCount;
+	vertexCount = (int)primitive.data.vertices.size();
+	boundsMin = primitive.data.boundsMin;
+	boundsMax = primitive.data.boundsMax;
+	boundsCenter = primitive.data.boundsCenter;
+	boundsRadius = primitive.data.boundsRadius;
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			DirectX::XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(DirectX::XMFLOAT2(0, 0));
-			}
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
-		}
+	// Flipping the winding would mean rewriting the indices, so
+	// the rasterizer is told which way round they are instead
+	if (device)
+	{
+		D3D11_RASTERIZER_DESC rastDesc = {};
+		rastDesc.FillMode = D3D11_FILL_SOLID;
+		rastDesc.CullMode = D3D11_CULL_BACK;
+		rastDesc.FrontCounterClockwise = true;
+		rastDesc.DepthClipEnable = true;
+		device->CreateRasterizerState(&rastDesc, windingState.GetAddressOf());
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
+	// The indices may still be in the mapped file, so the arena copies them
+	// from there without them ever being touched on the CPU
+	ContructVIBuffers(device, deviceContext, &primitive.data.vertices[0], primitive.GetIndices());
+	if (buildBvh)
+		BuildBvh(&primitive.data.vertices[0], primitive.GetIndices(), GetLod(0), bvh);
+	BuildOccluder(&primitive.data.vertices[0], primitive.GetIndices(), GetLod(GetLodCount() - 1), occluderCorners);
+	ready = true;
+}
 
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is the number of vertices
-	// - "indexCounter" is the number of indices
-	// - Yes, these are effectively the same since OBJs do not index entire vertices!  This means
-	//    an index buffer isn't doing much for us.  We could try to optimize the mesh ourselves
-	//    and detect duplicate vertices, but at that point it would be better to use a more
-	//    sophisticated model loading library like TinyOBJLoader or The Open Asset Importer Library
+Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, VertexFormat format, TangentMode tangentMode, bool buildMeshlets, bool buildBvh) :
+	device(device), deviceContext(deviceContext), indicesCount(0), vertexCount(0), buildMeshlets(buildMeshlets), buildBvh(buildBvh), boundsMin(0, 0, 0), boundsMax(0, 0, 0), boundsCenter(0, 0, 0), boundsRadius(0), format(format), tangentMode(tangentMode), ready(false), geometry(GEOMETRY_ARENA_INVALID)
+{
+	// Buffers are created later by Upload(), once the data is loaded
+}
 
-	indicesCount = indexCounter;
-	vertexCount = vertCounter;
+// --------------------------------------------------------
+// Import pipeline shared by every source of raw geometry
+// - Tangents come first since MikkTSpace mode can split
+//    vertices, and the optimizer should see the final set
+// - Then reorders for the GPU's caches, builds the LOD
+//    chain from the optimized indices and finds bounds
+// - Meshlets come last since they reorder the full
+//    detail range into clusters
+// - Meshes with several materials skip both, since LODs
+//    and meshlets would mix triangles across submeshes
+// --------------------------------------------------------
+void Mesh::ProcessMeshData(MeshData& data, TangentMode tangentMode, bool buildMeshlets)
+{
+	TangentGenerator::Generate(data, tangentMode);
+	MeshOptimizer::Optimize(data);
 
-	CalculateTangents(&verts[0], vertexCount, &indices[0], indicesCount);
-	ContructVIBuffers(device, deviceContext, &(verts[0]), &(indices[0]));
+	if (data.submeshes.size() <= 1)
+	{
+		MeshSimplifier::GenerateLods(data);
+		if (buildMeshlets)
+			MeshletBuilder::Build(data);
+	}
+
+	data.CalculateBounds();
 }
 
-Mesh::~Mesh()
+bool Mesh::ImportFile(const wchar_t* objFile, uint64_t sourceHash, TangentMode tangentMode, bool buildMeshlets, MeshData& data)
 {
+	// Parsing happens entirely on the CPU, see ObjParser for details
+	if (!ObjParser::ParseFile(objFile, data) || data.indices.empty())
+		return false;
 
+	ProcessMeshData(data, tangentMode, buildMeshlets);
+
+	// Missing or stale, so cook it for next time
+	MeshCache::Write(MeshCache::GetCachePath(objFile).c_str(), sourceHash, tangentMode, data);
+	return true;
 }
 
-void Mesh::ContructVIBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Vertex vertices[], unsigned int indices[])
+bool Mesh::LoadMeshData(const wchar_t* objFile, TangentMode tangentMode, bool buildMeshlets, MeshData& data)
 {
-	// Create a VERTEX BUFFER
-		// - This holds the vertex data of triangles for a single object
-		// - This buffer is created on the GPU, which is where the data needs to
-		//    be if we want the GPU to act on it (as in: draw it to the screen)
-	{
-		// First, we need to describe the buffer we want Direct3D to make on the GPU
-		//  - Note that this variable is created on the stack since we only need it once
-		//  - After the buffer is created, this description variable is unnecessary
-		D3D11_BUFFER_DESC vbd = {};
-		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * vertexCount;       // 3 = number of vertices in the buffer
-		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
-		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		vbd.MiscFlags = 0;
-		vbd.StructureByteStride = 0;
-
-		// Create the proper struct to hold the initial vertex data
-		// - This is how we initially fill the buffer with data
-		// - Essentially, we're specifying a pointer to the data to copy
-		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer on the GPU with the initial data
-		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
-		device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
-	}
+	uint64_t sourceHash = 0;
+	bool hasSource = MeshCache::HashFile(objFile, sourceHash);
 
-	// Create an INDEX BUFFER
-	// - This holds indices to elements in the vertex buffer
-	// - This is most useful when vertices are shared among neighboring triangles
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
+	if (hasSource)
 	{
-		// Describe the buffer, as we did above, with two major differences
-		//  - Byte Width (3 unsigned integers vs. 3 whole vertices)
-		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
-		D3D11_BUFFER_DESC ibd = {};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * indicesCount;
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
-		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		ibd.MiscFlags = 0;
-		ibd.StructureByteStride = 0;
-
-		// Specify the initial data for this buffer, similar to above
-		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer with the initial data
-		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-		device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+		// Copied out, since the mapping can't outlive this call
+		MeshCacheView cache(MeshCache::GetCachePath(objFile).c_str(), sourceHash, tangentMode, buildMeshlets);
+		if (cache.IsValid() && cache.GetIndexCount() > 0)
+		{
+			data.vertices.assign(cache.GetVertices(), cache.GetVertices() + cache.GetVertexCount());
+			data.indices.assign(cache.GetIndices(), cache.GetIndices() + cache.GetIndexCount());
+			data.lods.assign(cache.GetLods(), cache.GetLods() + cache.GetLodCount());
+			data.meshlets.assign(cache.GetMeshlets(), cache.GetMeshlets() + cache.GetMeshletCount());
+			data.submeshes.assign(cache.GetSubmeshes(), cache.GetSubmeshes() + cache.GetSubmeshCount());
+			data.materialSlots.assign(cache.GetMaterialSlots(), cache.GetMaterialSlots() + cache.GetMaterialSlotCount());
+			data.materialLibraries.assign(cache.GetMaterialLibraries(), cache.GetMaterialLibraries() + cache.GetMaterialLibraryCount());
+			data.boundsMin = cache.GetBoundsMin();
+			data.boundsMax = cache.GetBoundsMax();
+			data.boundsCenter = cache.GetBoundsCenter();
+			data.boundsRadius = cache.GetBoundsRadius();
+
+			// Libraries aren't part of the obj's hash, so they're read fresh every load
+			MtlParser::ResolveMaterials(
+				objFile,
+				data.materialSlots.data(), data.materialSlots.size(),
+				data.materialLibraries.data(), data.materialLibraries.size(),
+				data.materials);
+			return true;
+		}
 	}
+
+	return ImportFile(objFile, sourceHash, tangentMode, buildMeshlets, data);
 }
 
-// --------------------------------------------------------
-// Calculates the tangents of the vertices in a mesh
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-// - Updated version found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-// - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-// contain an XMFLOAT3 called Tangent
-//
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
-// --------------------------------------------------------
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+void Mesh::BuildBvh(const Vertex* vertices, const unsigned int* indices, const MeshLod& fullDetail, MeshBvh& bvh)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = DirectX::XMFLOAT3(0, 0, 0);
-	}
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
+	// Only full detail is cast against, so picks match what's drawn up close
+	bvh.Build(vertices, indices + fullDetail.indexStart, fullDetail.indexCount);
+}
+
+void Mesh::BuildOccluder(const Vertex* vertices, const unsigned int* indices, const MeshLod& coarsest, std::vector<XMFLOAT3>& corners)
+{
+	corners.clear();
+	if (coarsest.indexCount / 3 > MESH_OCCLUDER_MAX_TRIANGLES)
+		return;
+
+	corners.resize(coarsest.indexCount);
+	for (unsigned int i = 0; i < coarsest.indexCount; i++)
+		corners[i] = vertices[indices[coarsest.indexStart + i]].Position;
+}
+
+void Mesh::Upload(const MeshData& data)
+{
+	indicesCount = (int)data.indices.size();
+	vertexCount = (int)data.vertices.size();
+	boundsMin = data.boundsMin;
+	boundsMax = data.boundsMax;
+	boundsCenter = data.boundsCenter;
+	boundsRadius = data.boundsRadius;
+	lods = data.lods;
+	meshlets = data.meshlets;
+	submeshes = data.submeshes;
+	materials = data.materials;
+
+	ContructVIBuffers(device, deviceContext, &data.vertices[0], &data.indices[0]);
+	if (buildBvh && !bvh.IsBuilt())
+		BuildBvh(&data.vertices[0], &data.indices[0], GetLod(0), bvh);
+	BuildOccluder(&data.vertices[0], &data.indices[0], GetLod(GetLodCount() - 1), occluderCorners);
+	ready = true;
+}
+
+bool Mesh::LoadFromCache(const wchar_t* objFile, const wchar_t* cacheFile, uint64_t sourceHash)
+{
+	MeshCacheView cache(cacheFile, sourceHash, tangentMode, buildMeshlets);
+	if (!cache.IsValid() || cache.GetIndexCount() == 0)
+		return false;
+
+	indicesCount = (int)cache.GetIndexCount();
+	vertexCount = (int)cache.GetVertexCount();
+	boundsMin = cache.GetBoundsMin();
+	boundsMax = cache.GetBoundsMax();
+	boundsCenter = cache.GetBoundsCenter();
+	boundsRadius = cache.GetBoundsRadius();
+	lods.assign(cache.GetLods(), cache.GetLods() + cache.GetLodCount());
+	meshlets.assign(cache.GetMeshlets(), cache.GetMeshlets() + cache.GetMeshletCount());
+	submeshes.assign(cache.GetSubmeshes(), cache.GetSubmeshes() + cache.GetSubmeshCount());
+	MtlParser::ResolveMaterials(
+		objFile,
+		cache.GetMaterialSlots(), cache.GetMaterialSlotCount(),
+		cache.GetMaterialLibraries(), cache.GetMaterialLibraryCount(),
+		materials);
+
+	// Uncompressed blobs are already in their final form, so D3D copies
+	// them straight out of the mapped file with no per vertex work.
+	// Compressed ones were decoded into the cache when it was opened
+	ContructVIBuffers(device, deviceContext, cache.GetVertices(), cache.GetIndices());
+	if (buildBvh)
+		BuildBvh(cache.GetVertices(), cache.GetIndices(), GetLod(0), bvh);
+	BuildOccluder(cache.GetVertices(), cache.GetIndices(), GetLod(GetLodCount() - 1), occluderCorners);
+	ready = true;
+	return true;
+}
+
+Mesh::~Mesh()
+{
+	GeometryArena::GetInstance().Free(geometry);
+}
+
+void Mesh::ContructVIBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const Vertex vertices[], const unsigned int indices[])
+{
+	// Compact formats are encoded right before upload, so the cache and
+	// every CPU side step only ever deal with full vertices
+	dequantization = VertexCompression::CalculateDequantization(format, vertices, vertexCount);
+	std::vector<uint8_t> encodedVertices;
+	const void* vertexData = vertices;
+	if (format != VERTEX_FORMAT_FULL)
 	{
-		// Grab the two vectors
-		DirectX::XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		DirectX::XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = DirectX::XMVector3Normalize(
-			tangent - normal * DirectX::XMVector3Dot(normal, tangent)); // Value is repeated for each componenent apparently 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
+		VertexCompression::Encode(format, vertices, vertexCount, dequantization, encodedVertices);
+		vertexData = &encodedVertices[0];
 	}
-}
 
+	// Rather than buffers of its own, the mesh gets a slice of the arena's
+	// shared ones, so meshes drawn back to back don't rebind anything
+	GeometryArena& arena = GeometryArena::GetInstance();
+	arena.Free(geometry);
+	geometry = arena.Allocate(format, vertexData, vertexCount, indices, indicesCount);
+}
 
 /// <summary>
 /// Get this mesh's vertex buffer 
@@ -372,7 +261,7 @@ void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices,
 /// <returns></returns>
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
 {
-	return vertexBuffer;
+	return GeometryArena::GetInstance().GetVertexBuffer(format);
 }
 /// <summary>
 /// Get this mesh's index buffer 
@@ -380,7 +269,7 @@ Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
 /// <returns></returns>
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
 {
-	return indexBuffer;
+	return GeometryArena::GetInstance().GetIndexBuffer();
 }
 
 /// <summary>
@@ -392,21 +281,224 @@ int Mesh::GetIndexCount()
 	return indicesCount;
 }
 
-void Mesh::Draw()
+/// <summary>
+/// Get the minimum corner of this mesh's local bounding box 
+/// </summary>
+/// <returns></returns>
+DirectX::XMFLOAT3 Mesh::GetBoundsMin()
+{
+	return boundsMin;
+}
+
+/// <summary>
+/// Get the maximum corner of this mesh's local bounding box 
+/// </summary>
+/// <returns></returns>
+DirectX::XMFLOAT3 Mesh::GetBoundsMax()
+{
+	return boundsMax;
+}
+
+/// <summary>
+/// Get the center of this mesh's local bounding sphere 
+/// </summary>
+/// <returns></returns>
+DirectX::XMFLOAT3 Mesh::GetBoundsCenter()
+{
+	return boundsCenter;
+}
+
+/// <summary>
+/// Get the radius of this mesh's local bounding sphere 
+/// </summary>
+/// <returns></returns>
+float Mesh::GetBoundsRadius()
+{
+	return boundsRadius;
+}
+
+VertexFormat Mesh::GetVertexFormat()
+{
+	return format;
+}
+
+VertexDequantization Mesh::GetDequantization()
+{
+	return dequantization;
+}
+
+/// <summary>
+/// Get how many levels of detail this mesh can be drawn at
+/// </summary>
+/// <returns></returns>
+unsigned int Mesh::GetLodCount()
+{
+	return lods.empty() ? 1 : (unsigned int)lods.size();
+}
+
+/// <summary>
+/// Get the index range and error of one level of detail
+/// </summary>
+/// <returns></returns>
+MeshLod Mesh::GetLod(unsigned int lod)
+{
+	if (lods.empty())
+	{
+		MeshLod full = { 0, (unsigned int)indicesCount, 0.0f };
+		return full;
+	}
+	return lods[lod < lods.size() ? lod : lods.size() - 1];
+}
+
+/// <summary>
+/// Get whether this mesh's buffers exist yet. Meshes from the
+/// MeshLoader aren't ready until their data has been uploaded
+/// </summary>
+/// <returns></returns>
+bool Mesh::IsReady()
+{
+	return ready;
+}
+
+bool Mesh::HasMeshlets()
+{
+	return !meshlets.empty();
+}
+
+const std::vector<Meshlet>& Mesh::GetMeshlets()
+{
+	return meshlets;
+}
+
+bool Mesh::HasBvh()
 {
+	return bvh.IsBuilt();
+}
+
+const MeshBvh& Mesh::GetBvh()
+{
+	return bvh;
+}
+
+const std::vector<XMFLOAT3>& Mesh::GetOccluderCorners()
+{
+	return occluderCorners;
+}
+
+/// <summary>
+/// Get how many parts with their own material this mesh is drawn in
+/// </summary>
+/// <returns></returns>
+unsigned int Mesh::GetSubmeshCount()
+{
+	return submeshes.empty() ? 1 : (unsigned int)submeshes.size();
+}
+
+/// <summary>
+/// Get the index range and material slot of one part of the mesh
+/// </summary>
+/// <returns></returns>
+Submesh Mesh::GetSubmesh(unsigned int submesh)
+{
+	if (submeshes.empty())
+	{
+		Submesh whole = { 0, (unsigned int)indicesCount, 0 };
+		return whole;
+	}
+	return submeshes[submesh < submeshes.size() ? submesh : submeshes.size() - 1];
+}
+
+unsigned int Mesh::GetMaterialCount()
+{
+	return (unsigned int)materials.size();
+}
+
+/// <summary>
+/// Get what the obj's libraries say a material slot looks like. Slots
+/// without a definition, or meshes without materials, get the default
+/// </summary>
+/// <returns></returns>
+const MaterialDefinition& Mesh::GetMaterialDefinition(unsigned int slot)
+{
+	static const MaterialDefinition undefined;
+	return slot < materials.size() ? materials[slot] : undefined;
+}
+
+bool Mesh::Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, RayHit& hit)
+{
+	if (!ready)
+		return false;
+
+	return bvh.Intersect(origin, direction, maxDistance, hit);
+}
+
+void Mesh::CullMeshlets(const Frustum& frustum, DirectX::XMFLOAT3 cameraPosition, const DirectX::XMFLOAT4X4& world, std::vector<IndexRange>& visibleRanges)
+{
+	visibleRanges.clear();
+
+	XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+	XMVECTOR cameraPos = XMLoadFloat3(&cameraPosition);
+
+	// Spheres grow with the largest scale. Cones only hold up under uniform
+	// scale with no mirroring, otherwise the normals would need re-deriving
+	float scaleX = XMVectorGetX(XMVector3Length(worldMatrix.r[0]));
+	float scaleY = XMVectorGetX(XMVector3Length(worldMatrix.r[1]));
+	float scaleZ = XMVectorGetX(XMVector3Length(worldMatrix.r[2]));
+	float maxScale = std::max(scaleX, std::max(scaleY, scaleZ));
+	float minScale = std::min(scaleX, std::min(scaleY, scaleZ));
+	bool useCones =
+		maxScale - minScale <= maxScale * 0.001f &&
+		XMVectorGetX(XMMatrixDeterminant(worldMatrix)) > 0.0f;
+
+	for (const Meshlet& meshlet : meshlets)
+	{
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&meshlet.center), worldMatrix);
+		float radius = meshlet.radius * maxScale;
+
+		XMFLOAT3 worldCenter;
+		XMStoreFloat3(&worldCenter, center);
+		if (!frustum.IntersectsSphere(worldCenter, radius))
+			continue;
+
+		// Every triangle faces away if the camera sees the whole cone from behind
+		if (useCones && meshlet.coneCutoff < 1.0f)
+		{
+			XMVECTOR axis = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&meshlet.coneAxis), worldMatrix));
+			XMVECTOR toCenter = XMVectorSubtract(center, cameraPos);
+			float along = XMVectorGetX(XMVector3Dot(toCenter, axis));
+			if (along >= meshlet.coneCutoff * XMVectorGetX(XMVector3Length(toCenter)) + radius)
+				continue;
+		}
+
+		// Visible neighbors in the buffer are drawn with one call
+		if (!visibleRanges.empty() &&
+			visibleRanges.back().indexStart + visibleRanges.back().indexCount == meshlet.indexStart)
+		{
+			visibleRanges.back().indexCount += meshlet.indexCount;
+		}
+		else
+		{
+			IndexRange range = { meshlet.indexStart, meshlet.indexCount };
+			visibleRanges.push_back(range);
+		}
+	}
+}
+
+void Mesh::Draw(unsigned int lod)
+{
+	// Every LOD lives in the same index buffer, so picking
+	// one is only a matter of which range gets drawn
+	if (!ready)
+		return;
+
+	MeshLod range = GetLod(lod);
+	const GeometryAllocation& allocation = GeometryArena::GetInstance().GetAllocation(geometry);
+
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
 	{
-		// Set buffers in the input assembler (IA) stage
-		//  - Do this ONCE PER OBJECT, since each object may have different geometry
-		//  - For this demo, this step *could* simply be done once during Init()
-		//  - However, this needs to be done between EACH DrawIndexed() call
-		//     when drawing different geometry, so it's here as an example
-		deviceContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-		deviceContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+		SetBuffers();
 
 		// Tell Direct3D to draw
 		//  - Begins the rendering pipeline on the GPU
@@ -415,11 +507,54 @@ void Mesh::Draw()
 		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 		//     vertices in the currently set VERTEX BUFFER
 		deviceContext->DrawIndexed(
-			indicesCount,     // The number of indices to use (we could draw a subset if we wanted)
-			0,     // Offset to the first index we want to use
-			0);    // Offset to add to each index when looking up vertices
+			range.indexCount,     // The number of indices to use (we could draw a subset if we wanted)
+			allocation.firstIndex + range.indexStart,     // Offset to the first index we want to use
+			allocation.baseVertex);    // Offset to add to each index when looking up vertices
+
+		ResetWinding();
 	}
 
 }
 
+void Mesh::DrawRanges(const std::vector<IndexRange>& ranges)
+{
+	if (!ready || ranges.empty())
+		return;
+
+	const GeometryAllocation& allocation = GeometryArena::GetInstance().GetAllocation(geometry);
 
+	SetBuffers();
+	for (const IndexRange& range : ranges)
+		deviceContext->DrawIndexed(range.indexCount, allocation.firstIndex + range.indexStart, allocation.baseVertex);
+	ResetWinding();
+}
+
+void Mesh::DrawSubmesh(unsigned int submesh)
+{
+	if (!ready)
+		return;
+
+	Submesh range = GetSubmesh(submesh);
+	const GeometryAllocation& allocation = GeometryArena::GetInstance().GetAllocation(geometry);
+
+	SetBuffers();
+	deviceContext->DrawIndexed(range.indexCount, allocation.firstIndex + range.indexStart, allocation.baseVertex);
+	ResetWinding();
+}
+
+void Mesh::SetBuffers()
+{
+	// Set buffers in the input assembler (IA) stage
+	//  - Every mesh of this format shares the same buffers, so the
+	//     arena skips this entirely when they're already set
+	GeometryArena::GetInstance().Bind(format);
+
+	if (windingState)
+		deviceContext->RSSetState(windingState.Get());
+}
+
+void Mesh::ResetWinding()
+{
+	if (windingState)
+		deviceContext->RSSetState(0);
+}
@@ -4,19 +4,30 @@
 #include <d3d11.h>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include "Vertex.h"
+#include "MeshData.h"
+#include "VertexCompression.h"
+#include "TangentGenerator.h"
+#include "Frustum.h"
+#include "MeshBvh.h"
 
-#include <fstream>
 #include <vector>
 #include <DirectXMath.h>
 
+// Most triangles a mesh's coarsest LOD may have for it to be kept as
+// an occluder shape. Anything bigger would cost more to rasterize on the
+// CPU than it could save
+#define MESH_OCCLUDER_MAX_TRIANGLES 4096
+
+struct GltfPrimitive;
+
 class Mesh
 {
 private:
-	void ContructVIBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Vertex vertices[], unsigned int indices[]);
-
-	// Buffers that connect data to the GPU 
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	void ContructVIBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const Vertex vertices[], const unsigned int indices[]);
+	/// <summary>
+	/// Try to create the buffers straight from a cooked version of the given file
+	/// </summary>
+	bool LoadFromCache(const wchar_t* objFile, const wchar_t* cacheFile, uint64_t sourceHash);
 
 	Microsoft::WRL::ComPtr<ID3D11Device> device; 
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
@@ -24,23 +35,165 @@ private:
 	int indicesCount;
 	int vertexCount;
 
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	// Index ranges for each level of detail, full detail first
+	std::vector<MeshLod> lods;
+
+	// Clusters of the full detail triangles, culled individually
+	bool buildMeshlets;
+	std::vector<Meshlet> meshlets;
+
+	// Index ranges drawn with each material, empty for a single material,
+	// and what the obj's libraries say each material slot looks like
+	std::vector<Submesh> submeshes;
+	std::vector<MaterialDefinition> materials;
+
+	// Triangles of the full detail range, for ray casts
+	bool buildBvh;
+	MeshBvh bvh;
+
+	// Corners of the coarsest LOD's triangles, three per triangle, for
+	// software occlusion culling. Empty if it has too many triangles
+	std::vector<DirectX::XMFLOAT3> occluderCorners;
+
+	// Local space bounds of the vertex positions
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	DirectX::XMFLOAT3 boundsCenter;
+	float boundsRadius;
+
+	// How the vertex buffer is laid out, and what undoes its quantization
+	VertexFormat format;
+	VertexDequantization dequantization;
+
+	// How tangents are generated, cooked caches have to match it
+	TangentMode tangentMode;
+
+	// False until the buffers have been created
+	bool ready;
+
+	// Handle to where the vertices and indices live in the GeometryArena
+	unsigned int geometry;
+
+	// Set while drawing meshes whose front faces are counter-clockwise, null otherwise
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> windingState;
+
+	/// <summary>
+	/// Generate tangents, optimize, build LODs and meshlets and find bounds for freshly imported geometry
+	/// </summary>
+	static void ProcessMeshData(MeshData& data, TangentMode tangentMode, bool buildMeshlets);
+	/// <summary>
+	/// Parse and process an obj file, then cook it for next time
+	/// </summary>
+	static bool ImportFile(const wchar_t* objFile, uint64_t sourceHash, TangentMode tangentMode, bool buildMeshlets, MeshData& data);
+	/// <summary>
+	/// Get the processed data for an obj file from its cooked copy, or by importing
+	/// it. Touches no D3D or mesh state, so it can run on any thread
+	/// </summary>
+	static bool LoadMeshData(const wchar_t* objFile, TangentMode tangentMode, bool buildMeshlets, MeshData& data);
+	/// <summary>
+	/// Build a ray cast hierarchy over the full detail triangles of processed data
+	/// </summary>
+	static void BuildBvh(const Vertex* vertices, const unsigned int* indices, const MeshLod& fullDetail, MeshBvh& bvh);
+	/// <summary>
+	/// Copy out the positions of the coarsest LOD's triangles, if there are few enough of them
+	/// </summary>
+	static void BuildOccluder(const Vertex* vertices, const unsigned int* indices, const MeshLod& coarsest, std::vector<DirectX::XMFLOAT3>& corners);
+	/// <summary>
+	/// Take on processed data and create the buffers for it. Builds the
+	/// ray cast hierarchy too, unless one was already built off thread
+	/// </summary>
+	void Upload(const MeshData& data);
+
+	/// <summary>
+	/// Create an empty mesh for the MeshLoader to upload into later
+	/// </summary>
+	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, VertexFormat format, TangentMode tangentMode, bool buildMeshlets, bool buildBvh);
+	friend class MeshLoader;
+	/// <summary>
+	/// Bind the arena's buffers for this mesh's format to the input assembler,
+	/// and the winding state if it has one
+	/// </summary>
+	void SetBuffers();
+	/// <summary>
+	/// Put back the default rasterizer state if SetBuffers changed it
+	/// </summary>
+	void ResetWinding();
 
 public:
 	/// <summary>
 	/// Create a mesh based on manually given vertex data
 	/// </summary>
-	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Vertex vertices[], unsigned int indices[], int vertexCount, int indexCount);
+	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Vertex vertices[], unsigned int indices[], int vertexCount, int indexCount, VertexFormat format = VERTEX_FORMAT_FULL, TangentMode tangentMode = TANGENT_MODE_FAST, bool buildMeshlets = false, bool buildBvh = false);
 	/// <summary>
 	/// Create a mesh based on a given obj file 
+	/// - A cooked copy is kept next to the file and loaded instead
+	///    of the obj whenever it is up to date
+	/// - The format only changes what is uploaded to the GPU
+	/// - Use MikkTSpace tangents for normal maps baked by other tools
+	/// - Meshlets let large meshes draw only the parts in view
+	/// - A BVH keeps a copy of the triangles so rays can be cast against them
+	/// </summary>
+	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const wchar_t* file, VertexFormat format = VERTEX_FORMAT_FULL, TangentMode tangentMode = TANGENT_MODE_FAST, bool buildMeshlets = false, bool buildBvh = false);
+	/// <summary>
+	/// Create a mesh from one primitive of a glTF asset
+	/// - Its indices are uploaded straight from the asset, so
+	///    it's drawn as is, without optimizing or LODs
+	/// - It keeps glTF's counter-clockwise front faces
 	/// </summary>
-	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const wchar_t* file);
+	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const GltfPrimitive& primitive, VertexFormat format = VERTEX_FORMAT_FULL, bool buildBvh = false);
 	~Mesh();
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	int GetIndexCount();
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
+	VertexFormat GetVertexFormat();
+	VertexDequantization GetDequantization();
+	bool IsReady();
+	unsigned int GetLodCount();
+	MeshLod GetLod(unsigned int lod);
+	bool HasMeshlets();
+	const std::vector<Meshlet>& GetMeshlets();
+	bool HasBvh();
+	const MeshBvh& GetBvh();
+	/// <summary>
+	/// Get the local space corners of the triangles that stand in for this
+	/// mesh when it hides other things, three per triangle. May be empty
+	/// </summary>
+	const std::vector<DirectX::XMFLOAT3>& GetOccluderCorners();
+	unsigned int GetSubmeshCount();
+	Submesh GetSubmesh(unsigned int submesh);
+	unsigned int GetMaterialCount();
+	const MaterialDefinition& GetMaterialDefinition(unsigned int slot);
 
-	void Draw();
+	/// <summary>
+	/// Find the closest full detail triangle a local space ray hits before
+	/// maxDistance. Always misses without a BVH
+	/// </summary>
+	bool Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, RayHit& hit);
+
+	/// <summary>
+	/// Find the index ranges of the meshlets that are inside the frustum and
+	/// not entirely back facing, merging neighbors into single ranges
+	/// </summary>
+	void CullMeshlets(const Frustum& frustum, DirectX::XMFLOAT3 cameraPosition, const DirectX::XMFLOAT4X4& world, std::vector<IndexRange>& visibleRanges);
+
+	/// <summary>
+	/// Draw the mesh at the given level of detail, 0 being full detail.
+	/// Out of range LODs are clamped to the coarsest one
+	/// </summary>
+	void Draw(unsigned int lod = 0);
+	/// <summary>
+	/// Draw only the given index ranges, like the ones from CullMeshlets
+	/// </summary>
+	void DrawRanges(const std::vector<IndexRange>& ranges);
+	/// <summary>
+	/// Draw one material's part of the mesh. Every submesh shares the
+	/// same buffers, so drawing them back to back binds nothing new
+	/// </summary>
+	void DrawSubmesh(unsigned int submesh);
 };
 
@@ -0,0 +1,534 @@
+#include "MeshBvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+// Child references in a node: a node index, or a triangle pack with this bit set
+#define MESH_BVH_LEAF 0x80000000u
+#define MESH_BVH_EMPTY 0xFFFFFFFFu
+// Collapsing never makes the tree deeper than the binary one, and
+// each level pushes at most three more entries than it pops
+#define MESH_BVH_STACK_SIZE (3 * MESH_BVH_MAX_DEPTH + 1)
+
+namespace
+{
+	float HalfArea(XMFLOAT3 boxMin, XMFLOAT3 boxMax)
+	{
+		float x = boxMax.x - boxMin.x;
+		float y = boxMax.y - boxMin.y;
+		float z = boxMax.z - boxMin.z;
+		return x * y + y * z + z * x;
+	}
+
+	void Expand(XMFLOAT3& boxMin, XMFLOAT3& boxMax, XMFLOAT3 otherMin, XMFLOAT3 otherMax)
+	{
+		boxMin.x = std::min(boxMin.x, otherMin.x);
+		boxMin.y = std::min(boxMin.y, otherMin.y);
+		boxMin.z = std::min(boxMin.z, otherMin.z);
+		boxMax.x = std::max(boxMax.x, otherMax.x);
+		boxMax.y = std::max(boxMax.y, otherMax.y);
+		boxMax.z = std::max(boxMax.z, otherMax.z);
+	}
+
+	float GetAxis(XMFLOAT3 v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	// --------------------------------------------------------
+	// Narrows [enter, leave] to where the ray is between one
+	// axis' pair of slab planes, given the distances to them.
+	// A ray parallel to the planes starting on one of them
+	// gets 0 * inf = NaN, which min and max don't order. It
+	// runs along the plane, so it's inside the slab all the way
+	// --------------------------------------------------------
+	void ClipSlab(__m128 t0, __m128 t1, __m128& enter, __m128& leave)
+	{
+		__m128 ordered = _mm_cmpord_ps(t0, t1);
+		enter = _mm_max_ps(enter, _mm_and_ps(ordered, _mm_min_ps(t0, t1)));
+		leave = _mm_min_ps(leave, _mm_or_ps(
+			_mm_and_ps(ordered, _mm_max_ps(t0, t1)),
+			_mm_andnot_ps(ordered, leave)));
+	}
+}
+
+MeshBvh::MeshBvh() :
+	triangleCount(0),
+	depth(0)
+{
+}
+
+void MeshBvh::Build(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount)
+{
+	nodes.clear();
+	trianglePacks.clear();
+	depth = 0;
+	triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	std::vector<BuildTriangle> buildTriangles(triangleCount);
+	std::vector<unsigned int> order(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		XMFLOAT3 p0 = vertices[indices[t * 3 + 0]].Position;
+		XMFLOAT3 p1 = vertices[indices[t * 3 + 1]].Position;
+		XMFLOAT3 p2 = vertices[indices[t * 3 + 2]].Position;
+
+		BuildTriangle& triangle = buildTriangles[t];
+		triangle.boxMin = p0;
+		triangle.boxMax = p0;
+		Expand(triangle.boxMin, triangle.boxMax, p1, p1);
+		Expand(triangle.boxMin, triangle.boxMax, p2, p2);
+		triangle.centroid = XMFLOAT3(
+			(triangle.boxMin.x + triangle.boxMax.x) * 0.5f,
+			(triangle.boxMin.y + triangle.boxMax.y) * 0.5f,
+			(triangle.boxMin.z + triangle.boxMax.z) * 0.5f);
+		order[t] = t;
+	}
+
+	std::vector<BuildNode> buildNodes;
+	buildNodes.reserve(triangleCount / 2 + 1);
+	unsigned int root = BuildRecursive(buildNodes, buildTriangles, order, 0, triangleCount, 0);
+
+	// Four wide nodes need roughly a third as many as the binary tree
+	nodes.reserve(buildNodes.size() / 3 + 1);
+	trianglePacks.reserve(buildNodes.size() / 2 + 1);
+	Collapse(buildNodes, order, root, 0, vertices, indices);
+}
+
+bool MeshBvh::IsBuilt() const
+{
+	return !nodes.empty();
+}
+
+bool MeshBvh::Intersect(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, RayHit& hit) const
+{
+	return Traverse(origin, direction, maxDistance, false, hit);
+}
+
+bool MeshBvh::IntersectAny(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance) const
+{
+	RayHit hit;
+	return Traverse(origin, direction, maxDistance, true, hit);
+}
+
+unsigned int MeshBvh::GetNodeCount() const
+{
+	return (unsigned int)nodes.size();
+}
+
+unsigned int MeshBvh::GetTriangleCount() const
+{
+	return triangleCount;
+}
+
+unsigned int MeshBvh::GetDepth() const
+{
+	return depth;
+}
+
+// --------------------------------------------------------
+// Splits the triangles in [first, first + count) where the
+// surface area heuristic says a ray will test the fewest
+// of them. Centroids are binned along each axis, so every
+// level is linear rather than needing a sort
+// --------------------------------------------------------
+unsigned int MeshBvh::BuildRecursive(std::vector<BuildNode>& buildNodes, std::vector<BuildTriangle>& buildTriangles, std::vector<unsigned int>& order, unsigned int first, unsigned int count, unsigned int depth)
+{
+	BuildNode node;
+	node.boxMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	node.boxMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	XMFLOAT3 centroidMin = node.boxMin;
+	XMFLOAT3 centroidMax = node.boxMax;
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		const BuildTriangle& triangle = buildTriangles[order[i]];
+		Expand(node.boxMin, node.boxMax, triangle.boxMin, triangle.boxMax);
+		Expand(centroidMin, centroidMax, triangle.centroid, triangle.centroid);
+	}
+	node.first = first;
+	node.count = count;
+	node.left = 0;
+	node.right = 0;
+
+	unsigned int index = (unsigned int)buildNodes.size();
+	buildNodes.push_back(node);
+
+	// A leaf's four triangles are tested at once, so
+	// there's nothing to gain from splitting any smaller
+	if (count <= 4)
+		return index;
+
+	int bestAxis = -1;
+	int bestBin = 0;
+	float bestCost = FLT_MAX;
+	if (depth < MESH_BVH_MAX_SAH_DEPTH)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float axisMin = GetAxis(centroidMin, axis);
+			float extent = GetAxis(centroidMax, axis) - axisMin;
+			if (extent <= 0.0f)
+				continue;
+
+			unsigned int binCounts[MESH_BVH_BINS] = {};
+			XMFLOAT3 binMin[MESH_BVH_BINS];
+			XMFLOAT3 binMax[MESH_BVH_BINS];
+			for (int b = 0; b < MESH_BVH_BINS; b++)
+			{
+				binMin[b] = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+				binMax[b] = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			}
+
+			float binScale = MESH_BVH_BINS / extent;
+			for (unsigned int i = first; i < first + count; i++)
+			{
+				const BuildTriangle& triangle = buildTriangles[order[i]];
+				int b = std::min(MESH_BVH_BINS - 1, (int)((GetAxis(triangle.centroid, axis) - axisMin) * binScale));
+				binCounts[b]++;
+				Expand(binMin[b], binMax[b], triangle.boxMin, triangle.boxMax);
+			}
+
+			// Sweep from the right to get the cost of everything after each split
+			float rightCost[MESH_BVH_BINS];
+			XMFLOAT3 sweepMin(FLT_MAX, FLT_MAX, FLT_MAX);
+			XMFLOAT3 sweepMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			unsigned int sweepCount = 0;
+			for (int b = MESH_BVH_BINS - 1; b > 0; b--)
+			{
+				sweepCount += binCounts[b];
+				if (binCounts[b] > 0)
+					Expand(sweepMin, sweepMax, binMin[b], binMax[b]);
+				rightCost[b] = sweepCount > 0 ? HalfArea(sweepMin, sweepMax) * sweepCount : 0.0f;
+			}
+
+			// Then from the left, splitting after bin b
+			sweepMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			sweepMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			sweepCount = 0;
+			for (int b = 0; b < MESH_BVH_BINS - 1; b++)
+			{
+				sweepCount += binCounts[b];
+				if (binCounts[b] > 0)
+					Expand(sweepMin, sweepMax, binMin[b], binMax[b]);
+				if (sweepCount == 0 || sweepCount == count)
+					continue;
+
+				float cost = HalfArea(sweepMin, sweepMax) * sweepCount + rightCost[b + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+	}
+
+	unsigned int* begin = &order[first];
+	unsigned int* end = begin + count;
+	unsigned int* middle = begin;
+	if (bestAxis >= 0)
+	{
+		float axisMin = GetAxis(centroidMin, bestAxis);
+		float binScale = MESH_BVH_BINS / (GetAxis(centroidMax, bestAxis) - axisMin);
+		middle = std::partition(begin, end, [&](unsigned int t)
+			{
+				int b = std::min(MESH_BVH_BINS - 1, (int)((GetAxis(buildTriangles[t].centroid, bestAxis) - axisMin) * binScale));
+				return b <= bestBin;
+			});
+	}
+
+	// Too deep, or every centroid in the same place, so just halve it
+	if (middle == begin || middle == end)
+	{
+		XMFLOAT3 extent(centroidMax.x - centroidMin.x, centroidMax.y - centroidMin.y, centroidMax.z - centroidMin.z);
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		middle = begin + count / 2;
+		std::nth_element(begin, middle, end, [&](unsigned int a, unsigned int b)
+			{ return GetAxis(buildTriangles[a].centroid, axis) < GetAxis(buildTriangles[b].centroid, axis); });
+	}
+
+	unsigned int leftCount = (unsigned int)(middle - begin);
+	unsigned int left = BuildRecursive(buildNodes, buildTriangles, order, first, leftCount, depth + 1);
+	unsigned int right = BuildRecursive(buildNodes, buildTriangles, order, first + leftCount, count - leftCount, depth + 1);
+
+	buildNodes[index].left = left;
+	buildNodes[index].right = right;
+	buildNodes[index].count = 0;
+	return index;
+}
+
+// --------------------------------------------------------
+// Turns a binary node into a four wide one by pulling up
+// grandchildren, always opening the largest child, since
+// it's the one rays are most likely to enter
+// --------------------------------------------------------
+unsigned int MeshBvh::Collapse(const std::vector<BuildNode>& buildNodes, const std::vector<unsigned int>& order, unsigned int buildNode, unsigned int nodeDepth, const Vertex* vertices, const unsigned int* indices)
+{
+	depth = std::max(depth, nodeDepth);
+	unsigned int index = (unsigned int)nodes.size();
+	nodes.push_back(Node());
+
+	unsigned int children[4];
+	int childCount = 0;
+	const BuildNode& parent = buildNodes[buildNode];
+	if (parent.count > 0)
+	{
+		// Only a tiny mesh's root can be a leaf
+		children[childCount++] = buildNode;
+	}
+	else
+	{
+		children[childCount++] = parent.left;
+		children[childCount++] = parent.right;
+		while (childCount < 4)
+		{
+			int largest = -1;
+			float largestArea = -1.0f;
+			for (int c = 0; c < childCount; c++)
+			{
+				const BuildNode& child = buildNodes[children[c]];
+				float area = HalfArea(child.boxMin, child.boxMax);
+				if (child.count == 0 && area > largestArea)
+				{
+					largest = c;
+					largestArea = area;
+				}
+			}
+
+			if (largest < 0)
+				break;
+
+			const BuildNode& opened = buildNodes[children[largest]];
+			children[largest] = opened.left;
+			children[childCount++] = opened.right;
+		}
+	}
+
+	Node node;
+	for (int lane = 0; lane < 4; lane++)
+	{
+		node.minX[lane] = node.minY[lane] = node.minZ[lane] = FLT_MAX;
+		node.maxX[lane] = node.maxY[lane] = node.maxZ[lane] = -FLT_MAX;
+		node.children[lane] = MESH_BVH_EMPTY;
+	}
+
+	for (int lane = 0; lane < childCount; lane++)
+	{
+		const BuildNode& child = buildNodes[children[lane]];
+		node.minX[lane] = child.boxMin.x;
+		node.minY[lane] = child.boxMin.y;
+		node.minZ[lane] = child.boxMin.z;
+		node.maxX[lane] = child.boxMax.x;
+		node.maxY[lane] = child.boxMax.y;
+		node.maxZ[lane] = child.boxMax.z;
+
+		if (child.count > 0)
+			node.children[lane] = MESH_BVH_LEAF | AddTrianglePack(child, order, vertices, indices);
+		else
+			node.children[lane] = Collapse(buildNodes, order, children[lane], nodeDepth + 1, vertices, indices);
+	}
+
+	// Recursing may have moved the vector, so write it at the end
+	nodes[index] = node;
+	return index;
+}
+
+unsigned int MeshBvh::AddTrianglePack(const BuildNode& leaf, const std::vector<unsigned int>& order, const Vertex* vertices, const unsigned int* indices)
+{
+	TrianglePack pack;
+	for (unsigned int lane = 0; lane < 4; lane++)
+	{
+		// Unused lanes get zero length edges, which no ray can hit
+		XMFLOAT3 p0(0, 0, 0), p1(0, 0, 0), p2(0, 0, 0);
+		pack.triangles[lane] = RAY_HIT_NO_TRIANGLE;
+		if (lane < leaf.count)
+		{
+			unsigned int t = order[leaf.first + lane];
+			p0 = vertices[indices[t * 3 + 0]].Position;
+			p1 = vertices[indices[t * 3 + 1]].Position;
+			p2 = vertices[indices[t * 3 + 2]].Position;
+			pack.triangles[lane] = t;
+		}
+
+		pack.v0x[lane] = p0.x;
+		pack.v0y[lane] = p0.y;
+		pack.v0z[lane] = p0.z;
+		pack.e1x[lane] = p1.x - p0.x;
+		pack.e1y[lane] = p1.y - p0.y;
+		pack.e1z[lane] = p1.z - p0.z;
+		pack.e2x[lane] = p2.x - p0.x;
+		pack.e2y[lane] = p2.y - p0.y;
+		pack.e2z[lane] = p2.z - p0.z;
+	}
+
+	trianglePacks.push_back(pack);
+	return (unsigned int)trianglePacks.size() - 1;
+}
+
+// --------------------------------------------------------
+// Depth first, nearest child first, so the closest hit
+// shrinks the ray early and prunes the rest of the tree.
+// Boxes use the slab test and triangles Moller-Trumbore,
+// each four lanes at a time
+// --------------------------------------------------------
+bool MeshBvh::Traverse(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, bool anyHit, RayHit& hit) const
+{
+	if (nodes.empty())
+		return false;
+
+	const __m128 originX = _mm_set1_ps(origin.x);
+	const __m128 originY = _mm_set1_ps(origin.y);
+	const __m128 originZ = _mm_set1_ps(origin.z);
+	const __m128 directionX = _mm_set1_ps(direction.x);
+	const __m128 directionY = _mm_set1_ps(direction.y);
+	const __m128 directionZ = _mm_set1_ps(direction.z);
+	// Zero components become infinities, which can make NaNs in the
+	// slab test. Only those rays need ClipSlab() to deal with them
+	XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	const bool infiniteInverse = std::isinf(inverse.x) || std::isinf(inverse.y) || std::isinf(inverse.z);
+	const __m128 inverseX = _mm_set1_ps(inverse.x);
+	const __m128 inverseY = _mm_set1_ps(inverse.y);
+	const __m128 inverseZ = _mm_set1_ps(inverse.z);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	float closest = maxDistance;
+	bool found = false;
+
+	struct StackEntry
+	{
+		unsigned int child;
+		float distance;
+	};
+	StackEntry stack[MESH_BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, 0.0f };
+
+	while (stackSize > 0)
+	{
+		StackEntry entry = stack[--stackSize];
+		if (entry.distance > closest)
+			continue;
+
+		if (entry.child & MESH_BVH_LEAF)
+		{
+			const TrianglePack& pack = trianglePacks[entry.child & ~MESH_BVH_LEAF];
+			__m128 e1x = _mm_loadu_ps(pack.e1x);
+			__m128 e1y = _mm_loadu_ps(pack.e1y);
+			__m128 e1z = _mm_loadu_ps(pack.e1z);
+			__m128 e2x = _mm_loadu_ps(pack.e2x);
+			__m128 e2y = _mm_loadu_ps(pack.e2y);
+			__m128 e2z = _mm_loadu_ps(pack.e2z);
+
+			// p = d x e2, det = e1 . p
+			__m128 px = _mm_sub_ps(_mm_mul_ps(directionY, e2z), _mm_mul_ps(directionZ, e2y));
+			__m128 py = _mm_sub_ps(_mm_mul_ps(directionZ, e2x), _mm_mul_ps(directionX, e2z));
+			__m128 pz = _mm_sub_ps(_mm_mul_ps(directionX, e2y), _mm_mul_ps(directionY, e2x));
+			__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+			__m128 inverseDet = _mm_div_ps(one, det);
+
+			// s = o - v0, u = (s . p) / det
+			__m128 sx = _mm_sub_ps(originX, _mm_loadu_ps(pack.v0x));
+			__m128 sy = _mm_sub_ps(originY, _mm_loadu_ps(pack.v0y));
+			__m128 sz = _mm_sub_ps(originZ, _mm_loadu_ps(pack.v0z));
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+
+			// q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+			__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+			__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+			__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qx), _mm_mul_ps(directionY, qy)), _mm_mul_ps(directionZ, qz)), inverseDet);
+			__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+			__m128 mask = _mm_cmpneq_ps(det, zero);
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+			mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(t, zero));
+			mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(closest)));
+
+			int hits = _mm_movemask_ps(mask);
+			if (hits == 0)
+				continue;
+			if (anyHit)
+				return true;
+
+			float ts[4], us[4], vs[4];
+			_mm_storeu_ps(ts, t);
+			_mm_storeu_ps(us, u);
+			_mm_storeu_ps(vs, v);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if ((hits & (1 << lane)) && ts[lane] < closest)
+				{
+					closest = ts[lane];
+					hit.distance = ts[lane];
+					hit.u = us[lane];
+					hit.v = vs[lane];
+					hit.triangle = pack.triangles[lane];
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		const Node& node = nodes[entry.child];
+		__m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), originX), inverseX);
+		__m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), originX), inverseX);
+		__m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), originY), inverseY);
+		__m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), originY), inverseY);
+		__m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), originZ), inverseZ);
+		__m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), originZ), inverseZ);
+
+		__m128 enter = zero;
+		__m128 leave = _mm_set1_ps(closest);
+		if (infiniteInverse)
+		{
+			ClipSlab(x0, x1, enter, leave);
+			ClipSlab(y0, y1, enter, leave);
+			ClipSlab(z0, z1, enter, leave);
+		}
+		else
+		{
+			enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), enter));
+			leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), leave));
+		}
+		int hits = _mm_movemask_ps(_mm_cmple_ps(enter, leave));
+		if (hits == 0)
+			continue;
+
+		float distances[4];
+		_mm_storeu_ps(distances, enter);
+
+		// Sort the hit children farthest first, so the nearest is popped next
+		StackEntry entered[4];
+		int enteredCount = 0;
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (!(hits & (1 << lane)) || node.children[lane] == MESH_BVH_EMPTY)
+				continue;
+
+			StackEntry child = { node.children[lane], distances[lane] };
+			int position = enteredCount++;
+			while (position > 0 && entered[position - 1].distance < child.distance)
+			{
+				entered[position] = entered[position - 1];
+				position--;
+			}
+			entered[position] = child;
+		}
+
+		// Never more than the stack holds, see MESH_BVH_STACK_SIZE
+		for (int i = 0; i < enteredCount; i++)
+			stack[stackSize++] = entered[i];
+	}
+
+	return found;
+}
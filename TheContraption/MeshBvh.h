@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "Vertex.h"
+
+// Centroid bins tried along each axis when looking for the cheapest split
+#define MESH_BVH_BINS 16
+// Deeper than this always splits at the median, which keeps the
+// traversal stack bounded on degenerate input
+#define MESH_BVH_MAX_SAH_DEPTH 48
+// Deepest a tree can get. Indices are 32 bits, so there are under 2^31
+// triangles, and halving them down to leaves takes under 32 more levels
+#define MESH_BVH_MAX_DEPTH (MESH_BVH_MAX_SAH_DEPTH + 32)
+// Marks a ray that hit a bounding volume rather than a triangle
+#define RAY_HIT_NO_TRIANGLE 0xFFFFFFFFu
+
+// --------------------------------------------------------
+// Closest hit along a ray
+// - The hit point is v0 + u * (v1 - v0) + v * (v2 - v0)
+// - Distance is in units of the ray's direction, so it
+//    survives transforming the ray into local space
+// --------------------------------------------------------
+struct RayHit
+{
+	float distance;
+	float u;
+	float v;
+	unsigned int triangle;	// Index of the triangle's first index / 3
+};
+
+/*
+	Bounding volume hierarchy over a mesh's triangles, for ray casts.
+
+	It's built as a binary tree with binned SAH splits, then collapsed
+	so each node has four children whose boxes are tested together with
+	SSE. Leaves hold up to four triangles, stored pre-subtracted and
+	side by side so they're also intersected together.
+
+	Triangles are hit from either side. It keeps its own copy of the
+	triangles, so the vertices and indices can go away after Build().
+*/
+class MeshBvh
+{
+public:
+	MeshBvh();
+
+	/// <summary>
+	/// Build over the triangles of the given index range. Replaces any previous tree
+	/// </summary>
+	void Build(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount);
+	/// <summary>
+	/// Whether there is anything to cast against
+	/// </summary>
+	bool IsBuilt() const;
+
+	/// <summary>
+	/// Find the closest triangle the ray hits before maxDistance
+	/// </summary>
+	bool Intersect(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, RayHit& hit) const;
+	/// <summary>
+	/// Whether any triangle is hit before maxDistance. Stops at the first
+	/// one found, so it's cheaper than Intersect for line of sight checks
+	/// </summary>
+	bool IntersectAny(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance) const;
+
+	unsigned int GetNodeCount() const;
+	unsigned int GetTriangleCount() const;
+	/// <summary>
+	/// Levels of four wide nodes below the root, never more than MESH_BVH_MAX_DEPTH
+	/// </summary>
+	unsigned int GetDepth() const;
+
+private:
+	// Four child boxes, one per lane
+	struct Node
+	{
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		unsigned int children[4];	// Node index, leaf flag and triangle pack index, or empty
+	};
+
+	// Four triangles, one per lane, as a corner and two edges
+	struct TrianglePack
+	{
+		float v0x[4], v0y[4], v0z[4];
+		float e1x[4], e1y[4], e1z[4];
+		float e2x[4], e2y[4], e2z[4];
+		unsigned int triangles[4];
+	};
+
+	// Temporary binary tree used while building
+	struct BuildNode
+	{
+		DirectX::XMFLOAT3 boxMin;
+		DirectX::XMFLOAT3 boxMax;
+		unsigned int left;		// Children, or the range of triangles for leaves
+		unsigned int right;
+		unsigned int first;
+		unsigned int count;
+	};
+
+	struct BuildTriangle
+	{
+		DirectX::XMFLOAT3 boxMin;
+		DirectX::XMFLOAT3 boxMax;
+		DirectX::XMFLOAT3 centroid;
+	};
+
+	unsigned int BuildRecursive(std::vector<BuildNode>& buildNodes, std::vector<BuildTriangle>& buildTriangles, std::vector<unsigned int>& order, unsigned int first, unsigned int count, unsigned int depth);
+	unsigned int Collapse(const std::vector<BuildNode>& buildNodes, const std::vector<unsigned int>& order, unsigned int buildNode, unsigned int nodeDepth, const Vertex* vertices, const unsigned int* indices);
+	unsigned int AddTrianglePack(const BuildNode& leaf, const std::vector<unsigned int>& order, const Vertex* vertices, const unsigned int* indices);
+	bool Traverse(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, bool anyHit, RayHit& hit) const;
+
+	std::vector<Node> nodes;
+	std::vector<TrianglePack> trianglePacks;
+	unsigned int triangleCount;
+	unsigned int depth;
+};
@@ -0,0 +1,362 @@
+#include "MeshCache.h"
+#include "MeshCodec.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char cacheMagic[4] = { 'C', 'M', 'S', 'H' };
+
+	// Compressed blobs are padded so the tables after them stay aligned
+	uint64_t PaddedSize(uint64_t size)
+	{
+		return (size + 3) & ~3ull;
+	}
+
+#ifndef _WIN32
+	// Wide paths to the locale's multibyte encoding. Empty if some
+	// character has no encoding, which no file can then be opened by
+	std::string Narrow(const std::wstring& path)
+	{
+		size_t length = wcstombs(nullptr, path.c_str(), 0);
+		if (length == static_cast<size_t>(-1))
+			return std::string();
+
+		std::string narrow(length, '\0');
+		wcstombs(&narrow[0], path.c_str(), length);
+		return narrow;
+	}
+#endif
+
+	// Open a file for binary writing from a wide path
+	FILE* OpenForWrite(const std::wstring& path)
+	{
+		FILE* file = nullptr;
+#ifdef _WIN32
+		if (_wfopen_s(&file, path.c_str(), L"wb") != 0)
+			return nullptr;
+#else
+		std::string narrow = Narrow(path);
+		if (narrow.empty())
+			return nullptr;
+		file = fopen(narrow.c_str(), "wb");
+#endif
+		return file;
+	}
+
+	// Swap the finished temp file into place so a crash mid-write
+	// never leaves a half written cache behind
+	bool ReplaceFile(const std::wstring& from, const std::wstring& to)
+	{
+#ifdef _WIN32
+		return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		std::string narrowFrom = Narrow(from);
+		std::string narrowTo = Narrow(to);
+		return !narrowFrom.empty() && !narrowTo.empty() && rename(narrowFrom.c_str(), narrowTo.c_str()) == 0;
+#endif
+	}
+
+	void DeleteTempFile(const std::wstring& path)
+	{
+#ifdef _WIN32
+		DeleteFileW(path.c_str());
+#else
+		std::string narrow = Narrow(path);
+		if (!narrow.empty())
+			remove(narrow.c_str());
+#endif
+	}
+
+	// --------------------------------------------------------
+	// A temp file next to the cache that no other writer uses,
+	// in this process or another one, so two loads cooking the
+	// same mesh at once never write into the same file. The
+	// last one to finish replaces the cache
+	// --------------------------------------------------------
+	std::wstring MakeTempPath(const wchar_t* cacheFile)
+	{
+		static std::atomic<unsigned int> writeCount(0);
+#ifdef _WIN32
+		unsigned long process = GetCurrentProcessId();
+#else
+		unsigned long process = static_cast<unsigned long>(getpid());
+#endif
+		return std::wstring(cacheFile) + L"." + std::to_wstring(process) + L"." + std::to_wstring(writeCount++) + L".tmp";
+	}
+}
+
+#pragma region MeshCacheView
+
+MeshCacheView::MeshCacheView(const wchar_t* cacheFile, uint64_t expectedSourceHash, TangentMode expectedTangentMode, bool expectMeshlets) :
+	file(cacheFile), header(nullptr), vertices(nullptr), indices(nullptr), tables(nullptr)
+{
+	if (!file.IsOpen() || file.GetSize() < sizeof(MeshCacheHeader))
+		return;
+
+	const MeshCacheHeader* h = reinterpret_cast<const MeshCacheHeader*>(file.GetData());
+
+	// Reject anything that wasn't cooked by this exact pipeline from this exact source
+	if (memcmp(h->magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+		h->version != MESH_CACHE_VERSION ||
+		h->vertexStride != sizeof(Vertex) ||
+		h->sourceHash != expectedSourceHash ||
+		h->tangentMode != static_cast<uint32_t>(expectedTangentMode) ||
+		(h->submeshCount <= 1 && (h->meshletCount != 0) != expectMeshlets))
+		return;
+
+	// Uncompressed blobs have to be exactly as big as they claim
+	if (!h->compressed &&
+		(h->vertexBlobSize != static_cast<uint64_t>(h->vertexCount) * sizeof(Vertex) ||
+		 h->indexBlobSize != static_cast<uint64_t>(h->indexCount) * sizeof(unsigned int)))
+		return;
+
+	// Make sure the blobs are really all there
+	uint64_t expectedSize =
+		sizeof(MeshCacheHeader) +
+		PaddedSize(h->vertexBlobSize) +
+		PaddedSize(h->indexBlobSize) +
+		static_cast<uint64_t>(h->lodCount) * sizeof(MeshLod) +
+		static_cast<uint64_t>(h->meshletCount) * sizeof(Meshlet) +
+		static_cast<uint64_t>(h->submeshCount) * sizeof(Submesh) +
+		static_cast<uint64_t>(h->materialSlotCount + h->materialLibraryCount) * sizeof(MaterialName);
+	if (file.GetSize() != expectedSize)
+		return;
+
+	const uint8_t* vertexBlob = reinterpret_cast<const uint8_t*>(file.GetData()) + sizeof(MeshCacheHeader);
+	const uint8_t* indexBlob = vertexBlob + PaddedSize(h->vertexBlobSize);
+	tables = indexBlob + PaddedSize(h->indexBlobSize);
+
+	if (h->compressed)
+	{
+		decodedVertices.resize(h->vertexCount);
+		decodedIndices.resize(h->indexCount);
+		if (!MeshCodec::DecodeVertices(vertexBlob, h->vertexBlobSize, decodedVertices.data(), h->vertexCount, sizeof(Vertex)) ||
+			!MeshCodec::DecodeIndices(indexBlob, h->indexBlobSize, decodedIndices.data(), h->indexCount))
+			return;
+
+		vertices = decodedVertices.data();
+		indices = decodedIndices.data();
+	}
+	else
+	{
+		vertices = reinterpret_cast<const Vertex*>(vertexBlob);
+		indices = reinterpret_cast<const unsigned int*>(indexBlob);
+	}
+
+	header = h;
+}
+
+bool MeshCacheView::IsValid()
+{
+	return header != nullptr;
+}
+
+const Vertex* MeshCacheView::GetVertices()
+{
+	return vertices;
+}
+
+const unsigned int* MeshCacheView::GetIndices()
+{
+	return indices;
+}
+
+unsigned int MeshCacheView::GetVertexCount()
+{
+	return header->vertexCount;
+}
+
+unsigned int MeshCacheView::GetIndexCount()
+{
+	return header->indexCount;
+}
+
+const MeshLod* MeshCacheView::GetLods()
+{
+	return reinterpret_cast<const MeshLod*>(tables);
+}
+
+unsigned int MeshCacheView::GetLodCount()
+{
+	return header->lodCount;
+}
+
+const Meshlet* MeshCacheView::GetMeshlets()
+{
+	return reinterpret_cast<const Meshlet*>(GetLods() + header->lodCount);
+}
+
+unsigned int MeshCacheView::GetMeshletCount()
+{
+	return header->meshletCount;
+}
+
+const Submesh* MeshCacheView::GetSubmeshes()
+{
+	return reinterpret_cast<const Submesh*>(GetMeshlets() + header->meshletCount);
+}
+
+unsigned int MeshCacheView::GetSubmeshCount()
+{
+	return header->submeshCount;
+}
+
+const MaterialName* MeshCacheView::GetMaterialSlots()
+{
+	return reinterpret_cast<const MaterialName*>(GetSubmeshes() + header->submeshCount);
+}
+
+unsigned int MeshCacheView::GetMaterialSlotCount()
+{
+	return header->materialSlotCount;
+}
+
+const MaterialName* MeshCacheView::GetMaterialLibraries()
+{
+	return GetMaterialSlots() + header->materialSlotCount;
+}
+
+unsigned int MeshCacheView::GetMaterialLibraryCount()
+{
+	return header->materialLibraryCount;
+}
+
+DirectX::XMFLOAT3 MeshCacheView::GetBoundsMin()
+{
+	return header->boundsMin;
+}
+
+DirectX::XMFLOAT3 MeshCacheView::GetBoundsMax()
+{
+	return header->boundsMax;
+}
+
+DirectX::XMFLOAT3 MeshCacheView::GetBoundsCenter()
+{
+	return header->boundsCenter;
+}
+
+float MeshCacheView::GetBoundsRadius()
+{
+	return header->boundsRadius;
+}
+
+#pragma endregion
+
+#pragma region MeshCache
+
+std::wstring MeshCache::GetCachePath(const wchar_t* sourceFile)
+{
+	return std::wstring(sourceFile) + L".cmesh";
+}
+
+bool MeshCache::HashFile(const wchar_t* path, uint64_t& hash)
+{
+	MappedFile source(path);
+	if (!source.IsOpen())
+		return false;
+
+	// 64 bit multiply/rotate hash over 8 byte words. This only needs to
+	// catch edits to the source, so it favors speed over quality
+	const uint64_t prime = 0x9E3779B97F4A7C15ull;
+	const char* data = source.GetData();
+	size_t size = source.GetSize();
+
+	uint64_t h = prime ^ size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		h = (h ^ word) * prime;
+		h ^= h >> 29;
+	}
+	for (; i < size; i++)
+	{
+		h = (h ^ static_cast<unsigned char>(data[i])) * prime;
+	}
+
+	hash = h ^ (h >> 32);
+	return true;
+}
+
+bool MeshCache::Write(const wchar_t* cacheFile, uint64_t sourceHash, TangentMode tangentMode, const MeshData& data)
+{
+	MeshCacheHeader header = {};
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.tangentMode = static_cast<uint32_t>(tangentMode);
+	header.vertexStride = sizeof(Vertex);
+	header.vertexCount = static_cast<uint32_t>(data.vertices.size());
+	header.indexCount = static_cast<uint32_t>(data.indices.size());
+	header.lodCount = static_cast<uint32_t>(data.lods.size());
+	header.meshletCount = static_cast<uint32_t>(data.meshlets.size());
+	header.submeshCount = static_cast<uint32_t>(data.submeshes.size());
+	header.materialSlotCount = static_cast<uint32_t>(data.materialSlots.size());
+	header.materialLibraryCount = static_cast<uint32_t>(data.materialLibraries.size());
+	header.boundsMin = data.boundsMin;
+	header.boundsMax = data.boundsMax;
+	header.boundsCenter = data.boundsCenter;
+	header.boundsRadius = data.boundsRadius;
+
+	const uint8_t* vertexBlob = reinterpret_cast<const uint8_t*>(data.vertices.data());
+	const uint8_t* indexBlob = reinterpret_cast<const uint8_t*>(data.indices.data());
+	header.vertexBlobSize = header.vertexCount * sizeof(Vertex);
+	header.indexBlobSize = header.indexCount * sizeof(unsigned int);
+
+#if MESH_CACHE_COMPRESS
+	std::vector<uint8_t> compressedVertices;
+	std::vector<uint8_t> compressedIndices;
+	MeshCodec::EncodeVertices(data.vertices.data(), data.vertices.size(), sizeof(Vertex), compressedVertices);
+	MeshCodec::EncodeIndices(data.indices.data(), data.indices.size(), compressedIndices);
+
+	header.compressed = 1;
+	vertexBlob = compressedVertices.data();
+	indexBlob = compressedIndices.data();
+	header.vertexBlobSize = static_cast<uint32_t>(compressedVertices.size());
+	header.indexBlobSize = static_cast<uint32_t>(compressedIndices.size());
+#endif
+
+	std::wstring tempPath = MakeTempPath(cacheFile);
+	FILE* file = OpenForWrite(tempPath);
+	if (file == nullptr)
+		return false;
+
+	const uint8_t padding[4] = {};
+	size_t vertexPadding = static_cast<size_t>(PaddedSize(header.vertexBlobSize) - header.vertexBlobSize);
+	size_t indexPadding = static_cast<size_t>(PaddedSize(header.indexBlobSize) - header.indexBlobSize);
+
+	bool written =
+		fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(vertexBlob, 1, header.vertexBlobSize, file) == header.vertexBlobSize &&
+		fwrite(padding, 1, vertexPadding, file) == vertexPadding &&
+		fwrite(indexBlob, 1, header.indexBlobSize, file) == header.indexBlobSize &&
+		fwrite(padding, 1, indexPadding, file) == indexPadding &&
+		fwrite(data.lods.data(), sizeof(MeshLod), data.lods.size(), file) == data.lods.size() &&
+		fwrite(data.meshlets.data(), sizeof(Meshlet), header.meshletCount, file) == header.meshletCount &&
+		fwrite(data.submeshes.data(), sizeof(Submesh), header.submeshCount, file) == header.submeshCount &&
+		fwrite(data.materialSlots.data(), sizeof(MaterialName), header.materialSlotCount, file) == header.materialSlotCount &&
+		fwrite(data.materialLibraries.data(), sizeof(MaterialName), header.materialLibraryCount, file) == header.materialLibraryCount;
+	written = (fclose(file) == 0) && written;
+
+	// Whatever went wrong, nothing is left lying around next to the cache
+	if (!written || !ReplaceFile(tempPath, cacheFile))
+	{
+		DeleteTempFile(tempPath);
+		return false;
+	}
+	return true;
+}
+
+#pragma endregion
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "MappedFile.h"
+#include "MeshData.h"
+#include "TangentGenerator.h"
+
+// Bump whenever the cooked layout or the import pipeline output changes
+// so stale caches are rebuilt instead of loaded
+#define MESH_CACHE_VERSION 9
+// Cook vertex and index blobs through MeshCodec. Compressed caches are
+// about half the size but are decoded on load instead of used in place,
+// so it's off unless disk space matters more than load time. Caches of
+// either kind load whatever this is set to
+#ifndef MESH_CACHE_COMPRESS
+#define MESH_CACHE_COMPRESS 0
+#endif
+
+/*
+	Cooked meshes are stored as this header followed directly by the
+	vertex blob, the index blob (every LOD back to back), then the LOD
+	table, the meshlets and finally the submeshes, material slot names
+	and material library names.
+
+	Uncompressed blobs are exactly what is uploaded to the GPU, so
+	loading is just a map and a pointer offset. Compressed blobs are
+	MeshCodec streams, each padded to 4 bytes so the tables after them
+	stay aligned
+*/
+struct MeshCacheHeader
+{
+	char magic[4];				// Always "CMSH"
+	uint32_t version;			// MESH_CACHE_VERSION at cook time
+	uint64_t sourceHash;		// Content hash of the file this was cooked from
+	uint32_t vertexStride;		// sizeof(Vertex) at cook time
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t tangentMode;		// TangentMode the tangents were generated with
+	uint32_t lodCount;			// MeshLod entries after the indices
+	uint32_t meshletCount;		// Meshlet entries after the LODs, 0 if not built
+	uint32_t submeshCount;		// Submesh entries after the meshlets, 0 for a single material
+	uint32_t materialSlotCount;	// MaterialName entries after the submeshes
+	uint32_t materialLibraryCount;	// MaterialName entries after the slots
+	uint32_t compressed;		// 1 if the blobs are MeshCodec streams
+	uint32_t vertexBlobSize;	// Bytes of the vertex blob, without padding
+	uint32_t indexBlobSize;		// Bytes of the index blob, without padding
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	DirectX::XMFLOAT3 boundsCenter;
+	float boundsRadius;
+};
+
+/*
+	A memory mapped cooked mesh. Every pointer points into the mapping,
+	or into the view itself for decompressed blobs, so they are only
+	valid while the view is alive
+*/
+class MeshCacheView
+{
+public:
+	/// <summary>
+	/// Map a cooked mesh file and validate it against the given source hash and settings
+	/// </summary>
+	MeshCacheView(const wchar_t* cacheFile, uint64_t expectedSourceHash, TangentMode expectedTangentMode, bool expectMeshlets);
+
+	/// <summary>
+	/// False if the file is missing, truncated, from another version, stale
+	/// or cooked with different settings
+	/// </summary>
+	/// <returns></returns>
+	bool IsValid();
+
+	const Vertex* GetVertices();
+	const unsigned int* GetIndices();
+	unsigned int GetVertexCount();
+	unsigned int GetIndexCount();
+	const MeshLod* GetLods();
+	unsigned int GetLodCount();
+	const Meshlet* GetMeshlets();
+	unsigned int GetMeshletCount();
+	const Submesh* GetSubmeshes();
+	unsigned int GetSubmeshCount();
+	const MaterialName* GetMaterialSlots();
+	unsigned int GetMaterialSlotCount();
+	const MaterialName* GetMaterialLibraries();
+	unsigned int GetMaterialLibraryCount();
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
+
+private:
+	MappedFile file;
+	const MeshCacheHeader* header;
+
+	const Vertex* vertices;
+	const unsigned int* indices;
+	const uint8_t* tables;		// Where the LOD table starts
+
+	// Only used when the blobs were compressed
+	std::vector<Vertex> decodedVertices;
+	std::vector<unsigned int> decodedIndices;
+};
+
+class MeshCache
+{
+public:
+	/// <summary>
+	/// Get where the cooked version of a source file lives
+	/// </summary>
+	static std::wstring GetCachePath(const wchar_t* sourceFile);
+	/// <summary>
+	/// Hash the contents of a file so cooked data can be matched to its source.
+	/// Returns false if the file could not be read
+	/// </summary>
+	static bool HashFile(const wchar_t* file, uint64_t& hash);
+	/// <summary>
+	/// Cook the given mesh data to disk. Returns false if the file could not be written
+	/// </summary>
+	static bool Write(const wchar_t* cacheFile, uint64_t sourceHash, TangentMode tangentMode, const MeshData& data);
+};
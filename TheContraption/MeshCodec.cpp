@@ -0,0 +1,336 @@
+#include "MeshCodec.h"
+
+#include <cstring>
+#include <emmintrin.h>
+
+namespace
+{
+	// Bits per byte for each block width code
+	const int blockBits[5] = { 0, 1, 2, 4, 8 };
+
+	inline uint8_t ZigzagByte(uint8_t delta)
+	{
+		return static_cast<uint8_t>((delta << 1) ^ (static_cast<int8_t>(delta) >> 7));
+	}
+
+	inline uint32_t Zigzag(uint32_t delta)
+	{
+		return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+	}
+
+	// Smallest width code whose bits fit every value in a block
+	int ChooseWidth(const uint8_t* block)
+	{
+		uint8_t largest = 0;
+		for (int i = 0; i < MESH_CODEC_BLOCK_SIZE; i++)
+		{
+			largest |= block[i];
+		}
+
+		if (largest == 0) return 0;
+		if (largest <= 1) return 1;
+		if (largest <= 3) return 2;
+		if (largest <= 15) return 3;
+		return 4;
+	}
+
+	// Entropy code one plane of a chunk. Values past count are padded with zeros
+	void EncodePlane(const uint8_t* values, size_t count, std::vector<uint8_t>& out)
+	{
+		size_t blocks = (count + MESH_CODEC_BLOCK_SIZE - 1) / MESH_CODEC_BLOCK_SIZE;
+		size_t headerStart = out.size();
+		out.resize(headerStart + (blocks + 1) / 2, 0);
+
+		for (size_t b = 0; b < blocks; b++)
+		{
+			uint8_t block[MESH_CODEC_BLOCK_SIZE] = {};
+			size_t start = b * MESH_CODEC_BLOCK_SIZE;
+			size_t length = count - start < MESH_CODEC_BLOCK_SIZE ? count - start : MESH_CODEC_BLOCK_SIZE;
+			memcpy(block, values + start, length);
+
+			int code = ChooseWidth(block);
+			out[headerStart + b / 2] |= static_cast<uint8_t>(code << ((b & 1) * 4));
+
+			int bits = blockBits[code];
+			size_t dataStart = out.size();
+			out.resize(dataStart + bits * MESH_CODEC_BLOCK_SIZE / 8, 0);
+			for (int i = 0; bits > 0 && i < MESH_CODEC_BLOCK_SIZE; i++)
+			{
+				out[dataStart + i * bits / 8] |= static_cast<uint8_t>(block[i] << (i * bits % 8));
+			}
+		}
+	}
+
+	// Spread the low bits of each byte across two bytes, low half first
+	template<int Shift, int Mask>
+	inline __m128i Split(__m128i x)
+	{
+		const __m128i mask = _mm_set1_epi8(static_cast<char>(Mask));
+		return _mm_unpacklo_epi8(_mm_and_si128(x, mask), _mm_and_si128(_mm_srli_epi16(x, Shift), mask));
+	}
+
+	// Unpack one bit packed block back to 16 bytes
+	inline __m128i UnpackBlock(const uint8_t*& data, int code)
+	{
+		switch (code)
+		{
+		case 0:
+			return _mm_setzero_si128();
+		case 1:
+		{
+			uint16_t packed;
+			memcpy(&packed, data, sizeof(packed));
+			data += sizeof(packed);
+			return Split<1, 1>(Split<2, 3>(Split<4, 15>(_mm_cvtsi32_si128(packed))));
+		}
+		case 2:
+		{
+			int packed;
+			memcpy(&packed, data, sizeof(packed));
+			data += sizeof(packed);
+			return Split<2, 3>(Split<4, 15>(_mm_cvtsi32_si128(packed)));
+		}
+		case 3:
+		{
+			__m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+			data += 8;
+			return Split<4, 15>(packed);
+		}
+		default:
+		{
+			__m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+			data += 16;
+			return packed;
+		}
+		}
+	}
+
+	// Undo the zigzag and delta of a block of vertex bytes. last holds
+	// the running byte in every lane, so the sum never leaves registers
+	inline __m128i UndoByteDelta(__m128i x, __m128i& last)
+	{
+		x = _mm_xor_si128(
+			_mm_and_si128(_mm_srli_epi16(x, 1), _mm_set1_epi8(0x7F)),
+			_mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(x, _mm_set1_epi8(1))));
+
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi8(x, last);
+
+		// Broadcast the last byte for the next block
+		last = _mm_unpackhi_epi8(x, x);
+		last = _mm_shufflehi_epi16(last, _MM_SHUFFLE(3, 3, 3, 3));
+		last = _mm_unpackhi_epi64(last, last);
+		return x;
+	}
+
+	// Find where each of a chunk's four planes keeps its width codes and
+	// packed blocks, checking all of them are really there. Returns the
+	// end of the last plane, or null if the data runs out or is malformed
+	const uint8_t* FindPlanes(const uint8_t* data, const uint8_t* end, size_t blocks, const uint8_t* headers[4], const uint8_t* payloads[4])
+	{
+		size_t headerSize = (blocks + 1) / 2;
+		for (int p = 0; p < 4; p++)
+		{
+			if (static_cast<size_t>(end - data) < headerSize)
+				return nullptr;
+
+			size_t payload = 0;
+			for (size_t b = 0; b < blocks; b++)
+			{
+				int code = (data[b / 2] >> ((b & 1) * 4)) & 15;
+				if (code > 4)
+					return nullptr;
+				payload += blockBits[code] * MESH_CODEC_BLOCK_SIZE / 8;
+			}
+
+			headers[p] = data;
+			payloads[p] = data + headerSize;
+			data += headerSize;
+			if (static_cast<size_t>(end - data) < payload)
+				return nullptr;
+			data += payload;
+		}
+		return data;
+	}
+
+	inline __m128i NextBlock(const uint8_t* header, const uint8_t*& payload, size_t block)
+	{
+		return UnpackBlock(payload, (header[block / 2] >> ((block & 1) * 4)) & 15);
+	}
+
+	// Interleave the same 16 bytes of four planes into sixteen 4 byte words
+	inline void Interleave(__m128i a, __m128i b, __m128i c, __m128i d, __m128i words[4])
+	{
+		__m128i abLow = _mm_unpacklo_epi8(a, b);
+		__m128i abHigh = _mm_unpackhi_epi8(a, b);
+		__m128i cdLow = _mm_unpacklo_epi8(c, d);
+		__m128i cdHigh = _mm_unpackhi_epi8(c, d);
+
+		words[0] = _mm_unpacklo_epi16(abLow, cdLow);
+		words[1] = _mm_unpackhi_epi16(abLow, cdLow);
+		words[2] = _mm_unpacklo_epi16(abHigh, cdHigh);
+		words[3] = _mm_unpackhi_epi16(abHigh, cdHigh);
+	}
+}
+
+void MeshCodec::EncodeIndices(const unsigned int* indices, size_t count, std::vector<uint8_t>& out)
+{
+	uint8_t planes[4][MESH_CODEC_CHUNK_SIZE];
+	uint32_t last = 0;
+
+	for (size_t start = 0; start < count; start += MESH_CODEC_CHUNK_SIZE)
+	{
+		size_t chunk = count - start < MESH_CODEC_CHUNK_SIZE ? count - start : MESH_CODEC_CHUNK_SIZE;
+		for (size_t i = 0; i < chunk; i++)
+		{
+			uint32_t value = Zigzag(indices[start + i] - last);
+			last = indices[start + i];
+			for (int p = 0; p < 4; p++)
+			{
+				planes[p][i] = static_cast<uint8_t>(value >> (p * 8));
+			}
+		}
+
+		for (int p = 0; p < 4; p++)
+		{
+			EncodePlane(planes[p], chunk, out);
+		}
+	}
+}
+
+bool MeshCodec::DecodeIndices(const uint8_t* data, size_t size, unsigned int* indices, size_t count)
+{
+	const uint8_t* end = data + size;
+	__m128i last = _mm_setzero_si128();
+
+	for (size_t start = 0; start < count; start += MESH_CODEC_CHUNK_SIZE)
+	{
+		size_t chunk = count - start < MESH_CODEC_CHUNK_SIZE ? count - start : MESH_CODEC_CHUNK_SIZE;
+		const uint8_t* headers[4];
+		const uint8_t* payloads[4];
+		data = FindPlanes(data, end, (chunk + MESH_CODEC_BLOCK_SIZE - 1) / MESH_CODEC_BLOCK_SIZE, headers, payloads);
+		if (data == nullptr)
+			return false;
+
+		for (size_t i = 0; i < chunk; i += MESH_CODEC_BLOCK_SIZE)
+		{
+			size_t block = i / MESH_CODEC_BLOCK_SIZE;
+			__m128i words[4];
+			Interleave(
+				NextBlock(headers[0], payloads[0], block),
+				NextBlock(headers[1], payloads[1], block),
+				NextBlock(headers[2], payloads[2], block),
+				NextBlock(headers[3], payloads[3], block),
+				words);
+
+			// Undo the zigzag, then a running sum four indices at a time
+			for (int w = 0; w < 4; w++)
+			{
+				__m128i x = words[w];
+				x = _mm_xor_si128(_mm_srli_epi32(x, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(x, _mm_set1_epi32(1))));
+				x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+				x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+				x = _mm_add_epi32(x, last);
+				last = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+				words[w] = x;
+			}
+
+			if (chunk - i >= MESH_CODEC_BLOCK_SIZE)
+			{
+				for (int w = 0; w < 4; w++)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(indices + start + i + w * 4), words[w]);
+				}
+			}
+			else
+			{
+				// The last partial block was padded, so only copy what's real
+				memcpy(indices + start + i, words, (chunk - i) * sizeof(unsigned int));
+			}
+		}
+	}
+
+	return data == end;
+}
+
+bool MeshCodec::EncodeVertices(const void* vertices, size_t count, size_t stride, std::vector<uint8_t>& out)
+{
+	if (stride == 0 || stride % 4 != 0 || stride > MESH_CODEC_MAX_STRIDE)
+		return false;
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+	uint8_t last[MESH_CODEC_MAX_STRIDE] = {};
+	uint8_t plane[MESH_CODEC_CHUNK_SIZE];
+
+	for (size_t start = 0; start < count; start += MESH_CODEC_CHUNK_SIZE)
+	{
+		size_t chunk = count - start < MESH_CODEC_CHUNK_SIZE ? count - start : MESH_CODEC_CHUNK_SIZE;
+		for (size_t k = 0; k < stride; k++)
+		{
+			for (size_t i = 0; i < chunk; i++)
+			{
+				uint8_t value = bytes[(start + i) * stride + k];
+				plane[i] = ZigzagByte(static_cast<uint8_t>(value - last[k]));
+				last[k] = value;
+			}
+			EncodePlane(plane, chunk, out);
+		}
+	}
+	return true;
+}
+
+bool MeshCodec::DecodeVertices(const uint8_t* data, size_t size, void* vertices, size_t count, size_t stride)
+{
+	if (stride == 0 || stride % 4 != 0 || stride > MESH_CODEC_MAX_STRIDE)
+		return false;
+
+	// Running bytes of the previous vertex, one per lane of each register
+	__m128i last[MESH_CODEC_MAX_STRIDE];
+	for (size_t k = 0; k < stride; k++)
+	{
+		last[k] = _mm_setzero_si128();
+	}
+	uint8_t* bytes = static_cast<uint8_t*>(vertices);
+	const uint8_t* end = data + size;
+
+	for (size_t start = 0; start < count; start += MESH_CODEC_CHUNK_SIZE)
+	{
+		size_t chunk = count - start < MESH_CODEC_CHUNK_SIZE ? count - start : MESH_CODEC_CHUNK_SIZE;
+		size_t blocks = (chunk + MESH_CODEC_BLOCK_SIZE - 1) / MESH_CODEC_BLOCK_SIZE;
+
+		// Four planes make one 4 byte word of each vertex. Decoding them
+		// side by side keeps their four running sums independent
+		for (size_t k = 0; k < stride; k += 4)
+		{
+			const uint8_t* headers[4];
+			const uint8_t* payloads[4];
+			data = FindPlanes(data, end, blocks, headers, payloads);
+			if (data == nullptr)
+				return false;
+
+			for (size_t i = 0; i < chunk; i += MESH_CODEC_BLOCK_SIZE)
+			{
+				size_t block = i / MESH_CODEC_BLOCK_SIZE;
+				alignas(16) uint32_t words[MESH_CODEC_BLOCK_SIZE];
+				Interleave(
+					UndoByteDelta(NextBlock(headers[0], payloads[0], block), last[k]),
+					UndoByteDelta(NextBlock(headers[1], payloads[1], block), last[k + 1]),
+					UndoByteDelta(NextBlock(headers[2], payloads[2], block), last[k + 2]),
+					UndoByteDelta(NextBlock(headers[3], payloads[3], block), last[k + 3]),
+					reinterpret_cast<__m128i*>(words));
+
+				size_t length = chunk - i < MESH_CODEC_BLOCK_SIZE ? chunk - i : MESH_CODEC_BLOCK_SIZE;
+				uint8_t* target = bytes + (start + i) * stride + k;
+				for (size_t v = 0; v < length; v++)
+				{
+					memcpy(target + v * stride, &words[v], sizeof(uint32_t));
+				}
+			}
+		}
+	}
+
+	return data == end;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bytes in one entropy coded block. Each block picks its own bit width
+#define MESH_CODEC_BLOCK_SIZE 16
+// Vertices (or indices) decoded together, so a chunk's byte planes stay in L1
+#define MESH_CODEC_CHUNK_SIZE 256
+// Largest vertex stride the codec accepts. Strides must also be a multiple of 4
+#define MESH_CODEC_MAX_STRIDE 256
+
+/*
+	Lossless compression for cooked vertex and index data.
+
+	Both streams are cut into chunks of MESH_CODEC_CHUNK_SIZE elements,
+	and each chunk is split into byte planes: every vertex's first byte,
+	then every vertex's second byte and so on. Neighbouring vertices
+	tend to share their high bytes, so planes are mostly small numbers.
+
+	Vertex planes store each byte as the zigzagged difference from the
+	same byte of the vertex before. Indices are differenced and
+	zigzagged as whole 32 bit values first, since an optimized index
+	buffer mostly walks forward in small steps, and only then split
+	into four planes.
+
+	The entropy stage is deliberately simple so it decodes with a few
+	shuffles: each 16 byte block of a plane is bit packed at 0, 1, 2, 4
+	or 8 bits per byte, whichever is the smallest that fits, with a
+	4 bit width code per block in front of the plane.
+
+	Decoding uses SSE2 where available, which every x64 CPU has.
+	Encoding is plain scalar code, as it only runs at cook time
+*/
+class MeshCodec
+{
+public:
+	/// <summary>
+	/// Compress an index buffer, appending the result to out
+	/// </summary>
+	static void EncodeIndices(const unsigned int* indices, size_t count, std::vector<uint8_t>& out);
+	/// <summary>
+	/// Decompress exactly count indices. Returns false if the data is
+	/// malformed or isn't exactly size bytes long
+	/// </summary>
+	static bool DecodeIndices(const uint8_t* data, size_t size, unsigned int* indices, size_t count);
+
+	/// <summary>
+	/// Compress count vertices of the given stride, appending the result to out.
+	/// Returns false if the stride isn't supported
+	/// </summary>
+	static bool EncodeVertices(const void* vertices, size_t count, size_t stride, std::vector<uint8_t>& out);
+	/// <summary>
+	/// Decompress exactly count vertices of the given stride. Returns false
+	/// if the stride isn't supported, or the data is malformed or isn't
+	/// exactly size bytes long
+	/// </summary>
+	static bool DecodeVertices(const uint8_t* data, size_t size, void* vertices, size_t count, size_t stride);
+};
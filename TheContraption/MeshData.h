@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// Longest material or material library name kept from an obj, including the terminator
+#define MATERIAL_NAME_LENGTH 128
+
+/*
+	A range of the index buffer that draws the whole mesh at some
+	level of detail. Every LOD shares the same vertices
+*/
+struct MeshLod
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+	float error;	// Object space distance the surface may be off from full detail
+};
+
+/*
+	A contiguous run of indices to draw
+*/
+struct IndexRange
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+};
+
+/*
+	A small cluster of the full detail triangles that is culled on its
+	own. Its triangles are a contiguous range of the index buffer
+*/
+struct Meshlet
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+
+	// Object space bounding sphere
+	DirectX::XMFLOAT3 center;
+	float radius;
+
+	// Average facing of the triangles, and the sine of how far the
+	// most divergent one is from it. 1 means the cone can't cull anything
+	DirectX::XMFLOAT3 coneAxis;
+	float coneCutoff;
+};
+
+/*
+	A range of the index buffer drawn with a single material. The
+	material is a slot in the mesh's material list
+*/
+struct Submesh
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+	unsigned int material;
+};
+
+/*
+	A fixed size name, so it can be cooked straight to disk
+*/
+struct MaterialName
+{
+	char name[MATERIAL_NAME_LENGTH];
+};
+
+/*
+	A material as described by an .MTL library. Only what the
+	renderer can use is kept. Texture paths are already resolved
+	against the folder the library is in
+*/
+struct MaterialDefinition
+{
+	std::string name;
+	DirectX::XMFLOAT3 diffuse;	// Kd
+	DirectX::XMFLOAT3 specular;	// Ks
+	float specularExponent;		// Ns
+	float opacity;				// d, or 1 - Tr
+	std::wstring diffuseMap;	// map_Kd
+	std::wstring normalMap;		// norm, bump or map_Bump
+	bool defined;				// False if no library had a material by this name
+
+	MaterialDefinition() :
+		diffuse(0.8f, 0.8f, 0.8f),
+		specular(0.5f, 0.5f, 0.5f),
+		specularExponent(32.0f),
+		opacity(1.0f),
+		defined(false) {}
+
+	/// <summary>
+	/// Whether two definitions would make identical materials. The name doesn't matter
+	/// </summary>
+	bool SameAs(const MaterialDefinition& other) const
+	{
+		return
+			diffuse.x == other.diffuse.x && diffuse.y == other.diffuse.y && diffuse.z == other.diffuse.z &&
+			specular.x == other.specular.x && specular.y == other.specular.y && specular.z == other.specular.z &&
+			specularExponent == other.specularExponent &&
+			opacity == other.opacity &&
+			diffuseMap == other.diffuseMap &&
+			normalMap == other.normalMap;
+	}
+};
+
+/*
+	CPU-side geometry ready to be handed to a Mesh. Nothing in here
+	touches D3D so it can be built, processed and cached anywhere
+*/
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	// Ranges of indices, from full detail to coarsest.
+	// Empty means all of the indices are a single LOD
+	std::vector<MeshLod> lods;
+
+	// Clusters of the full detail triangles, empty unless built
+	std::vector<Meshlet> meshlets;
+
+	// Index ranges grouped by material. Empty means the whole
+	// mesh uses one material. The slots and libraries come from
+	// the obj, and the definitions are looked up from the libraries
+	std::vector<Submesh> submeshes;
+	std::vector<MaterialName> materialSlots;
+	std::vector<MaterialName> materialLibraries;
+	std::vector<MaterialDefinition> materials;
+
+	// Local space bounds of all vertex positions
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	DirectX::XMFLOAT3 boundsCenter;
+	float boundsRadius;
+
+	MeshData() :
+		boundsMin(0, 0, 0),
+		boundsMax(0, 0, 0),
+		boundsCenter(0, 0, 0),
+		boundsRadius(0) {}
+
+	/// <summary>
+	/// Recalculate the bounding box and sphere from the current vertices
+	/// </summary>
+	void CalculateBounds()
+	{
+		CalculateBounds(vertices.data(), vertices.size(), boundsMin, boundsMax);
+		CalculateBoundingSphere(vertices.data(), vertices.size(), boundsCenter, boundsRadius);
+	}
+
+	/// <summary>
+	/// Find the min and max corners of a set of vertex positions
+	/// </summary>
+	static void CalculateBounds(const Vertex* verts, size_t count, DirectX::XMFLOAT3& min, DirectX::XMFLOAT3& max)
+	{
+		if (count == 0)
+		{
+			min = max = DirectX::XMFLOAT3(0, 0, 0);
+			return;
+		}
+
+		DirectX::XMVECTOR vMin = DirectX::XMLoadFloat3(&verts[0].Position);
+		DirectX::XMVECTOR vMax = vMin;
+		for (size_t i = 1; i < count; i++)
+		{
+			DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&verts[i].Position);
+			vMin = DirectX::XMVectorMin(vMin, p);
+			vMax = DirectX::XMVectorMax(vMax, p);
+		}
+
+		DirectX::XMStoreFloat3(&min, vMin);
+		DirectX::XMStoreFloat3(&max, vMax);
+	}
+
+	/// <summary>
+	/// Find a sphere around a set of vertex positions. Uses Ritter's
+	/// algorithm, which is usually within a few percent of the smallest
+	/// sphere, or the sphere around the box's center if that is tighter
+	/// </summary>
+	static void CalculateBoundingSphere(const Vertex* verts, size_t count, DirectX::XMFLOAT3& center, float& radius)
+	{
+		if (count == 0)
+		{
+			center = DirectX::XMFLOAT3(0, 0, 0);
+			radius = 0;
+			return;
+		}
+
+		// Start from the furthest apart pair of extreme points on each axis
+		size_t minIndex[3] = { 0, 0, 0 };
+		size_t maxIndex[3] = { 0, 0, 0 };
+		for (size_t i = 1; i < count; i++)
+		{
+			const float* p = &verts[i].Position.x;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (p[axis] < (&verts[minIndex[axis]].Position.x)[axis]) minIndex[axis] = i;
+				if (p[axis] > (&verts[maxIndex[axis]].Position.x)[axis]) maxIndex[axis] = i;
+			}
+		}
+
+		DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&verts[minIndex[0]].Position);
+		DirectX::XMVECTOR b = DirectX::XMLoadFloat3(&verts[maxIndex[0]].Position);
+		float widest = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(b, a)));
+		for (int axis = 1; axis < 3; axis++)
+		{
+			DirectX::XMVECTOR axisMin = DirectX::XMLoadFloat3(&verts[minIndex[axis]].Position);
+			DirectX::XMVECTOR axisMax = DirectX::XMLoadFloat3(&verts[maxIndex[axis]].Position);
+			float span = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(axisMax, axisMin)));
+			if (span > widest)
+			{
+				a = axisMin;
+				b = axisMax;
+				widest = span;
+			}
+		}
+
+		// Grow the sphere just enough to reach every point outside it
+		DirectX::XMVECTOR c = DirectX::XMVectorScale(DirectX::XMVectorAdd(a, b), 0.5f);
+		float r = sqrtf(widest) * 0.5f;
+		for (size_t i = 0; i < count; i++)
+		{
+			DirectX::XMVECTOR toPoint = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&verts[i].Position), c);
+			float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(toPoint));
+			if (distance > r)
+			{
+				float grownRadius = (r + distance) * 0.5f;
+				c = DirectX::XMVectorAdd(c, DirectX::XMVectorScale(toPoint, (grownRadius - r) / distance));
+				r = grownRadius;
+			}
+		}
+
+		// The box's center does better on some shapes, like long thin ones
+		DirectX::XMFLOAT3 min, max;
+		CalculateBounds(verts, count, min, max);
+		DirectX::XMVECTOR boxCenter = DirectX::XMVectorScale(
+			DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&min), DirectX::XMLoadFloat3(&max)), 0.5f);
+		DirectX::XMVECTOR boxRadiusSq = DirectX::XMVectorZero();
+		for (size_t i = 0; i < count; i++)
+		{
+			DirectX::XMVECTOR toPoint = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&verts[i].Position), boxCenter);
+			boxRadiusSq = DirectX::XMVectorMax(boxRadiusSq, DirectX::XMVector3LengthSq(toPoint));
+		}
+
+		float boxRadius = sqrtf(DirectX::XMVectorGetX(boxRadiusSq));
+		if (boxRadius < r)
+		{
+			c = boxCenter;
+			r = boxRadius;
+		}
+
+		DirectX::XMStoreFloat3(&center, c);
+		radius = r;
+	}
+};
@@ -0,0 +1,171 @@
+#include "MeshLoader.h"
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Singleton requirement
+MeshLoader* MeshLoader::instance;
+
+MeshLoader::~MeshLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queued.clear();
+	}
+	wake.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void MeshLoader::Initialize(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	this->device = device;
+	this->context = context;
+
+	// The placeholder is a plain unit cube, built right away since it is tiny
+	Vertex vertices[24];
+	unsigned int indices[36];
+	for (int face = 0; face < 6; face++)
+	{
+		int axis = face / 2;
+		float sign = (face % 2 == 0) ? 1.0f : -1.0f;
+
+		float normal[3] = { 0, 0, 0 };
+		normal[axis] = sign;
+		float u[3] = { 0, 0, 0 };
+		u[(axis + 1) % 3] = 1.0f;
+		float v[3] = { 0, 0, 0 };
+		v[(axis + 2) % 3] = 1.0f;
+
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float cu = (corner == 1 || corner == 2) ? 0.5f : -0.5f;
+			float cv = (corner >= 2) ? 0.5f : -0.5f;
+
+			Vertex& vert = vertices[face * 4 + corner];
+			vert.Position = XMFLOAT3(
+				normal[0] * 0.5f + u[0] * cu + v[0] * cv,
+				normal[1] * 0.5f + u[1] * cu + v[1] * cv,
+				normal[2] * 0.5f + u[2] * cu + v[2] * cv);
+			vert.Normal = XMFLOAT3(normal[0], normal[1], normal[2]);
+			vert.UV = XMFLOAT2(cu + 0.5f, 0.5f - cv);
+			vert.Tangent = XMFLOAT4(0, 0, 0, 1);
+		}
+
+		// u x v points along +axis, so flip the winding on the
+		// negative faces to keep every face clockwise from outside
+		unsigned int base = face * 4;
+		unsigned int order[6] = { 0, 1, 2, 0, 2, 3 };
+		if (sign < 0)
+		{
+			order[1] = 2; order[2] = 1;
+			order[4] = 3; order[5] = 2;
+		}
+		for (int i = 0; i < 6; i++)
+			indices[face * 6 + i] = base + order[i];
+	}
+
+	// One per vertex format, so the placeholder fits whatever shader
+	// the mesh it stands in for would have been drawn with
+	for (int format = 0; format < VERTEX_FORMAT_COUNT; format++)
+		placeholders[format] = std::make_shared<Mesh>(device, context, vertices, indices, 24, 36, (VertexFormat)format);
+
+	// Leave a core for the main thread, though there's always at least one
+	// worker. hardware_concurrency() can be 0, so it's raised before subtracting
+	unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	threadCount = std::min(std::max(threadCount, 1u), (unsigned int)MESH_LOADER_MAX_THREADS);
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.push_back(std::thread(&MeshLoader::WorkerLoop, this));
+}
+
+void MeshLoader::Update()
+{
+	std::vector<std::unique_ptr<LoadJob>> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(finished);
+		pendingCount -= (unsigned int)done.size();
+	}
+
+	for (std::unique_ptr<LoadJob>& job : done)
+	{
+		if (job->succeeded)
+		{
+			job->mesh->bvh = std::move(job->bvh);
+			job->mesh->Upload(job->data);
+		}
+#if defined(DEBUG) || defined(_DEBUG)
+		else
+			wprintf(L"Failed to load mesh %ls\n", job->file.c_str());
+#endif
+	}
+}
+
+std::shared_ptr<Mesh> MeshLoader::Load(const wchar_t* file, VertexFormat format, TangentMode tangentMode, bool buildMeshlets, bool buildBvh)
+{
+	std::unique_ptr<LoadJob> job(new LoadJob());
+	job->mesh = std::shared_ptr<Mesh>(new Mesh(device, context, format, tangentMode, buildMeshlets, buildBvh));
+	job->file = file;
+	job->succeeded = false;
+
+	std::shared_ptr<Mesh> mesh = job->mesh;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(std::move(job));
+		pendingCount++;
+	}
+	wake.notify_one();
+
+	return mesh;
+}
+
+std::shared_ptr<Mesh> MeshLoader::GetPlaceholder(VertexFormat format)
+{
+	return placeholders[format];
+}
+
+unsigned int MeshLoader::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pendingCount;
+}
+
+void MeshLoader::WorkerLoop()
+{
+	while (true)
+	{
+		std::unique_ptr<LoadJob> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !queued.empty(); });
+			if (stopping)
+				return;
+
+			job = std::move(queued.front());
+			queued.pop_front();
+		}
+
+		// The mesh itself is left alone here, only the main thread touches it
+		job->succeeded = Mesh::LoadMeshData(
+			job->file.c_str(),
+			job->mesh->tangentMode,
+			job->mesh->buildMeshlets,
+			job->data);
+
+		// Building the BVH can take a while on big meshes, so it's done here too
+		if (job->succeeded && job->mesh->buildBvh)
+		{
+			MeshLod fullDetail = { 0, (unsigned int)job->data.indices.size(), 0.0f };
+			if (!job->data.lods.empty())
+				fullDetail = job->data.lods[0];
+			Mesh::BuildBvh(&job->data.vertices[0], &job->data.indices[0], fullDetail, job->bvh);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.push_back(std::move(job));
+	}
+}
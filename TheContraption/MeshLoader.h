@@ -0,0 +1,112 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "Mesh.h"
+
+// Most background threads used for loading. Parsing large files already
+// splits itself across threads, so a couple of loaders is plenty
+#define MESH_LOADER_MAX_THREADS 2
+
+/*
+	Loads meshes on background threads so startup doesn't wait on them.
+
+	Load() hands back a mesh straight away that isn't ready yet. A worker
+	reads its cooked copy, or parses and processes the obj, into CPU side
+	MeshData. Update() on the main thread then creates the buffers for
+	everything that has finished, so D3D is only ever touched there.
+
+	Until a mesh is ready, entities draw the placeholder in its place.
+*/
+class MeshLoader
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static MeshLoader& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new MeshLoader();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	MeshLoader(MeshLoader const&) = delete;
+	void operator=(MeshLoader const&) = delete;
+
+private:
+	static MeshLoader* instance;
+	MeshLoader() : stopping(false), pendingCount(0) {};
+#pragma endregion
+
+public:
+	/// <summary>
+	/// Waits for the current loads to finish and stops the workers
+	/// </summary>
+	~MeshLoader();
+
+	/// <summary>
+	/// Start the workers and build the placeholder mesh
+	/// </summary>
+	void Initialize(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	/// <summary>
+	/// Upload every mesh that finished loading since the last call. Main thread only
+	/// </summary>
+	void Update();
+
+	/// <summary>
+	/// Start loading an obj file in the background. The mesh can be handed
+	/// out right away and becomes ready during a later Update()
+	/// </summary>
+	std::shared_ptr<Mesh> Load(const wchar_t* file, VertexFormat format = VERTEX_FORMAT_FULL, TangentMode tangentMode = TANGENT_MODE_FAST, bool buildMeshlets = false, bool buildBvh = false);
+
+	/// <summary>
+	/// Get the mesh drawn in place of ones that are still loading, in the
+	/// same vertex format as them. Null until Initialize() is called
+	/// </summary>
+	std::shared_ptr<Mesh> GetPlaceholder(VertexFormat format = VERTEX_FORMAT_FULL);
+
+	/// <summary>
+	/// Get how many loads haven't been uploaded yet
+	/// </summary>
+	unsigned int GetPendingCount();
+
+private:
+	struct LoadJob
+	{
+		std::shared_ptr<Mesh> mesh;
+		std::wstring file;
+		MeshData data;
+		MeshBvh bvh;
+		bool succeeded;
+	};
+
+	void WorkerLoop();
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	std::shared_ptr<Mesh> placeholders[VERTEX_FORMAT_COUNT];
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping;
+
+	// Guarded by mutex
+	std::deque<std::unique_ptr<LoadJob>> queued;
+	std::vector<std::unique_ptr<LoadJob>> finished;
+	unsigned int pendingCount;
+};
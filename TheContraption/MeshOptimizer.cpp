@@ -0,0 +1,447 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" tuning values
+	// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+	const int forsythCacheSize = 32;
+	const int forsythMaxValence = 64;
+	const float forsythCacheDecayPower = 1.5f;
+	const float forsythLastTriScore = 0.75f;
+	const float forsythValenceBoostScale = 2.0f;
+	const float forsythValenceBoostPower = 0.5f;
+
+	// Score tables so the inner loop never calls pow()
+	struct ForsythScoreTable
+	{
+		float cache[forsythCacheSize];
+		float valence[forsythMaxValence];
+
+		ForsythScoreTable()
+		{
+			for (int i = 0; i < forsythCacheSize; i++)
+			{
+				// The three most recent vertices get a fixed score so the
+				// next triangle doesn't always reuse the last one's edge
+				if (i < 3)
+				{
+					cache[i] = forsythLastTriScore;
+				}
+				else
+				{
+					float scaler = 1.0f - (i - 3) / static_cast<float>(forsythCacheSize - 3);
+					cache[i] = std::pow(scaler, forsythCacheDecayPower);
+				}
+			}
+
+			valence[0] = 0.0f;
+			for (int i = 1; i < forsythMaxValence; i++)
+			{
+				valence[i] = forsythValenceBoostScale * std::pow(static_cast<float>(i), -forsythValenceBoostPower);
+			}
+		}
+	};
+
+	const ForsythScoreTable& GetScoreTable()
+	{
+		static ForsythScoreTable table;
+		return table;
+	}
+
+	inline float ScoreVertex(int cachePosition, unsigned int remainingTriangles)
+	{
+		// Vertices with nothing left to draw are worthless
+		if (remainingTriangles == 0)
+			return -1.0f;
+
+		const ForsythScoreTable& table = GetScoreTable();
+		float score = cachePosition >= 0 ? table.cache[cachePosition] : 0.0f;
+		score += table.valence[std::min(remainingTriangles, static_cast<unsigned int>(forsythMaxValence - 1))];
+		return score;
+	}
+
+	// FIFO post-transform cache simulation. A vertex is in the cache if
+	// fewer than cacheSize misses have happened since it was last loaded
+	struct FifoCache
+	{
+		std::vector<unsigned int> timestamps;
+		unsigned int time;
+		unsigned int size;
+
+		FifoCache(size_t vertexCount, unsigned int cacheSize) :
+			timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+		// Returns 1 if the vertex had to be transformed
+		inline unsigned int Touch(unsigned int v)
+		{
+			if (time - timestamps[v] > size)
+			{
+				timestamps[v] = time++;
+				return 1;
+			}
+			return 0;
+		}
+
+		// Push everything out, as if a new draw started
+		inline void Flush()
+		{
+			time += size + 1;
+		}
+	};
+}
+
+void MeshOptimizer::Optimize(MeshData& data)
+{
+	if (data.indices.empty() || data.vertices.empty())
+		return;
+
+	if (data.submeshes.empty())
+	{
+		OptimizeVertexCache(&data.indices[0], data.indices.size(), data.vertices.size());
+		OptimizeOverdraw(&data.indices[0], data.indices.size(), &data.vertices[0], data.vertices.size());
+	}
+	else
+	{
+		// Triangles can't cross into another material's range, so each submesh is reordered on its own
+		for (const Submesh& submesh : data.submeshes)
+		{
+			OptimizeVertexCache(&data.indices[submesh.indexStart], submesh.indexCount, data.vertices.size());
+			OptimizeOverdraw(&data.indices[submesh.indexStart], submesh.indexCount, &data.vertices[0], data.vertices.size());
+		}
+	}
+
+	size_t used = OptimizeVertexFetch(&data.vertices[0], &data.indices[0], data.indices.size(), data.vertices.size());
+	data.vertices.resize(used);
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Build vertex -> triangle adjacency. Each vertex's live triangles are
+	// kept at the front of its range so emitted ones can be swapped out
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+
+	std::vector<unsigned int> offsets(vertexCount, 0);
+	unsigned int offset = 0;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		offsets[v] = offset;
+		offset += remaining[v];
+	}
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(offsets);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		adjacency[fill[indices[t * 3 + 0]]++] = static_cast<unsigned int>(t);
+		adjacency[fill[indices[t * 3 + 1]]++] = static_cast<unsigned int>(t);
+		adjacency[fill[indices[t * 3 + 2]]++] = static_cast<unsigned int>(t);
+	}
+
+	// Initial scores
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = ScoreVertex(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] =
+			vertexScore[indices[t * 3 + 0]] +
+			vertexScore[indices[t * 3 + 1]] +
+			vertexScore[indices[t * 3 + 2]];
+	}
+
+	// Room for a full cache plus the three vertices of the new triangle
+	unsigned int cache[forsythCacheSize + 3];
+	unsigned int newCache[forsythCacheSize + 3];
+	int cacheCount = 0;
+
+	std::vector<unsigned int> result(triangleCount * 3);
+	size_t inputCursor = 0;
+	int bestTriangle = static_cast<int>(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+	for (size_t out = 0; out < triangleCount; out++)
+	{
+		// Nothing in the cache is useful, so restart from the next unused triangle
+		if (bestTriangle < 0)
+		{
+			while (emitted[inputCursor]) inputCursor++;
+			bestTriangle = static_cast<int>(inputCursor);
+		}
+
+		unsigned int tri[3] =
+		{
+			indices[bestTriangle * 3 + 0],
+			indices[bestTriangle * 3 + 1],
+			indices[bestTriangle * 3 + 2]
+		};
+
+		result[out * 3 + 0] = tri[0];
+		result[out * 3 + 1] = tri[1];
+		result[out * 3 + 2] = tri[2];
+		emitted[bestTriangle] = true;
+
+		// Remove the triangle from each of its vertices' live lists
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = tri[k];
+			unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == static_cast<unsigned int>(bestTriangle))
+				{
+					list[i] = list[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// The new triangle's vertices move to the front of the cache
+		int newCount = 0;
+		newCache[newCount++] = tri[0];
+		newCache[newCount++] = tri[1];
+		newCache[newCount++] = tri[2];
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore everything that moved, pushing the change to adjacent triangles
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < forsythCacheSize ? i : -1;
+
+			float score = ScoreVertex(cachePosition[v], remaining[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int a = 0; a < remaining[v]; a++)
+			{
+				triangleScore[list[a]] += delta;
+			}
+		}
+
+		// Only triangles touching the cache are worth considering next
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		cacheCount = std::min(newCount, forsythCacheSize);
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = newCache[i];
+			cache[i] = v;
+
+			const unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int a = 0; a < remaining[v]; a++)
+			{
+				if (triangleScore[list[a]] > bestScore)
+				{
+					bestScore = triangleScore[list[a]];
+					bestTriangle = static_cast<int>(list[a]);
+				}
+			}
+		}
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Hard boundaries - a triangle where every vertex misses the cache is
+	// a natural restart point, so reordering there costs nothing
+	std::vector<unsigned int> hardClusters;
+	{
+		FifoCache fifo(vertexCount, VERTEX_CACHE_SIM_SIZE);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			unsigned int misses =
+				fifo.Touch(indices[t * 3 + 0]) +
+				fifo.Touch(indices[t * 3 + 1]) +
+				fifo.Touch(indices[t * 3 + 2]);
+
+			if (t == 0 || misses == 3)
+				hardClusters.push_back(static_cast<unsigned int>(t));
+		}
+	}
+	hardClusters.push_back(static_cast<unsigned int>(triangleCount));
+
+	// Soft boundaries - split hard clusters further wherever the partial
+	// cluster's ACMR is still within the threshold of the whole cluster's
+	std::vector<unsigned int> clusters;
+	{
+		FifoCache fifo(vertexCount, VERTEX_CACHE_SIM_SIZE);
+		for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+		{
+			unsigned int start = hardClusters[c];
+			unsigned int end = hardClusters[c + 1];
+
+			fifo.Flush();
+			unsigned int clusterMisses = 0;
+			for (unsigned int t = start; t < end; t++)
+			{
+				clusterMisses +=
+					fifo.Touch(indices[t * 3 + 0]) +
+					fifo.Touch(indices[t * 3 + 1]) +
+					fifo.Touch(indices[t * 3 + 2]);
+			}
+			float clusterAcmr = clusterMisses / static_cast<float>(end - start);
+
+			fifo.Flush();
+			clusters.push_back(start);
+			unsigned int softStart = start;
+			unsigned int misses = 0;
+			for (unsigned int t = start; t < end; t++)
+			{
+				misses +=
+					fifo.Touch(indices[t * 3 + 0]) +
+					fifo.Touch(indices[t * 3 + 1]) +
+					fifo.Touch(indices[t * 3 + 2]);
+
+				if (t + 1 < end && misses <= clusterAcmr * threshold * (t + 1 - softStart))
+				{
+					clusters.push_back(t + 1);
+					softStart = t + 1;
+					misses = 0;
+					fifo.Flush();
+				}
+			}
+		}
+	}
+	clusters.push_back(static_cast<unsigned int>(triangleCount));
+
+	// The mesh centroid is the reference point for "outward facing"
+	DirectX::XMVECTOR meshCentroid = DirectX::XMVectorZero();
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		meshCentroid = DirectX::XMVectorAdd(meshCentroid, DirectX::XMLoadFloat3(&vertices[indices[i]].Position));
+	}
+	meshCentroid = DirectX::XMVectorScale(meshCentroid, 1.0f / indexCount);
+
+	// Clusters that face away from the center are most likely to be in
+	// front of the rest of the mesh, so they should be drawn first
+	size_t clusterCount = clusters.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		DirectX::XMVECTOR centroid = DirectX::XMVectorZero();
+		DirectX::XMVECTOR normal = DirectX::XMVectorZero();
+		float area = 0.0f;
+
+		for (unsigned int t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&vertices[indices[t * 3 + 0]].Position);
+			DirectX::XMVECTOR p1 = DirectX::XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+			DirectX::XMVECTOR p2 = DirectX::XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+
+			// Length of the cross product is twice the triangle's area, so
+			// summing them gives an area weighted normal for free
+			DirectX::XMVECTOR n = DirectX::XMVector3Cross(
+				DirectX::XMVectorSubtract(p1, p0),
+				DirectX::XMVectorSubtract(p2, p0));
+			float a = DirectX::XMVectorGetX(DirectX::XMVector3Length(n));
+
+			DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(DirectX::XMVectorAdd(p0, p1), p2), 1.0f / 3.0f);
+			centroid = DirectX::XMVectorAdd(centroid, DirectX::XMVectorScale(center, a));
+			normal = DirectX::XMVectorAdd(normal, n);
+			area += a;
+		}
+
+		if (area <= 0.0f)
+		{
+			sortKeys[c] = 0.0f;
+			continue;
+		}
+
+		centroid = DirectX::XMVectorScale(centroid, 1.0f / area);
+		normal = DirectX::XMVector3Normalize(normal);
+		sortKeys[c] = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVectorSubtract(centroid, meshCentroid), normal));
+	}
+
+	std::vector<unsigned int> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) order[c] = static_cast<unsigned int>(c);
+	std::stable_sort(order.begin(), order.end(),
+		[&sortKeys](unsigned int a, unsigned int b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<unsigned int> result;
+	result.reserve(triangleCount * 3);
+	for (unsigned int c : order)
+	{
+		result.insert(result.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(Vertex* vertices, unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(vertexCount, unused);
+	std::vector<Vertex> result;
+	result.reserve(vertexCount);
+
+	// Vertices are placed in the order the GPU will first ask for them
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int& mapped = remap[indices[i]];
+		if (mapped == unused)
+		{
+			mapped = static_cast<unsigned int>(result.size());
+			result.push_back(vertices[indices[i]]);
+		}
+		indices[i] = mapped;
+	}
+
+	std::copy(result.begin(), result.end(), vertices);
+	return result.size();
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = {};
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return stats;
+
+	FifoCache fifo(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+	size_t usedCount = 0;
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		stats.transformedVertices += fifo.Touch(indices[i]);
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = true;
+			usedCount++;
+		}
+	}
+
+	stats.acmr = stats.transformedVertices / static_cast<float>(triangleCount);
+	stats.atvr = stats.transformedVertices / static_cast<float>(usedCount);
+	return stats;
+}
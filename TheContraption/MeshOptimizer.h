@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include "MeshData.h"
+
+// Size of the FIFO cache used when measuring index buffers. Real GPUs
+// vary, but 16-32 entries is typical of D3D11 era hardware
+#define VERTEX_CACHE_SIM_SIZE 16
+
+/// <summary>
+/// Results of running an index buffer through a simulated post-transform cache
+/// </summary>
+struct VertexCacheStats
+{
+	unsigned int transformedVertices;	// Cache misses - how many times the vertex shader runs
+	float acmr;							// Average cache miss ratio - misses per triangle (0.5 - 3.0)
+	float atvr;							// Average transformed vertex ratio - misses per used vertex (1.0 is ideal)
+};
+
+/*
+	Reorders mesh data so the GPU does less work drawing it. None of this
+	touches D3D, so it can run anywhere in the import pipeline:
+
+	1. OptimizeVertexCache - Forsyth's linear-speed vertex cache optimization
+	2. OptimizeOverdraw    - splits the result into clusters and draws the
+	                         outward facing ones first so more pixels fail the depth test
+	3. OptimizeVertexFetch - orders vertices by first use so fetches stay sequential
+*/
+class MeshOptimizer
+{
+public:
+	/// <summary>
+	/// Run every pass, in order, over the given mesh data
+	/// </summary>
+	static void Optimize(MeshData& data);
+
+	/// <summary>
+	/// Reorder triangles to reuse recently transformed vertices
+	/// </summary>
+	static void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+	/// <summary>
+	/// Reorder clusters of already cache optimized triangles to reduce overdraw.
+	/// Threshold is how much worse than the input ACMR the clusters are allowed to get
+	/// </summary>
+	static void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold = 1.05f);
+	/// <summary>
+	/// Reorder vertices by first use in the index buffer, remapping the indices.
+	/// Unused vertices are dropped. Returns the new vertex count
+	/// </summary>
+	static size_t OptimizeVertexFetch(Vertex* vertices, unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+	/// <summary>
+	/// Measure how well an index buffer uses a FIFO post-transform cache
+	/// </summary>
+	static VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIM_SIZE);
+};
@@ -0,0 +1,389 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Symmetric 4x4 matrix of a sum of squared plane distances, plus the
+	// total area it was built from so errors don't grow with tessellation
+	struct Quadric
+	{
+		float a2, b2, c2, d2;
+		float ab, ac, ad;
+		float bc, bd;
+		float cd;
+		float weight;
+	};
+
+	Quadric MakePlaneQuadric(float a, float b, float c, float d, float weight)
+	{
+		Quadric q;
+		q.a2 = a * a * weight; q.b2 = b * b * weight; q.c2 = c * c * weight; q.d2 = d * d * weight;
+		q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+		q.bc = b * c * weight; q.bd = b * d * weight;
+		q.cd = c * d * weight;
+		q.weight = weight;
+		return q;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a2 += other.a2; q.b2 += other.b2; q.c2 += other.c2; q.d2 += other.d2;
+		q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+		q.bc += other.bc; q.bd += other.bd;
+		q.cd += other.cd;
+		q.weight += other.weight;
+	}
+
+	// Weighted average squared distance from p to every plane in the quadric
+	float EvaluateQuadric(const Quadric& q, const XMFLOAT3& p)
+	{
+		float rx = q.a2 * p.x + q.ab * p.y + q.ac * p.z + q.ad;
+		float ry = q.ab * p.x + q.b2 * p.y + q.bc * p.z + q.bd;
+		float rz = q.ac * p.x + q.bc * p.y + q.c2 * p.z + q.cd;
+		float rw = q.ad * p.x + q.bd * p.y + q.cd * p.z + q.d2;
+		float error = p.x * rx + p.y * ry + p.z * rz + rw;
+		return q.weight > 0.0f ? fabsf(error) / q.weight : 0.0f;
+	}
+
+	inline XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	struct PositionHash
+	{
+		size_t operator()(const XMFLOAT3& p) const
+		{
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			uint64_t h = bits[0];
+			h = h * 0x9E3779B97F4A7C15ull ^ bits[1];
+			h = h * 0x9E3779B97F4A7C15ull ^ bits[2];
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const XMFLOAT3& a, const XMFLOAT3& b) const
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+	};
+
+	// Which triangles use each vertex, stored as one flat list
+	struct TriangleAdjacency
+	{
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> triangles;
+
+		void Build(const unsigned int* indices, size_t indexCount, size_t vertexCount)
+		{
+			offsets.assign(vertexCount + 1, 0);
+			for (size_t i = 0; i < indexCount; i++)
+				offsets[indices[i] + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				offsets[v + 1] += offsets[v];
+
+			triangles.resize(indexCount);
+			std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indexCount; i++)
+				triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+		}
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		float error;
+	};
+
+	// True if moving 'from' onto 'to' would turn any of from's triangles
+	// (other than the ones being removed) over or into a sliver
+	bool CollapseFlipsTriangle(
+		unsigned int from, unsigned int to,
+		const unsigned int* indices, const TriangleAdjacency& adjacency,
+		const std::vector<XMFLOAT3>& positions)
+	{
+		for (unsigned int t = adjacency.offsets[from]; t < adjacency.offsets[from + 1]; t++)
+		{
+			const unsigned int* tri = &indices[adjacency.triangles[t] * 3];
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+				continue;
+
+			// Rotate so 'from' is the first corner
+			int k = tri[0] == from ? 0 : (tri[1] == from ? 1 : 2);
+			const XMFLOAT3& b = positions[tri[(k + 1) % 3]];
+			const XMFLOAT3& c = positions[tri[(k + 2) % 3]];
+
+			XMFLOAT3 before = Cross(Subtract(b, positions[from]), Subtract(c, positions[from]));
+			XMFLOAT3 after = Cross(Subtract(b, positions[to]), Subtract(c, positions[to]));
+
+			// Allow some rotation, but nothing near or past perpendicular
+			float d = Dot(before, after);
+			if (d <= 0.25f * sqrtf(Dot(before, before) * Dot(after, after)))
+				return true;
+		}
+		return false;
+	}
+}
+
+void MeshSimplifier::GenerateLods(MeshData& data)
+{
+	data.lods.clear();
+	if (data.indices.empty())
+		return;
+
+	MeshLod full = { 0, static_cast<unsigned int>(data.indices.size()), 0.0f };
+	data.lods.push_back(full);
+
+	std::vector<unsigned int> source(data.indices);
+	std::vector<unsigned int> simplified(source.size());
+
+	for (int lod = 1; lod < MESH_LOD_MAX_COUNT; lod++)
+	{
+		size_t target = static_cast<size_t>(source.size() / 3 * MESH_LOD_REDUCTION) * 3;
+
+		// Each LOD is simplified from the last, so their errors add up
+		float error = 0.0f;
+		size_t count = Simplify(&simplified[0], &source[0], source.size(),
+			&data.vertices[0], data.vertices.size(), target, MESH_LOD_MAX_ERROR, &error);
+
+		// Not worth a draw range of its own
+		if (count == 0 || count > source.size() * 4 / 5)
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(&simplified[0], count, data.vertices.size());
+
+		MeshLod next;
+		next.indexStart = static_cast<unsigned int>(data.indices.size());
+		next.indexCount = static_cast<unsigned int>(count);
+		next.error = data.lods.back().error + error;
+		data.lods.push_back(next);
+		data.indices.insert(data.indices.end(), simplified.begin(), simplified.begin() + count);
+
+		source.assign(simplified.begin(), simplified.begin() + count);
+	}
+}
+
+size_t MeshSimplifier::Simplify(
+	unsigned int* destination,
+	const unsigned int* indices, size_t indexCount,
+	const Vertex* vertices, size_t vertexCount,
+	size_t targetIndexCount, float targetError,
+	float* resultError)
+{
+	if (resultError) *resultError = 0.0f;
+	memcpy(destination, indices, indexCount * sizeof(unsigned int));
+	if (indexCount <= targetIndexCount || vertexCount == 0)
+		return indexCount;
+
+	// Work in a unit sized space so errors are relative to the mesh
+	XMFLOAT3 min, max;
+	MeshData::CalculateBounds(vertices, vertexCount, min, max);
+	float extent = std::max(max.x - min.x, std::max(max.y - min.y, max.z - min.z));
+	float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+
+	std::vector<XMFLOAT3> positions(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		positions[v] = XMFLOAT3(
+			(vertices[v].Position.x - min.x) * scale,
+			(vertices[v].Position.y - min.y) * scale,
+			(vertices[v].Position.z - min.z) * scale);
+	}
+
+	// Every vertex at the same spot shares one canonical vertex, so
+	// topology is judged by position rather than by attributes
+	std::vector<unsigned int> canonical(vertexCount);
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<XMFLOAT3, unsigned int, PositionHash, PositionEqual> firstAtPosition;
+		firstAtPosition.reserve(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			auto found = firstAtPosition.emplace(vertices[v].Position, static_cast<unsigned int>(v));
+			canonical[v] = found.first->second;
+
+			// Attribute seam - moving one side would tear the other
+			if (!found.second)
+			{
+				locked[v] = true;
+				locked[found.first->second] = true;
+			}
+		}
+	}
+
+	// Open borders - an edge with no matching edge going the other way
+	{
+		std::unordered_map<uint64_t, unsigned int> edges;
+		edges.reserve(indexCount);
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				uint64_t a = canonical[indices[i + k]];
+				uint64_t b = canonical[indices[i + (k + 1) % 3]];
+				edges[(a << 32) | b]++;
+			}
+		}
+
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				uint64_t a = canonical[indices[i + k]];
+				uint64_t b = canonical[indices[i + (k + 1) % 3]];
+				if (edges.find((b << 32) | a) == edges.end())
+				{
+					locked[indices[i + k]] = true;
+					locked[indices[i + (k + 1) % 3]] = true;
+				}
+			}
+		}
+	}
+
+	// Each triangle's plane, weighted by area, added to its corners
+	std::vector<Quadric> quadrics(vertexCount, MakePlaneQuadric(0, 0, 0, 0, 0));
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		const XMFLOAT3& p0 = positions[indices[i]];
+		XMFLOAT3 n = Cross(Subtract(positions[indices[i + 1]], p0), Subtract(positions[indices[i + 2]], p0));
+		float length = sqrtf(Dot(n, n));
+		if (length == 0.0f)
+			continue;
+
+		n = XMFLOAT3(n.x / length, n.y / length, n.z / length);
+		Quadric q = MakePlaneQuadric(n.x, n.y, n.z, -Dot(n, p0), length * 0.5f);
+		for (int k = 0; k < 3; k++)
+			AddQuadric(quadrics[indices[i + k]], q);
+	}
+
+	size_t currentCount = indexCount;
+	float maxSquaredError = targetError * targetError;
+	float reachedError = 0.0f;
+
+	TriangleAdjacency adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+
+	// Each pass collapses a batch of independent edges, cheapest first
+	while (currentCount > targetIndexCount)
+	{
+		adjacency.Build(destination, currentCount, vertexCount);
+
+		// Cheapest neighbor for every vertex that's allowed to move
+		collapses.clear();
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			if (locked[v] || adjacency.offsets[v] == adjacency.offsets[v + 1])
+				continue;
+
+			Collapse best = { static_cast<unsigned int>(v), 0, FLT_MAX };
+			for (unsigned int t = adjacency.offsets[v]; t < adjacency.offsets[v + 1]; t++)
+			{
+				const unsigned int* tri = &destination[adjacency.triangles[t] * 3];
+				for (int k = 0; k < 3; k++)
+				{
+					if (tri[k] == v)
+						continue;
+
+					Quadric q = quadrics[v];
+					AddQuadric(q, quadrics[tri[k]]);
+					float error = EvaluateQuadric(q, positions[tri[k]]);
+					if (error < best.error)
+					{
+						best.to = tri[k];
+						best.error = error;
+					}
+				}
+			}
+
+			if (best.error <= maxSquaredError)
+				collapses.push_back(best);
+		}
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = static_cast<unsigned int>(v);
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Each collapse takes out about two triangles
+		size_t trianglesToRemove = (currentCount - targetIndexCount) / 3;
+		size_t removed = 0;
+		size_t applied = 0;
+
+		for (const Collapse& c : collapses)
+		{
+			if (removed >= trianglesToRemove)
+				break;
+
+			// Anything near an earlier collapse this pass has stale neighbors
+			if (touched[c.from] || touched[c.to])
+				continue;
+
+			if (CollapseFlipsTriangle(c.from, c.to, destination, adjacency, positions))
+				continue;
+
+			remap[c.from] = c.to;
+			AddQuadric(quadrics[c.to], quadrics[c.from]);
+			reachedError = std::max(reachedError, c.error);
+			applied++;
+
+			for (unsigned int t = adjacency.offsets[c.from]; t < adjacency.offsets[c.from + 1]; t++)
+			{
+				const unsigned int* tri = &destination[adjacency.triangles[t] * 3];
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+					removed++;
+
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+		}
+
+		if (applied == 0)
+			break;
+
+		// Apply the collapses and drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < currentCount; i += 3)
+		{
+			unsigned int a = remap[destination[i]];
+			unsigned int b = remap[destination[i + 1]];
+			unsigned int c = remap[destination[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			destination[write++] = a;
+			destination[write++] = b;
+			destination[write++] = c;
+		}
+		currentCount = write;
+	}
+
+	if (resultError) *resultError = sqrtf(reachedError) * extent;
+	return currentCount;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include "MeshData.h"
+
+// Most LODs a mesh gets, including the full detail one
+#define MESH_LOD_MAX_COUNT 5
+// Each LOD aims for this fraction of the previous one's triangles
+#define MESH_LOD_REDUCTION 0.5f
+// Furthest a simplified surface may drift from the original, relative to the mesh's size
+#define MESH_LOD_MAX_ERROR 0.05f
+
+/*
+	Quadric error metric simplification (Garland & Heckbert 1997).
+
+	Only the index buffer is simplified - edges are collapsed onto one of
+	their existing vertices, so every LOD reuses the full detail vertex
+	buffer and a LOD is just a different range of indices.
+
+	Vertices on open borders and on attribute seams (several vertices at
+	one position, like a uv seam or a hard edge) are never moved, so the
+	silhouette and texture layout of the mesh hold together.
+*/
+class MeshSimplifier
+{
+public:
+	/// <summary>
+	/// Build a chain of LODs for the given mesh data. Each LOD's indices are
+	/// appended to data.indices and described by an entry in data.lods
+	/// </summary>
+	static void GenerateLods(MeshData& data);
+
+	/// <summary>
+	/// Simplify an index buffer down to targetIndexCount, or until collapsing
+	/// anything else would move the surface further than targetError (relative
+	/// to the mesh's size). Destination needs room for indexCount indices.
+	/// Returns the new index count, and the object space error in resultError
+	/// </summary>
+	static size_t Simplify(
+		unsigned int* destination,
+		const unsigned int* indices, size_t indexCount,
+		const Vertex* vertices, size_t vertexCount,
+		size_t targetIndexCount, float targetError,
+		float* resultError = nullptr);
+};
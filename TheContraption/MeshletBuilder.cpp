@@ -0,0 +1,208 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+void MeshletBuilder::Build(MeshData& data)
+{
+	data.meshlets.clear();
+
+	// Only the full detail LOD is clustered
+	size_t start = 0;
+	size_t indexCount = data.indices.size();
+	if (!data.lods.empty())
+	{
+		start = data.lods[0].indexStart;
+		indexCount = data.lods[0].indexCount;
+	}
+
+	size_t triangleCount = indexCount / 3;
+	size_t vertexCount = data.vertices.size();
+	if (triangleCount == 0)
+		return;
+
+	const unsigned int* indices = &data.indices[start];
+
+	// Which triangles use each vertex, as one flat list
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < indexCount; i++)
+		offsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+
+	std::vector<unsigned int> adjacency(indexCount);
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; i++)
+			adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<unsigned int> ordered;
+	ordered.reserve(indexCount);
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> vertexMeshlet(vertexCount, UINT_MAX);
+	std::vector<unsigned int> queuedMeshlet(triangleCount, UINT_MAX);
+	std::vector<unsigned int> candidates;
+	size_t nextSeed = 0;
+
+	while (ordered.size() < indexCount)
+	{
+		unsigned int meshletIndex = static_cast<unsigned int>(data.meshlets.size());
+		Meshlet meshlet = {};
+		meshlet.indexStart = static_cast<unsigned int>(start + ordered.size());
+
+		unsigned int meshletVertices = 0;
+		unsigned int meshletTriangles = 0;
+		candidates.clear();
+
+		while (meshletTriangles < MESHLET_MAX_TRIANGLES)
+		{
+			// Neighbor that adds the fewest vertices, earliest in the
+			// buffer on ties to keep the optimizer's ordering
+			unsigned int best = UINT_MAX;
+			unsigned int bestNew = 4;
+			for (size_t c = 0; c < candidates.size();)
+			{
+				unsigned int t = candidates[c];
+				if (emitted[t])
+				{
+					candidates[c] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+
+				unsigned int newVertices = 0;
+				for (int k = 0; k < 3; k++)
+					newVertices += vertexMeshlet[indices[t * 3 + k]] != meshletIndex;
+
+				if (newVertices < bestNew || (newVertices == bestNew && t < best))
+				{
+					best = t;
+					bestNew = newVertices;
+				}
+				c++;
+			}
+
+			// Nothing connected is left, so continue from the next
+			// triangle in buffer order, which is usually close by
+			if (best == UINT_MAX)
+			{
+				while (nextSeed < triangleCount && emitted[nextSeed])
+					nextSeed++;
+				if (nextSeed == triangleCount)
+					break;
+
+				best = static_cast<unsigned int>(nextSeed);
+				bestNew = 0;
+				for (int k = 0; k < 3; k++)
+					bestNew += vertexMeshlet[indices[best * 3 + k]] != meshletIndex;
+			}
+
+			if (meshletVertices + bestNew > MESHLET_MAX_VERTICES)
+				break;
+
+			emitted[best] = true;
+			meshletTriangles++;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[best * 3 + k];
+				ordered.push_back(v);
+				if (vertexMeshlet[v] != meshletIndex)
+				{
+					vertexMeshlet[v] = meshletIndex;
+					meshletVertices++;
+				}
+
+				// Everything touching the new triangle is a candidate
+				for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+				{
+					unsigned int neighbor = adjacency[a];
+					if (!emitted[neighbor] && queuedMeshlet[neighbor] != meshletIndex)
+					{
+						queuedMeshlet[neighbor] = meshletIndex;
+						candidates.push_back(neighbor);
+					}
+				}
+			}
+		}
+
+		meshlet.indexCount = meshletTriangles * 3;
+		data.meshlets.push_back(meshlet);
+	}
+
+	// Every meshlet becomes one contiguous range
+	std::copy(ordered.begin(), ordered.end(), data.indices.begin() + start);
+
+	for (Meshlet& meshlet : data.meshlets)
+		CalculateBounds(meshlet, &data.indices[0], &data.vertices[0]);
+}
+
+void MeshletBuilder::CalculateBounds(Meshlet& meshlet, const unsigned int* indices, const Vertex* vertices)
+{
+	const unsigned int* tris = &indices[meshlet.indexStart];
+
+	// Sphere around the center of the box
+	XMVECTOR min = XMLoadFloat3(&vertices[tris[0]].Position);
+	XMVECTOR max = min;
+	for (unsigned int i = 1; i < meshlet.indexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[tris[i]].Position);
+		min = XMVectorMin(min, p);
+		max = XMVectorMax(max, p);
+	}
+
+	XMVECTOR center = XMVectorScale(XMVectorAdd(min, max), 0.5f);
+	XMVECTOR radiusSq = XMVectorZero();
+	for (unsigned int i = 0; i < meshlet.indexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[tris[i]].Position);
+		radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(XMVectorSubtract(p, center)));
+	}
+
+	XMStoreFloat3(&meshlet.center, center);
+	meshlet.radius = sqrtf(XMVectorGetX(radiusSq));
+
+	// Cone axis is the average of the unit face normals. Normals face the
+	// same way as the front face winding, so the cone points outwards
+	XMVECTOR axis = XMVectorZero();
+	for (unsigned int i = 0; i < meshlet.indexCount; i += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[tris[i]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[tris[i + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[tris[i + 2]].Position);
+		XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+		if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+			axis = XMVectorAdd(axis, XMVector3Normalize(normal));
+	}
+
+	meshlet.coneAxis = XMFLOAT3(0, 0, 1);
+	meshlet.coneCutoff = 1.0f;
+	if (XMVectorGetX(XMVector3LengthSq(axis)) == 0.0f)
+		return;
+
+	axis = XMVector3Normalize(axis);
+	XMStoreFloat3(&meshlet.coneAxis, axis);
+
+	float minDot = 1.0f;
+	for (unsigned int i = 0; i < meshlet.indexCount; i += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[tris[i]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[tris[i + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[tris[i + 2]].Position);
+		XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+		if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+			minDot = fminf(minDot, XMVectorGetX(XMVector3Dot(XMVector3Normalize(normal), axis)));
+	}
+
+	// Too wide to ever be entirely back facing - anything close to a
+	// hemisphere only culls from directly behind, so don't bother
+	if (minDot <= 0.1f)
+		return;
+
+	meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include "MeshData.h"
+
+// Most vertices and triangles a single meshlet may hold
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+/*
+	Splits a mesh into small clusters of triangles (meshlets) that can
+	each be culled on their own, so a large mesh that is only partly in
+	view only draws the part that is.
+
+	Meshlets are grown triangle by triangle from a seed, always taking
+	the neighboring triangle that adds the fewest new vertices. The full
+	detail index range is then rewritten in meshlet order, so every
+	meshlet is a contiguous range that DrawIndexed can draw directly.
+
+	Each meshlet gets a bounding sphere for frustum culling, and a normal
+	cone holding the average facing of its triangles and how far they
+	spread from it. When the camera sees the whole cone from behind, every
+	triangle in the meshlet is a back face.
+*/
+class MeshletBuilder
+{
+public:
+	/// <summary>
+	/// Build meshlets over the full detail index range of the given mesh
+	/// data, reordering that range and filling in data.meshlets
+	/// </summary>
+	static void Build(MeshData& data);
+
+	/// <summary>
+	/// Fill in a meshlet's bounding sphere and normal cone from its triangles
+	/// </summary>
+	static void CalculateBounds(Meshlet& meshlet, const unsigned int* indices, const Vertex* vertices);
+};
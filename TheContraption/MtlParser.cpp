@@ -0,0 +1,143 @@
+#include "MtlParser.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	// Splits a line into whitespace separated tokens
+	void Tokenize(const char* c, const char* end, std::vector<std::string>& tokens)
+	{
+		tokens.clear();
+		while (c < end)
+		{
+			while (c < end && IsSpace(*c)) c++;
+			if (c >= end || *c == '#')
+				break;
+
+			const char* start = c;
+			while (c < end && !IsSpace(*c)) c++;
+			tokens.push_back(std::string(start, c));
+		}
+	}
+
+	float ToFloat(const std::vector<std::string>& tokens, size_t index, float fallback)
+	{
+		return index < tokens.size() ? strtof(tokens[index].c_str(), nullptr) : fallback;
+	}
+
+	// Names in these files are plain ASCII, so widening is byte by byte
+	std::wstring Widen(const std::string& text)
+	{
+		return std::wstring(text.begin(), text.end());
+	}
+}
+
+bool MtlParser::ParseFile(const wchar_t* file, std::vector<MaterialDefinition>& out)
+{
+	MappedFile mapped(file);
+	if (!mapped.IsOpen())
+		return false;
+
+	Parse(mapped.GetData(), mapped.GetSize(), GetDirectory(file), out);
+	return true;
+}
+
+void MtlParser::Parse(const char* data, size_t size, const std::wstring& directory, std::vector<MaterialDefinition>& out)
+{
+	const char* c = data;
+	const char* end = data + size;
+	MaterialDefinition* current = nullptr;
+	std::vector<std::string> tokens;
+
+	while (c < end)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(c, '\n', end - c));
+		if (lineEnd == nullptr)
+			lineEnd = end;
+
+		Tokenize(c, lineEnd, tokens);
+		c = lineEnd < end ? lineEnd + 1 : end;
+		if (tokens.empty())
+			continue;
+
+		const std::string& keyword = tokens[0];
+		if (keyword == "newmtl")
+		{
+			MaterialDefinition material;
+			material.name = tokens.size() > 1 ? tokens[1] : "";
+			material.defined = true;
+			out.push_back(material);
+			current = &out.back();
+			continue;
+		}
+
+		// Anything before the first newmtl has nothing to apply to
+		if (current == nullptr)
+			continue;
+
+		if (keyword == "Kd")
+			current->diffuse = DirectX::XMFLOAT3(ToFloat(tokens, 1, 0), ToFloat(tokens, 2, 0), ToFloat(tokens, 3, 0));
+		else if (keyword == "Ks")
+			current->specular = DirectX::XMFLOAT3(ToFloat(tokens, 1, 0), ToFloat(tokens, 2, 0), ToFloat(tokens, 3, 0));
+		else if (keyword == "Ns")
+			current->specularExponent = ToFloat(tokens, 1, current->specularExponent);
+		else if (keyword == "d")
+			current->opacity = ToFloat(tokens, 1, 1.0f);
+		else if (keyword == "Tr")
+			current->opacity = 1.0f - ToFloat(tokens, 1, 0.0f);
+		else if (keyword == "map_Kd" && tokens.size() > 1)
+			current->diffuseMap = directory + Widen(tokens.back());
+		else if ((keyword == "norm" || keyword == "bump" || keyword == "map_Bump" || keyword == "map_bump") && tokens.size() > 1)
+			current->normalMap = directory + Widen(tokens.back());
+	}
+}
+
+void MtlParser::ResolveMaterials(
+	const wchar_t* objFile,
+	const MaterialName* slots, size_t slotCount,
+	const MaterialName* libraries, size_t libraryCount,
+	std::vector<MaterialDefinition>& out)
+{
+	out.clear();
+	if (slotCount == 0)
+		return;
+
+	std::wstring directory = GetDirectory(objFile);
+	std::vector<MaterialDefinition> available;
+	for (size_t i = 0; i < libraryCount; i++)
+	{
+		if (!ParseFile((directory + Widen(libraries[i].name)).c_str(), available))
+		{
+#if defined(DEBUG) || defined(_DEBUG)
+			printf("Missing material library %s\n", libraries[i].name);
+#endif
+		}
+	}
+
+	// Like most importers, a later definition of the same name wins
+	out.resize(slotCount);
+	for (size_t s = 0; s < slotCount; s++)
+	{
+		out[s].name = slots[s].name;
+		for (size_t m = available.size(); m-- > 0;)
+		{
+			if (available[m].name == slots[s].name)
+			{
+				out[s] = available[m];
+				break;
+			}
+		}
+	}
+}
+
+std::wstring MtlParser::GetDirectory(const wchar_t* file)
+{
+	std::wstring path(file);
+	size_t slash = path.find_last_of(L"/\\");
+	return slash == std::wstring::npos ? std::wstring() : path.substr(0, slash + 1);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+/*
+	Parses .MTL material libraries into material definitions.
+
+	Libraries are tiny next to the objs that use them, so they're just
+	read line by line. Colors, the specular exponent, opacity and the
+	diffuse and normal map file names are kept, everything else is
+	skipped. Options in front of a map's file name (like -bm 1.0) are
+	ignored, and the file name is resolved against the library's folder.
+*/
+class MtlParser
+{
+public:
+	/// <summary>
+	/// Parse a whole library, adding its materials to out. Returns false if it could not be opened
+	/// </summary>
+	static bool ParseFile(const wchar_t* file, std::vector<MaterialDefinition>& out);
+	/// <summary>
+	/// Parse library text that is already in memory. Map paths are prefixed with the directory
+	/// </summary>
+	static void Parse(const char* data, size_t size, const std::wstring& directory, std::vector<MaterialDefinition>& out);
+
+	/// <summary>
+	/// Look up each of a mesh's material slots in its libraries, which
+	/// are found relative to the obj. Slots no library defines get the
+	/// default definition, so out always lines up with the slots
+	/// </summary>
+	static void ResolveMaterials(
+		const wchar_t* objFile,
+		const MaterialName* slots, size_t slotCount,
+		const MaterialName* libraries, size_t libraryCount,
+		std::vector<MaterialDefinition>& out);
+
+	/// <summary>
+	/// Get the folder part of a path, including the trailing slash
+	/// </summary>
+	static std::wstring GetDirectory(const wchar_t* file);
+};
@@ -0,0 +1,640 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "MtlParser.h"
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	// A single "v/t/n" entry of a face line, already converted to 0-based
+	// indices. -1 means the entry was not given in the file
+	struct ObjCorner
+	{
+		int position;
+		int uv;
+		int normal;
+	};
+
+	inline bool operator==(const ObjCorner& a, const ObjCorner& b)
+	{
+		return a.position == b.position && a.uv == b.uv && a.normal == b.normal;
+	}
+
+	// Used to find corners that reference the exact same position/uv/normal
+	// so they can share a single vertex in the output
+	struct ObjCornerHash
+	{
+		size_t operator()(const ObjCorner& c) const
+		{
+			uint64_t h = static_cast<uint32_t>(c.position);
+			h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(c.uv);
+			h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(c.normal);
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+	};
+
+	// A face line, pointing into its chunk's corner list. The attribute
+	// counts are the chunk local counts at the time the face was read,
+	// which is what relative indices are relative to
+	struct ObjFace
+	{
+		unsigned int firstCorner;
+		unsigned int cornerCount;
+		unsigned int positionCount;
+		unsigned int uvCount;
+		unsigned int normalCount;
+		int material;	// Into the chunk's material names, -1 if set by an earlier chunk
+	};
+
+	// A newline aligned slice of the file and everything read from it
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<DirectX::XMFLOAT3> normals;
+		std::vector<DirectX::XMFLOAT2> uvs;
+		std::vector<ObjCorner> corners;
+		std::vector<ObjFace> faces;
+
+		// Every usemtl and mtllib name, in the order first seen
+		std::vector<std::string> materials;
+		std::vector<std::string> libraries;
+
+		// Where this chunk's attributes start in the merged arrays
+		size_t positionBase;
+		size_t uvBase;
+		size_t normalBase;
+	};
+
+	// Exact powers of ten that a double can represent
+	const double powersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+	inline bool IsLineEnd(char c) { return c == '\n' || c == '\r'; }
+
+	inline const char* SkipSpaces(const char* c, const char* end)
+	{
+		while (c < end && IsSpace(*c)) c++;
+		return c;
+	}
+
+	inline const char* SkipLine(const char* c, const char* end)
+	{
+		while (c < end && *c != '\n') c++;
+		return c < end ? c + 1 : end;
+	}
+
+	// Reads the next whitespace separated word on the line
+	inline const char* ParseName(const char* c, const char* end, std::string& out)
+	{
+		c = SkipSpaces(c, end);
+		const char* start = c;
+		while (c < end && !IsSpace(*c) && !IsLineEnd(*c)) c++;
+		out.assign(start, c);
+		return c;
+	}
+
+	// Finds a name in a list, adding it if it isn't there yet
+	unsigned int FindOrAdd(std::vector<std::string>& names, const std::string& name)
+	{
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			if (names[i] == name)
+				return static_cast<unsigned int>(i);
+		}
+
+		names.push_back(name);
+		return static_cast<unsigned int>(names.size() - 1);
+	}
+
+	void CopyName(const std::string& name, MaterialName& out)
+	{
+		size_t length = std::min(name.size(), static_cast<size_t>(MATERIAL_NAME_LENGTH - 1));
+		memcpy(out.name, name.c_str(), length);
+		out.name[length] = '\0';
+	}
+
+	// Parses a decimal float of the form [+-]digits[.digits][(e|E)[+-]digits]
+	// Mantissa digits are gathered into an integer and scaled once at the
+	// end, which keeps the result within an ulp of strtof for obj data
+	const char* ParseFloat(const char* c, const char* end, float& out)
+	{
+		c = SkipSpaces(c, end);
+
+		bool negative = false;
+		if (c < end && (*c == '-' || *c == '+'))
+		{
+			negative = *c == '-';
+			c++;
+		}
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+
+		// Integer part - digits past what fits in the mantissa only shift the exponent
+		for (; c < end && IsDigit(*c); c++)
+		{
+			if (digits < 19) { mantissa = mantissa * 10 + (*c - '0'); if (mantissa) digits++; }
+			else exponent++;
+		}
+
+		// Fractional part
+		if (c < end && *c == '.')
+		{
+			for (c++; c < end && IsDigit(*c); c++)
+			{
+				if (digits < 19) { mantissa = mantissa * 10 + (*c - '0'); if (mantissa) digits++; exponent--; }
+			}
+		}
+
+		// Exponent
+		if (c < end && (*c == 'e' || *c == 'E'))
+		{
+			c++;
+			bool negativeExp = false;
+			if (c < end && (*c == '-' || *c == '+'))
+			{
+				negativeExp = *c == '-';
+				c++;
+			}
+
+			int e = 0;
+			for (; c < end && IsDigit(*c); c++)
+			{
+				if (e < 10000) e = e * 10 + (*c - '0');
+			}
+			exponent += negativeExp ? -e : e;
+		}
+
+		double value = static_cast<double>(mantissa);
+		while (exponent > 22) { value *= 1e22; exponent -= 22; }
+		while (exponent < -22) { value /= 1e22; exponent += 22; }
+		value = exponent < 0 ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+
+		out = static_cast<float>(negative ? -value : value);
+		return c;
+	}
+
+	const char* ParseInt(const char* c, const char* end, int& out)
+	{
+		bool negative = false;
+		if (c < end && (*c == '-' || *c == '+'))
+		{
+			negative = *c == '-';
+			c++;
+		}
+
+		int value = 0;
+		for (; c < end && IsDigit(*c); c++)
+		{
+			value = value * 10 + (*c - '0');
+		}
+
+		out = negative ? -value : value;
+		return c;
+	}
+
+	// OBJ indices are 1-based, and negative values count back from the
+	// most recently declared element. 0 is never valid
+	inline int ResolveIndex(int index, size_t count)
+	{
+		if (index > 0) return index - 1;
+		if (index < 0) return static_cast<int>(count) + index;
+		return -1;
+	}
+
+	// Reads every "v", "v/t", "v//n" or "v/t/n" entry on a face line and
+	// appends them to corners exactly as written in the file. Relative
+	// indices can't be resolved until every chunk's counts are known
+	const char* ParseFace(const char* c, const char* end, std::vector<ObjCorner>& corners)
+	{
+		while (true)
+		{
+			c = SkipSpaces(c, end);
+			if (c >= end || IsLineEnd(*c) || *c == '#' || !(IsDigit(*c) || *c == '-' || *c == '+'))
+				break;
+
+			// 0 is never a valid obj index, so it doubles as "not given"
+			ObjCorner corner = { 0, 0, 0 };
+
+			c = ParseInt(c, end, corner.position);
+
+			if (c < end && *c == '/')
+			{
+				c++;
+				if (c < end && *c != '/')
+					c = ParseInt(c, end, corner.uv);
+
+				if (c < end && *c == '/')
+				{
+					c++;
+					c = ParseInt(c, end, corner.normal);
+				}
+			}
+
+			corners.push_back(corner);
+		}
+
+		return c;
+	}
+
+	// Looks up the data for a single face corner and converts it to a
+	// left-handed space: flip the position and normal Z and flip the V
+	// coordinate since DirectX puts (0,0) in the top left of a texture
+	inline Vertex BuildVertex(
+		const ObjCorner& corner,
+		const std::vector<DirectX::XMFLOAT3>& positions,
+		const std::vector<DirectX::XMFLOAT2>& uvs,
+		const std::vector<DirectX::XMFLOAT3>& normals,
+		const DirectX::XMFLOAT3& faceNormal)
+	{
+		Vertex v = {};
+
+		if (corner.position >= 0 && corner.position < static_cast<int>(positions.size()))
+			v.Position = positions[corner.position];
+
+		if (corner.uv >= 0 && corner.uv < static_cast<int>(uvs.size()))
+			v.UV = uvs[corner.uv];
+
+		v.Normal = (corner.normal >= 0 && corner.normal < static_cast<int>(normals.size())) ?
+			normals[corner.normal] : faceNormal;
+
+		v.UV.y = 1.0f - v.UV.y;
+		v.Position.z *= -1.0f;
+		v.Normal.z *= -1.0f;
+		return v;
+	}
+
+	// Used for corners that have no normal in the file
+	DirectX::XMFLOAT3 CalculateFaceNormal(
+		const ObjCorner* corners,
+		const std::vector<DirectX::XMFLOAT3>& positions)
+	{
+		DirectX::XMFLOAT3 n(0, 0, 0);
+		int count = static_cast<int>(positions.size());
+		if (corners[0].position < 0 || corners[0].position >= count ||
+			corners[1].position < 0 || corners[1].position >= count ||
+			corners[2].position < 0 || corners[2].position >= count)
+			return n;
+
+		const DirectX::XMFLOAT3& p0 = positions[corners[0].position];
+		const DirectX::XMFLOAT3& p1 = positions[corners[1].position];
+		const DirectX::XMFLOAT3& p2 = positions[corners[2].position];
+
+		float ax = p1.x - p0.x, ay = p1.y - p0.y, az = p1.z - p0.z;
+		float bx = p2.x - p0.x, by = p2.y - p0.y, bz = p2.z - p0.z;
+		n.x = ay * bz - az * by;
+		n.y = az * bx - ax * bz;
+		n.z = ax * by - ay * bx;
+
+		float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+		if (length > 0.0f)
+		{
+			n.x /= length;
+			n.y /= length;
+			n.z /= length;
+		}
+		return n;
+	}
+	// Splits the file into roughly equal slices, each pushed forward to
+	// start right after a newline so no line is ever split in two
+	std::vector<ObjChunk> SplitIntoChunks(const char* data, size_t size, size_t chunkCount)
+	{
+		std::vector<ObjChunk> chunks;
+		chunks.reserve(chunkCount);
+
+		const char* end = data + size;
+		const char* begin = data;
+		for (size_t i = 1; i <= chunkCount && begin < end; i++)
+		{
+			const char* split = (i == chunkCount) ? end : SkipLine(data + size / chunkCount * i, end);
+			if (split <= begin)
+				continue;
+
+			ObjChunk chunk = {};
+			chunk.begin = begin;
+			chunk.end = split;
+			chunks.push_back(std::move(chunk));
+			begin = split;
+		}
+
+		return chunks;
+	}
+
+	// Reads every statement in a chunk. Nothing here depends on any other
+	// chunk, so every chunk can be tokenized at the same time
+	void TokenizeChunk(ObjChunk& chunk)
+	{
+		const char* c = chunk.begin;
+		const char* end = chunk.end;
+
+		// Rough guess based on typical line lengths to avoid most regrowth
+		size_t lines = (end - c) / 32;
+		chunk.positions.reserve(lines / 4);
+		chunk.corners.reserve(lines);
+		chunk.faces.reserve(lines / 2);
+		int material = -1;
+		std::string name;
+
+		while (c < end)
+		{
+			c = SkipSpaces(c, end);
+			if (c >= end)
+				break;
+
+			if (c[0] == 'v' && c + 1 < end && IsSpace(c[1]))
+			{
+				DirectX::XMFLOAT3 pos;
+				c = ParseFloat(c + 1, end, pos.x);
+				c = ParseFloat(c, end, pos.y);
+				c = ParseFloat(c, end, pos.z);
+				chunk.positions.push_back(pos);
+			}
+			else if (c[0] == 'v' && c + 2 < end && c[1] == 't' && IsSpace(c[2]))
+			{
+				DirectX::XMFLOAT2 uv;
+				c = ParseFloat(c + 2, end, uv.x);
+				c = ParseFloat(c, end, uv.y);
+				chunk.uvs.push_back(uv);
+			}
+			else if (c[0] == 'v' && c + 2 < end && c[1] == 'n' && IsSpace(c[2]))
+			{
+				DirectX::XMFLOAT3 norm;
+				c = ParseFloat(c + 2, end, norm.x);
+				c = ParseFloat(c, end, norm.y);
+				c = ParseFloat(c, end, norm.z);
+				chunk.normals.push_back(norm);
+			}
+			else if (c[0] == 'f' && c + 1 < end && IsSpace(c[1]))
+			{
+				ObjFace face;
+				face.firstCorner = static_cast<unsigned int>(chunk.corners.size());
+				face.positionCount = static_cast<unsigned int>(chunk.positions.size());
+				face.uvCount = static_cast<unsigned int>(chunk.uvs.size());
+				face.normalCount = static_cast<unsigned int>(chunk.normals.size());
+				face.material = material;
+
+				c = ParseFace(c + 1, end, chunk.corners);
+				face.cornerCount = static_cast<unsigned int>(chunk.corners.size()) - face.firstCorner;
+
+				// Points and lines aren't triangles, so drop them entirely
+				if (face.cornerCount >= 3)
+					chunk.faces.push_back(face);
+				else
+					chunk.corners.resize(face.firstCorner);
+			}
+			else if (end - c > 7 && strncmp(c, "usemtl", 6) == 0 && IsSpace(c[6]))
+			{
+				c = ParseName(c + 6, end, name);
+				material = static_cast<int>(FindOrAdd(chunk.materials, name));
+			}
+			else if (end - c > 7 && strncmp(c, "mtllib", 6) == 0 && IsSpace(c[6]))
+			{
+				// Any number of libraries, though names with spaces aren't supported
+				c = SkipSpaces(c + 6, end);
+				while (c < end && !IsLineEnd(*c) && *c != '#')
+				{
+					c = ParseName(c, end, name);
+					if (!name.empty())
+						FindOrAdd(chunk.libraries, name);
+					c = SkipSpaces(c, end);
+				}
+			}
+
+			// Anything left on the line (extra components, comments,
+			// unsupported statements) is skipped
+			c = SkipLine(c, end);
+		}
+	}
+
+	// Runs work(i) for every chunk, spread across the JobSystem. Loads
+	// already run on MeshLoader's threads, so this shares the workers
+	// rather than starting more. A single chunk stays on this thread
+	template<typename Work>
+	void RunForEachChunk(size_t chunkCount, Work work)
+	{
+		auto runChunks = [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				work(i);
+		};
+		JobSystem::GetInstance().ParallelFor(chunkCount, 1, runChunks);
+	}
+}
+
+bool ObjParser::ParseFile(const wchar_t* file, MeshData& out)
+{
+	MappedFile mapped(file);
+	if (!mapped.IsOpen())
+		return false;
+
+	Parse(mapped.GetData(), mapped.GetSize(), out);
+	MtlParser::ResolveMaterials(
+		file,
+		out.materialSlots.data(), out.materialSlots.size(),
+		out.materialLibraries.data(), out.materialLibraries.size(),
+		out.materials);
+	return true;
+}
+
+void ObjParser::Parse(const char* data, size_t size, MeshData& out, size_t chunkCount)
+{
+	out.vertices.clear();
+	out.indices.clear();
+	out.submeshes.clear();
+	out.materialSlots.clear();
+	out.materialLibraries.clear();
+	out.materials.clear();
+
+	// Small files aren't worth splitting, so they end up as a single
+	// chunk and run the exact same steps on this thread
+	if (chunkCount == 0)
+	{
+		chunkCount = size / OBJ_PARALLEL_MIN_CHUNK_SIZE;
+		size_t threadCount = JobSystem::GetInstance().GetThreadCount();
+		if (chunkCount > threadCount) chunkCount = threadCount;
+		if (chunkCount < 1) chunkCount = 1;
+	}
+
+	std::vector<ObjChunk> chunks = SplitIntoChunks(data, size, chunkCount);
+
+	// 1. Tokenize every chunk independently
+	RunForEachChunk(chunks.size(), [&](size_t i) { TokenizeChunk(chunks[i]); });
+
+	// 2. Prefix sum the per chunk counts so each chunk knows where its
+	//    attributes land in the merged arrays
+	size_t positionCount = 0;
+	size_t uvCount = 0;
+	size_t normalCount = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.positionBase = positionCount;
+		chunk.uvBase = uvCount;
+		chunk.normalBase = normalCount;
+		positionCount += chunk.positions.size();
+		uvCount += chunk.uvs.size();
+		normalCount += chunk.normals.size();
+	}
+
+	std::vector<DirectX::XMFLOAT3> positions(positionCount);
+	std::vector<DirectX::XMFLOAT3> normals(normalCount);
+	std::vector<DirectX::XMFLOAT2> uvs(uvCount);
+
+	// 3. Merge the attributes and turn every corner into a global 0-based index
+	RunForEachChunk(chunks.size(), [&](size_t i)
+	{
+		ObjChunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase);
+		std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + chunk.uvBase);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase);
+
+		for (const ObjFace& face : chunk.faces)
+		{
+			for (unsigned int k = 0; k < face.cornerCount; k++)
+			{
+				ObjCorner& corner = chunk.corners[face.firstCorner + k];
+				corner.position = ResolveIndex(corner.position, chunk.positionBase + face.positionCount);
+				corner.uv = ResolveIndex(corner.uv, chunk.uvBase + face.uvCount);
+				corner.normal = ResolveIndex(corner.normal, chunk.normalBase + face.normalCount);
+			}
+		}
+	});
+
+	// 4. Weld in file order. This stays on one thread so vertices are
+	//    numbered exactly as a single front to back pass would number them.
+	//    Triangles are sorted into one list per material as they go, and
+	//    a material set in one chunk carries on into the next
+	std::unordered_map<ObjCorner, unsigned int, ObjCornerHash> cornerToVertex;
+	cornerToVertex.reserve(size / 64);
+	std::vector<unsigned int> faceVertices;
+
+	std::vector<std::string> slotNames;
+	std::vector<std::string> libraryNames;
+	std::vector<std::vector<unsigned int>> slotIndices;
+	std::vector<int> chunkToSlot;
+	int slot = -1;
+	std::string activeName;
+
+	for (const ObjChunk& chunk : chunks)
+	{
+		for (const std::string& library : chunk.libraries)
+			FindOrAdd(libraryNames, library);
+
+		// Slots are only made once a face uses them, so unused materials don't get one
+		chunkToSlot.assign(chunk.materials.size(), -1);
+
+		for (const ObjFace& face : chunk.faces)
+		{
+			if (face.material >= 0)
+			{
+				int& mapped = chunkToSlot[face.material];
+				if (mapped < 0)
+					mapped = static_cast<int>(FindOrAdd(slotNames, chunk.materials[face.material]));
+				slot = mapped;
+			}
+			else if (slot < 0)
+			{
+				// Faces before any usemtl get an unnamed slot
+				slot = static_cast<int>(FindOrAdd(slotNames, activeName));
+			}
+
+			if (slotIndices.size() < slotNames.size())
+				slotIndices.resize(slotNames.size());
+			std::vector<unsigned int>& indices = slotIndices[slot];
+
+			const ObjCorner* corners = &chunk.corners[face.firstCorner];
+
+			// Only needed when a corner is missing its normal
+			DirectX::XMFLOAT3 faceNormal(0, 0, 0);
+			for (unsigned int k = 0; k < face.cornerCount; k++)
+			{
+				if (corners[k].normal < 0)
+				{
+					faceNormal = CalculateFaceNormal(corners, positions);
+					break;
+				}
+			}
+
+			// Find or create the vertex for each corner of the face
+			faceVertices.clear();
+			for (unsigned int k = 0; k < face.cornerCount; k++)
+			{
+				const ObjCorner& corner = corners[k];
+
+				// Corners without a normal use this face's normal, so they can't be shared
+				if (corner.normal < 0)
+				{
+					faceVertices.push_back(static_cast<unsigned int>(out.vertices.size()));
+					out.vertices.push_back(BuildVertex(corner, positions, uvs, normals, faceNormal));
+					continue;
+				}
+
+				auto found = cornerToVertex.find(corner);
+				if (found == cornerToVertex.end())
+				{
+					unsigned int index = static_cast<unsigned int>(out.vertices.size());
+					out.vertices.push_back(BuildVertex(corner, positions, uvs, normals, faceNormal));
+					found = cornerToVertex.emplace(corner, index).first;
+				}
+				faceVertices.push_back(found->second);
+			}
+
+			// Triangulate as a fan, flipping the winding order as we go
+			// (for a quad this matches the old 1-3-2, 1-4-3 split)
+			for (size_t k = 1; k + 1 < faceVertices.size(); k++)
+			{
+				indices.push_back(faceVertices[0]);
+				indices.push_back(faceVertices[k + 1]);
+				indices.push_back(faceVertices[k]);
+			}
+		}
+	}
+
+	for (const std::string& library : libraryNames)
+	{
+		MaterialName libraryName;
+		CopyName(library, libraryName);
+		out.materialLibraries.push_back(libraryName);
+	}
+
+	// A file without any usemtl is one material with nothing to look up
+	if (slotIndices.size() == 1 && slotNames[0].empty())
+	{
+		out.indices.swap(slotIndices[0]);
+		return;
+	}
+
+	// 5. One index buffer, with a submesh for each material's range
+	size_t indexCount = 0;
+	for (const std::vector<unsigned int>& indices : slotIndices)
+		indexCount += indices.size();
+	out.indices.reserve(indexCount);
+
+	for (size_t s = 0; s < slotIndices.size(); s++)
+	{
+		Submesh submesh;
+		submesh.indexStart = static_cast<unsigned int>(out.indices.size());
+		submesh.indexCount = static_cast<unsigned int>(slotIndices[s].size());
+		submesh.material = static_cast<unsigned int>(s);
+		out.indices.insert(out.indices.end(), slotIndices[s].begin(), slotIndices[s].end());
+		out.submeshes.push_back(submesh);
+
+		MaterialName slotName;
+		CopyName(slotNames[s], slotName);
+		out.materialSlots.push_back(slotName);
+	}
+}
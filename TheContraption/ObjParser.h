@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include "MeshData.h"
+
+// Files are only split across threads in slices at least this big,
+// below that the extra merging costs more than it saves
+#define OBJ_PARALLEL_MIN_CHUNK_SIZE (1 << 20)
+
+/*
+	Parses .OBJ files into vertex and index arrays without touching D3D.
+
+	The file is memory mapped and walked once with hand written number
+	parsing, so there are no line length limits and no per line sscanf.
+	Supports positions, uvs and normals, faces with any number of sides
+	(triangulated as a fan) and negative (relative) indices.
+
+	Face corners that reference the same position/uv/normal triplet are
+	welded into a single vertex, so the index buffer actually shares
+	vertices between neighboring triangles.
+
+	Large files are split into newline aligned chunks that are tokenized
+	in parallel on the JobSystem. Per chunk attribute counts are prefix
+	summed so face indices still resolve globally, and welding runs in
+	file order so the result is identical no matter how many chunks or
+	threads were used.
+
+	Each usemtl starts a material slot. Triangles are grouped by slot
+	into one index buffer with a submesh per slot, and ParseFile looks
+	the slots up in the file's mtllib libraries.
+
+	Like the original loader the output is converted to a left-handed
+	space: Z is flipped, V is flipped and the winding order is reversed.
+*/
+class ObjParser
+{
+public:
+	/// <summary>
+	/// Parse an entire obj file into out. Returns false if the file could not be opened
+	/// </summary>
+	static bool ParseFile(const wchar_t* file, MeshData& out);
+	/// <summary>
+	/// Parse obj text that is already in memory. Splits it into chunkCount
+	/// chunks, or picks a count from its size and the thread count if 0
+	/// </summary>
+	static void Parse(const char* data, size_t size, MeshData& out, size_t chunkCount = 0);
+};
@@ -0,0 +1,273 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+	const int TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+	const int TILES_Y = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+	const int BLOCKS_X = OCCLUSION_WIDTH / OCCLUSION_BLOCK_SIZE;
+	const int BLOCKS_Y = OCCLUSION_HEIGHT / OCCLUSION_BLOCK_SIZE;
+
+	// Clip space to pixels, with y flipped to run down the screen
+	inline float ToPixelX(float ndcX) { return (ndcX * 0.5f + 0.5f) * OCCLUSION_WIDTH; }
+	inline float ToPixelY(float ndcY) { return (0.5f - ndcY * 0.5f) * OCCLUSION_HEIGHT; }
+
+	// Clamped before converting, since corners close to the camera's
+	// plane can project far beyond what an int holds
+	inline int FloorClamped(float value, int low, int high)
+	{
+		return (int)std::floor(std::min(std::max(value, (float)low), (float)high));
+	}
+}
+
+OcclusionCuller::OcclusionCuller() :
+	bins(TILES_X * TILES_Y),
+	depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f),
+	blockDepth(BLOCKS_X * BLOCKS_Y, 1.0f)
+{
+	XMStoreFloat4x4(&viewProj, XMMatrixIdentity());
+}
+
+void OcclusionCuller::Begin(const XMFLOAT4X4& nextViewProj)
+{
+	viewProj = nextViewProj;
+	triangles.clear();
+	for (std::vector<unsigned int>& bin : bins)
+		bin.clear();
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* corners, size_t cornerCount, const XMFLOAT4X4& world)
+{
+	XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProj));
+
+	for (size_t c = 0; c + 3 <= cornerCount; c += 3)
+	{
+		XMFLOAT4 clip[3];
+		bool crossesNear = false;
+		for (int v = 0; v < 3; v++)
+		{
+			XMStoreFloat4(&clip[v], XMVector3Transform(XMLoadFloat3(&corners[c + v]), worldViewProj));
+			crossesNear |= clip[v].z < 0.0f;
+		}
+
+		// Clipping would make new triangles, and leaving it out only hides less
+		if (crossesNear)
+			continue;
+
+		ScreenTriangle triangle;
+		for (int v = 0; v < 3; v++)
+		{
+			float reciprocalW = 1.0f / clip[v].w;
+			triangle.x[v] = ToPixelX(clip[v].x * reciprocalW);
+			triangle.y[v] = ToPixelY(clip[v].y * reciprocalW);
+			triangle.z[v] = clip[v].z * reciprocalW;
+		}
+
+		// Both sides are drawn, so back faces are just turned around
+		float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+			(triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+		if (area == 0.0f)
+			continue;
+		if (area < 0.0f)
+		{
+			std::swap(triangle.x[1], triangle.x[2]);
+			std::swap(triangle.y[1], triangle.y[2]);
+			std::swap(triangle.z[1], triangle.z[2]);
+		}
+
+		float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		float minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+		float maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+		if (maxX < 0.0f || maxY < 0.0f || minX >= OCCLUSION_WIDTH || minY >= OCCLUSION_HEIGHT)
+			continue;
+
+		int tileLeft = FloorClamped(minX, 0, OCCLUSION_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+		int tileRight = FloorClamped(maxX, 0, OCCLUSION_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+		int tileTop = FloorClamped(minY, 0, OCCLUSION_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+		int tileBottom = FloorClamped(maxY, 0, OCCLUSION_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+
+		unsigned int index = (unsigned int)triangles.size();
+		triangles.push_back(triangle);
+		for (int ty = tileTop; ty <= tileBottom; ty++)
+		{
+			for (int tx = tileLeft; tx <= tileRight; tx++)
+				bins[ty * TILES_X + tx].push_back(index);
+		}
+	}
+}
+
+void OcclusionCuller::Rasterize()
+{
+	// Tiles share no pixels or blocks, so they need no locking
+	auto rasterizeTiles = [&](size_t begin, size_t end)
+	{
+		for (size_t tile = begin; tile < end; tile++)
+			RasterizeTile((unsigned int)tile);
+	};
+	JobSystem::GetInstance().ParallelFor(bins.size(), 1, rasterizeTiles);
+}
+
+void OcclusionCuller::RasterizeTile(unsigned int tile)
+{
+	int left = (tile % TILES_X) * OCCLUSION_TILE_WIDTH;
+	int top = (tile / TILES_X) * OCCLUSION_TILE_HEIGHT;
+	int right = left + OCCLUSION_TILE_WIDTH;
+	int bottom = top + OCCLUSION_TILE_HEIGHT;
+
+	for (int y = top; y < bottom; y++)
+		std::fill(&depth[y * OCCLUSION_WIDTH + left], &depth[y * OCCLUSION_WIDTH + right], 1.0f);
+
+	for (unsigned int index : bins[tile])
+		RasterizeTriangle(triangles[index], left, top, right, bottom);
+
+	// Then the farthest depth of each block, which is what boxes are tested against
+	for (int blockY = top / OCCLUSION_BLOCK_SIZE; blockY < bottom / OCCLUSION_BLOCK_SIZE; blockY++)
+	{
+		for (int blockX = left / OCCLUSION_BLOCK_SIZE; blockX < right / OCCLUSION_BLOCK_SIZE; blockX++)
+		{
+			__m128 farthest = _mm_setzero_ps();
+			for (int y = blockY * OCCLUSION_BLOCK_SIZE; y < (blockY + 1) * OCCLUSION_BLOCK_SIZE; y++)
+			{
+				const float* row = &depth[y * OCCLUSION_WIDTH + blockX * OCCLUSION_BLOCK_SIZE];
+				for (int x = 0; x < OCCLUSION_BLOCK_SIZE; x += 4)
+					farthest = _mm_max_ps(farthest, _mm_loadu_ps(row + x));
+			}
+
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+			_mm_store_ss(&blockDepth[blockY * BLOCKS_X + blockX], farthest);
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& t, int left, int top, int right, int bottom)
+{
+	// Only the pixels of this tile the triangle's bounds cover, in whole
+	// groups of four. Pixels are sampled at their centers
+	float minX = std::min(t.x[0], std::min(t.x[1], t.x[2]));
+	float maxX = std::max(t.x[0], std::max(t.x[1], t.x[2]));
+	float minY = std::min(t.y[0], std::min(t.y[1], t.y[2]));
+	float maxY = std::max(t.y[0], std::max(t.y[1], t.y[2]));
+	int startX = FloorClamped(minX, left, right) & ~3;
+	int endX = std::min(right, FloorClamped(maxX, left, right) + 1);
+	int startY = FloorClamped(minY, top, bottom);
+	int endY = std::min(bottom, FloorClamped(maxY, top, bottom) + 1);
+	if (startX >= endX || startY >= endY)
+		return;
+
+	// Edge e runs from corner e to the next one, and is positive on the
+	// inside. The edge opposite a corner, over the area, weighs that corner
+	float edgeX[3], edgeY[3];
+	for (int e = 0; e < 3; e++)
+	{
+		int next = (e + 1) % 3;
+		edgeX[e] = t.y[e] - t.y[next];
+		edgeY[e] = t.x[next] - t.x[e];
+	}
+	float area = edgeY[0] * (t.y[2] - t.y[0]) + edgeX[0] * (t.x[2] - t.x[0]);
+
+	// Depth is linear across the screen, so it's a plane through the corners
+	float depthX = (edgeX[1] * t.z[0] + edgeX[2] * t.z[1] + edgeX[0] * t.z[2]) / area;
+	float depthY = (edgeY[1] * t.z[0] + edgeY[2] * t.z[1] + edgeY[0] * t.z[2]) / area;
+
+	__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 zero = _mm_setzero_ps();
+	__m128 edgeX0 = _mm_set1_ps(edgeX[0]);
+	__m128 edgeX1 = _mm_set1_ps(edgeX[1]);
+	__m128 edgeX2 = _mm_set1_ps(edgeX[2]);
+	__m128 slopeX = _mm_set1_ps(depthX);
+
+	for (int y = startY; y < endY; y++)
+	{
+		float centerY = y + 0.5f;
+		__m128 row0 = _mm_set1_ps(edgeY[0] * (centerY - t.y[0]) - edgeX[0] * t.x[0]);
+		__m128 row1 = _mm_set1_ps(edgeY[1] * (centerY - t.y[1]) - edgeX[1] * t.x[1]);
+		__m128 row2 = _mm_set1_ps(edgeY[2] * (centerY - t.y[2]) - edgeX[2] * t.x[2]);
+		__m128 rowDepth = _mm_set1_ps(t.z[0] + depthY * (centerY - t.y[0]) - depthX * t.x[0]);
+
+		float* pixels = &depth[y * OCCLUSION_WIDTH];
+		for (int x = startX; x < endX; x += 4)
+		{
+			__m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+			__m128 inside = _mm_and_ps(_mm_and_ps(
+				_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX0, centerX), row0), zero),
+				_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX1, centerX), row1), zero)),
+				_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX2, centerX), row2), zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			// Keep the nearer depth, only where the triangle covers the pixel
+			__m128 stored = _mm_loadu_ps(pixels + x);
+			__m128 nearest = _mm_min_ps(stored, _mm_add_ps(_mm_mul_ps(slopeX, centerX), rowDepth));
+			_mm_storeu_ps(pixels + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, stored)));
+		}
+	}
+}
+
+bool OcclusionCuller::IsBoxVisible(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax) const
+{
+	// Each corner is a sum of one pick per axis of the matrix's scaled rows
+	XMMATRIX m = XMLoadFloat4x4(&viewProj);
+	XMVECTOR axisX[2] = { XMVectorScale(m.r[0], boxMin.x), XMVectorScale(m.r[0], boxMax.x) };
+	XMVECTOR axisY[2] = { XMVectorScale(m.r[1], boxMin.y), XMVectorScale(m.r[1], boxMax.y) };
+	XMVECTOR axisZ[2] = { XMVectorAdd(XMVectorScale(m.r[2], boxMin.z), m.r[3]), XMVectorAdd(XMVectorScale(m.r[2], boxMax.z), m.r[3]) };
+
+	float minX = FLT_MAX, maxX = -FLT_MAX;
+	float minY = FLT_MAX, maxY = -FLT_MAX;
+	float nearest = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVectorAdd(XMVectorAdd(axisX[corner & 1], axisY[(corner >> 1) & 1]), axisZ[corner >> 2]));
+
+		// Reaching past the near plane, the box could be covering the whole view
+		if (clip.z < 0.0f)
+			return true;
+
+		float reciprocalW = 1.0f / clip.w;
+		float x = ToPixelX(clip.x * reciprocalW);
+		float y = ToPixelY(clip.y * reciprocalW);
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * reciprocalW);
+	}
+
+	// Off screen is for the frustum to decide
+	if (maxX < 0.0f || maxY < 0.0f || minX >= OCCLUSION_WIDTH || minY >= OCCLUSION_HEIGHT)
+		return true;
+
+	int blockLeft = FloorClamped(minX, 0, OCCLUSION_WIDTH - 1) / OCCLUSION_BLOCK_SIZE;
+	int blockRight = FloorClamped(maxX, 0, OCCLUSION_WIDTH - 1) / OCCLUSION_BLOCK_SIZE;
+	int blockTop = FloorClamped(minY, 0, OCCLUSION_HEIGHT - 1) / OCCLUSION_BLOCK_SIZE;
+	int blockBottom = FloorClamped(maxY, 0, OCCLUSION_HEIGHT - 1) / OCCLUSION_BLOCK_SIZE;
+	for (int by = blockTop; by <= blockBottom; by++)
+	{
+		for (int bx = blockLeft; bx <= blockRight; bx++)
+		{
+			if (blockDepth[by * BLOCKS_X + bx] >= nearest)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+const float* OcclusionCuller::GetDepth() const
+{
+	return depth.data();
+}
+
+size_t OcclusionCuller::GetTriangleCount() const
+{
+	return triangles.size();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <DirectXMath.h>
+
+// Size in pixels of the depth buffer occluders are drawn into. Small
+// enough to rasterize on the CPU, and a whole number of tiles
+#define OCCLUSION_WIDTH 320
+#define OCCLUSION_HEIGHT 192
+// Pixels per screen tile, each rasterized as its own job. The
+// width is a multiple of four so rows split into whole SSE groups
+#define OCCLUSION_TILE_WIDTH 64
+#define OCCLUSION_TILE_HEIGHT 32
+// Pixels per side of the blocks that boxes are tested against
+#define OCCLUSION_BLOCK_SIZE 8
+
+/*
+	Hides things behind big solid occluders, entirely on the CPU.
+
+	Occluder triangles are projected and binned into the screen tiles
+	they overlap. Each tile then runs as a job that rasterizes its bin
+	into a small depth buffer, four pixels at a time with SSE, and keeps
+	the farthest depth in each of its blocks. A box is hidden when its
+	nearest point is farther away than that in every block it covers.
+
+	Every shortcut errs towards visible. Occluder triangles that cross the
+	near plane are left out, and boxes that cross it are never hidden.
+	Depths are D3D's, 0 at the near plane and 1 at the far one.
+*/
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	/// <summary>
+	/// Forget the last view's occluders and start a new one
+	/// </summary>
+	void Begin(const DirectX::XMFLOAT4X4& viewProj);
+	/// <summary>
+	/// Add local space triangles, three corners each, placed by a world matrix
+	/// </summary>
+	void AddOccluder(const DirectX::XMFLOAT3* corners, size_t cornerCount, const DirectX::XMFLOAT4X4& world);
+	/// <summary>
+	/// Draw every occluder added since Begin() into the depth buffer,
+	/// spreading the tiles across the JobSystem
+	/// </summary>
+	void Rasterize();
+
+	/// <summary>
+	/// False only if the world space box is entirely behind what was rasterized
+	/// </summary>
+	bool IsBoxVisible(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax) const;
+
+	/// <summary>
+	/// Get the rasterized depths, OCCLUSION_WIDTH per row from the top left
+	/// </summary>
+	const float* GetDepth() const;
+	/// <summary>
+	/// Get how many occluder triangles made it onto the screen since Begin()
+	/// </summary>
+	size_t GetTriangleCount() const;
+
+private:
+	// A projected triangle in pixels, y down, wound so its area is positive
+	struct ScreenTriangle
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+	};
+
+	void RasterizeTile(unsigned int tile);
+	void RasterizeTriangle(const ScreenTriangle& triangle, int left, int top, int right, int bottom);
+
+	DirectX::XMFLOAT4X4 viewProj;
+	std::vector<ScreenTriangle> triangles;
+	// Per tile, the triangles that overlap it. Kept between views to reuse their allocations
+	std::vector<std::vector<unsigned int>> bins;
+
+	std::vector<float> depth;
+	// Per block, the farthest depth of any of its pixels
+	std::vector<float> blockDepth;
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Objects per block of a pool's storage. Blocks are never moved or freed,
+// so pointers to pooled objects stay valid until they're destroyed
+#define POOL_BLOCK_SIZE 256
+// Index of handles that don't refer to anything
+#define POOL_INVALID_INDEX 0xFFFFFFFFu
+
+/*
+	Refers to an object in a Pool without owning it. Every slot counts how
+	many times it has been freed, and a handle remembers that count, so a
+	handle to a destroyed object never finds whatever reuses its slot.
+*/
+template<typename T>
+struct PoolHandle
+{
+	unsigned int index;
+	unsigned int generation;
+
+	PoolHandle() : index(POOL_INVALID_INDEX), generation(0) {}
+	PoolHandle(unsigned int index, unsigned int generation) : index(index), generation(generation) {}
+
+	bool operator==(const PoolHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const PoolHandle& other) const { return !(*this == other); }
+};
+
+/*
+	Owns objects of one type in blocks of POOL_BLOCK_SIZE, reusing the
+	slots of destroyed ones. Once the pool has grown to the most objects
+	it has held at once, creating and destroying them never touches the
+	heap.
+
+	Live objects are also listed densely, so they can be walked with
+	GetCount() and GetAt() without chasing handles. Destroying one moves
+	the last into its place, so that order isn't stable.
+*/
+template<typename T>
+class Pool
+{
+public:
+	Pool() : count(0) {}
+
+	~Pool()
+	{
+		while (count > 0)
+			Destroy(GetHandleAt(count - 1));
+	}
+
+	// Objects are owned in place, so a pool can't be copied
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+
+	/// <summary>
+	/// Construct a new object from the given arguments
+	/// </summary>
+	template<typename... Args>
+	PoolHandle<T> Create(Args&&... args)
+	{
+		if (freeSlots.empty())
+			Grow();
+
+		unsigned int slot = freeSlots.back();
+		freeSlots.pop_back();
+		new (Address(slot)) T(std::forward<Args>(args)...);
+
+		denseSlots[count] = slot;
+		slotDense[slot] = count;
+		count++;
+		return PoolHandle<T>(slot, generations[slot]);
+	}
+
+	/// <summary>
+	/// Destroy an object. Stale handles are ignored
+	/// </summary>
+	void Destroy(PoolHandle<T> handle)
+	{
+		T* object = Get(handle);
+		if (!object)
+			return;
+
+		object->~T();
+		generations[handle.index]++;
+
+		// Keep the live list packed by moving the last object's entry here
+		unsigned int dense = slotDense[handle.index];
+		unsigned int last = denseSlots[count - 1];
+		denseSlots[dense] = last;
+		slotDense[last] = dense;
+		slotDense[handle.index] = POOL_INVALID_INDEX;
+		count--;
+
+		freeSlots.push_back(handle.index);
+	}
+
+	/// <summary>
+	/// Get the object a handle refers to, or null if it's been destroyed
+	/// </summary>
+	T* Get(PoolHandle<T> handle)
+	{
+		if (handle.index >= generations.size() || generations[handle.index] != handle.generation ||
+			slotDense[handle.index] == POOL_INVALID_INDEX)
+			return nullptr;
+
+		return Address(handle.index);
+	}
+
+	/// <summary>
+	/// Get how many objects are alive
+	/// </summary>
+	unsigned int GetCount() { return count; }
+	/// <summary>
+	/// Get one of the live objects, from 0 to GetCount()
+	/// </summary>
+	T& GetAt(unsigned int i) { return *Address(denseSlots[i]); }
+	/// <summary>
+	/// Get the handle of one of the live objects, from 0 to GetCount()
+	/// </summary>
+	PoolHandle<T> GetHandleAt(unsigned int i) { return PoolHandle<T>(denseSlots[i], generations[denseSlots[i]]); }
+
+private:
+	typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+	T* Address(unsigned int slot)
+	{
+		return reinterpret_cast<T*>(&blocks[slot / POOL_BLOCK_SIZE][slot % POOL_BLOCK_SIZE]);
+	}
+
+	// Add a block, along with room for every list to cover it
+	void Grow()
+	{
+		unsigned int first = (unsigned int)generations.size();
+		blocks.push_back(std::unique_ptr<Storage[]>(new Storage[POOL_BLOCK_SIZE]));
+		generations.resize(first + POOL_BLOCK_SIZE, 0);
+		slotDense.resize(first + POOL_BLOCK_SIZE, POOL_INVALID_INDEX);
+		denseSlots.resize(first + POOL_BLOCK_SIZE, POOL_INVALID_INDEX);
+		freeSlots.reserve(first + POOL_BLOCK_SIZE);
+
+		// Backwards, so the lowest slots are handed out first
+		for (unsigned int slot = first + POOL_BLOCK_SIZE; slot > first; slot--)
+			freeSlots.push_back(slot - 1);
+	}
+
+	std::vector<std::unique_ptr<Storage[]>> blocks;
+	std::vector<unsigned int> generations;	// Per slot, bumped when its object is destroyed
+	std::vector<unsigned int> slotDense;	// Per slot, its place in denseSlots or POOL_INVALID_INDEX
+	std::vector<unsigned int> denseSlots;	// Slots of the live objects, packed
+	std::vector<unsigned int> freeSlots;
+	unsigned int count;
+};
@@ -0,0 +1,126 @@
+#include "RangeAllocator.h"
+
+RangeAllocator::RangeAllocator(unsigned int capacity) :
+	capacity(0), used(0)
+{
+	Reset(capacity);
+}
+
+unsigned int RangeAllocator::Allocate(unsigned int size)
+{
+	if (size == 0)
+		return RANGE_ALLOCATOR_INVALID;
+
+	// Smallest free range that fits, lowest offset on ties
+	std::map<unsigned int, unsigned int>::iterator best = freeRanges.end();
+	for (std::map<unsigned int, unsigned int>::iterator it = freeRanges.begin(); it != freeRanges.end(); ++it)
+	{
+		if (it->second >= size && (best == freeRanges.end() || it->second < best->second))
+		{
+			best = it;
+			if (best->second == size)
+				break;
+		}
+	}
+
+	if (best == freeRanges.end())
+		return RANGE_ALLOCATOR_INVALID;
+
+	// Take the front of the range and keep whatever is left
+	unsigned int offset = best->first;
+	unsigned int remaining = best->second - size;
+	freeRanges.erase(best);
+	if (remaining > 0)
+		freeRanges[offset + size] = remaining;
+
+	used += size;
+	return offset;
+}
+
+void RangeAllocator::Free(unsigned int offset, unsigned int size)
+{
+	if (size == 0 || offset == RANGE_ALLOCATOR_INVALID)
+		return;
+
+	used -= size;
+
+	// Merge with the free range right after this one
+	std::map<unsigned int, unsigned int>::iterator next = freeRanges.lower_bound(offset);
+	if (next != freeRanges.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = freeRanges.erase(next);
+	}
+
+	// And with the one right before it
+	if (next != freeRanges.begin())
+	{
+		std::map<unsigned int, unsigned int>::iterator previous = next;
+		--previous;
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+
+	freeRanges[offset] = size;
+}
+
+void RangeAllocator::Grow(unsigned int newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+
+	// The new space is just one more free range at the end. Freeing
+	// it merges it with a free range that already runs to the end
+	unsigned int added = newCapacity - capacity;
+	unsigned int oldCapacity = capacity;
+	capacity = newCapacity;
+	used += added;
+	Free(oldCapacity, added);
+}
+
+void RangeAllocator::Reset(unsigned int newCapacity)
+{
+	freeRanges.clear();
+	capacity = newCapacity;
+	used = 0;
+	if (capacity > 0)
+		freeRanges[0] = capacity;
+}
+
+unsigned int RangeAllocator::GetCapacity()
+{
+	return capacity;
+}
+
+unsigned int RangeAllocator::GetUsed()
+{
+	return used;
+}
+
+unsigned int RangeAllocator::GetFreeRangeCount()
+{
+	return (unsigned int)freeRanges.size();
+}
+
+unsigned int RangeAllocator::GetLargestFreeRange()
+{
+	unsigned int largest = 0;
+	for (std::map<unsigned int, unsigned int>::iterator it = freeRanges.begin(); it != freeRanges.end(); ++it)
+	{
+		if (it->second > largest)
+			largest = it->second;
+	}
+	return largest;
+}
+
+float RangeAllocator::GetFragmentation()
+{
+	unsigned int free = capacity - used;
+	if (free == 0)
+		return 0.0f;
+
+	return 1.0f - (float)GetLargestFreeRange() / (float)free;
+}
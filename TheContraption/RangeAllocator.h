@@ -0,0 +1,55 @@
+#pragma once
+
+#include <map>
+
+// Returned when an allocation doesn't fit
+#define RANGE_ALLOCATOR_INVALID 0xFFFFFFFFu
+
+/*
+	Hands out ranges of some linear space, like the elements of a big
+	GPU buffer. It only does the bookkeeping, so it needs no device.
+
+	Free ranges are kept sorted by offset and merged with their
+	neighbors when freed. Allocation is best fit, which leaves the
+	large free ranges alone for as long as possible.
+*/
+class RangeAllocator
+{
+public:
+	RangeAllocator(unsigned int capacity = 0);
+
+	/// <summary>
+	/// Reserve a range of the given size. Returns its offset, or
+	/// RANGE_ALLOCATOR_INVALID if no free range is big enough
+	/// </summary>
+	unsigned int Allocate(unsigned int size);
+	/// <summary>
+	/// Give back a range from Allocate
+	/// </summary>
+	void Free(unsigned int offset, unsigned int size);
+	/// <summary>
+	/// Make the space bigger. Everything already allocated stays put
+	/// </summary>
+	void Grow(unsigned int newCapacity);
+	/// <summary>
+	/// Forget every allocation and start over with the given capacity
+	/// </summary>
+	void Reset(unsigned int newCapacity);
+
+	unsigned int GetCapacity();
+	unsigned int GetUsed();
+	unsigned int GetFreeRangeCount();
+	unsigned int GetLargestFreeRange();
+
+	/// <summary>
+	/// How broken up the free space is, from 0 (all in one range) to
+	/// nearly 1 (spread over many small ranges)
+	/// </summary>
+	float GetFragmentation();
+
+private:
+	// Offset to size of every free range
+	std::map<unsigned int, unsigned int> freeRanges;
+	unsigned int capacity;
+	unsigned int used;
+};
@@ -0,0 +1,149 @@
+#include "RenderQueue.h"
+#include "Entity.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// Key field widths. Shader programs are a vertex and a pixel shader id side by side
+	const unsigned int SHADER_ID_BITS = 7;
+	const unsigned int MATERIAL_ID_BITS = 16;
+	const unsigned int MESH_ID_BITS = 16;
+	const unsigned int DEPTH_BITS = 16;
+	const uint64_t DEPTH_MAX = (1ull << DEPTH_BITS) - 1;
+	const unsigned int RADIX_BUCKETS = 1 << RENDER_QUEUE_RADIX_BITS;
+}
+
+RenderQueue::RenderQueue() :
+	cameraPosition(0, 0, 0), cameraForward(0, 0, 1), farClip(1.0f),
+	nextShaderId(0), nextMaterialId(0), nextMeshId(0)
+{
+}
+
+void RenderQueue::Begin(const XMFLOAT3& position, const XMFLOAT3& forward, float far)
+{
+	cameraPosition = position;
+	cameraForward = forward;
+	farClip = far;
+	packets.clear();
+
+	// Ids are never given back, so once any field runs out they all start
+	// over. That also keeps the map from growing forever, since it holds on
+	// to the addresses of destroyed objects until then. Something allocated
+	// at one of those meanwhile just inherits its id
+	if (nextShaderId >= (1u << SHADER_ID_BITS) || nextMaterialId >= (1u << MATERIAL_ID_BITS) || nextMeshId >= (1u << MESH_ID_BITS))
+	{
+		ids.clear();
+		nextShaderId = 0;
+		nextMaterialId = 0;
+		nextMeshId = 0;
+	}
+}
+
+void RenderQueue::Add(Entity* entity)
+{
+	// Sorted by the center of the bounds, so every packet of an entity has the same depth
+	const WorldBounds& bounds = entity->GetWorldBounds();
+	XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&bounds.sphereCenter), XMLoadFloat3(&cameraPosition));
+	float depth = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&cameraForward))) / farClip;
+
+	Mesh* model = entity->GetModel().get();
+	if (model->IsReady() && model->GetSubmeshCount() > 1)
+	{
+		for (unsigned int i = 0; i < model->GetSubmeshCount(); i++)
+			AddPacket(entity, entity->GetSubmeshMat(model->GetSubmesh(i).material).get(), i, model, depth);
+		return;
+	}
+
+	AddPacket(entity, entity->GetMat().get(), RENDER_QUEUE_WHOLE_MESH, model, depth);
+}
+
+void RenderQueue::AddPacket(Entity* entity, Material* material, unsigned int submesh, const void* mesh, float depth)
+{
+	DrawPacket packet;
+	packet.entity = entity;
+	packet.material = material;
+	packet.vertexShader = material->GetVertexShader().get();
+	packet.pixelShader = material->GetPixelShader().get();
+	packet.submesh = submesh;
+	packet.pass = material->IsTransparent() ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE;
+
+	uint64_t program =
+		(uint64_t)GetId(packet.vertexShader, nextShaderId, SHADER_ID_BITS) << SHADER_ID_BITS |
+		GetId(packet.pixelShader, nextShaderId, SHADER_ID_BITS);
+	uint64_t materialId = GetId(material, nextMaterialId, MATERIAL_ID_BITS);
+	uint64_t meshId = GetId(mesh, nextMeshId, MESH_ID_BITS);
+	uint64_t quantizedDepth = (uint64_t)(std::min(std::max(depth, 0.0f), 1.0f) * DEPTH_MAX);
+
+	// Pass takes the top two bits, then the rest is laid out per pass
+	uint64_t key = (uint64_t)packet.pass << 62;
+	if (packet.pass == RENDER_PASS_OPAQUE)
+		key |= program << 48 | materialId << 32 | meshId << 16 | quantizedDepth;
+	else
+		key |= (DEPTH_MAX - quantizedDepth) << 46 | program << 32 | materialId << 16 | meshId;
+	packet.key = key;
+
+	packets.push_back(packet);
+}
+
+unsigned int RenderQueue::GetId(const void* object, unsigned int& nextId, unsigned int bits)
+{
+	// Ids that wrap within a frame, before Begin() can start over, only
+	// cost some grouping, never correctness
+	std::unordered_map<const void*, unsigned int>::iterator found = ids.find(object);
+	if (found != ids.end())
+		return found->second;
+
+	unsigned int id = nextId++ & ((1u << bits) - 1);
+	ids[object] = id;
+	return id;
+}
+
+void RenderQueue::Sort()
+{
+	size_t count = packets.size();
+	order.resize(count);
+	scratch.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		order[i].key = packets[i].key;
+		order[i].packet = (unsigned int)i;
+	}
+
+	// Lowest digit first. Each pass is stable, so the order the
+	// earlier digits set survives wherever the later ones tie
+	for (unsigned int shift = 0; shift < 64; shift += RENDER_QUEUE_RADIX_BITS)
+	{
+		size_t counts[RADIX_BUCKETS] = {};
+		for (size_t i = 0; i < count; i++)
+			counts[(order[i].key >> shift) & (RADIX_BUCKETS - 1)]++;
+
+		// A digit every key shares wouldn't move anything
+		if (count == 0 || counts[(order[0].key >> shift) & (RADIX_BUCKETS - 1)] == count)
+			continue;
+
+		size_t offset = 0;
+		for (unsigned int bucket = 0; bucket < RADIX_BUCKETS; bucket++)
+		{
+			size_t bucketCount = counts[bucket];
+			counts[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			scratch[counts[(order[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = order[i];
+		order.swap(scratch);
+	}
+}
+
+unsigned int RenderQueue::GetCount()
+{
+	return (unsigned int)packets.size();
+}
+
+const DrawPacket& RenderQueue::GetPacket(unsigned int i)
+{
+	return packets[order[i].packet];
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+class Entity;
+class Material;
+class SimpleVertexShader;
+class SimplePixelShader;
+
+// Submesh of a packet that draws the entity's whole model
+#define RENDER_QUEUE_WHOLE_MESH 0xFFFFFFFFu
+// Bits of the key sorted per radix pass
+#define RENDER_QUEUE_RADIX_BITS 8
+
+// Passes are drawn in this order
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE,
+	RENDER_PASS_TRANSPARENT,
+	RENDER_PASS_COUNT
+};
+
+/*
+	One draw call's worth of work: an entity, or one material's part of
+	it, and everything that decides where it goes in the queue
+*/
+struct DrawPacket
+{
+	uint64_t key;
+	Entity* entity;
+	Material* material;
+	SimpleVertexShader* vertexShader;
+	SimplePixelShader* pixelShader;
+	unsigned int submesh;	// RENDER_QUEUE_WHOLE_MESH for the whole model
+	RenderPass pass;
+};
+
+/*
+	Collects a frame's draws and orders them so that neighbors share as
+	much state as possible.
+
+	Every packet gets a 64 bit key, most significant bits first:
+	- Opaque: pass, shader program, material, mesh, depth
+	- Transparent: pass, inverted depth, shader program, material, mesh
+	So opaque draws are grouped by state and go front to back within a
+	group, while transparent ones go back to front no matter what.
+
+	Keys are sorted with a least significant digit radix sort, skipping
+	any digit every key shares. Shaders, materials and meshes are keyed
+	by small ids handed out the first time each one is seen, and all
+	handed out again from zero once any kind runs out of them.
+*/
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	/// <summary>
+	/// Drop the last frame's packets. Depths are measured along the
+	/// camera's forward, and out to the far clip
+	/// </summary>
+	void Begin(const DirectX::XMFLOAT3& cameraPosition, const DirectX::XMFLOAT3& cameraForward, float farClip);
+	/// <summary>
+	/// Add a packet for the entity, or one per submesh if its model has several
+	/// </summary>
+	void Add(Entity* entity);
+	/// <summary>
+	/// Order the packets by key
+	/// </summary>
+	void Sort();
+
+	/// <summary>
+	/// Get how many packets there are
+	/// </summary>
+	unsigned int GetCount();
+	/// <summary>
+	/// Get a packet in sorted order. Only valid after Sort()
+	/// </summary>
+	const DrawPacket& GetPacket(unsigned int i);
+
+private:
+	// What actually gets sorted, so the packets themselves never move
+	struct SortItem
+	{
+		uint64_t key;
+		unsigned int packet;
+	};
+
+	void AddPacket(Entity* entity, Material* material, unsigned int submesh, const void* mesh, float depth);
+	// Id of a shader, material or mesh, from its own counter and wrapped to fit its bits
+	unsigned int GetId(const void* object, unsigned int& nextId, unsigned int bits);
+
+	std::vector<DrawPacket> packets;
+	std::vector<SortItem> order;
+	std::vector<SortItem> scratch;
+
+	DirectX::XMFLOAT3 cameraPosition;
+	DirectX::XMFLOAT3 cameraForward;
+	float farClip;
+
+	// Keyed by address, and cleared in Begin() when a counter passes its field
+	std::unordered_map<const void*, unsigned int> ids;
+	unsigned int nextShaderId;
+	unsigned int nextMaterialId;
+	unsigned int nextMeshId;
+};
@@ -1,23 +1,13 @@
 #include "Scenes.h"
 
-Scene::Scene(
-	std::vector<std::shared_ptr<Camera>> cameras,
-	std::vector<std::shared_ptr<Entity>> entities,
-	std::vector<std::tuple<std::shared_ptr<Light>,std::shared_ptr<Entity>>> lightAndGui,
-	std::shared_ptr<Sky> sky
-) :
-	cameras(cameras), entities(entities), lights(lights)
-{
-	// Start of cameras vector 
-	currentCam = 0;
-
-	// Split lights and their gui into two different vectors 
-	SetLightsAndGui(lightAndGui);
-}
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 
 Scene::Scene()
 {
 	currentCam = 0;
+	screenHeight = 720.0f;
 
 	lightToGizmos = std::unordered_map<Light*, Entity*>();
 }
@@ -25,96 +15,333 @@ Scene::Scene()
 
 void Scene::DrawEntities(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 {
-	for (unsigned int i = 0; i < entities.size(); i++)
+	CullEntities();
+	SelectLods();
+
+	Camera* camera = GetCurrentCam();
+	Transform* cameraTransform = camera->GetTransform();
+	renderQueue.Begin(cameraTransform->GetPosition(), cameraTransform->GetForward(), camera->GetFarClip());
+	for (unsigned int i = 0; i < visibleEntities.size(); i++)
+		renderQueue.Add(&entities.GetAt(visibleEntities[i]));
+	renderQueue.Sort();
+
+	// Neighbors mostly share state, so each piece is only set when it
+	// differs from the last packet's. Everything per frame goes up with
+	// the shaders, since their local copies keep it between draws
+	RenderPass pass = RENDER_PASS_OPAQUE;
+	SimpleVertexShader* vs = nullptr;
+	SimplePixelShader* ps = nullptr;
+	Material* material = nullptr;
+	for (unsigned int i = 0; i < renderQueue.GetCount(); i++)
+	{
+		const DrawPacket& packet = renderQueue.GetPacket(i);
+		if (packet.pass != pass)
+		{
+			pass = packet.pass;
+			SetPassState(context, pass);
+		}
+
+		if (packet.vertexShader != vs)
+		{
+			vs = packet.vertexShader;
+			vs->SetShader();
+			vs->SetMatrix4x4("viewMatrix", camera->GetViewMatrix());
+			vs->SetMatrix4x4("projMatrix", camera->GetProjMatrix());
+		}
+
+		if (packet.pixelShader != ps)
+		{
+			ps = packet.pixelShader;
+			ps->SetShader();
+			ps->SetFloat3("camPos", cameraTransform->GetPosition());
+			SetLightData(ps);
+			material = nullptr;
+		}
+
+		if (packet.material != material)
+		{
+			material = packet.material;
+			vs->SetFloat4("colorTint", material->GetTint());
+			ps->SetFloat4("colorTint", material->GetTint());
+			ps->SetFloat("roughness", material->GetRoughness());
+			ps->SetFloat2("uvOffset", material->GetUVOffset());
+			ps->CopyAllBufferData();
+			material->PrepareMaterial();
+		}
+
+		packet.entity->DrawQueued(packet, camera);
+	}
+
+	if (pass != RENDER_PASS_OPAQUE)
+		SetPassState(context, RENDER_PASS_OPAQUE);
+}
+
+void Scene::SetPassState(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, RenderPass pass)
+{
+	if (!transparentBlend && pass != RENDER_PASS_OPAQUE)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		context->GetDevice(device.GetAddressOf());
+
+		D3D11_BLEND_DESC blendDesc = {};
+		blendDesc.RenderTarget[0].BlendEnable = true;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+		blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+		HRESULT blendResult = device->CreateBlendState(&blendDesc, transparentBlend.GetAddressOf());
+
+		// Still tested against what's opaque, but never hiding each other
+		D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+		depthDesc.DepthEnable = true;
+		depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+		depthDesc.DepthFunc = D3D11_COMPARISON_LESS;
+		HRESULT depthResult = device->CreateDepthStencilState(&depthDesc, transparentDepth.GetAddressOf());
+
+		// Without both, transparent draws fall back to the opaque state
+		// rather than binding half a pass. This runs again next frame
+		if (FAILED(blendResult) || FAILED(depthResult))
+		{
+			transparentBlend.Reset();
+			transparentDepth.Reset();
+		}
+	}
+
+	if (pass == RENDER_PASS_OPAQUE || !transparentBlend)
+	{
+		context->OMSetBlendState(0, 0, 0xFFFFFFFF);
+		context->OMSetDepthStencilState(0, 0);
+		return;
+	}
+
+	context->OMSetBlendState(transparentBlend.Get(), 0, 0xFFFFFFFF);
+	context->OMSetDepthStencilState(transparentDepth.Get(), 0);
+}
+
+void Scene::SetLightData(SimplePixelShader* ps)
+{
+	DirectX::XMFLOAT3 ambient(0.1f, 0.1f, 0.25f);
+	ps->SetFloat3("ambient", ambient);
+
+	int dLights = 1;
+	int sLights = 1;
+	int pLights = 1;
+	for (int l = 0; l < lights.size(); l++)
+	{
+		int lightType = lights[l]->type;
+		std::string name; //= (lights[l].type == 0 ? "directionalLight" : "spotLight") + std::to_string(l + 1);
+
+		switch (lightType)
+		{
+		case LIGHT_TYPE_DIRECTIONAL:
+			name = "directionalLight" + std::to_string(dLights);
+			dLights++;
+			break;
+		case  LIGHT_TYPE_POINT:
+			name = "pointLight" + std::to_string(pLights);
+			pLights++;
+			break;
+		case LIGHT_TYPE_SPOT: // Not implemented yet 
+		default:
+			continue;
+		}
+
+		ps->SetData(
+			name, // The name of the (eventual) variable in the shader
+			lights[l].get(), // The address of the data to set
+			sizeof(Light)); // The size of the data (the whole struct!) to set
+	}
+}
+
+void Scene::CullEntities()
+{
+	unsigned int count = entities.GetCount();
+	entitySpheres.resize(count);
+	visibleEntities.resize(count);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Entity& entity = entities.GetAt(i);
+		const WorldBounds& bounds = entity.GetWorldBounds();
+		entitySpheres[i] = DirectX::XMFLOAT4(bounds.sphereCenter.x, bounds.sphereCenter.y, bounds.sphereCenter.z, bounds.sphereRadius);
+
+		// Loading models have no bounds yet, and their placeholder is always drawn
+		if (!entity.GetModel()->IsReady())
+			entitySpheres[i].w = FLT_MAX;
+	}
+
+	Camera* camera = GetCurrentCam();
+	size_t visibleCount = camera->GetFrustum().CullSpheres(entitySpheres.data(), count, visibleEntities.data());
+	visibleEntities.resize(visibleCount);
+
+	// Then draw the occluders in view on the CPU and drop whatever they hide
+	DirectX::XMFLOAT4X4 viewProj;
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(
+		DirectX::XMLoadFloat4x4(&camera->GetViewMatrix()),
+		DirectX::XMLoadFloat4x4(&camera->GetProjMatrix())));
+	occlusion.Begin(viewProj);
+
+	for (unsigned int i = 0; i < visibleEntities.size(); i++)
+	{
+		Entity& entity = entities.GetAt(visibleEntities[i]);
+		const std::vector<DirectX::XMFLOAT3>& corners = entity.GetModel()->GetOccluderCorners();
+		if (entity.IsOccluder() && entity.GetModel()->IsReady() && !corners.empty())
+			occlusion.AddOccluder(corners.data(), corners.size(), entity.GetTransform()->GetWorldMatrix());
+	}
+
+	if (occlusion.GetTriangleCount() == 0)
+		return;
+	occlusion.Rasterize();
+
+	// Occluders stay, since their boxes sit right on the depths they wrote
+	size_t kept = 0;
+	for (unsigned int i = 0; i < visibleEntities.size(); i++)
+	{
+		Entity& entity = entities.GetAt(visibleEntities[i]);
+		const WorldBounds& bounds = entity.GetWorldBounds();
+		if (entity.IsOccluder() || !entity.GetModel()->IsReady() || occlusion.IsBoxVisible(bounds.boxMin, bounds.boxMax))
+			visibleEntities[kept++] = visibleEntities[i];
+	}
+	visibleEntities.resize(kept);
+}
+
+void Scene::SelectLods()
+{
+	Camera* camera = GetCurrentCam();
+	DirectX::XMFLOAT3 cameraPos = camera->GetTransform()->GetPosition();
+
+	// Projected size of one world unit, one unit away from the camera
+	float pixelsPerUnitAtOne = screenHeight * 0.5f * camera->GetProjMatrix()._22;
+
+	for (unsigned int i = 0; i < visibleEntities.size(); i++)
 	{
-		DirectX::XMFLOAT3 ambient(0.1f, 0.1f, 0.25f);
-		entities[i]->GetMat()->GetPixelShader()->SetFloat3("ambient", ambient);
+		Entity* entity = &entities.GetAt(visibleEntities[i]);
+		Mesh* mesh = entity->GetModel().get();
+		if (mesh->GetLodCount() <= 1)
+			continue;
 
-		int dLights = 1;
-		int sLights = 1;
-		int pLights = 1;
-		for (int l = 0; l < lights.size(); l++)
+		// Errors are in object space, so they grow with the entity's scale
+		DirectX::XMFLOAT3 scale = entity->GetTransform()->GetScale();
+		float maxScale = std::max(fabsf(scale.x), std::max(fabsf(scale.y), fabsf(scale.z)));
+
+		const WorldBounds& bounds = entity->GetWorldBounds();
+		float radius = bounds.sphereRadius;
+		float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(
+			DirectX::XMLoadFloat3(&bounds.sphereCenter), DirectX::XMLoadFloat3(&cameraPos))));
+
+		// Inside the sphere anything could be right in front of the camera
+		unsigned int current = entity->GetLod();
+		if (distance <= radius)
 		{
-			int lightType = lights[l]->type;
-			std::string name; //= (lights[l].type == 0 ? "directionalLight" : "spotLight") + std::to_string(l + 1);
-
-			switch (lightType)
-			{
-			case LIGHT_TYPE_DIRECTIONAL:
-				name = "directionalLight" + std::to_string(dLights);
-				dLights++;
-				break;
-			case  LIGHT_TYPE_POINT:
-				name = "pointLight" + std::to_string(pLights);
-				pLights++;
-				break;
-			case LIGHT_TYPE_SPOT: // Not implemented yet 
-			default:
-				continue;
-			}
-
-			entities[i]->GetMat()->GetPixelShader()->SetData(
-				name, // The name of the (eventual) variable in the shader
-				lights[l].get(), // The address of the data to set
-				sizeof(Light)); // The size of the data (the whole struct!) to set
+			entity->SetLod(0);
+			continue;
 		}
 
-		entities[i]->Draw(context, cameras[currentCam]);
+		float pixelsPerUnit = pixelsPerUnitAtOne * maxScale / (distance - radius);
+
+		// Refine as soon as the current LOD is too coarse, but
+		// only coarsen once the next LOD is comfortably fine enough
+		unsigned int finer = SelectLod(mesh, pixelsPerUnit, LOD_PIXEL_ERROR);
+		unsigned int coarser = SelectLod(mesh, pixelsPerUnit, LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS));
+		if (current > finer)
+			current = finer;
+		else if (current < coarser)
+			current = coarser;
+
+		entity->SetLod(current);
 	}
 }
 
+EntityHandle Scene::Pick(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, RayHit& hit)
+{
+	// Each hit shortens the ray, so farther entities are rejected by their bounds
+	EntityHandle picked;
+	for (unsigned int i = 0; i < entities.GetCount(); i++)
+	{
+		RayHit entityHit;
+		if (entities.GetAt(i).Raycast(origin, direction, maxDistance, entityHit))
+		{
+			hit = entityHit;
+			maxDistance = entityHit.distance;
+			picked = entities.GetHandleAt(i);
+		}
+	}
+
+	return picked;
+}
+
+unsigned int Scene::SelectLod(Mesh* mesh, float pixelsPerUnit, float threshold)
+{
+	unsigned int lod = 0;
+	for (unsigned int l = 1; l < mesh->GetLodCount(); l++)
+	{
+		if (mesh->GetLod(l).error * pixelsPerUnit > threshold)
+			break;
+		lod = l;
+	}
+	return lod;
+}
+
 void Scene::DrawSky(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 {
-	sky->Draw(cameras[currentCam]);
+	sky->Draw(GetCurrentCam());
 }
 
 void Scene::DrawLightsGui(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 {
-	for (unsigned int i = 0; i < lightGizmos.size(); i++)
+	Camera* camera = GetCurrentCam();
+	for (unsigned int i = 0; i < lightGizmos.GetCount(); i++)
 	{
-		lightGizmos[i]->Draw(context, cameras[currentCam]);
+		lightGizmos.GetAt(i).Draw(context, camera);
 	}
 }
 
 void Scene::ChangeCurrentCam(int index)
 {
 	// Safety 
-	if (index >= 0 && index < cameras.size())
+	if (index >= 0 && index < (int)cameras.GetCount())
 	{
 		currentCam = index;
 	}
 }
 
-void Scene::SetCameras(std::vector<std::shared_ptr<Camera>> cameras)
+void Scene::SetSky(std::shared_ptr<Sky> sky)
 {
-	(*this).cameras = cameras;
+	(*this).sky = sky;
 }
 
-void Scene::SetEntities(std::vector<std::shared_ptr<Entity>> entities)
+void Scene::SetLights(std::vector<std::shared_ptr<Light>> lights)
 {
-	(*this).entities = entities;
+	(*this).lights = lights;
 }
 
-void Scene::SetSky(std::shared_ptr<Sky> sky)
+EntityHandle Scene::CreateEntity(std::shared_ptr<Mesh> model, std::shared_ptr<Material> mat)
 {
-	(*this).sky = sky;
+	return entities.Create(model, mat);
 }
 
-void Scene::SetLights(std::vector<std::shared_ptr<Light>> lights)
+void Scene::DestroyEntity(EntityHandle entity)
 {
-	(*this).lights = lights;
+	entities.Destroy(entity);
 }
 
-void Scene::SetLightsAndGui(std::vector<std::tuple<std::shared_ptr<Light>, std::shared_ptr<Entity>>> lightAndGui)
+Entity* Scene::GetEntity(EntityHandle entity)
 {
-	for (int i = 0; i < lightAndGui.size(); i++)
-	{
-		std::tuple<std::shared_ptr<Light>, std::shared_ptr<Entity>> current = lightAndGui[i];
-		lights.push_back(std::get<0>(current));
-		lightGizmos.push_back(std::get<1>(current));
+	return entities.Get(entity);
+}
 
-		lightToGizmos[lights[lights.size() - 1].get()] = lightGizmos[lightGizmos.size() - 1].get();
-	}
+CameraHandle Scene::CreateCamera(
+	float x, float y, float z,
+	float moveSpeed,
+	float sprintMoveSpeed,
+	float mouseLookSpeed,
+	float fov,
+	float aspectRatio)
+{
+	return cameras.Create(x, y, z, moveSpeed, sprintMoveSpeed, mouseLookSpeed, fov, aspectRatio);
 }
 
 void Scene::GenerateLightGizmos(
@@ -132,42 +359,49 @@ void Scene::GenerateLightGizmos(
 		// Light gizmos mat
 		std::shared_ptr<Material> mat = std::make_shared<Material>(startColor, 1.0f, DirectX::XMFLOAT2(0, 0), vertex, pixel);
 
-		// Add light gizmos to their own vector 
-		lightGizmos.push_back(std::shared_ptr<Entity>(new Entity(lightMesh, mat)));
-		lightGizmos[i]->GetTransform()->SetPosition(light->position);
-		lightToGizmos[light] = lightGizmos[i].get();
+		// Add light gizmos to their own pool 
+		Entity* gizmo = lightGizmos.Get(lightGizmos.Create(lightMesh, mat));
+		gizmo->GetTransform()->SetPosition(light->position);
+		lightToGizmos[light] = gizmo;
 	}
 }
 
-std::vector<std::shared_ptr<Entity>> Scene::GetEntities()
+Pool<Entity>& Scene::GetEntities()
 {
 	return entities;
 }
 
-std::vector<std::shared_ptr<Light>> Scene::GetLights()
+const std::vector<std::shared_ptr<Light>>& Scene::GetLights()
 {
 	return lights;
 }
 
-std::unordered_map<Light*, Entity*> Scene::GetLightToGizmos()
+const std::unordered_map<Light*, Entity*>& Scene::GetLightToGizmos()
 {
 	return lightToGizmos;
 }
 
-std::vector<std::shared_ptr<Camera>> Scene::GetAllCams()
+Camera* Scene::GetCamera(unsigned int index)
+{
+	return &cameras.GetAt(index);
+}
+
+unsigned int Scene::GetCameraCount()
 {
-	return cameras;
+	return cameras.GetCount();
 }
 
-std::shared_ptr<Camera> Scene::GetCurrentCam()
+Camera* Scene::GetCurrentCam()
 {
-	return cameras[currentCam];
+	return &cameras.GetAt(currentCam);
 }
 
 
 void Scene::ResizeCam(float windowWidth, float windowHeight)
 {
-	GetCurrentCam().get()->UpdateProjMatrix(
+	screenHeight = windowHeight;
+
+	GetCurrentCam()->UpdateProjMatrix(
 		DirectX::XM_PIDIV4,								// FOV 
 		windowWidth / windowHeight				// Aspect Ratio
 	);
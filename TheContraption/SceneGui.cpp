@@ -1,16 +1,26 @@
 #include "SceneGui.h"
 using namespace DirectX;
 
-SceneGui::SceneGui(){}
+SceneGui::SceneGui() :
+	openSelected(false)
+{
+}
+
+void SceneGui::SelectEntity(EntityHandle entity, const RayHit& hit)
+{
+	selectedEntity = entity;
+	selectedHit = hit;
+	openSelected = entity.index != POOL_INVALID_INDEX;
+}
 
-void SceneGui::CreateEntityGui(std::shared_ptr<Entity> entity)
+void SceneGui::CreateEntityGui(Entity* entity)
 {
 	Transform* trans = entity->GetTransform();
-	XMFLOAT3 pos = *(trans->GetPosition().get());
+	XMFLOAT3 pos = trans->GetPosition();
 	XMFLOAT3 rot = trans->GetEulerRotation();
 	XMFLOAT3 sca = trans->GetScale();
 
-	XMFLOAT2 uvOff = entity.get()->GetMat()->GetUVOffset();
+	XMFLOAT2 uvOff = entity->GetMat()->GetUVOffset();
 
 	if (ImGui::DragFloat3("Position", &pos.x, 0.01f)) trans->SetPosition(pos);
 	if (ImGui::DragFloat3("Rotation (Radians)", &rot.x, 0.01f)) trans->SetEulerRotation(rot);
@@ -65,7 +75,7 @@ void SceneGui::CreatePointLightGui(Light* light)
 	if (ImGui::DragFloat("Range", &range, 0.01f)) light->range = range;
 }
 
-void SceneGui::UpdateLightGUI(std::vector<std::shared_ptr<Light>> lights, std::unordered_map<Light*, Entity*> lightToGizmos)
+void SceneGui::UpdateLightGUI(const std::vector<std::shared_ptr<Light>>& lights, const std::unordered_map<Light*, Entity*>& lightToGizmos)
 {
 	// Display Light GUI
 
@@ -74,7 +84,7 @@ void SceneGui::UpdateLightGUI(std::vector<std::shared_ptr<Light>> lights, std::u
 		ImGui::PushID(i);
 		if (ImGui::TreeNode(lights[i]->type == LIGHT_TYPE_DIRECTIONAL ? "Directional" : "Point")) // TODO - Account for more light types 
 		{
-			CreateLightGui(lights[i].get(), lightToGizmos[lights[i].get()]);
+			CreateLightGui(lights[i].get(), lightToGizmos.at(lights[i].get()));
 			ImGui::TreePop();
 		}
 		ImGui::PopID();
@@ -88,24 +98,34 @@ void SceneGui::CreateCamGui(Camera* cam)
 	if (ImGui::DragFloat("Common Move Speed", &commonMoveSpeed, 0.01f)) cam->SetCommonMoveSpeed(commonMoveSpeed);
 }
 
-void SceneGui::UpdateEntityGUI(std::vector<std::shared_ptr<Entity>> entities)
+void SceneGui::UpdateEntityGUI(Pool<Entity>& entities)
 {
 	// Display Entity data 
-	for (unsigned int i = 0; i < entities.size(); i++)
+	for (unsigned int i = 0; i < entities.GetCount(); i++)
 	{
-		// Unique id
-		ImGui::PushID(i);
-		if (ImGui::TreeNode("Entity")) // How to make name based on id? 
+		// Unique id, which stays with the entity as others come and go
+		EntityHandle handle = entities.GetHandleAt(i);
+		ImGui::PushID(handle.index);
+		bool selected = handle == selectedEntity;
+		if (selected && openSelected)
+			ImGui::SetNextItemOpen(true);
+
+		if (ImGui::TreeNode(selected ? "Entity (Picked)" : "Entity")) // How to make name based on id? 
 		{
-			CreateEntityGui(entities[i]);
+			if (selected && selectedHit.triangle != RAY_HIT_NO_TRIANGLE)
+				ImGui::Text("Triangle %u, %.2f units away", selectedHit.triangle, selectedHit.distance);
+
+			CreateEntityGui(&entities.GetAt(i));
 			ImGui::TreePop();
 		}
 		ImGui::PopID();
 	}
+
+	openSelected = false;
 }
 
 
-void SceneGui::UpdateCameraGUI(std::vector<std::shared_ptr<Camera>> cameras, Scene *scene, float screenWidth, float screenHeight)
+void SceneGui::UpdateCameraGUI(Scene *scene, float screenWidth, float screenHeight)
 {
 	const char* items[] = { "Cam0", "Cam1", "Cam2", "Cam3" };
 	static const char* current_item = items[0];
@@ -131,7 +151,7 @@ void SceneGui::UpdateCameraGUI(std::vector<std::shared_ptr<Camera>> cameras, Sce
 		}
 		ImGui::EndCombo();
 	}
-	CreateCamGui(cameras[current].get());
+	CreateCamGui(scene->GetCamera(current));
 }
 
 void SceneGui::CreateCurveGui(int curveType, float plotSizeX, float plotSizeY)
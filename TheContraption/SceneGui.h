@@ -16,11 +16,16 @@ class SceneGui
 {
 public:
 	SceneGui();
-	void UpdateEntityGUI(std::vector<std::shared_ptr<Entity>> entities);
-	void UpdateLightGUI(std::vector<std::shared_ptr<Light>> lights, std::unordered_map<Light*, Entity*> lightToGizmos);
-	void UpdateCameraGUI(std::vector<std::shared_ptr<Camera>> cameras, Scene* scene, float screenWidth, float screenHeight);
+	void UpdateEntityGUI(Pool<Entity>& entities);
+	void UpdateLightGUI(const std::vector<std::shared_ptr<Light>>& lights, const std::unordered_map<Light*, Entity*>& lightToGizmos);
+	void UpdateCameraGUI(Scene* scene, float screenWidth, float screenHeight);
 
-	void CreateEntityGui(std::shared_ptr<Entity> entity);
+	void CreateEntityGui(Entity* entity);
+	/// <summary>
+	/// Open the given entity's GUI, like after picking it in the scene.
+	/// An invalid handle clears the selection
+	/// </summary>
+	void SelectEntity(EntityHandle entity, const RayHit& hit);
 	/// <summary>
 	/// Call this function to automatically create a light
 	/// based on the lights type index
@@ -47,5 +52,7 @@ public:
 	int CreateCurveGuiWithDropDown(float plotSizeX = 100.0f, float plotSizeY = 80.0f);
 
 	private:
-
+		EntityHandle selectedEntity;
+		RayHit selectedHit;
+		bool openSelected;
 };
\ No newline at end of file
@@ -2,30 +2,34 @@
 #include "Entity.h"
 #include "Lights.h"
 #include "Sky.h"
-#include <tuple>
+#include "Pool.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include <unordered_map>
 
 #include "SimpleShader.h"
 #include <DirectXMath.h>
 
+// Most pixels a LOD's simplification error may cover on screen
+#define LOD_PIXEL_ERROR 1.0f
+// Fraction the projected error has to drop below the threshold before
+// switching back to a coarser LOD, so entities near a boundary don't flicker
+#define LOD_HYSTERESIS 0.25f
+
 /*
 	The purpose of the script is to hold individual scene data that 
 	lets us organize our game objects and to draw the appropriate 
 	gui data for said scene 
+
+	Entities and cameras live in pools owned by the scene, and are
+	referred to by handles, so adding and removing them doesn't touch
+	the heap once the pools are big enough
 */
 
 struct Scene
 {
 public:
 	
-	Scene(
-		std::vector<std::shared_ptr<Camera>> cameras,
-		std::vector<std::shared_ptr<Entity>> entities,
-		// We pass in light and its gui at the same time so
-		// that they have the same size.
-		std::vector<std::tuple<std::shared_ptr<Light>, std::shared_ptr<Entity>>> lightAndGui,
-		std::shared_ptr<Sky> sky
-	);
-
 	Scene();
 
 	void DrawEntities(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
@@ -34,14 +38,41 @@ public:
 	void DrawImGui();
 
 	void ChangeCurrentCam(int index);
-	void SetCameras(std::vector<std::shared_ptr<Camera>> cameras);
-	void SetEntities(std::vector<std::shared_ptr<Entity>> entities);
-	void SetLightsAndGui(std::vector<std::tuple<std::shared_ptr<Light>, std::shared_ptr<Entity>>> lightAndGui);
 	void SetLights(std::vector<std::shared_ptr<Light>> lights);
 	void SetSky(std::shared_ptr<Sky> sky);
 
 	void ResizeCam(float windowWidth, float windowHeight);
 
+	/// <summary>
+	/// Add an entity with its own transform to the scene
+	/// </summary>
+	EntityHandle CreateEntity(std::shared_ptr<Mesh> model, std::shared_ptr<Material> mat);
+	/// <summary>
+	/// Remove an entity from the scene. Stale handles are ignored
+	/// </summary>
+	void DestroyEntity(EntityHandle entity);
+	/// <summary>
+	/// Get an entity, or null if it has been destroyed
+	/// </summary>
+	Entity* GetEntity(EntityHandle entity);
+
+	/// <summary>
+	/// Add a camera after the existing ones
+	/// </summary>
+	CameraHandle CreateCamera(
+		float x, float y, float z,
+		float moveSpeed,
+		float sprintMoveSpeed,
+		float mouseLookSpeed,
+		float fov,
+		float aspectRatio);
+
+	/// <summary>
+	/// Find the closest entity a world space ray hits before maxDistance.
+	/// An invalid handle when it hits nothing
+	/// </summary>
+	EntityHandle Pick(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, RayHit& hit);
+
 	// Recreate the gizmos for light objects 
 	// using the given mesh
 	void GenerateLightGizmos(
@@ -50,24 +81,69 @@ public:
 		std::shared_ptr<SimplePixelShader> pixel
 	);
 
-	std::vector<std::shared_ptr<Entity>> GetEntities();
-	std::vector<std::shared_ptr<Light>> GetLights();
-	std::unordered_map<Light*, Entity*> GetLightToGizmos();
-	std::vector<std::shared_ptr<Camera>> GetAllCams();
-	std::shared_ptr<Camera> GetCurrentCam();
+	Pool<Entity>& GetEntities();
+	const std::vector<std::shared_ptr<Light>>& GetLights();
+	const std::unordered_map<Light*, Entity*>& GetLightToGizmos();
+	/// <summary>
+	/// Get a camera in the order they were created
+	/// </summary>
+	Camera* GetCamera(unsigned int index);
+	unsigned int GetCameraCount();
+	Camera* GetCurrentCam();
 
 private:
+	/// <summary>
+	/// Find the entities whose bounding spheres touch the current camera's
+	/// frustum, in one batch, then drop any hidden behind occluders
+	/// </summary>
+	void CullEntities();
+
+	/// <summary>
+	/// Pick each visible entity's level of detail from how big its mesh's
+	/// simplification error is on screen from the current camera
+	/// </summary>
+	void SelectLods();
+
+	/// <summary>
+	/// Coarsest LOD of the mesh whose error, scaled to pixels, stays under the threshold
+	/// </summary>
+	static unsigned int SelectLod(Mesh* mesh, float pixelsPerUnit, float threshold);
+
+	/// <summary>
+	/// Send the ambient color and every light to a pixel shader
+	/// </summary>
+	void SetLightData(SimplePixelShader* ps);
+
+	/// <summary>
+	/// Switch the output merger over to a pass's blending and depth writes
+	/// </summary>
+	void SetPassState(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, RenderPass pass);
+
 	// World entities 
-	std::vector<std::shared_ptr<Entity>> entities;
+	Pool<Entity> entities;
+
+	// Every entity's world bounding sphere, radius in w, and the pool
+	// indices of the ones that survived culling. Kept between frames to
+	// reuse their allocations
+	std::vector<DirectX::XMFLOAT4> entitySpheres;
+	std::vector<unsigned int> visibleEntities;
+	OcclusionCuller occlusion;
+
+	// Visible entities' draws, sorted to change state as little as possible
+	RenderQueue renderQueue;
+	// Alpha blending without depth writes, made the first time anything is transparent
+	Microsoft::WRL::ComPtr<ID3D11BlendState> transparentBlend;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> transparentDepth;
 
 	std::shared_ptr<Sky> sky;
 
-	// Camera 
+	// Camera. None are ever destroyed, so the pool keeps them in order
 	int currentCam;
-	std::vector<std::shared_ptr<Camera>> cameras;
+	Pool<Camera> cameras;
+	float screenHeight;
 
 	// Display light positions 
 	std::vector<std::shared_ptr<Light>> lights;
-	std::vector<std::shared_ptr<Entity>> lightGizmos;
+	Pool<Entity> lightGizmos;
 	std::unordered_map<Light*, Entity*> lightToGizmos; 
 };
\ No newline at end of file
@@ -100,9 +100,9 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	// Simplifications include not re-normalizing the same vector more than once!
 	float3 N = normalize(input.normal); // Must be normalized here or before
-	float3 T = normalize(input.tangent); // Must be normalized here or before
+	float3 T = normalize(input.tangent.xyz); // Must be normalized here or before
 	T = normalize(T - N * dot(T, N)); // Gram-Schmidt assumes T&N are normalized!
-	float3 B = cross(T, N);
+	float3 B = cross(T, N) * input.tangent.w; // Flipped where the uvs are mirrored
 	float3x3 TBN = float3x3(T, B, N);
 
 	// Assumes that input.normal is the normal later in the shader
@@ -129,5 +129,5 @@ float4 main(VertexToPixel input) : SV_TARGET
 	// 0.04f is recommended amount 
 	float3 finalColor = lerp(totalLight, reflectionColor, SimpleFresnel(input.normal, viewVector, 0.04f));
 
-	return float4(finalColor, 1);
+	return float4(finalColor, colorTint.a);
 }
\ No newline at end of file
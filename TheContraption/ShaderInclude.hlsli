@@ -32,10 +32,42 @@ struct VertexShaderInput
 	//  v    v                v
 	float3 localPosition	: POSITION;     // XYZ position
 	float3 normal			: NORMAL;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;		// W is the bitangent's sign
 	float4 uv				: TEXCOORD;
 };
 
+// Vertex input for the compact formats in VertexCompression.h
+// - The input layout converts every component to a float, so the
+//    same struct works for all of them
+// - Normals and tangents are octahedral encoded, see OctDecode() and
+//    OctDecodeTangent()
+// - Quantized positions and uvs are in the 0-1 range and still need
+//    to be scaled back into the mesh's range
+struct VertexShaderInput_Compact
+{
+	float3 localPosition	: POSITION;
+	float2 normal			: NORMAL;
+	float2 tangent			: TANGENT;
+	float2 uv				: TEXCOORD;
+};
+
+// Turns an octahedral encoded vector back into a unit vector
+float3 OctDecode(float2 e)
+{
+	float3 v = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-v.z);
+	v.xy += v.xy >= 0.0f ? -t : t;
+	return normalize(v);
+}
+
+// Same for tangents, whose y also carries the sign of w. Its magnitude
+// runs from 1 to 32767 snorm steps, see VertexCompression::EncodeTangent
+float4 OctDecodeTangent(float2 e)
+{
+	float y = (abs(e.y) * 32767.0f - 1.0f) / 16383.0f - 1.0f;
+	return float4(OctDecode(float2(e.x, y)), e.y < 0.0f ? -1.0f : 1.0f);
+}
+
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
 // - The name of the struct itself is unimportant
@@ -52,7 +84,7 @@ struct VertexToPixel
 	float3 worldPosition	: POSITION;
 	float2 uv				: TEXCOORD;
 	float3 normal			: NORMAL;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;		// W is the bitangent's sign
 };
 
 struct VertexToPixel_Sky
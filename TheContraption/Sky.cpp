@@ -47,7 +47,7 @@ Sky::Sky(Microsoft::WRL::ComPtr<ID3D11Device> device,
     device->CreateDepthStencilState(&depthDesc, stencilState.GetAddressOf());
 }
 
-void Sky::Draw(std::shared_ptr<Camera> cam)
+void Sky::Draw(Camera* cam)
 {
     context->OMSetDepthStencilState(stencilState.Get(), 0);
     context->RSSetState(rasterizeState.Get());
@@ -57,8 +57,8 @@ void Sky::Draw(std::shared_ptr<Camera> cam)
     skyPS->SetShader();
 
     // Vertex Data
-    skyVS->SetMatrix4x4("view", *cam->GetViewMatrix());
-    skyVS->SetMatrix4x4("proj", *cam->GetProjMatrix());
+    skyVS->SetMatrix4x4("view", cam->GetViewMatrix());
+    skyVS->SetMatrix4x4("proj", cam->GetProjMatrix());
     skyVS->CopyAllBufferData();
 
     // Pixel Data
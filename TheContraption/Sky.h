@@ -25,7 +25,7 @@ public:
 		const wchar_t vertexShaderPath[] = L"SkyVertexShader.cso"
 	);
 
-	void Draw(std::shared_ptr<Camera> cam);
+	void Draw(Camera* cam);
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetCubeSRV();
 private:
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
@@ -0,0 +1,397 @@
+#include "TangentGenerator.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+#pragma region SIMD
+	// Just enough of a wrapper that the fast kernel is written once
+	// for both instruction sets
+#if defined(__AVX2__)
+	const size_t simdWidth = 8;
+	typedef __m256 SimdFloat;
+	inline SimdFloat SimdLoad(const float* p) { return _mm256_load_ps(p); }
+	inline void SimdStore(float* p, SimdFloat v) { _mm256_store_ps(p, v); }
+	inline SimdFloat SimdSet(float v) { return _mm256_set1_ps(v); }
+	inline SimdFloat SimdSub(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a, b); }
+	inline SimdFloat SimdMul(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a, b); }
+	inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a, b); }
+	inline SimdFloat SimdAnd(SimdFloat a, SimdFloat b) { return _mm256_and_ps(a, b); }
+	inline SimdFloat SimdNotEqual(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ); }
+#else
+	const size_t simdWidth = 4;
+	typedef __m128 SimdFloat;
+	inline SimdFloat SimdLoad(const float* p) { return _mm_load_ps(p); }
+	inline void SimdStore(float* p, SimdFloat v) { _mm_store_ps(p, v); }
+	inline SimdFloat SimdSet(float v) { return _mm_set1_ps(v); }
+	inline SimdFloat SimdSub(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a, b); }
+	inline SimdFloat SimdMul(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a, b); }
+	inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b) { return _mm_div_ps(a, b); }
+	inline SimdFloat SimdAnd(SimdFloat a, SimdFloat b) { return _mm_and_ps(a, b); }
+	inline SimdFloat SimdNotEqual(SimdFloat a, SimdFloat b) { return _mm_cmpneq_ps(a, b); }
+#endif
+#pragma endregion
+
+	// One thread's running tangent sums. Only the span of vertices its
+	// triangles actually use is stored, which on meshes with any locality
+	// keeps this far smaller than a full copy per thread
+	struct TangentAccumulator
+	{
+		size_t firstVertex;
+		std::vector<XMFLOAT3> tangents;
+	};
+
+	// Runs work(i) for i in [0, count) as JobSystem jobs. Meshes are
+	// generated on MeshLoader's threads, so this shares the workers
+	// rather than starting more. A count of 1 stays on this thread
+	template<typename Work>
+	void RunParallel(size_t count, Work work)
+	{
+		auto runRange = [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				work(i);
+		};
+		JobSystem::GetInstance().ParallelFor(count, 1, runRange);
+	}
+
+	size_t GetThreadCount(size_t triangleCount)
+	{
+		size_t threadCount = triangleCount / TANGENT_PARALLEL_MIN_TRIANGLES;
+		size_t jobThreads = JobSystem::GetInstance().GetThreadCount();
+		if (threadCount > jobThreads) threadCount = jobThreads;
+		return threadCount < 1 ? 1 : threadCount;
+	}
+
+	// Splits the triangles between threads, each summing into its own
+	// accumulator with accumulate(firstTriangle, lastTriangle, accumulator)
+	template<typename Accumulate>
+	void AccumulateInParallel(const unsigned int* indices, size_t triangleCount, std::vector<TangentAccumulator>& accumulators, Accumulate accumulate)
+	{
+		size_t threadCount = GetThreadCount(triangleCount);
+		accumulators.resize(threadCount);
+
+		RunParallel(threadCount, [&](size_t t)
+		{
+			size_t first = triangleCount * t / threadCount;
+			size_t last = triangleCount * (t + 1) / threadCount;
+			TangentAccumulator& accumulator = accumulators[t];
+
+			unsigned int minIndex = ~0u;
+			unsigned int maxIndex = 0;
+			for (size_t i = first * 3; i < last * 3; i++)
+			{
+				minIndex = std::min(minIndex, indices[i]);
+				maxIndex = std::max(maxIndex, indices[i]);
+			}
+
+			accumulator.firstVertex = first < last ? minIndex : 0;
+			accumulator.tangents.assign(first < last ? maxIndex - minIndex + 1 : 0, XMFLOAT3(0, 0, 0));
+			accumulate(first, last, accumulator);
+		});
+	}
+
+	// Makes the tangent perpendicular to the normal and unit length. Vertices
+	// that got no usable tangent at all get an arbitrary perpendicular one
+	// so the shader never normalizes a zero vector
+	XMFLOAT3 Orthonormalize(const XMFLOAT3& n, const XMFLOAT3& t)
+	{
+		XMVECTOR normal = XMLoadFloat3(&n);
+		XMVECTOR tangent = XMLoadFloat3(&t);
+		tangent = XMVectorSubtract(tangent, XMVectorMultiply(normal, XMVector3Dot(normal, tangent)));
+
+		if (XMVectorGetX(XMVector3LengthSq(tangent)) < 1e-20f)
+		{
+			XMVECTOR axis = fabsf(n.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+			tangent = XMVector3Cross(normal, axis);
+		}
+
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVector3Normalize(tangent));
+		return result;
+	}
+
+	// Adds up every thread's sums in thread order, so the result never
+	// depends on timing, then orthonormalizes against the vertex normal.
+	// Every w is set to 1, for right-handed frames
+	void ResolveTangents(Vertex* vertices, size_t vertexCount, const std::vector<TangentAccumulator>& accumulators)
+	{
+		size_t threadCount = accumulators.size();
+		RunParallel(threadCount, [&](size_t t)
+		{
+			size_t first = vertexCount * t / threadCount;
+			size_t last = vertexCount * (t + 1) / threadCount;
+			for (size_t v = first; v < last; v++)
+			{
+				XMFLOAT3 sum(0, 0, 0);
+				for (const TangentAccumulator& accumulator : accumulators)
+				{
+					if (v < accumulator.firstVertex || v - accumulator.firstVertex >= accumulator.tangents.size())
+						continue;
+
+					const XMFLOAT3& partial = accumulator.tangents[v - accumulator.firstVertex];
+					sum.x += partial.x;
+					sum.y += partial.y;
+					sum.z += partial.z;
+				}
+
+				XMFLOAT3 tangent = Orthonormalize(vertices[v].Normal, sum);
+				vertices[v].Tangent = XMFLOAT4(tangent.x, tangent.y, tangent.z, 1.0f);
+			}
+		});
+	}
+
+	// --------------------------------------------------------
+	// Fast mode kernel - the textbook per triangle tangent
+	//  T = (t2 * e1 - t1 * e2) / det
+	// computed for a whole block of triangles at once, then
+	// scattered into the vertices that use them
+	// - Originally adapted from: http://www.terathon.com/code/tangent.html
+	// - See listing 7.4 in section 7.5 of
+	//    http://foundationsofgameenginedev.com/FGED2-sample.pdf
+	// --------------------------------------------------------
+	void AccumulateFast(const Vertex* vertices, const unsigned int* indices, size_t firstTriangle, size_t lastTriangle, TangentAccumulator& accumulator)
+	{
+		// Edges relative to the first corner, one lane per triangle
+		alignas(32) float x1[simdWidth], y1[simdWidth], z1[simdWidth];
+		alignas(32) float x2[simdWidth], y2[simdWidth], z2[simdWidth];
+		alignas(32) float s1[simdWidth], t1[simdWidth], s2[simdWidth], t2[simdWidth];
+		alignas(32) float tx[simdWidth], ty[simdWidth], tz[simdWidth];
+
+		for (size_t block = firstTriangle; block < lastTriangle; block += simdWidth)
+		{
+			size_t count = std::min(simdWidth, lastTriangle - block);
+
+			// Gather into SoA. Unused lanes get zero uvs, which the
+			// det mask below turns into zero tangents
+			for (size_t lane = 0; lane < simdWidth; lane++)
+			{
+				if (lane >= count)
+				{
+					x1[lane] = y1[lane] = z1[lane] = x2[lane] = y2[lane] = z2[lane] = 0.0f;
+					s1[lane] = t1[lane] = s2[lane] = t2[lane] = 0.0f;
+					continue;
+				}
+
+				const unsigned int* tri = &indices[(block + lane) * 3];
+				const Vertex& v1 = vertices[tri[0]];
+				const Vertex& v2 = vertices[tri[1]];
+				const Vertex& v3 = vertices[tri[2]];
+				x1[lane] = v2.Position.x - v1.Position.x;
+				y1[lane] = v2.Position.y - v1.Position.y;
+				z1[lane] = v2.Position.z - v1.Position.z;
+				x2[lane] = v3.Position.x - v1.Position.x;
+				y2[lane] = v3.Position.y - v1.Position.y;
+				z2[lane] = v3.Position.z - v1.Position.z;
+				s1[lane] = v2.UV.x - v1.UV.x;
+				t1[lane] = v2.UV.y - v1.UV.y;
+				s2[lane] = v3.UV.x - v1.UV.x;
+				t2[lane] = v3.UV.y - v1.UV.y;
+			}
+
+			SimdFloat vt1 = SimdLoad(t1);
+			SimdFloat vt2 = SimdLoad(t2);
+			SimdFloat det = SimdSub(SimdMul(SimdLoad(s1), vt2), SimdMul(SimdLoad(s2), vt1));
+
+			// Triangles with degenerate uvs would spread inf/NaN into every
+			// neighbor that shares one of their vertices, so they add nothing
+			SimdFloat r = SimdAnd(SimdDiv(SimdSet(1.0f), det), SimdNotEqual(det, SimdSet(0.0f)));
+
+			SimdStore(tx, SimdMul(SimdSub(SimdMul(vt2, SimdLoad(x1)), SimdMul(vt1, SimdLoad(x2))), r));
+			SimdStore(ty, SimdMul(SimdSub(SimdMul(vt2, SimdLoad(y1)), SimdMul(vt1, SimdLoad(y2))), r));
+			SimdStore(tz, SimdMul(SimdSub(SimdMul(vt2, SimdLoad(z1)), SimdMul(vt1, SimdLoad(z2))), r));
+
+			// Scatter into this thread's sums
+			for (size_t lane = 0; lane < count; lane++)
+			{
+				const unsigned int* tri = &indices[(block + lane) * 3];
+				for (int k = 0; k < 3; k++)
+				{
+					XMFLOAT3& sum = accumulator.tangents[tri[k] - accumulator.firstVertex];
+					sum.x += tx[lane];
+					sum.y += ty[lane];
+					sum.z += tz[lane];
+				}
+			}
+		}
+	}
+
+	// Triangle uv orientation, used to decide which vertices to split
+	const unsigned char orientationDegenerate = 0;
+	const unsigned char orientationPreserving = 1;
+	const unsigned char orientationMirrored = 2;
+
+	// Projects v onto the plane with the given unit normal
+	inline XMVECTOR ProjectOntoPlane(FXMVECTOR v, FXMVECTOR normal)
+	{
+		return XMVectorSubtract(v, XMVectorMultiply(normal, XMVector3Dot(normal, v)));
+	}
+}
+
+void TangentGenerator::Generate(MeshData& data, TangentMode mode)
+{
+	if (data.vertices.empty() || data.indices.empty())
+		return;
+
+	if (mode == TANGENT_MODE_MIKKTSPACE)
+		GenerateMikkTSpace(data);
+	else
+		GenerateFast(&data.vertices[0], data.vertices.size(), &data.indices[0], data.indices.size());
+}
+
+void TangentGenerator::GenerateFast(Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount)
+{
+	std::vector<TangentAccumulator> accumulators;
+	AccumulateInParallel(indices, indexCount / 3, accumulators,
+		[&](size_t first, size_t last, TangentAccumulator& accumulator)
+		{
+			AccumulateFast(vertices, indices, first, last, accumulator);
+		});
+
+	ResolveTangents(vertices, vertexCount, accumulators);
+}
+
+void TangentGenerator::GenerateMikkTSpace(MeshData& data)
+{
+	size_t triangleCount = data.indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// 1. Every triangle's unit tangent and uv orientation
+	std::vector<XMFLOAT3> triangleTangents(triangleCount);
+	std::vector<unsigned char> orientations(triangleCount);
+	{
+		const Vertex* vertices = &data.vertices[0];
+		const unsigned int* indices = &data.indices[0];
+		size_t threadCount = GetThreadCount(triangleCount);
+		RunParallel(threadCount, [&](size_t t)
+		{
+			size_t first = triangleCount * t / threadCount;
+			size_t last = triangleCount * (t + 1) / threadCount;
+			for (size_t i = first; i < last; i++)
+			{
+				const Vertex& v1 = vertices[indices[i * 3 + 0]];
+				const Vertex& v2 = vertices[indices[i * 3 + 1]];
+				const Vertex& v3 = vertices[indices[i * 3 + 2]];
+
+				XMVECTOR p1 = XMLoadFloat3(&v1.Position);
+				XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&v2.Position), p1);
+				XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&v3.Position), p1);
+				float s1 = v2.UV.x - v1.UV.x;
+				float t1 = v2.UV.y - v1.UV.y;
+				float s2 = v3.UV.x - v1.UV.x;
+				float t2 = v3.UV.y - v1.UV.y;
+
+				float area = s1 * t2 - s2 * t1;
+				XMVECTOR tangent = XMVectorSubtract(XMVectorScale(e1, t2), XMVectorScale(e2, t1));
+				float length = XMVectorGetX(XMVector3Length(tangent));
+
+				if (area == 0.0f || length == 0.0f)
+				{
+					orientations[i] = orientationDegenerate;
+					triangleTangents[i] = XMFLOAT3(0, 0, 0);
+					continue;
+				}
+
+				// Like the reference, flip mirrored triangles so every tangent points along +u
+				orientations[i] = area > 0.0f ? orientationPreserving : orientationMirrored;
+				XMStoreFloat3(&triangleTangents[i], XMVectorScale(tangent, (area > 0.0f ? 1.0f : -1.0f) / length));
+			}
+		});
+	}
+
+	// 2. Split any vertex used by both orientations, moving the mirrored
+	//    triangles onto a copy so the two sides are averaged separately.
+	//    Afterwards every vertex is used by only one orientation
+	std::vector<unsigned char> vertexOrientations(data.vertices.size(), 0);
+	{
+		size_t vertexCount = data.vertices.size();
+		for (size_t i = 0; i < data.indices.size(); i++)
+			vertexOrientations[data.indices[i]] |= orientations[i / 3];
+
+		// 0 means not split yet, since a copy can never be vertex 0
+		std::vector<unsigned int> mirroredCopy(vertexCount, 0);
+		for (size_t i = 0; i < data.indices.size(); i++)
+		{
+			unsigned int v = data.indices[i];
+			if (orientations[i / 3] != orientationMirrored ||
+				vertexOrientations[v] != (orientationPreserving | orientationMirrored))
+				continue;
+
+			if (mirroredCopy[v] == 0)
+			{
+				mirroredCopy[v] = static_cast<unsigned int>(data.vertices.size());
+				data.vertices.push_back(data.vertices[v]);
+				vertexOrientations.push_back(orientationMirrored);
+			}
+			data.indices[i] = mirroredCopy[v];
+		}
+
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			if (mirroredCopy[v] != 0)
+				vertexOrientations[v] = orientationPreserving;
+		}
+	}
+
+	// 3. Sum each triangle's tangent into its corners, projected onto the
+	//    corner's normal and weighted by the angle at that corner
+	const Vertex* vertices = &data.vertices[0];
+	const unsigned int* indices = &data.indices[0];
+	std::vector<TangentAccumulator> accumulators;
+	AccumulateInParallel(indices, triangleCount, accumulators,
+		[&](size_t first, size_t last, TangentAccumulator& accumulator)
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				if (orientations[i] == orientationDegenerate)
+					continue;
+
+				XMVECTOR triangleTangent = XMLoadFloat3(&triangleTangents[i]);
+				const unsigned int* tri = &indices[i * 3];
+				for (int k = 0; k < 3; k++)
+				{
+					const Vertex& corner = vertices[tri[k]];
+					XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(&corner.Normal));
+					XMVECTOR tangent = ProjectOntoPlane(triangleTangent, normal);
+					if (XMVectorGetX(XMVector3LengthSq(tangent)) == 0.0f)
+						continue;
+
+					XMVECTOR position = XMLoadFloat3(&corner.Position);
+					XMVECTOR toPrev = XMVector3Normalize(ProjectOntoPlane(
+						XMVectorSubtract(XMLoadFloat3(&vertices[tri[(k + 2) % 3]].Position), position), normal));
+					XMVECTOR toNext = XMVector3Normalize(ProjectOntoPlane(
+						XMVectorSubtract(XMLoadFloat3(&vertices[tri[(k + 1) % 3]].Position), position), normal));
+					float cosAngle = XMVectorGetX(XMVector3Dot(toPrev, toNext));
+					float angle = acosf(std::max(-1.0f, std::min(1.0f, cosAngle)));
+
+					XMFLOAT3 weighted;
+					XMStoreFloat3(&weighted, XMVectorScale(XMVector3Normalize(tangent), angle));
+					XMFLOAT3& sum = accumulator.tangents[tri[k] - accumulator.firstVertex];
+					sum.x += weighted.x;
+					sum.y += weighted.y;
+					sum.z += weighted.z;
+				}
+			}
+		});
+
+	ResolveTangents(&data.vertices[0], data.vertices.size(), accumulators);
+
+	// 4. Mirrored uvs make a left-handed frame, so flip the bitangent there
+	for (size_t v = 0; v < data.vertices.size(); v++)
+	{
+		if (vertexOrientations[v] == orientationMirrored)
+			data.vertices[v].Tangent.w = -1.0f;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include "MeshData.h"
+
+// Each thread gets at least this many triangles, so small
+// meshes are done entirely on the calling thread
+#define TANGENT_PARALLEL_MIN_TRIANGLES (1 << 15)
+
+// --------------------------------------------------------
+// How tangents are built from a mesh's uvs
+// --------------------------------------------------------
+enum TangentMode
+{
+	TANGENT_MODE_FAST,			// Sum each triangle's uv tangent into its vertices, then Gram-Schmidt
+	TANGENT_MODE_MIKKTSPACE		// MikkTSpace's weighting and vertex splitting, to match baked normal maps
+};
+
+/*
+	Generates per vertex tangents without touching D3D.
+
+	Triangles are split into ranges that run as JobSystem jobs, each
+	accumulating into its own buffer. The buffers are then reduced in a
+	fixed order, so the result only depends on the mesh. The fast mode
+	works through each range in SoA blocks with SSE (AVX2 when the
+	compiler targets it).
+
+	The MikkTSpace mode follows the reference implementation:
+	- Each triangle's tangent is normalized, then projected onto the
+	   plane of each corner's normal and weighted by the corner's angle
+	- Vertices shared by triangles with opposite uv orientation (mirrored
+	   uvs) are split, so each side gets its own tangent
+	- The tangent's w is -1 on the mirrored side, since shaders build the
+	   bitangent as cross(T, N) * w. Fast mode doesn't split vertices, so
+	   it always leaves w at 1
+*/
+class TangentGenerator
+{
+public:
+	/// <summary>
+	/// Replace the tangents of the given mesh data. MikkTSpace mode can add vertices
+	/// </summary>
+	static void Generate(MeshData& data, TangentMode mode);
+
+	/// <summary>
+	/// Fast mode on raw arrays. Never changes the vertex count
+	/// </summary>
+	static void GenerateFast(Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+	/// <summary>
+	/// MikkTSpace mode, splitting vertices where the uv orientation flips
+	/// </summary>
+	static void GenerateMikkTSpace(MeshData& data);
+};
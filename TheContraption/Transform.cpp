@@ -1,199 +1,239 @@
 #include "Transform.h"
+#include "TransformSystem.h"
 
-Transform::Transform() :
-	position(std::make_shared<DirectX::XMFLOAT3>(0.0f, 0.0f, 0.0f)),
-	eulerRotation(0.0f, 0.0f, 0.0f),
-	scale(1.0f, 1.0f, 1.0f)
+namespace
 {
-	DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixIdentity());
-	DirectX::XMStoreFloat4x4(&worldTranspose, DirectX::XMMatrixIdentity());
-
-	matIsDirty = true;
-	dirIsDirty = true;
-
-	parent = nullptr;
-
-	CleanVectors();
+	// What the matrix getters give back for a handle that isn't valid
+	DirectX::XMFLOAT4X4 IdentityMatrix()
+	{
+		DirectX::XMFLOAT4X4 identity;
+		DirectX::XMStoreFloat4x4(&identity, DirectX::XMMatrixIdentity());
+		return identity;
+	}
 }
 
-#pragma region HELPERS
-
-void Transform::CleanMatrices()
+Transform::Transform() :
+	id(TRANSFORM_INVALID),
+	generation(0)
 {
-	// Create a new world if transform has been mutated 
-	if (matIsDirty)
-	{
-		// Get each of parts that represent the world matrix 
-		DirectX::XMMATRIX pos =
-			DirectX::XMMatrixTranslationFromVector(
-				DirectX::XMLoadFloat3(position.get()));
+}
 
-		DirectX::XMMATRIX rot =
-			DirectX::XMMatrixRotationRollPitchYawFromVector(DirectX::XMLoadFloat3(&eulerRotation));
+Transform::Transform(unsigned int id, unsigned int generation) :
+	id(id),
+	generation(generation)
+{
+}
 
-		DirectX::XMMATRIX sc =
-			DirectX::XMMatrixScalingFromVector(
-				XMLoadFloat3(&scale));
+Transform Transform::Create()
+{
+	TransformSystem& system = TransformSystem::GetInstance();
+	unsigned int slot = system.Create();
+	return Transform(slot, system.GetGeneration(slot));
+}
 
-		// Update the matricies 
-		DirectX::XMMATRIX wm = pos * rot * sc;
-		DirectX::XMStoreFloat4x4(&world, wm);
-		DirectX::XMStoreFloat4x4(&worldTranspose,
-			DirectX::XMMatrixInverse(0, DirectX::XMMatrixTranspose(wm)));
+void Transform::Destroy()
+{
+	if (IsValid())
+		TransformSystem::GetInstance().Release(id);
+}
 
-		matIsDirty = false;
-	}
+void Transform::DestroyHierarchy()
+{
+	if (IsValid())
+		TransformSystem::GetInstance().ReleaseHierarchy(id);
 }
 
-void Transform::CleanVectors()
+bool Transform::IsValid()
 {
-	if (!dirIsDirty)
-		return;
+	return id != TRANSFORM_INVALID && TransformSystem::GetInstance().GetGeneration(id) == generation;
+}
 
-	DirectX::XMVECTOR rotQuat = DirectX::XMQuaternionRotationRollPitchYawFromVector(DirectX::XMLoadFloat3(&eulerRotation));
-	DirectX::XMStoreFloat3(&right, DirectX::XMVector3Rotate(DirectX::XMVectorSet(1, 0, 0, 0), rotQuat));
-	DirectX::XMStoreFloat3(&up, DirectX::XMVector3Rotate(DirectX::XMVectorSet(0, 1, 0, 0), rotQuat));
-	DirectX::XMStoreFloat3(&forward, DirectX::XMVector3Rotate(DirectX::XMVectorSet(0, 0, 1, 0), rotQuat));
+bool Transform::operator==(const Transform& other) const
+{
+	return id == other.id && generation == other.generation;
+}
 
-	dirIsDirty = false;
+bool Transform::operator!=(const Transform& other) const
+{
+	return !(*this == other);
 }
-#pragma endregion 
 
 #pragma region SETTERS
 
 void Transform::SetPosition(float x, float y, float z)
 {
-	// Was there a XMFloat function for this? 
-	position.get()->x = x;
-	position.get()->y = y;
-	position.get()->z = z;
-
-	matIsDirty = true;
+	SetPosition(DirectX::XMFLOAT3(x, y, z));
 }
 
 void Transform::SetPosition(DirectX::XMFLOAT3 position)
 {
-	*(this->position.get()) = position;
-
-	matIsDirty = true;
+	if (IsValid())
+		TransformSystem::GetInstance().SetPosition(id, position);
 }
 
 void Transform::SetEulerRotation(float pitch, float yaw, float roll)
 {
-	eulerRotation.x = pitch;
-	eulerRotation.y = yaw;
-	eulerRotation.z = roll;
-
-	matIsDirty = true;
-	dirIsDirty = true;
+	SetEulerRotation(DirectX::XMFLOAT3(pitch, yaw, roll));
 }
 
 void Transform::SetEulerRotation(DirectX::XMFLOAT3 rotation)
 {
-	this->eulerRotation = rotation;
+	if (IsValid())
+		TransformSystem::GetInstance().SetEulerRotation(id, rotation);
+}
 
-	matIsDirty = true;
-	dirIsDirty = true;
+void Transform::SetRotation(DirectX::XMFLOAT4 quaternion)
+{
+	if (IsValid())
+		TransformSystem::GetInstance().SetRotation(id, quaternion);
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
-	scale.x = x;
-	scale.y = y;
-	scale.z = z;
-
-	matIsDirty = true;
+	SetScale(DirectX::XMFLOAT3(x, y, z));
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 scale)
 {
-	this->scale = scale;
-
-	matIsDirty = true;
+	if (IsValid())
+		TransformSystem::GetInstance().SetScale(id, scale);
 }
 
 void Transform::SetScale(float s)
 {
 	SetScale(s, s, s);
-
-	matIsDirty = true;
 }
 
 #pragma endregion
 
 #pragma region GETTERS
-std::shared_ptr<DirectX::XMFLOAT3> Transform::GetPosition()
+DirectX::XMFLOAT3 Transform::GetPosition()
 {
-	return position;
+	if (!IsValid())
+		return DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	return TransformSystem::GetInstance().GetPosition(id);
 }
 
 DirectX::XMFLOAT3 Transform::GetEulerRotation()
 {
-	return eulerRotation;
+	if (!IsValid())
+		return DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	return TransformSystem::GetInstance().GetEulerRotation(id);
+}
+
+DirectX::XMFLOAT4 Transform::GetRotation()
+{
+	if (!IsValid())
+		return DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	return TransformSystem::GetInstance().GetRotation(id);
 }
 
 DirectX::XMFLOAT3 Transform::GetScale()
 {
-	return scale;
+	if (!IsValid())
+		return DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+
+	return TransformSystem::GetInstance().GetScale(id);
+}
+
+unsigned int Transform::GetVersion()
+{
+	if (!IsValid())
+		return 0;
+
+	return TransformSystem::GetInstance().GetVersion(id);
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	CleanMatrices();
-	return world;
+	if (!IsValid())
+		return IdentityMatrix();
+
+	return TransformSystem::GetInstance().GetWorldMatrix(id);
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 {
-	CleanMatrices();
-	return worldTranspose;
+	if (!IsValid())
+		return IdentityMatrix();
+
+	return TransformSystem::GetInstance().GetWorldInverseTransposeMatrix(id);
 }
 
 DirectX::XMFLOAT3 Transform::GetRight()
 {
-	if (dirIsDirty)
-		CleanVectors();
+	if (!IsValid())
+		return DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
 
-	return right;
+	const DirectX::XMFLOAT3X3& basis = TransformSystem::GetInstance().GetBasis(id);
+	return DirectX::XMFLOAT3(basis._11, basis._12, basis._13);
 }
 
 DirectX::XMFLOAT3 Transform::GetUp()
 {
-	if (dirIsDirty)
-		CleanVectors();
+	if (!IsValid())
+		return DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
 
-	return up;
+	const DirectX::XMFLOAT3X3& basis = TransformSystem::GetInstance().GetBasis(id);
+	return DirectX::XMFLOAT3(basis._21, basis._22, basis._23);
 }
 
 DirectX::XMFLOAT3 Transform::GetForward()
 {
-	if (dirIsDirty)
-		CleanVectors();
+	if (!IsValid())
+		return DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f);
 
-	return forward;
+	const DirectX::XMFLOAT3X3& basis = TransformSystem::GetInstance().GetBasis(id);
+	return DirectX::XMFLOAT3(basis._31, basis._32, basis._33);
 }
 
-std::shared_ptr<Transform> Transform::GetParent()
+Transform Transform::GetParent()
 {
-	return parent;
+	if (!IsValid())
+		return Transform();
+
+	TransformSystem& system = TransformSystem::GetInstance();
+	unsigned int parent = system.GetParent(id);
+	if (parent == TRANSFORM_INVALID)
+		return Transform();
+
+	return Transform(parent, system.GetGeneration(parent));
 }
 
-std::shared_ptr<Transform> Transform::GetChild(unsigned int index)
+Transform Transform::GetChild(unsigned int index)
 {
-	return children[index];
+	if (!IsValid())
+		return Transform();
+
+	TransformSystem& system = TransformSystem::GetInstance();
+	unsigned int child = system.GetFirstChild(id);
+	for (unsigned int i = 0; i < index && child != TRANSFORM_INVALID; i++)
+	{
+		child = system.GetNextSibling(child);
+	}
+
+	if (child == TRANSFORM_INVALID)
+		return Transform();
+
+	return Transform(child, system.GetGeneration(child));
 }
 
-int Transform::GetChildIndex(std::shared_ptr<Transform> child)
+int Transform::GetChildIndex(Transform child)
 {
-	// Better to have a has table? 
+	if (!IsValid() || !child.IsValid())
+		return -1;
 
-	int size = children.size();
-	for (unsigned int i = 0; i < size; i++)
+	// Children are a linked list in the system, so this walks it
+	TransformSystem& system = TransformSystem::GetInstance();
+	int index = 0;
+	for (unsigned int slot = system.GetFirstChild(id); slot != TRANSFORM_INVALID; slot = system.GetNextSibling(slot))
 	{
-		if (child == children[i])
-		{
-			return i;
-		}
+		if (slot == child.id)
+			return index;
+		index++;
 	}
 
 	// If not value is found 
@@ -202,7 +242,17 @@ int Transform::GetChildIndex(std::shared_ptr<Transform> child)
 
 unsigned int Transform::GetChildCount()
 {
-	return children.size();
+	if (!IsValid())
+		return 0;
+
+	TransformSystem& system = TransformSystem::GetInstance();
+	unsigned int count = 0;
+	for (unsigned int slot = system.GetFirstChild(id); slot != TRANSFORM_INVALID; slot = system.GetNextSibling(slot))
+	{
+		count++;
+	}
+
+	return count;
 }
 
 #pragma endregion
@@ -210,142 +260,115 @@ unsigned int Transform::GetChildCount()
 #pragma region MUTATORS 
 void Transform::MoveAbs(float x, float y, float z)
 {
-	this->position.get()->x += x;
-	this->position.get()->y += y;
-	this->position.get()->z += z;
-	matIsDirty = true;
+	DirectX::XMFLOAT3 position = GetPosition();
+	SetPosition(position.x + x, position.y + y, position.z + z);
 }
 
 void Transform::MoveAbs(DirectX::XMFLOAT3 offset)
 {
-	this->position.get()->x += offset.x;
-	this->position.get()->y += offset.y;
-	this->position.get()->z += offset.z;
-	matIsDirty = true;
+	MoveAbs(offset.x, offset.y, offset.z);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	// Turn the euler angles into a quaternion 
-	DirectX::XMVECTOR rotQuat = DirectX::XMQuaternionRotationRollPitchYawFromVector(
-		DirectX::XMLoadFloat3(&eulerRotation)
-	);
-	
-	// Creat the movement variable 
-	DirectX::XMVECTOR toMove = DirectX::XMVectorSet(x, y, z, 0);
-
-	// Convert to local space 
-	toMove = DirectX::XMVector3Rotate(toMove, rotQuat);
-
-	// Add in local space 
-	toMove = DirectX::XMVectorAdd(DirectX::XMLoadFloat3(position.get()), toMove);
+	if (!IsValid())
+		return;
 
-	// Store 
-	DirectX::XMStoreFloat3(position.get(), toMove);
-	matIsDirty = true;
+	// The rotated axes are already cached, so this is just a sum along them
+	const DirectX::XMFLOAT3X3& basis = TransformSystem::GetInstance().GetBasis(id);
+	DirectX::XMFLOAT3 position = GetPosition();
+	position.x += x * basis._11 + y * basis._21 + z * basis._31;
+	position.y += x * basis._12 + y * basis._22 + z * basis._32;
+	position.z += x * basis._13 + y * basis._23 + z * basis._33;
+	SetPosition(position);
 }
 
 void Transform::MoveRelative(DirectX::XMFLOAT3 vec)
 {
-	// Setup 
-	DirectX::XMVECTOR rotEuler = DirectX::XMLoadFloat3(&eulerRotation);
-	
-	// Turn the euler angles into a quaternion 
-	DirectX::XMVECTOR rotQuat = DirectX::XMQuaternionRotationRollPitchYaw(
-		DirectX::XMVectorGetIntX(rotEuler),
-		DirectX::XMVectorGetIntY(rotEuler),
-		DirectX::XMVectorGetIntZ(rotEuler)
-	);
-	
-	DirectX::XMVECTOR toMove = DirectX::XMLoadFloat3(&vec);
-
-	// Convert to local space 
-	toMove = DirectX::XMVector3Rotate(toMove, rotQuat);
-
-	// Add in local space 
-	toMove = DirectX::XMVectorAdd(DirectX::XMLoadFloat3(position.get()), toMove);
-
-	// Store 
-	DirectX::XMStoreFloat3(position.get(), toMove);
-
-	matIsDirty = true;
+	MoveRelative(vec.x, vec.y, vec.z);
 }
 
 void Transform::RotateEuler(float pitch, float yaw, float roll)
 {
-	eulerRotation.x += pitch;
-	eulerRotation.y += yaw;
-	eulerRotation.z += roll;
+	// Yaw goes after the current rotation, so it turns about the world's
+	// up, and pitch and roll before it, about this transform's own axes.
+	// Without roll that's the same as adding to each angle
+	DirectX::XMFLOAT4 current = GetRotation();
+	DirectX::XMVECTOR rotation = DirectX::XMQuaternionMultiply(
+		DirectX::XMQuaternionRotationRollPitchYaw(pitch, 0.0f, roll),
+		DirectX::XMLoadFloat4(&current));
+	rotation = DirectX::XMQuaternionMultiply(rotation,
+		DirectX::XMQuaternionRotationRollPitchYaw(0.0f, yaw, 0.0f));
 
-	matIsDirty = true;
-	dirIsDirty = true;
+	DirectX::XMFLOAT4 quaternion;
+	DirectX::XMStoreFloat4(&quaternion, rotation);
+	SetRotation(quaternion);
 }
 
 void Transform::RotateEuler(DirectX::XMFLOAT3 rotation)
 {
-	eulerRotation.x += rotation.x;
-	eulerRotation.y += rotation.y;
-	eulerRotation.z += rotation.z;
-
-	matIsDirty = true;
-	dirIsDirty = true;
+	RotateEuler(rotation.x, rotation.y, rotation.z);
 }
 
 void Transform::Scale(float x, float y, float z)
 {
-	scale.x += x;
-	scale.y += y;
-	scale.z += z;
-
-	matIsDirty = true;
+	DirectX::XMFLOAT3 scale = GetScale();
+	SetScale(scale.x + x, scale.y + y, scale.z + z);
 }
 
 void Transform::Scale(DirectX::XMFLOAT3 scale)
 {
-	this->scale.x += scale.x;
-	this->scale.y += scale.y;
-	this->scale.z += scale.z;
-
-	matIsDirty = true;
+	Scale(scale.x, scale.y, scale.z);
 }
 
 void Transform::Scale(float scale)
 {
-	this->scale.x += scale;
-	this->scale.y += scale;
-	this->scale.z += scale;
-
-	matIsDirty = true;
+	Scale(scale, scale, scale);
 }
 
 #pragma endregion
 
 #pragma region HIERACHY
 
-void Transform::AddChild(std::shared_ptr<Transform> child)
+void Transform::AddChild(Transform child)
 {
-	children.push_back(child);
+	if (!IsValid() || !child.IsValid() || child.GetParent() == *this)
+		return;
+
+	// A transform can't end up under itself
+	TransformSystem& system = TransformSystem::GetInstance();
+	for (unsigned int ancestor = id; ancestor != TRANSFORM_INVALID; ancestor = system.GetParent(ancestor))
+	{
+		if (ancestor == child.id)
+			return;
+	}
+
+	system.SetParent(child.id, id);
 }
 
-void Transform::RemoveChild(std::shared_ptr<Transform> child)
+void Transform::RemoveChild(Transform child)
 {
-	int index = GetChildIndex(child);
-	children[index]->SetParent(nullptr);
-	children.erase(children.begin() + index);
+	if (IsValid() && child.IsValid() && child.GetParent() == *this)
+		TransformSystem::GetInstance().SetParent(child.id, TRANSFORM_INVALID);
 }
 
 void Transform::RemoveChild(int childIndex)
 {
-	children.erase(children.begin() + childIndex);
+	if (childIndex < 0)
+		return;
+
+	RemoveChild(GetChild(childIndex));
 }
 
-void Transform::SetParent(std::shared_ptr<Transform> parent)
+void Transform::SetParent(Transform parent)
 {
-	//// Check if currently a child 
-	//if (parent != nullptr)
-	//{
-	//	parent->RemoveChild()
-	//}
+	if (!IsValid())
+		return;
+
+	if (parent.IsValid())
+		parent.AddChild(*this);
+	else
+		TransformSystem::GetInstance().SetParent(id, TRANSFORM_INVALID);
 }
 
-#pragma endregion
+#pragma endregion
\ No newline at end of file
@@ -1,53 +1,61 @@
 #pragma once
 #include <DirectXMath.h>
-#include <memory>
-#include <vector>
 
+/*
+	Position, rotation and scale, optionally relative to a parent.
+
+	This is only a handle, small enough to pass around by value: the data
+	itself lives in the TransformSystem, which rebuilds matrices in
+	batches. Handles don't own anything, so whoever calls Create() is
+	responsible for calling Destroy(). Once that happens every copy of
+	the handle stops being valid, even if the slot is reused. Setters on
+	a handle that isn't valid do nothing, and getters return what a new
+	transform would have. A child's world matrix is its local one
+	followed by its parent's.
+
+	Rotation is a quaternion. Euler angles are only a view of it for
+	the editor, worked out when asked for.
+*/
 class Transform
 {
 private:
 
 	/// <summary>
-	/// Represents this objects scale in x, y, and z components 
+	/// This transform's slot in the TransformSystem, and the slot's
+	/// generation when it was handed out
 	/// </summary>
-	DirectX::XMFLOAT3 scale;
-	/// <summary>
-	/// Represents this objects rotation as a euler 
-	/// </summary>
-	DirectX::XMFLOAT3 eulerRotation;
+	unsigned int id;
+	unsigned int generation;
 
-	DirectX::XMFLOAT4X4 world;
-	DirectX::XMFLOAT4X4 worldTranspose;
+	Transform(unsigned int id, unsigned int generation);
 
-	/// <summary>
-	/// Set the matricies so that they accomodate mutations 
-	/// </summary>
-	void CleanMatrices();
-	void CleanVectors();
-
-	bool matIsDirty;
-	bool dirIsDirty;
+public:
 
-	// Local Vectors 
-	DirectX::XMFLOAT3 right;
-	DirectX::XMFLOAT3 up;
-	DirectX::XMFLOAT3 forward;
 
 	/// <summary>
-	/// Represents this objects position in x, y, and z components 
+	/// Create a handle that doesn't refer to any transform
 	/// </summary>
-	std::shared_ptr<DirectX::XMFLOAT3> position;
-
-	std::vector<std::shared_ptr<Transform>> children;
-	std::shared_ptr<Transform> parent;
-
-public:
-
+	Transform();
 
 	/// <summary>
-	/// Create a transform that represents a position, scale, and rotation in 3D space 
+	/// Create a transform at the origin with no rotation and a scale of one
 	/// </summary>
-	Transform();
+	static Transform Create();
+	/// <summary>
+	/// Free this transform. Its children are left without a parent
+	/// </summary>
+	void Destroy();
+	/// <summary>
+	/// Free this transform and every transform under it
+	/// </summary>
+	void DestroyHierarchy();
+	/// <summary>
+	/// True while the transform this refers to hasn't been destroyed
+	/// </summary>
+	bool IsValid();
+
+	bool operator==(const Transform& other) const;
+	bool operator!=(const Transform& other) const;
 
 	#pragma region SETTERS
 	/// <summary>
@@ -69,6 +77,10 @@ public:
 	/// <param name="rotation"></param>
 	void SetEulerRotation(DirectX::XMFLOAT3 rotation);
 	/// <summary>
+	/// Sets the rotation of this transform to the given quaternion
+	/// </summary>
+	void SetRotation(DirectX::XMFLOAT4 quaternion);
+	/// <summary>
 	/// Sets the scale of this transform to the given components
 	/// </summary>
 	void SetScale(float x, float y, float z);
@@ -88,18 +100,30 @@ public:
 	/// Get this transform's current x, y, and z position in 3D space
 	/// </summary>
 	/// <returns></returns>
-	std::shared_ptr<DirectX::XMFLOAT3> GetPosition();
+	DirectX::XMFLOAT3 GetPosition();
 	/// <summary>
-	/// Get this transform's current euler rotation 
+	/// Get this transform's current euler rotation. Worked out from the
+	/// quaternion, so it may not be the angles that were set
 	/// </summary>
 	/// <returns></returns>
 	DirectX::XMFLOAT3 GetEulerRotation();
 	/// <summary>
+	/// Get this transform's current rotation as a quaternion
+	/// </summary>
+	/// <returns></returns>
+	DirectX::XMFLOAT4 GetRotation();
+	/// <summary>
 	/// Get this transform's current x, y, and z scalar components 
 	/// </summary>
 	/// <returns></returns>
 	DirectX::XMFLOAT3 GetScale();
 	/// <summary>
+	/// Get a counter that changes whenever this transform or any of its parents
+	/// does, so anything derived from it can tell when it needs rebuilding
+	/// </summary>
+	/// <returns></returns>
+	unsigned int GetVersion();
+	/// <summary>
 	/// Get this transform's world matrix that represents its position, rotation, and scale 
 	/// </summary>
 	/// <returns></returns>
@@ -125,24 +149,24 @@ public:
 	/// <returns></returns>
 	DirectX::XMFLOAT3 GetForward();
 	/// <summary>
-	/// Get this transform's current parents 
-	/// Nullptr if not possible 
+	/// Get this transform's current parent 
+	/// Invalid if it has none 
 	/// </summary>
 	/// <returns></returns>
-	std::shared_ptr<Transform> GetParent();
+	Transform GetParent();
 	/// <summary>
 	/// Get the child trasnform based on index 
-	/// Nullptr if not possible 
+	/// Invalid if not possible 
 	/// </summary>
 	/// <returns></returns>
-	std::shared_ptr<Transform> GetChild(unsigned int index);
+	Transform GetChild(unsigned int index);
 	/// <summary>
 	/// Get the index of a child of this transform 
 	/// -1 if not a child 
 	/// </summary>
 	/// <param name="child"></param>
 	/// <returns></returns>
-	int GetChildIndex(std::shared_ptr<Transform> child);
+	int GetChildIndex(Transform child);
 	/// <summary>
 	/// Get the current amount of children directly under this transform
 	/// </summary>
@@ -168,7 +192,8 @@ public:
 	/// </summary>
 	void MoveRelative(DirectX::XMFLOAT3 offset);
 	/// <summary>
-	/// Rotate this transform by the given euler angles
+	/// Rotate this transform by the given euler angles. Pitch and roll
+	/// turn about its own axes, yaw about the world's up
 	/// </summary>
 	void RotateEuler(float pitch, float yaw, float roll);
 	/// <summary>
@@ -192,24 +217,25 @@ public:
 	#pragma region HIERACHY
 
 	/// <summary>
-	/// Connect a transform to make it relative to this transform 
+	/// Connect a transform to make it relative to this transform. It is taken
+	/// from its old parent, and ignored if it is this transform or an ancestor
 	/// </summary>
 	/// <param name="child"></param>
-	void AddChild(std::shared_ptr<Transform> child);
+	void AddChild(Transform child);
 	/// <summary>
 	/// If possible make a child no longer a child of this transform 
 	/// </summary>
 	/// <param name="child"></param>
-	void RemoveChild(std::shared_ptr<Transform> child);
+	void RemoveChild(Transform child);
 	/// <summary>
 	/// If possible make a child no longer a child of this transform 
 	/// </summary>
 	/// <param name="childIndex"></param>
 	void RemoveChild(int childIndex);
 	/// <summary>
-	/// Link this transform to a new parent 
+	/// Link this transform to a new parent, or none if the handle is invalid
 	/// </summary>
 	/// <param name="parent"></param>
-	void SetParent(std::shared_ptr<Transform> parent);
+	void SetParent(Transform parent);
 	#pragma endregion
 };
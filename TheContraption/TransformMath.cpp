@@ -0,0 +1,139 @@
+#include "TransformMath.h"
+
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+	inline XMVECTOR LoadRow(const XMFLOAT3X3& m, int row)
+	{
+		return XMVectorSet(m.m[row][0], m.m[row][1], m.m[row][2], 0.0f);
+	}
+
+	// The row of an inverse transpose for one row of the undone 3x3 part,
+	// with the translation's share in w
+	inline XMVECTOR InverseTransposeRow(FXMVECTOR row, FXMVECTOR translation)
+	{
+		return XMVectorSetW(row, -XMVectorGetX(XMVector3Dot(row, translation)));
+	}
+}
+
+XMMATRIX TransformMath::Trs(const XMFLOAT3& position, const XMFLOAT3X3& basis, const XMFLOAT3& scale)
+{
+	// Row vectors read left to right, so each axis only needs its own scale
+	XMMATRIX m;
+	m.r[0] = XMVectorScale(LoadRow(basis, 0), scale.x);
+	m.r[1] = XMVectorScale(LoadRow(basis, 1), scale.y);
+	m.r[2] = XMVectorScale(LoadRow(basis, 2), scale.z);
+	m.r[3] = XMVectorSetW(XMLoadFloat3(&position), 1.0f);
+	return m;
+}
+
+XMMATRIX TransformMath::TrsInverseTranspose(const XMFLOAT3& position, const XMFLOAT3X3& basis, const XMFLOAT3& scale)
+{
+	// A rotation is its own inverse transpose, so only the scale flips
+	XMMATRIX m;
+	m.r[0] = XMVectorScale(LoadRow(basis, 0), 1.0f / scale.x);
+	m.r[1] = XMVectorScale(LoadRow(basis, 1), 1.0f / scale.y);
+	m.r[2] = XMVectorScale(LoadRow(basis, 2), 1.0f / scale.z);
+
+	XMVECTOR translation = XMLoadFloat3(&position);
+	m.r[0] = InverseTransposeRow(m.r[0], translation);
+	m.r[1] = InverseTransposeRow(m.r[1], translation);
+	m.r[2] = InverseTransposeRow(m.r[2], translation);
+	m.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	return m;
+}
+
+XMMATRIX TransformMath::AffineInverseTranspose(FXMMATRIX m)
+{
+	// Each cofactor row is the cross product of the other two rows
+	XMVECTOR c0 = XMVector3Cross(m.r[1], m.r[2]);
+	XMVECTOR c1 = XMVector3Cross(m.r[2], m.r[0]);
+	XMVECTOR c2 = XMVector3Cross(m.r[0], m.r[1]);
+	XMVECTOR reciprocal = XMVectorReciprocal(XMVector3Dot(m.r[0], c0));
+
+	XMMATRIX result;
+	result.r[0] = InverseTransposeRow(XMVectorMultiply(c0, reciprocal), m.r[3]);
+	result.r[1] = InverseTransposeRow(XMVectorMultiply(c1, reciprocal), m.r[3]);
+	result.r[2] = InverseTransposeRow(XMVectorMultiply(c2, reciprocal), m.r[3]);
+	result.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	return result;
+}
+
+void TransformMath::AffineInverseTransposeBatch(
+	const XMFLOAT4X4* matrices,
+	XMFLOAT4X4* results,
+	const unsigned int* indices,
+	size_t count)
+{
+	// Four matrices per pass, turned sideways so each register holds
+	// the same element of all four and no lane waits on another
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const float* m0 = &matrices[indices[i]].m[0][0];
+		const float* m1 = &matrices[indices[i + 1]].m[0][0];
+		const float* m2 = &matrices[indices[i + 2]].m[0][0];
+		const float* m3 = &matrices[indices[i + 3]].m[0][0];
+
+		__m128 ax[4], ay[4], az[4], aw[4];
+		for (int row = 0; row < 4; row++)
+		{
+			ax[row] = _mm_loadu_ps(m0 + row * 4);
+			ay[row] = _mm_loadu_ps(m1 + row * 4);
+			az[row] = _mm_loadu_ps(m2 + row * 4);
+			aw[row] = _mm_loadu_ps(m3 + row * 4);
+			_MM_TRANSPOSE4_PS(ax[row], ay[row], az[row], aw[row]);
+		}
+
+		// ax[row] now holds element (row, 0) of all four matrices, and so on
+		__m128 cx[3], cy[3], cz[3];
+		for (int row = 0; row < 3; row++)
+		{
+			int a = (row + 1) % 3;
+			int b = (row + 2) % 3;
+			cx[row] = _mm_sub_ps(_mm_mul_ps(ay[a], az[b]), _mm_mul_ps(az[a], ay[b]));
+			cy[row] = _mm_sub_ps(_mm_mul_ps(az[a], ax[b]), _mm_mul_ps(ax[a], az[b]));
+			cz[row] = _mm_sub_ps(_mm_mul_ps(ax[a], ay[b]), _mm_mul_ps(ay[a], ax[b]));
+		}
+
+		__m128 determinant = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(ax[0], cx[0]), _mm_mul_ps(ay[0], cy[0])), _mm_mul_ps(az[0], cz[0]));
+		__m128 reciprocal = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+		float* out[4] = {
+			&results[indices[i]].m[0][0],
+			&results[indices[i + 1]].m[0][0],
+			&results[indices[i + 2]].m[0][0],
+			&results[indices[i + 3]].m[0][0] };
+
+		for (int row = 0; row < 3; row++)
+		{
+			__m128 x = _mm_mul_ps(cx[row], reciprocal);
+			__m128 y = _mm_mul_ps(cy[row], reciprocal);
+			__m128 z = _mm_mul_ps(cz[row], reciprocal);
+			__m128 w = _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(x, ax[3]), _mm_mul_ps(y, ay[3])), _mm_mul_ps(z, az[3])));
+
+			// Back to one register per matrix
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+			_mm_storeu_ps(out[0] + row * 4, x);
+			_mm_storeu_ps(out[1] + row * 4, y);
+			_mm_storeu_ps(out[2] + row * 4, z);
+			_mm_storeu_ps(out[3] + row * 4, w);
+		}
+
+		__m128 lastRow = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+		for (int k = 0; k < 4; k++)
+		{
+			_mm_storeu_ps(out[k] + 12, lastRow);
+		}
+	}
+
+	for (; i < count; i++)
+	{
+		XMStoreFloat4x4(&results[indices[i]], AffineInverseTranspose(XMLoadFloat4x4(&matrices[indices[i]])));
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <DirectXMath.h>
+
+/*
+	Matrix helpers specialized for transforms, which are always a scale,
+	a rotation and a translation, and so never need a general inverse.
+
+	The inverse transpose of such a matrix only has to undo the 3x3 part.
+	Built from its pieces that's the rotation with each row divided by
+	its scale, and for any other affine matrix it's the cofactors of the
+	3x3 part over its determinant. Either way the translation just ends
+	up in the last column.
+
+	Inverse transposes compose in the same order as the matrices they
+	come from, so a child's can be built from its local one and its
+	parent's, with no inverse at all.
+*/
+class TransformMath
+{
+public:
+	/// <summary>
+	/// Build the matrix that scales, then rotates by the given axes, then moves
+	/// </summary>
+	static DirectX::XMMATRIX Trs(
+		const DirectX::XMFLOAT3& position,
+		const DirectX::XMFLOAT3X3& basis,
+		const DirectX::XMFLOAT3& scale);
+	/// <summary>
+	/// Build the inverse transpose of the matrix Trs() would, straight from
+	/// the rotation and the reciprocal scale
+	/// </summary>
+	static DirectX::XMMATRIX TrsInverseTranspose(
+		const DirectX::XMFLOAT3& position,
+		const DirectX::XMFLOAT3X3& basis,
+		const DirectX::XMFLOAT3& scale);
+
+	/// <summary>
+	/// Get the inverse transpose of a matrix whose last column is 0, 0, 0, 1
+	/// </summary>
+	static DirectX::XMMATRIX AffineInverseTranspose(DirectX::FXMMATRIX m);
+	/// <summary>
+	/// Get the inverse transposes of the matrices at the given indices,
+	/// four at a time. Each result goes to the same index of results
+	/// </summary>
+	static void AffineInverseTransposeBatch(
+		const DirectX::XMFLOAT4X4* matrices,
+		DirectX::XMFLOAT4X4* results,
+		const unsigned int* indices,
+		size_t count);
+};
@@ -0,0 +1,551 @@
+#include "TransformSystem.h"
+#include "TransformMath.h"
+#include "JobSystem.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+TransformSystem* TransformSystem::instance;
+
+unsigned int TransformSystem::Create()
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (unsigned int)slotNodes.size();
+		slotNodes.push_back(TRANSFORM_INVALID);
+		parents.push_back(TRANSFORM_INVALID);
+		firstChildren.push_back(TRANSFORM_INVALID);
+		nextSiblings.push_back(TRANSFORM_INVALID);
+		slotGenerations.push_back(0);
+		eulerViews.push_back(XMFLOAT3(0.0f, 0.0f, 0.0f));
+		eulerViewRotations.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+
+	parents[slot] = TRANSFORM_INVALID;
+	firstChildren[slot] = TRANSFORM_INVALID;
+	nextSiblings[slot] = TRANSFORM_INVALID;
+	eulerViews[slot] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	eulerViewRotations[slot] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	slotNodes[slot] = AppendNode(slot);
+	return slot;
+}
+
+void TransformSystem::Release(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return;
+
+	Unlink(slot);
+
+	unsigned int child = firstChildren[slot];
+	while (child != TRANSFORM_INVALID)
+	{
+		unsigned int next = nextSiblings[child];
+		parents[child] = TRANSFORM_INVALID;
+		nextSiblings[child] = TRANSFORM_INVALID;
+		nodeParents[slotNodes[child]] = TRANSFORM_INVALID;
+		MarkDirty(slotNodes[child]);
+		child = next;
+	}
+
+	nodeSlots[slotNodes[slot]] = TRANSFORM_INVALID;
+	gapCount++;
+
+	firstChildren[slot] = TRANSFORM_INVALID;
+	slotNodes[slot] = TRANSFORM_INVALID;
+	slotGenerations[slot]++;
+	freeSlots.push_back(slot);
+}
+
+void TransformSystem::ReleaseHierarchy(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return;
+
+	// Children first, so each release finds nothing left under it
+	moveStack.clear();
+	moveStack.push_back(slot);
+	for (size_t i = 0; i < moveStack.size(); i++)
+	{
+		for (unsigned int child = firstChildren[moveStack[i]]; child != TRANSFORM_INVALID; child = nextSiblings[child])
+		{
+			moveStack.push_back(child);
+		}
+	}
+
+	while (!moveStack.empty())
+	{
+		Release(moveStack.back());
+		moveStack.pop_back();
+	}
+}
+
+unsigned int TransformSystem::GetGeneration(unsigned int slot)
+{
+	return slot < slotGenerations.size() ? slotGenerations[slot] : 0;
+}
+
+bool TransformSystem::IsAlive(unsigned int slot)
+{
+	return slot < slotNodes.size() && slotNodes[slot] != TRANSFORM_INVALID;
+}
+
+#pragma region Components
+
+XMFLOAT3 TransformSystem::GetPosition(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	return positions[slotNodes[slot]];
+}
+
+XMFLOAT4 TransformSystem::GetRotation(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	return rotations[slotNodes[slot]];
+}
+
+XMFLOAT3 TransformSystem::GetScale(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return XMFLOAT3(1.0f, 1.0f, 1.0f);
+
+	return scales[slotNodes[slot]];
+}
+
+void TransformSystem::SetPosition(unsigned int slot, XMFLOAT3 position)
+{
+	if (!IsAlive(slot))
+		return;
+
+	positions[slotNodes[slot]] = position;
+	MarkDirty(slotNodes[slot]);
+}
+
+void TransformSystem::SetRotation(unsigned int slot, XMFLOAT4 rotation)
+{
+	if (!IsAlive(slot))
+		return;
+
+	unsigned int node = slotNodes[slot];
+	XMVECTOR q = XMQuaternionNormalize(XMLoadFloat4(&rotation));
+	XMStoreFloat4(&rotations[node], q);
+	XMStoreFloat3x3(&bases[node], XMMatrixRotationQuaternion(q));
+	MarkDirty(node);
+}
+
+void TransformSystem::SetScale(unsigned int slot, XMFLOAT3 scale)
+{
+	if (!IsAlive(slot))
+		return;
+
+	scales[slotNodes[slot]] = scale;
+	MarkDirty(slotNodes[slot]);
+}
+
+const XMFLOAT3X3& TransformSystem::GetBasis(unsigned int slot)
+{
+	static const XMFLOAT3X3 identity(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	if (!IsAlive(slot))
+		return identity;
+
+	return bases[slotNodes[slot]];
+}
+
+XMFLOAT3 TransformSystem::GetEulerRotation(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	const XMFLOAT4& rotation = rotations[slotNodes[slot]];
+	XMFLOAT3& view = eulerViews[slot];
+	XMFLOAT4& viewRotation = eulerViewRotations[slot];
+	if (rotation.x == viewRotation.x && rotation.y == viewRotation.y &&
+		rotation.z == viewRotation.z && rotation.w == viewRotation.w)
+		return view;
+
+	// Rotations are built as roll, then pitch, then yaw, so pull the
+	// angles back out of the matrix that order makes
+	const XMFLOAT3X3& m = bases[slotNodes[slot]];
+	float sinPitch = -m._32;
+	float cosPitch = sqrtf(m._31 * m._31 + m._33 * m._33);
+	view.x = atan2f(sinPitch, cosPitch);
+	if (cosPitch < 1e-6f)
+	{
+		// Looking straight up or down, where yaw and roll are the same axis
+		view.y = atan2f(-m._13, m._11);
+		view.z = 0.0f;
+	}
+	else
+	{
+		view.y = atan2f(m._31, m._33);
+		view.z = atan2f(m._12, m._22);
+	}
+
+	viewRotation = rotation;
+	return view;
+}
+
+void TransformSystem::SetEulerRotation(unsigned int slot, XMFLOAT3 rotation)
+{
+	if (!IsAlive(slot))
+		return;
+
+	XMFLOAT4 quaternion;
+	XMStoreFloat4(&quaternion, XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation)));
+	SetRotation(slot, quaternion);
+
+	// Remember the angles as given, so the editor doesn't see them jump
+	eulerViews[slot] = rotation;
+	eulerViewRotations[slot] = rotations[slotNodes[slot]];
+}
+
+#pragma endregion
+
+#pragma region Hierarchy
+
+unsigned int TransformSystem::GetParent(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return TRANSFORM_INVALID;
+
+	return parents[slot];
+}
+
+unsigned int TransformSystem::GetFirstChild(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return TRANSFORM_INVALID;
+
+	return firstChildren[slot];
+}
+
+unsigned int TransformSystem::GetNextSibling(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return TRANSFORM_INVALID;
+
+	return nextSiblings[slot];
+}
+
+void TransformSystem::SetParent(unsigned int slot, unsigned int parent)
+{
+	if (!IsAlive(slot) || (parent != TRANSFORM_INVALID && !IsAlive(parent)) || parents[slot] == parent)
+		return;
+
+	Unlink(slot);
+	if (parent != TRANSFORM_INVALID)
+	{
+		parents[slot] = parent;
+		nextSiblings[slot] = firstChildren[parent];
+		firstChildren[parent] = slot;
+
+		// Parents have to come first, so bring this subtree after its new one
+		if (slotNodes[parent] > slotNodes[slot])
+			MoveToEnd(slot);
+
+		nodeParents[slotNodes[slot]] = slotNodes[parent];
+	}
+	else
+	{
+		nodeParents[slotNodes[slot]] = TRANSFORM_INVALID;
+	}
+
+	MarkDirty(slotNodes[slot]);
+}
+
+void TransformSystem::Unlink(unsigned int slot)
+{
+	unsigned int parent = parents[slot];
+	if (parent == TRANSFORM_INVALID)
+		return;
+
+	unsigned int* link = &firstChildren[parent];
+	while (*link != slot)
+	{
+		link = &nextSiblings[*link];
+	}
+	*link = nextSiblings[slot];
+
+	parents[slot] = TRANSFORM_INVALID;
+	nextSiblings[slot] = TRANSFORM_INVALID;
+}
+
+#pragma endregion
+
+#pragma region Nodes
+
+unsigned int TransformSystem::AppendNode(unsigned int slot)
+{
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	XMFLOAT3X3 identityBasis;
+	XMStoreFloat3x3(&identityBasis, XMMatrixIdentity());
+
+	unsigned int node = (unsigned int)nodeSlots.size();
+	positions.push_back(XMFLOAT3(0.0f, 0.0f, 0.0f));
+	rotations.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+	bases.push_back(identityBasis);
+	scales.push_back(XMFLOAT3(1.0f, 1.0f, 1.0f));
+	worlds.push_back(identity);
+	worldInverseTransposes.push_back(identity);
+	nodeParents.push_back(TRANSFORM_INVALID);
+	nodeSlots.push_back(slot);
+	generations.push_back(0);
+	parentGenerations.push_back(0);
+	localDirty.push_back(0);
+	rebuilding.push_back(0);
+	depths.push_back(0);
+
+	MarkDirty(node);
+	return node;
+}
+
+void TransformSystem::MoveToEnd(unsigned int slot)
+{
+	// Depth first, so each parent is copied before its children
+	moveStack.clear();
+	moveStack.push_back(slot);
+	while (!moveStack.empty())
+	{
+		unsigned int current = moveStack.back();
+		moveStack.pop_back();
+
+		unsigned int from = slotNodes[current];
+		unsigned int to = AppendNode(current);
+		positions[to] = positions[from];
+		rotations[to] = rotations[from];
+		bases[to] = bases[from];
+		scales[to] = scales[from];
+		worlds[to] = worlds[from];
+		worldInverseTransposes[to] = worldInverseTransposes[from];
+		generations[to] = generations[from];
+		parentGenerations[to] = parentGenerations[from];
+
+		// Everything under the moved root only changed place, so it
+		// keeps its matrices until its parent's generation moves
+		if (current != slot)
+		{
+			nodeParents[to] = slotNodes[parents[current]];
+			localDirty[to] = localDirty[from];
+		}
+
+		nodeSlots[from] = TRANSFORM_INVALID;
+		gapCount++;
+		slotNodes[current] = to;
+
+		for (unsigned int child = firstChildren[current]; child != TRANSFORM_INVALID; child = nextSiblings[child])
+		{
+			moveStack.push_back(child);
+		}
+	}
+}
+
+void TransformSystem::Compact()
+{
+	// Parents are before children, so a parent's new node is always known
+	// by the time one of its children gets there
+	unsigned int write = 0;
+	for (unsigned int read = 0; read < nodeSlots.size(); read++)
+	{
+		unsigned int slot = nodeSlots[read];
+		if (slot == TRANSFORM_INVALID)
+			continue;
+
+		if (write != read)
+		{
+			positions[write] = positions[read];
+			rotations[write] = rotations[read];
+			bases[write] = bases[read];
+			scales[write] = scales[read];
+			worlds[write] = worlds[read];
+			worldInverseTransposes[write] = worldInverseTransposes[read];
+			nodeSlots[write] = slot;
+			generations[write] = generations[read];
+			parentGenerations[write] = parentGenerations[read];
+			localDirty[write] = localDirty[read];
+			depths[write] = depths[read];
+		}
+
+		slotNodes[slot] = write;
+		nodeParents[write] = parents[slot] == TRANSFORM_INVALID ? TRANSFORM_INVALID : slotNodes[parents[slot]];
+		write++;
+	}
+
+	positions.resize(write);
+	rotations.resize(write);
+	bases.resize(write);
+	scales.resize(write);
+	worlds.resize(write);
+	worldInverseTransposes.resize(write);
+	nodeParents.resize(write);
+	nodeSlots.resize(write);
+	generations.resize(write);
+	parentGenerations.resize(write);
+	localDirty.resize(write);
+	rebuilding.resize(write);
+	depths.resize(write);
+	gapCount = 0;
+}
+
+#pragma endregion
+
+#pragma region Matrices
+
+unsigned int TransformSystem::GetVersion(unsigned int slot)
+{
+	if (!IsAlive(slot))
+		return 0;
+
+	// Generations only move when matrices are rebuilt, so catch up first
+	Clean(slotNodes[slot]);
+	return generations[slotNodes[slot]];
+}
+
+XMFLOAT4X4 TransformSystem::GetWorldMatrix(unsigned int slot)
+{
+	if (!IsAlive(slot))
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		return identity;
+	}
+
+	Clean(slotNodes[slot]);
+	return worlds[slotNodes[slot]];
+}
+
+XMFLOAT4X4 TransformSystem::GetWorldInverseTransposeMatrix(unsigned int slot)
+{
+	if (!IsAlive(slot))
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		return identity;
+	}
+
+	Clean(slotNodes[slot]);
+	return worldInverseTransposes[slotNodes[slot]];
+}
+
+void TransformSystem::MarkDirty(unsigned int node)
+{
+	localDirty[node] = 1;
+	if (firstDirty == TRANSFORM_INVALID || node < firstDirty)
+		firstDirty = node;
+}
+
+bool TransformSystem::IsStale(unsigned int node)
+{
+	unsigned int parent = nodeParents[node];
+	return localDirty[node] || (parent != TRANSFORM_INVALID && parentGenerations[node] != generations[parent]);
+}
+
+void TransformSystem::BuildWorld(unsigned int node, unsigned int generation)
+{
+	XMMATRIX world = TransformMath::Trs(positions[node], bases[node], scales[node]);
+	unsigned int parent = nodeParents[node];
+	if (parent != TRANSFORM_INVALID)
+	{
+		world = XMMatrixMultiply(world, XMLoadFloat4x4(&worlds[parent]));
+		parentGenerations[node] = generations[parent];
+	}
+
+	XMStoreFloat4x4(&worlds[node], world);
+	generations[node] = generation;
+	localDirty[node] = 0;
+}
+
+void TransformSystem::Clean(unsigned int node)
+{
+	// Everything before the first change is current
+	if (firstDirty == TRANSFORM_INVALID || node < firstDirty)
+		return;
+
+	unsigned int parent = nodeParents[node];
+	if (parent != TRANSFORM_INVALID)
+		Clean(parent);
+
+	if (IsStale(node))
+	{
+		BuildWorld(node, ++generationCounter);
+
+		// Inverse transposes compose like the matrices themselves, and the
+		// parent's is already current, so there's nothing to invert
+		XMMATRIX inverseTranspose = TransformMath::TrsInverseTranspose(positions[node], bases[node], scales[node]);
+		if (parent != TRANSFORM_INVALID)
+			inverseTranspose = XMMatrixMultiply(inverseTranspose, XMLoadFloat4x4(&worldInverseTransposes[parent]));
+		XMStoreFloat4x4(&worldInverseTransposes[node], inverseTranspose);
+	}
+}
+
+void TransformSystem::UpdateTransforms()
+{
+	if (firstDirty != TRANSFORM_INVALID)
+	{
+		// Work out what needs rebuilding first, in order, so a parent is
+		// always decided before its children check it. This touches no
+		// matrices, so it stays cheap even though it's serial
+		rebuilt.clear();
+		for (std::vector<unsigned int>& level : levels)
+			level.clear();
+
+		for (unsigned int node = firstDirty; node < nodeSlots.size(); node++)
+		{
+			if (nodeSlots[node] == TRANSFORM_INVALID)
+				continue;
+
+			unsigned int parent = nodeParents[node];
+			depths[node] = parent == TRANSFORM_INVALID ? 0 : depths[parent] + 1;
+			if (!IsStale(node) && (parent == TRANSFORM_INVALID || !rebuilding[parent]))
+				continue;
+
+			rebuilding[node] = 1;
+			rebuilt.push_back(node);
+			if (depths[node] >= levels.size())
+				levels.resize(depths[node] + 1);
+			levels[depths[node]].push_back(node);
+		}
+
+		// One generation for the whole update, so it's the same whichever
+		// thread gets to a node first
+		unsigned int generation = ++generationCounter;
+		JobSystem& jobs = JobSystem::GetInstance();
+		for (std::vector<unsigned int>& level : levels)
+		{
+			auto buildLevel = [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+					BuildWorld(level[i], generation);
+			};
+			jobs.ParallelFor(level.size(), TRANSFORM_PARALLEL_GRAIN, buildLevel);
+		}
+
+		// Worlds are all affine and independent of each other by now
+		auto invertRange = [&](size_t begin, size_t end)
+		{
+			TransformMath::AffineInverseTransposeBatch(worlds.data(), worldInverseTransposes.data(), rebuilt.data() + begin, end - begin);
+		};
+		jobs.ParallelFor(rebuilt.size(), TRANSFORM_PARALLEL_GRAIN, invertRange);
+
+		for (unsigned int node : rebuilt)
+			rebuilding[node] = 0;
+
+		firstDirty = TRANSFORM_INVALID;
+	}
+
+	if (gapCount > nodeSlots.size() * TRANSFORM_GAP_THRESHOLD)
+		Compact();
+}
+
+#pragma endregion
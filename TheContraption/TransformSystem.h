@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+// Slot or node meaning "no transform", used for roots' parents
+#define TRANSFORM_INVALID 0xFFFFFFFFu
+// Share of the node array that may be gaps before it's compacted on the next update
+#define TRANSFORM_GAP_THRESHOLD 0.5f
+// Transforms rebuilt per job in UpdateTransforms(). Smaller batches stay on the calling thread
+#define TRANSFORM_PARALLEL_GRAIN 512
+
+/*
+	Every transform's data, kept in flat arrays rather than spread across
+	the Transform objects themselves.
+
+	Transforms are known by a slot, which never changes while they're
+	alive, and the slot's generation, which changes when it's released
+	so stale handles can be told apart from whatever reuses it. Their data
+	lives in nodes that are always ordered parents before children. One
+	linear pass over the nodes, starting from the first that changed,
+	therefore updates every dirty subtree with each parent done before
+	anything that depends on it.
+
+	Nothing is propagated down when a transform changes. Every world
+	matrix has a generation, and each node remembers the generation of
+	its parent's matrix it was built from. A node is rebuilt only if its
+	own values changed or that generation moved, so an unchanged parent
+	costs one comparison.
+
+	Reparenting under a node that's already earlier in the array just
+	relinks. Otherwise the moved subtree is copied to the end, leaving
+	gaps that are compacted away once there are enough of them, so the
+	cost follows what changed rather than the size of the scene.
+
+	Rotations are stored as quaternions, along with the rotated axes
+	they produce, so moving along those axes and building matrices
+	needs no trig at all.
+
+	UpdateTransforms() works out what needs rebuilding in one cheap pass,
+	then rebuilds it a depth at a time across the JobSystem. Everything
+	at one depth only reads matrices from the depth above, so separate
+	hierarchies, and siblings within one, are all rebuilt side by side.
+	Each matrix comes out the same on any thread, so the results match
+	a serial update exactly.
+
+	Asking for a matrix before UpdateTransforms() still works, it just
+	rebuilds that transform and its parents on the spot.
+*/
+class TransformSystem
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static TransformSystem& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new TransformSystem();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	TransformSystem(TransformSystem const&) = delete;
+	void operator=(TransformSystem const&) = delete;
+
+private:
+	static TransformSystem* instance;
+	TransformSystem() :
+		generationCounter(0),
+		firstDirty(TRANSFORM_INVALID),
+		gapCount(0)
+	{};
+#pragma endregion
+
+public:
+	/// <summary>
+	/// Get a slot for a new transform at the origin with no rotation, a
+	/// scale of one and no parent
+	/// </summary>
+	unsigned int Create();
+	/// <summary>
+	/// Free a transform's slot. Its children are left without a parent
+	/// </summary>
+	void Release(unsigned int slot);
+	/// <summary>
+	/// Free a transform's slot along with every transform under it
+	/// </summary>
+	void ReleaseHierarchy(unsigned int slot);
+	/// <summary>
+	/// Get how many times a slot has been released
+	/// </summary>
+	unsigned int GetGeneration(unsigned int slot);
+	/// <summary>
+	/// True if a slot holds a transform right now. Everything below
+	/// ignores slots that don't, returning defaults or doing nothing
+	/// </summary>
+	bool IsAlive(unsigned int slot);
+
+	DirectX::XMFLOAT3 GetPosition(unsigned int slot);
+	DirectX::XMFLOAT4 GetRotation(unsigned int slot);
+	DirectX::XMFLOAT3 GetScale(unsigned int slot);
+	void SetPosition(unsigned int slot, DirectX::XMFLOAT3 position);
+	/// <summary>
+	/// Set the rotation quaternion, which doesn't need to be normalized
+	/// </summary>
+	void SetRotation(unsigned int slot, DirectX::XMFLOAT4 rotation);
+	void SetScale(unsigned int slot, DirectX::XMFLOAT3 scale);
+
+	/// <summary>
+	/// Get the local axes after rotation: right, up and forward in that order
+	/// </summary>
+	const DirectX::XMFLOAT3X3& GetBasis(unsigned int slot);
+
+	/// <summary>
+	/// Get the rotation as euler angles. The angles last set come back
+	/// until something else rotates the transform
+	/// </summary>
+	DirectX::XMFLOAT3 GetEulerRotation(unsigned int slot);
+	void SetEulerRotation(unsigned int slot, DirectX::XMFLOAT3 rotation);
+
+	/// <summary>
+	/// Get the slot of a transform's parent, or TRANSFORM_INVALID
+	/// </summary>
+	unsigned int GetParent(unsigned int slot);
+	/// <summary>
+	/// Get a transform's first child, or TRANSFORM_INVALID. The rest follow
+	/// from GetNextSibling()
+	/// </summary>
+	unsigned int GetFirstChild(unsigned int slot);
+	unsigned int GetNextSibling(unsigned int slot);
+	/// <summary>
+	/// Make a transform relative to another, or to nothing with
+	/// TRANSFORM_INVALID. The caller makes sure this can't form a cycle
+	/// </summary>
+	void SetParent(unsigned int slot, unsigned int parent);
+
+	/// <summary>
+	/// Get a counter that changes whenever this transform's world matrix does
+	/// </summary>
+	unsigned int GetVersion(unsigned int slot);
+	/// <summary>
+	/// Get a transform's world matrix, rebuilding it now if it's out of date
+	/// </summary>
+	DirectX::XMFLOAT4X4 GetWorldMatrix(unsigned int slot);
+	/// <summary>
+	/// Get a transform's world inverse transpose matrix, rebuilding it now if it's out of date
+	/// </summary>
+	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix(unsigned int slot);
+
+	/// <summary>
+	/// Rebuild every out of date transform's matrices. Call once per frame,
+	/// after everything has moved and before anything is drawn
+	/// </summary>
+	void UpdateTransforms();
+
+private:
+	// Add a node at the end of the array, with default values, for the given slot
+	unsigned int AppendNode(unsigned int slot);
+	// Move a transform and everything under it to the end of the array
+	void MoveToEnd(unsigned int slot);
+	// Squeeze the gaps out of the node array, keeping its order
+	void Compact();
+
+	// Flag a node's own values as changed
+	void MarkDirty(unsigned int node);
+	// True if a node's matrices are older than its values or its parent's matrix
+	bool IsStale(unsigned int node);
+	// Build a node's world matrix from its values and its parent's matrix
+	void BuildWorld(unsigned int node, unsigned int generation);
+	// Make sure one node's matrices are current, parents first
+	void Clean(unsigned int node);
+	// Take a transform out of its parent's child list
+	void Unlink(unsigned int slot);
+
+	// Per slot, so handles stay valid while nodes move
+	std::vector<unsigned int> slotNodes;		// The node holding each slot's data
+	std::vector<unsigned int> parents;			// Parent slot
+	std::vector<unsigned int> firstChildren;	// Child slots, as a linked list so no slot needs its own allocation
+	std::vector<unsigned int> nextSiblings;
+	std::vector<unsigned int> slotGenerations;
+	std::vector<unsigned int> freeSlots;
+
+	// Euler angles last set or worked out, and the rotation they were for,
+	// so the editor sees the same angles while nothing else rotates it
+	std::vector<DirectX::XMFLOAT3> eulerViews;
+	std::vector<DirectX::XMFLOAT4> eulerViewRotations;
+
+	// Per node, with every parent before its children
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT4> rotations;	// Normalized quaternions
+	std::vector<DirectX::XMFLOAT3X3> bases;		// Rows are the rotated x, y and z axes
+	std::vector<DirectX::XMFLOAT3> scales;
+	std::vector<DirectX::XMFLOAT4X4> worlds;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposes;
+	std::vector<unsigned int> nodeParents;		// Parent node
+	std::vector<unsigned int> nodeSlots;		// Owning slot, or TRANSFORM_INVALID for gaps
+	std::vector<unsigned int> generations;		// Of the world matrix
+	std::vector<unsigned int> parentGenerations;	// Of the parent's world matrix this was built from
+	std::vector<uint8_t> localDirty;			// Own values changed since the last build
+	std::vector<uint8_t> rebuilding;			// Set only during UpdateTransforms()
+	std::vector<unsigned int> depths;			// How many parents up to the root
+
+	// Handed out to every rebuilt matrix, so generations never repeat
+	unsigned int generationCounter;
+	// Nodes before this are all current. TRANSFORM_INVALID when everything is
+	unsigned int firstDirty;
+	unsigned int gapCount;
+
+	// Scratch
+	std::vector<unsigned int> rebuilt;
+	std::vector<std::vector<unsigned int>> levels;	// Rebuilt nodes by depth
+	std::vector<unsigned int> moveStack;
+};
@@ -11,6 +11,6 @@ struct Vertex
 {
 	DirectX::XMFLOAT3 Position;	    // The local position of the vertex
 	DirectX::XMFLOAT3 Normal;
-	DirectX::XMFLOAT3 Tangent;
+	DirectX::XMFLOAT4 Tangent;		// W is the bitangent's sign, -1 where the uvs are mirrored
 	DirectX::XMFLOAT2 UV;	    
 };
\ No newline at end of file
@@ -0,0 +1,354 @@
+#include "VertexCompression.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <DirectXPackedVector.h>
+
+#include "MeshData.h"
+
+using namespace DirectX;
+
+namespace
+{
+	inline float Clamp(float v, float low, float high)
+	{
+		return v < low ? low : (v > high ? high : v);
+	}
+
+	inline float SignNotZero(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	inline uint32_t Pack(uint16_t x, uint16_t y)
+	{
+		return static_cast<uint32_t>(x) | (static_cast<uint32_t>(y) << 16);
+	}
+
+	inline uint16_t UnpackX(uint32_t packed) { return static_cast<uint16_t>(packed & 0xFFFF); }
+	inline uint16_t UnpackY(uint32_t packed) { return static_cast<uint16_t>(packed >> 16); }
+
+	// Matches DXGI's SNORM conversion, where both -32768 and -32767 read as -1
+	inline uint16_t FloatToSnorm16(float v)
+	{
+		return static_cast<uint16_t>(static_cast<int16_t>(std::lround(Clamp(v, -1.0f, 1.0f) * 32767.0f)));
+	}
+
+	inline float Snorm16ToFloat(uint16_t v)
+	{
+		return Clamp(static_cast<int16_t>(v) / 32767.0f, -1.0f, 1.0f);
+	}
+
+	inline uint16_t FloatToUnorm16(float v, float offset, float scale)
+	{
+		float n = scale > 0.0f ? (v - offset) / scale : 0.0f;
+		return static_cast<uint16_t>(std::lround(Clamp(n, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	inline float Unorm16ToFloat(uint16_t v, float offset, float scale)
+	{
+		return offset + (v / 65535.0f) * scale;
+	}
+
+	uint32_t EncodeUV(VertexFormat format, const XMFLOAT2& uv, const VertexDequantization& dq)
+	{
+		if (format == VERTEX_FORMAT_COMPACT_HALF_UV)
+		{
+			return Pack(
+				PackedVector::XMConvertFloatToHalf(uv.x),
+				PackedVector::XMConvertFloatToHalf(uv.y));
+		}
+
+		return Pack(
+			FloatToUnorm16(uv.x, dq.uvOffset.x, dq.uvScale.x),
+			FloatToUnorm16(uv.y, dq.uvOffset.y, dq.uvScale.y));
+	}
+
+	XMFLOAT2 DecodeUV(VertexFormat format, uint32_t packed, const VertexDequantization& dq)
+	{
+		if (format == VERTEX_FORMAT_COMPACT_HALF_UV)
+		{
+			return XMFLOAT2(
+				PackedVector::XMConvertHalfToFloat(UnpackX(packed)),
+				PackedVector::XMConvertHalfToFloat(UnpackY(packed)));
+		}
+
+		return XMFLOAT2(
+			Unorm16ToFloat(UnpackX(packed), dq.uvOffset.x, dq.uvScale.x),
+			Unorm16ToFloat(UnpackY(packed), dq.uvOffset.y, dq.uvScale.y));
+	}
+
+	// Onto the octahedron's [-1, 1] square, see EncodeOctahedral
+	void FoldOctahedral(const XMFLOAT3& v, float& x, float& y)
+	{
+		float l1 = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+		if (l1 == 0.0f)
+		{
+			x = y = 0.0f;
+			return;
+		}
+
+		x = v.x / l1;
+		y = v.y / l1;
+		if (v.z < 0.0f)
+		{
+			float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+			float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+			x = foldedX;
+			y = foldedY;
+		}
+	}
+
+	XMFLOAT3 UnfoldOctahedral(float x, float y)
+	{
+		float z = 1.0f - fabsf(x) - fabsf(y);
+
+		// Unfold the bottom half
+		float t = Clamp(-z, 0.0f, 1.0f);
+		x += x >= 0.0f ? -t : t;
+		y += y >= 0.0f ? -t : t;
+
+		float length = sqrtf(x * x + y * y + z * z);
+		return XMFLOAT3(x / length, y / length, z / length);
+	}
+}
+
+unsigned int VertexCompression::GetStride(VertexFormat format)
+{
+	switch (format)
+	{
+	case VERTEX_FORMAT_COMPACT_HALF_UV:
+	case VERTEX_FORMAT_COMPACT_UNORM_UV:
+		return sizeof(CompactVertex);
+	case VERTEX_FORMAT_QUANTIZED:
+		return sizeof(QuantizedVertex);
+	case VERTEX_FORMAT_FULL:
+	default:
+		return sizeof(Vertex);
+	}
+}
+
+VertexDequantization VertexCompression::CalculateDequantization(VertexFormat format, const Vertex* vertices, size_t count)
+{
+	VertexDequantization dq;
+	dq.positionOffset = XMFLOAT3(0, 0, 0);
+	dq.positionScale = XMFLOAT3(1, 1, 1);
+	dq.uvOffset = XMFLOAT2(0, 0);
+	dq.uvScale = XMFLOAT2(1, 1);
+
+	if (count == 0)
+		return dq;
+
+	if (format == VERTEX_FORMAT_QUANTIZED)
+	{
+		XMFLOAT3 min, max;
+		MeshData::CalculateBounds(vertices, count, min, max);
+		dq.positionOffset = min;
+		dq.positionScale = XMFLOAT3(max.x - min.x, max.y - min.y, max.z - min.z);
+	}
+
+	if (format == VERTEX_FORMAT_COMPACT_UNORM_UV || format == VERTEX_FORMAT_QUANTIZED)
+	{
+		XMFLOAT2 min = vertices[0].UV;
+		XMFLOAT2 max = vertices[0].UV;
+		for (size_t i = 1; i < count; i++)
+		{
+			min.x = fminf(min.x, vertices[i].UV.x);
+			min.y = fminf(min.y, vertices[i].UV.y);
+			max.x = fmaxf(max.x, vertices[i].UV.x);
+			max.y = fmaxf(max.y, vertices[i].UV.y);
+		}
+		dq.uvOffset = min;
+		dq.uvScale = XMFLOAT2(max.x - min.x, max.y - min.y);
+	}
+
+	return dq;
+}
+
+void VertexCompression::Encode(VertexFormat format, const Vertex* vertices, size_t count, const VertexDequantization& dq, std::vector<uint8_t>& out)
+{
+	out.resize(count * GetStride(format));
+	if (count == 0)
+		return;
+
+	if (format == VERTEX_FORMAT_FULL)
+	{
+		memcpy(&out[0], vertices, count * sizeof(Vertex));
+		return;
+	}
+
+	if (format == VERTEX_FORMAT_QUANTIZED)
+	{
+		QuantizedVertex* encoded = reinterpret_cast<QuantizedVertex*>(&out[0]);
+		for (size_t i = 0; i < count; i++)
+		{
+			const Vertex& v = vertices[i];
+			encoded[i].Position[0] = FloatToUnorm16(v.Position.x, dq.positionOffset.x, dq.positionScale.x);
+			encoded[i].Position[1] = FloatToUnorm16(v.Position.y, dq.positionOffset.y, dq.positionScale.y);
+			encoded[i].Position[2] = FloatToUnorm16(v.Position.z, dq.positionOffset.z, dq.positionScale.z);
+			encoded[i].Position[3] = 0;
+			encoded[i].Normal = EncodeOctahedral(v.Normal);
+			encoded[i].Tangent = EncodeTangent(v.Tangent);
+			encoded[i].UV = EncodeUV(format, v.UV, dq);
+		}
+		return;
+	}
+
+	CompactVertex* encoded = reinterpret_cast<CompactVertex*>(&out[0]);
+	for (size_t i = 0; i < count; i++)
+	{
+		const Vertex& v = vertices[i];
+		encoded[i].Position = v.Position;
+		encoded[i].Normal = EncodeOctahedral(v.Normal);
+		encoded[i].Tangent = EncodeTangent(v.Tangent);
+		encoded[i].UV = EncodeUV(format, v.UV, dq);
+	}
+}
+
+void VertexCompression::Decode(VertexFormat format, const void* data, size_t count, const VertexDequantization& dq, Vertex* out)
+{
+	if (format == VERTEX_FORMAT_FULL)
+	{
+		memcpy(out, data, count * sizeof(Vertex));
+		return;
+	}
+
+	if (format == VERTEX_FORMAT_QUANTIZED)
+	{
+		const QuantizedVertex* encoded = static_cast<const QuantizedVertex*>(data);
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i].Position = XMFLOAT3(
+				Unorm16ToFloat(encoded[i].Position[0], dq.positionOffset.x, dq.positionScale.x),
+				Unorm16ToFloat(encoded[i].Position[1], dq.positionOffset.y, dq.positionScale.y),
+				Unorm16ToFloat(encoded[i].Position[2], dq.positionOffset.z, dq.positionScale.z));
+			out[i].Normal = DecodeOctahedral(encoded[i].Normal);
+			out[i].Tangent = DecodeTangent(encoded[i].Tangent);
+			out[i].UV = DecodeUV(format, encoded[i].UV, dq);
+		}
+		return;
+	}
+
+	const CompactVertex* encoded = static_cast<const CompactVertex*>(data);
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i].Position = encoded[i].Position;
+		out[i].Normal = DecodeOctahedral(encoded[i].Normal);
+		out[i].Tangent = DecodeTangent(encoded[i].Tangent);
+		out[i].UV = DecodeUV(format, encoded[i].UV, dq);
+	}
+}
+
+// --------------------------------------------------------
+// Octahedral encoding
+// - Projects the unit sphere onto an octahedron, then
+//    unfolds the bottom half over the corners of the top
+//    half so the whole thing fits in a [-1, 1] square
+// - See "A Survey of Efficient Representations for
+//    Independent Unit Vectors" (Cigolle et al. 2014)
+// --------------------------------------------------------
+uint32_t VertexCompression::EncodeOctahedral(XMFLOAT3 v)
+{
+	float x;
+	float y;
+	FoldOctahedral(v, x, y);
+	return Pack(FloatToSnorm16(x), FloatToSnorm16(y));
+}
+
+XMFLOAT3 VertexCompression::DecodeOctahedral(uint32_t packed)
+{
+	return UnfoldOctahedral(Snorm16ToFloat(UnpackX(packed)), Snorm16ToFloat(UnpackY(packed)));
+}
+
+// --------------------------------------------------------
+// Tangents keep the sign of w in the sign of y. Y's -1 to 1
+// goes to a magnitude of 1 to 32767, which is never 0, so the
+// sign always survives. The shader reads that back as a
+// float, see OctDecodeTangent() in ShaderInclude.hlsli
+// --------------------------------------------------------
+uint32_t VertexCompression::EncodeTangent(XMFLOAT4 t)
+{
+	float x;
+	float y;
+	FoldOctahedral(XMFLOAT3(t.x, t.y, t.z), x, y);
+
+	int16_t magnitude = static_cast<int16_t>(1 + std::lround((Clamp(y, -1.0f, 1.0f) * 0.5f + 0.5f) * 32766.0f));
+	return Pack(FloatToSnorm16(x), static_cast<uint16_t>(t.w < 0.0f ? -magnitude : magnitude));
+}
+
+XMFLOAT4 VertexCompression::DecodeTangent(uint32_t packed)
+{
+	int16_t signedMagnitude = static_cast<int16_t>(UnpackY(packed));
+	float y = (abs(signedMagnitude) - 1) / 16383.0f - 1.0f;
+
+	XMFLOAT3 direction = UnfoldOctahedral(Snorm16ToFloat(UnpackX(packed)), Clamp(y, -1.0f, 1.0f));
+	return XMFLOAT4(direction.x, direction.y, direction.z, signedMagnitude < 0 ? -1.0f : 1.0f);
+}
+
+#ifdef _WIN32
+void VertexCompression::GetInputLayoutDesc(VertexFormat format, std::vector<D3D11_INPUT_ELEMENT_DESC>& out)
+{
+	DXGI_FORMAT positionFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+	DXGI_FORMAT normalFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+	DXGI_FORMAT tangentFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	DXGI_FORMAT uvFormat = DXGI_FORMAT_R32G32_FLOAT;
+
+	switch (format)
+	{
+	case VERTEX_FORMAT_COMPACT_HALF_UV:
+		normalFormat = DXGI_FORMAT_R16G16_SNORM;
+		tangentFormat = DXGI_FORMAT_R16G16_SNORM;
+		uvFormat = DXGI_FORMAT_R16G16_FLOAT;
+		break;
+	case VERTEX_FORMAT_COMPACT_UNORM_UV:
+		normalFormat = DXGI_FORMAT_R16G16_SNORM;
+		tangentFormat = DXGI_FORMAT_R16G16_SNORM;
+		uvFormat = DXGI_FORMAT_R16G16_UNORM;
+		break;
+	case VERTEX_FORMAT_QUANTIZED:
+		positionFormat = DXGI_FORMAT_R16G16B16A16_UNORM;
+		normalFormat = DXGI_FORMAT_R16G16_SNORM;
+		tangentFormat = DXGI_FORMAT_R16G16_SNORM;
+		uvFormat = DXGI_FORMAT_R16G16_UNORM;
+		break;
+	case VERTEX_FORMAT_FULL:
+	default:
+		break;
+	}
+
+	// Same order as every vertex struct - position, normal, tangent, uv
+	out.clear();
+	out.push_back({ "POSITION", 0, positionFormat, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+	out.push_back({ "NORMAL", 0, normalFormat, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+	out.push_back({ "TANGENT", 0, tangentFormat, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+	out.push_back({ "TEXCOORD", 0, uvFormat, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+}
+
+std::shared_ptr<SimpleVertexShader> VertexCompression::CreateVertexShader(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	VertexFormat format,
+	LPCWSTR shaderFile)
+{
+	// The input layout has to be validated against the shader's byte code,
+	// so the compiled shader gets read once here and again by SimpleShader
+	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	if (FAILED(D3DReadFileToBlob(shaderFile, shaderBlob.GetAddressOf())))
+		return nullptr;
+
+	std::vector<D3D11_INPUT_ELEMENT_DESC> desc;
+	GetInputLayoutDesc(format, desc);
+
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	if (FAILED(device->CreateInputLayout(
+		&desc[0],
+		(unsigned int)desc.size(),
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		inputLayout.GetAddressOf())))
+		return nullptr;
+
+	return std::make_shared<SimpleVertexShader>(device, context, shaderFile, inputLayout, false);
+}
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "Vertex.h"
+
+// Only the input layouts and shaders need D3D, so headless tools
+// and tests that build elsewhere still get all of the encoding
+#ifdef _WIN32
+#include <d3d11.h>
+#include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+#include "SimpleShader.h"
+#endif
+
+// --------------------------------------------------------
+// The layouts a mesh's vertex buffer can be stored in
+//
+// Anything other than FULL must be drawn with a vertex
+// shader created by VertexCompression::CreateVertexShader
+// --------------------------------------------------------
+enum VertexFormat
+{
+	VERTEX_FORMAT_FULL,				// 48 bytes - the regular Vertex, all 32 bit floats
+	VERTEX_FORMAT_COMPACT_HALF_UV,	// 24 bytes - float3 position, octahedral normal and tangent, half float uv
+	VERTEX_FORMAT_COMPACT_UNORM_UV,	// 24 bytes - same as above, but the uv is unorm16 over the mesh's uv range
+	VERTEX_FORMAT_QUANTIZED,		// 20 bytes - unorm16 position over the mesh bounds, octahedral normal and tangent, unorm16 uv
+	VERTEX_FORMAT_COUNT
+};
+
+// Normals and tangents are octahedral encoded into two snorm16s and
+// packed into a single uint (x in the low half), as is the uv. The
+// tangent's y also carries its w, see EncodeTangent
+struct CompactVertex
+{
+	DirectX::XMFLOAT3 Position;
+	uint32_t Normal;
+	uint32_t Tangent;
+	uint32_t UV;
+};
+
+// The 4th position component is padding so the position stays 8 byte aligned
+struct QuantizedVertex
+{
+	uint16_t Position[4];
+	uint32_t Normal;
+	uint32_t Tangent;
+	uint32_t UV;
+};
+
+// --------------------------------------------------------
+// What a vertex shader needs to bring unorm16 data back
+// into its original range:  original = offset + value * scale
+//
+// Formats that don't quantize a value get an offset of 0
+// and a scale of 1 so the shader can always apply it
+// --------------------------------------------------------
+struct VertexDequantization
+{
+	DirectX::XMFLOAT3 positionOffset;
+	DirectX::XMFLOAT3 positionScale;
+	DirectX::XMFLOAT2 uvOffset;
+	DirectX::XMFLOAT2 uvScale;
+};
+
+/*
+	Encodes and decodes the compact vertex formats, and builds the input
+	layouts that match them. None of the encoding touches D3D.
+
+	Worst case round trip error of each encoding:
+	- Octahedral snorm16 normals - under 0.0001 radians
+	- Tangents, which give up a bit of y for the sign - under 0.00015 radians
+	- unorm16 positions/uvs - half a step, (range / 65535) / 2
+	- Half float uvs - a relative error of 2^-11, so only use them
+	   for uvs that stay close to the 0-1 range
+*/
+class VertexCompression
+{
+public:
+	/// <summary>
+	/// Size in bytes of a single vertex of the given format
+	/// </summary>
+	static unsigned int GetStride(VertexFormat format);
+
+	/// <summary>
+	/// Find the ranges the given vertices will be quantized into for the given format
+	/// </summary>
+	static VertexDequantization CalculateDequantization(VertexFormat format, const Vertex* vertices, size_t count);
+	/// <summary>
+	/// Encode vertices into the given format, replacing the contents of out
+	/// </summary>
+	static void Encode(VertexFormat format, const Vertex* vertices, size_t count, const VertexDequantization& dequantization, std::vector<uint8_t>& out);
+	/// <summary>
+	/// Decode vertices of the given format back into full vertices
+	/// </summary>
+	static void Decode(VertexFormat format, const void* data, size_t count, const VertexDequantization& dequantization, Vertex* out);
+
+	/// <summary>
+	/// Octahedral encode a unit vector into two snorm16s packed in a uint
+	/// </summary>
+	static uint32_t EncodeOctahedral(DirectX::XMFLOAT3 v);
+	/// <summary>
+	/// Decode an octahedral encoded uint back into a unit vector
+	/// </summary>
+	static DirectX::XMFLOAT3 DecodeOctahedral(uint32_t packed);
+	/// <summary>
+	/// Octahedral encode a tangent's direction, with the sign of its w
+	/// stored as the sign of y. Y's magnitude then only has 15 bits
+	/// </summary>
+	static uint32_t EncodeTangent(DirectX::XMFLOAT4 t);
+	/// <summary>
+	/// Decode a tangent from EncodeTangent. W comes back as exactly 1 or -1
+	/// </summary>
+	static DirectX::XMFLOAT4 DecodeTangent(uint32_t packed);
+
+#ifdef _WIN32
+	/// <summary>
+	/// Get the input layout description for the given format
+	/// </summary>
+	static void GetInputLayoutDesc(VertexFormat format, std::vector<D3D11_INPUT_ELEMENT_DESC>& out);
+	/// <summary>
+	/// Load a vertex shader that reads the given format. The shader's input
+	/// has to be compatible, see CompactVertexShader.hlsl
+	/// </summary>
+	static std::shared_ptr<SimpleVertexShader> CreateVertexShader(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		VertexFormat format,
+		LPCWSTR shaderFile);
+#endif
+};
@@ -35,7 +35,7 @@ VertexToPixel main( VertexShaderInput input )
 	output.uv = input.uv;
 
 	output.normal = mul((float3x3)worldInvTranspose, input.normal); // Perfect
-	output.tangent = mul((float3x3)world, input.tangent);
+	output.tangent = float4(mul((float3x3)world, input.tangent.xyz), input.tangent.w);
 	output.worldPosition = mul(world, float4(input.localPosition, 1.0f)).xyz;
 
 	// Whatever we return will make its way through the pipeline to the
@@ -99,9 +99,9 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	// Simplifications include not re-normalizing the same vector more than once!
 	float3 N = normalize(input.normal); // Must be normalized here or before
-	float3 T = normalize(input.tangent); // Must be normalized here or before
+	float3 T = normalize(input.tangent.xyz); // Must be normalized here or before
 	T = normalize(T - N * dot(T, N)); // Gram-Schmidt assumes T&N are normalized!
-	float3 B = cross(T, N);
+	float3 B = cross(T, N) * input.tangent.w; // Flipped where the uvs are mirrored
 	float3x3 TBN = float3x3(T, B, N);
 
 	// Assumes that input.normal is the normal later in the shader
@@ -118,5 +118,5 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float3 light5 = PointLight(pointLight2, input, ambient, roughness);
 
 	float3 totalLight = light1 + light2 + light3 + light4 + light5;
-	return float4(pow(totalLight, 1.0f / 2.2f), 1);
+	return float4(pow(totalLight, 1.0f / 2.2f), colorTint.a);
 }
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Frustum.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Objects in the benchmark scene, odd so the last group of four is partial
+	const size_t BENCHMARK_OBJECT_COUNT = 1000003;
+
+	// --------------------------------------------------------
+	// A camera off the origin looking slightly down and to the
+	// side, so no plane lines up with an axis
+	// --------------------------------------------------------
+	Frustum MakeFrustum()
+	{
+		XMMATRIX view = XMMatrixLookToLH(
+			XMVectorSet(1.0f, 2.0f, -3.0f, 0.0f),
+			XMVector3Normalize(XMVectorSet(0.3f, -0.1f, 1.0f, 0.0f)),
+			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(0.8f, 16.0f / 9.0f, 0.1f, 500.0f);
+
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, projection));
+		return Frustum::FromViewProjection(viewProj);
+	}
+
+	// --------------------------------------------------------
+	// Spheres and boxes scattered well past the far plane on
+	// every side, so about as many are culled by each plane.
+	// The w of centers and extents is junk that must be ignored
+	// --------------------------------------------------------
+	void MakeScene(size_t count, std::vector<XMFLOAT4>& spheres, std::vector<XMFLOAT4>& centers, std::vector<XMFLOAT4>& extents)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> position(-600.0f, 600.0f);
+		std::uniform_real_distribution<float> size(0.0f, 5.0f);
+
+		spheres.resize(count);
+		centers.resize(count);
+		extents.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			spheres[i] = XMFLOAT4(position(random), position(random) * 0.2f, position(random), size(random));
+			centers[i] = XMFLOAT4(spheres[i].x, spheres[i].y, spheres[i].z, 7.0f);
+			extents[i] = XMFLOAT4(size(random), size(random), size(random), -3.0f);
+		}
+	}
+
+	size_t CullSpheresScalar(const Frustum& frustum, const std::vector<XMFLOAT4>& spheres, size_t count, unsigned int* visible)
+	{
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (frustum.IntersectsSphere(XMFLOAT3(spheres[i].x, spheres[i].y, spheres[i].z), spheres[i].w))
+				visible[visibleCount++] = (unsigned int)i;
+		}
+		return visibleCount;
+	}
+
+	size_t CullBoxesScalar(const Frustum& frustum, const std::vector<XMFLOAT4>& centers, const std::vector<XMFLOAT4>& extents, size_t count, unsigned int* visible)
+	{
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (frustum.IntersectsBox(XMFLOAT3(centers[i].x, centers[i].y, centers[i].z), XMFLOAT3(extents[i].x, extents[i].y, extents[i].z)))
+				visible[visibleCount++] = (unsigned int)i;
+		}
+		return visibleCount;
+	}
+
+	// The batched and one at a time paths have to agree index for index
+	bool SameVisible(const std::vector<unsigned int>& a, size_t aCount, const std::vector<unsigned int>& b, size_t bCount)
+	{
+		return aCount == bCount && std::equal(a.begin(), a.begin() + aCount, b.begin());
+	}
+}
+
+TEST(FrustumCullsAroundCamera)
+{
+	XMMATRIX view = XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 1.0f, 100.0f)));
+	Frustum frustum = Frustum::FromViewProjection(viewProj);
+
+	// Planes are normalized, so a sphere can be placed against one exactly
+	for (const XMFLOAT4& plane : frustum.planes)
+		CHECK(fabsf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z - 1.0f) < 1e-5f);
+
+	CHECK(frustum.IntersectsSphere(XMFLOAT3(0.0f, 0.0f, 10.0f), 1.0f));
+	CHECK(!frustum.IntersectsSphere(XMFLOAT3(0.0f, 0.0f, -10.0f), 1.0f));
+	CHECK(!frustum.IntersectsSphere(XMFLOAT3(0.0f, 0.0f, 110.0f), 5.0f));
+	CHECK(frustum.IntersectsSphere(XMFLOAT3(0.0f, 0.0f, 0.5f), 0.6f));
+	CHECK(!frustum.IntersectsSphere(XMFLOAT3(-20.0f, 0.0f, 10.0f), 1.0f));
+
+	CHECK(frustum.IntersectsBox(XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)));
+	CHECK(!frustum.IntersectsBox(XMFLOAT3(0.0f, 30.0f, 10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)));
+	CHECK(frustum.IntersectsBox(XMFLOAT3(0.0f, 30.0f, 10.0f), XMFLOAT3(1.0f, 25.0f, 1.0f)));
+}
+
+TEST(FrustumBatchesMatchScalar)
+{
+	Frustum frustum = MakeFrustum();
+	std::vector<XMFLOAT4> spheres;
+	std::vector<XMFLOAT4> centers;
+	std::vector<XMFLOAT4> extents;
+	MakeScene(20000, spheres, centers, extents);
+
+	// Every count up to a few groups of four, for the partial last group,
+	// then the whole scene
+	std::vector<unsigned int> batched(spheres.size());
+	std::vector<unsigned int> scalar(spheres.size());
+	std::vector<size_t> counts;
+	for (size_t count = 0; count <= 13; count++)
+		counts.push_back(count);
+	counts.push_back(spheres.size());
+
+	size_t visibleSpheres = 0;
+	size_t visibleBoxes = 0;
+	for (size_t count : counts)
+	{
+		size_t batchedCount = frustum.CullSpheres(spheres.data(), count, batched.data());
+		size_t scalarCount = CullSpheresScalar(frustum, spheres, count, scalar.data());
+		CHECK(SameVisible(batched, batchedCount, scalar, scalarCount));
+		visibleSpheres = scalarCount;
+
+		batchedCount = frustum.CullBoxes(centers.data(), extents.data(), count, batched.data());
+		scalarCount = CullBoxesScalar(frustum, centers, extents, count, scalar.data());
+		CHECK(SameVisible(batched, batchedCount, scalar, scalarCount));
+		visibleBoxes = scalarCount;
+	}
+
+	// Otherwise agreeing wouldn't say much
+	CHECK(visibleSpheres > 0 && visibleSpheres < spheres.size() / 2);
+	CHECK(visibleBoxes > 0 && visibleBoxes < centers.size() / 2);
+}
+
+BENCHMARK(FrustumCulling)
+{
+	Frustum frustum = MakeFrustum();
+	std::vector<XMFLOAT4> spheres;
+	std::vector<XMFLOAT4> centers;
+	std::vector<XMFLOAT4> extents;
+	MakeScene(BENCHMARK_OBJECT_COUNT, spheres, centers, extents);
+	std::vector<unsigned int> visible(BENCHMARK_OBJECT_COUNT);
+
+	size_t visibleCount = 0;
+	double spheresBatched = TimeBest(20, [&]() { visibleCount = frustum.CullSpheres(spheres.data(), spheres.size(), visible.data()); });
+	double spheresScalar = TimeBest(20, [&]() { CullSpheresScalar(frustum, spheres, spheres.size(), visible.data()); });
+	printf("%zu spheres, %zu visible: %.2f ms, scalar %.2f ms, %.2fx\n",
+		spheres.size(), visibleCount, spheresBatched * 1000, spheresScalar * 1000, spheresScalar / spheresBatched);
+
+	double boxesBatched = TimeBest(20, [&]() { visibleCount = frustum.CullBoxes(centers.data(), extents.data(), centers.size(), visible.data()); });
+	double boxesScalar = TimeBest(20, [&]() { CullBoxesScalar(frustum, centers, extents, centers.size(), visible.data()); });
+	printf("%zu boxes, %zu visible: %.2f ms, scalar %.2f ms, %.2fx\n",
+		centers.size(), visibleCount, boxesBatched * 1000, boxesScalar * 1000, boxesScalar / boxesBatched);
+}
@@ -0,0 +1,260 @@
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "GeometryArena.h"
+
+namespace
+{
+	// --------------------------------------------------------
+	// Every test runs against the arena without a device, so
+	// only the bookkeeping is exercised. Nothing is written
+	// without a context either, so no geometry is passed in
+	// --------------------------------------------------------
+	unsigned int AllocateEmpty(VertexFormat format, unsigned int vertexCount, unsigned int indexCount)
+	{
+		return GeometryArena::GetInstance().Allocate(format, nullptr, vertexCount, nullptr, indexCount);
+	}
+
+	void FreeAll(std::vector<unsigned int>& handles)
+	{
+		for (unsigned int handle : handles)
+			GeometryArena::GetInstance().Free(handle);
+		handles.clear();
+	}
+
+	// Sorted by start, each range has to end before the next begins and inside the buffer
+	bool Disjoint(std::vector<std::pair<unsigned int, unsigned int>> ranges, unsigned int capacity)
+	{
+		std::sort(ranges.begin(), ranges.end());
+		for (size_t i = 0; i < ranges.size(); i++)
+		{
+			unsigned int end = ranges[i].first + ranges[i].second;
+			if (end > capacity || (i + 1 < ranges.size() && end > ranges[i + 1].first))
+				return false;
+		}
+		return true;
+	}
+
+	// No two live allocations share a vertex of the same buffer or an index
+	bool NoOverlaps(const std::vector<unsigned int>& handles)
+	{
+		GeometryArena& arena = GeometryArena::GetInstance();
+		std::vector<std::pair<unsigned int, unsigned int>> vertexRanges[VERTEX_FORMAT_COUNT];
+		std::vector<std::pair<unsigned int, unsigned int>> indexRanges;
+		for (unsigned int handle : handles)
+		{
+			const GeometryAllocation& allocation = arena.GetAllocation(handle);
+			vertexRanges[allocation.format].push_back(std::make_pair(allocation.baseVertex, allocation.vertexCount));
+			indexRanges.push_back(std::make_pair(allocation.firstIndex, allocation.indexCount));
+		}
+
+		for (int format = 0; format < VERTEX_FORMAT_COUNT; format++)
+		{
+			if (!Disjoint(vertexRanges[format], arena.GetVertexCapacity((VertexFormat)format)))
+				return false;
+		}
+		return Disjoint(indexRanges, arena.GetIndexCapacity());
+	}
+}
+
+TEST(GeometryArenaGrowsByDoubling)
+{
+	GeometryArena& arena = GeometryArena::GetInstance();
+	std::vector<unsigned int> handles;
+
+	// Exactly full at the starting size, or whatever an earlier test grew it to
+	unsigned int vertexCapacity = std::max(arena.GetVertexCapacity(VERTEX_FORMAT_FULL), (unsigned int)GEOMETRY_ARENA_INITIAL_VERTICES);
+	unsigned int indexCapacity = std::max(arena.GetIndexCapacity(), (unsigned int)GEOMETRY_ARENA_INITIAL_INDICES);
+	handles.push_back(AllocateEmpty(VERTEX_FORMAT_FULL, vertexCapacity, indexCapacity));
+	CHECK(handles[0] != GEOMETRY_ARENA_INVALID);
+	CHECK(arena.GetVertexCapacity(VERTEX_FORMAT_FULL) == vertexCapacity);
+	CHECK(arena.GetIndexCapacity() == indexCapacity);
+
+	// One more of each doubles both, and what was there stays put
+	handles.push_back(AllocateEmpty(VERTEX_FORMAT_FULL, 1, 1));
+	CHECK(arena.GetVertexCapacity(VERTEX_FORMAT_FULL) == vertexCapacity * 2);
+	CHECK(arena.GetIndexCapacity() == indexCapacity * 2);
+	CHECK(arena.GetAllocation(handles[0]).baseVertex == 0 && arena.GetAllocation(handles[0]).firstIndex == 0);
+	CHECK(arena.GetAllocation(handles[1]).baseVertex == vertexCapacity);
+	CHECK(arena.GetAllocation(handles[1]).firstIndex == indexCapacity);
+
+	// Far too big for one doubling keeps doubling until it fits
+	handles.push_back(AllocateEmpty(VERTEX_FORMAT_FULL, vertexCapacity * 5, 1));
+	CHECK(arena.GetVertexCapacity(VERTEX_FORMAT_FULL) == vertexCapacity * 8);
+	CHECK(arena.GetIndexCapacity() == indexCapacity * 2);
+	CHECK(NoOverlaps(handles));
+
+	// Other formats have buffers of their own
+	unsigned int quantizedCapacity = arena.GetVertexCapacity(VERTEX_FORMAT_QUANTIZED);
+	handles.push_back(AllocateEmpty(VERTEX_FORMAT_QUANTIZED, 1, 1));
+	CHECK(arena.GetVertexCapacity(VERTEX_FORMAT_QUANTIZED) == std::max(quantizedCapacity, (unsigned int)GEOMETRY_ARENA_INITIAL_VERTICES));
+
+	// Nothing, or more than a buffer could ever hold, isn't allocated
+	CHECK(AllocateEmpty(VERTEX_FORMAT_FULL, 0, 3) == GEOMETRY_ARENA_INVALID);
+	CHECK(AllocateEmpty(VERTEX_FORMAT_FULL, 0xFFFFFFF0u, 3) == GEOMETRY_ARENA_INVALID);
+
+	FreeAll(handles);
+	CHECK(arena.GetFragmentation() == 0.0f);
+}
+
+TEST(GeometryArenaAllocatesAfterMakingRoom)
+{
+	GeometryArena& arena = GeometryArena::GetInstance();
+	std::vector<unsigned int> handles;
+
+	// Fill the index buffer with eight meshes and free every other one.
+	// The vertex buffer has plenty of room, with holes the size of the
+	// freed meshes
+	handles.push_back(AllocateEmpty(VERTEX_FORMAT_FULL, 10, 3));
+	arena.Free(handles.back());
+	handles.clear();
+	unsigned int indexCapacity = arena.GetIndexCapacity();
+	for (int i = 0; i < 8; i++)
+		handles.push_back(AllocateEmpty(VERTEX_FORMAT_FULL, 10, indexCapacity / 8));
+	CHECK(arena.GetIndexCapacity() == indexCapacity);
+	for (int i = 0; i < 8; i += 2)
+		arena.Free(handles[i]);
+	std::vector<unsigned int> survivors = { handles[1], handles[3], handles[5], handles[7] };
+	handles = survivors;
+
+	// Doubling leaves a free range at the end of the index buffer that
+	// is still too small, so it also has to compact. The vertex range
+	// best fits one of the holes, which compacting then packs a
+	// survivor into, unless it's taken only after making room
+	unsigned int big = AllocateEmpty(VERTEX_FORMAT_FULL, 5, indexCapacity + indexCapacity / 8);
+	CHECK(big != GEOMETRY_ARENA_INVALID);
+	handles.push_back(big);
+	CHECK(arena.GetIndexCapacity() == indexCapacity * 2);
+	CHECK(NoOverlaps(handles));
+
+	// Survivors were packed to the front in order, the new mesh after them
+	for (size_t i = 0; i < survivors.size(); i++)
+	{
+		const GeometryAllocation& allocation = arena.GetAllocation(survivors[i]);
+		CHECK(allocation.baseVertex == i * 10 && allocation.vertexCount == 10);
+		CHECK(allocation.firstIndex == i * (indexCapacity / 8) && allocation.indexCount == indexCapacity / 8);
+	}
+	CHECK(arena.GetAllocation(big).baseVertex == 40);
+	CHECK(arena.GetAllocation(big).firstIndex == indexCapacity / 2);
+
+	// And what the allocators think is free really is
+	handles.push_back(AllocateEmpty(VERTEX_FORMAT_FULL, 100, 100));
+	CHECK(NoOverlaps(handles));
+
+	FreeAll(handles);
+	CHECK(arena.GetFragmentation() == 0.0f);
+}
+
+TEST(GeometryArenaCompactKeepsOffsetsConsistent)
+{
+	GeometryArena& arena = GeometryArena::GetInstance();
+	std::mt19937 random(9);
+	std::uniform_int_distribution<unsigned int> size(1, 500);
+
+	std::vector<unsigned int> handles;
+	for (int i = 0; i < 400; i++)
+		handles.push_back(AllocateEmpty((VertexFormat)(random() % VERTEX_FORMAT_COUNT), size(random), size(random) * 3));
+
+	// Free a random half, which breaks up the free space
+	std::shuffle(handles.begin(), handles.end(), random);
+	for (size_t i = handles.size() / 2; i < handles.size(); i++)
+		arena.Free(handles[i]);
+	handles.resize(handles.size() / 2);
+	CHECK(arena.GetFragmentation() > 0.0f);
+
+	std::vector<GeometryAllocation> before;
+	for (unsigned int handle : handles)
+		before.push_back(arena.GetAllocation(handle));
+
+	arena.Compact();
+	CHECK(arena.GetFragmentation() == 0.0f);
+	CHECK(NoOverlaps(handles));
+
+	// Every allocation kept its size and format, and each buffer is now
+	// packed from the front in the same order as before
+	std::vector<size_t> byVertex(handles.size());
+	std::vector<size_t> byIndex(handles.size());
+	for (size_t i = 0; i < handles.size(); i++)
+		byVertex[i] = byIndex[i] = i;
+	std::sort(byVertex.begin(), byVertex.end(), [&](size_t a, size_t b)
+		{ return before[a].baseVertex < before[b].baseVertex; });
+	std::sort(byIndex.begin(), byIndex.end(), [&](size_t a, size_t b)
+		{ return before[a].firstIndex < before[b].firstIndex; });
+
+	int mismatches = 0;
+	unsigned int nextVertex[VERTEX_FORMAT_COUNT] = {};
+	for (size_t i : byVertex)
+	{
+		const GeometryAllocation& allocation = arena.GetAllocation(handles[i]);
+		mismatches += allocation.format != before[i].format;
+		mismatches += allocation.vertexCount != before[i].vertexCount;
+		mismatches += allocation.indexCount != before[i].indexCount;
+		mismatches += allocation.baseVertex != nextVertex[allocation.format];
+		nextVertex[allocation.format] += allocation.vertexCount;
+	}
+	unsigned int nextIndex = 0;
+	for (size_t i : byIndex)
+	{
+		const GeometryAllocation& allocation = arena.GetAllocation(handles[i]);
+		mismatches += allocation.firstIndex != nextIndex;
+		nextIndex += allocation.indexCount;
+	}
+	CHECK(mismatches == 0);
+
+	// Packed, so updating leaves everything be
+	before.clear();
+	for (unsigned int handle : handles)
+		before.push_back(arena.GetAllocation(handle));
+	arena.Update();
+	for (size_t i = 0; i < handles.size(); i++)
+		mismatches += memcmp(&before[i], &arena.GetAllocation(handles[i]), sizeof(GeometryAllocation)) != 0;
+	CHECK(mismatches == 0);
+
+	// Freed handles are reused and stale ones ignored
+	unsigned int stale = handles.back();
+	arena.Free(stale);
+	arena.Free(stale);
+	CHECK(arena.GetAllocation(stale).vertexCount == 0);
+	handles.back() = AllocateEmpty(VERTEX_FORMAT_FULL, 3, 3);
+	CHECK(handles.back() == stale);
+
+	FreeAll(handles);
+	CHECK(arena.GetFragmentation() == 0.0f);
+}
+
+TEST(GeometryArenaSkipsRedundantBinds)
+{
+	GeometryArena& arena = GeometryArena::GetInstance();
+	unsigned int handle = AllocateEmpty(VERTEX_FORMAT_FULL, 3, 3);
+
+	arena.InvalidateBindings();
+	unsigned int binds = arena.GetBindCount();
+
+	// The vertex and index buffers, then nothing for the same format
+	arena.Bind(VERTEX_FORMAT_FULL);
+	CHECK(arena.GetBindCount() == binds + 2);
+	arena.Bind(VERTEX_FORMAT_FULL);
+	CHECK(arena.GetBindCount() == binds + 2);
+
+	// The index buffer is shared, so another format only needs its vertices
+	arena.Bind(VERTEX_FORMAT_QUANTIZED);
+	CHECK(arena.GetBindCount() == binds + 3);
+	arena.Bind(VERTEX_FORMAT_QUANTIZED);
+	CHECK(arena.GetBindCount() == binds + 3);
+
+	// Once something else may have bound buffers, both go again
+	arena.InvalidateBindings();
+	arena.Bind(VERTEX_FORMAT_QUANTIZED);
+	CHECK(arena.GetBindCount() == binds + 5);
+
+	// As they do after compacting, since the buffers were replaced
+	arena.Compact();
+	arena.Bind(VERTEX_FORMAT_QUANTIZED);
+	CHECK(arena.GetBindCount() == binds + 7);
+
+	arena.Free(handle);
+}
@@ -0,0 +1,318 @@
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "MeshBvh.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Triangles and rays in the benchmark
+	const int BENCHMARK_TRIANGLES = 100000;
+	const int BENCHMARK_RAYS = 20000;
+	// Rays the brute force benchmark casts, as each tests every triangle
+	const int BENCHMARK_BRUTE_FORCE_RAYS = 500;
+
+	struct Ray
+	{
+		XMFLOAT3 origin;
+		XMFLOAT3 direction;
+	};
+
+	struct TriangleSoup
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+
+		void AddTriangle(XMFLOAT3 a, XMFLOAT3 b, XMFLOAT3 c)
+		{
+			Vertex corners[3] = {};
+			corners[0].Position = a;
+			corners[1].Position = b;
+			corners[2].Position = c;
+			for (int i = 0; i < 3; i++)
+			{
+				indices.push_back((unsigned int)vertices.size());
+				vertices.push_back(corners[i]);
+			}
+		}
+	};
+
+	// --------------------------------------------------------
+	// Moller-Trumbore against every triangle, one at a time,
+	// with the same rules as the BVH: either side counts, and
+	// a hit right on an edge or at the origin counts
+	// --------------------------------------------------------
+	bool BruteForce(const TriangleSoup& mesh, const Ray& ray, float maxDistance, RayHit& hit)
+	{
+		XMVECTOR origin = XMLoadFloat3(&ray.origin);
+		XMVECTOR direction = XMLoadFloat3(&ray.direction);
+		float closest = maxDistance;
+		bool found = false;
+		for (size_t i = 0; i + 3 <= mesh.indices.size(); i += 3)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&mesh.vertices[mesh.indices[i]].Position);
+			XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&mesh.vertices[mesh.indices[i + 1]].Position), v0);
+			XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&mesh.vertices[mesh.indices[i + 2]].Position), v0);
+
+			XMVECTOR p = XMVector3Cross(direction, e2);
+			float det = XMVectorGetX(XMVector3Dot(e1, p));
+			if (det == 0.0f)
+				continue;
+
+			XMVECTOR s = XMVectorSubtract(origin, v0);
+			XMVECTOR q = XMVector3Cross(s, e1);
+			float u = XMVectorGetX(XMVector3Dot(s, p)) / det;
+			float v = XMVectorGetX(XMVector3Dot(direction, q)) / det;
+			float t = XMVectorGetX(XMVector3Dot(e2, q)) / det;
+			if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < closest)
+			{
+				closest = t;
+				hit.distance = t;
+				hit.u = u;
+				hit.v = v;
+				hit.triangle = (unsigned int)(i / 3);
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	// --------------------------------------------------------
+	// Casts every ray both ways and counts where they disagree.
+	// Two triangles can be hit at the same distance where they
+	// share an edge, so the distance is compared, not which
+	// triangle it was
+	// --------------------------------------------------------
+	int CountMismatches(const MeshBvh& bvh, const TriangleSoup& mesh, const std::vector<Ray>& rays, float maxDistance)
+	{
+		int mismatches = 0;
+		for (const Ray& ray : rays)
+		{
+			RayHit expected;
+			RayHit actual;
+			bool expectedHit = BruteForce(mesh, ray, maxDistance, expected);
+			bool actualHit = bvh.Intersect(ray.origin, ray.direction, maxDistance, actual);
+			mismatches += expectedHit != actualHit;
+			mismatches += bvh.IntersectAny(ray.origin, ray.direction, maxDistance) != expectedHit;
+			if (expectedHit && actualHit)
+				mismatches += fabsf(expected.distance - actual.distance) > 0.0001f * (1.0f + expected.distance);
+		}
+		return mismatches;
+	}
+
+	// Triangles of all sizes and orientations, some overlapping, spread around the origin
+	TriangleSoup MakeSoup(std::mt19937& random, int count)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> size(0.01f, 1.5f);
+		TriangleSoup mesh;
+		for (int i = 0; i < count; i++)
+		{
+			XMFLOAT3 center(unit(random) * 20.0f, unit(random) * 20.0f, unit(random) * 20.0f);
+			float s = size(random);
+			XMFLOAT3 corners[3];
+			for (int c = 0; c < 3; c++)
+				corners[c] = XMFLOAT3(center.x + unit(random) * s, center.y + unit(random) * s, center.z + unit(random) * s);
+			mesh.AddTriangle(corners[0], corners[1], corners[2]);
+		}
+		return mesh;
+	}
+
+	// Rays from outside the soup aimed somewhere inside it, so most of them hit
+	std::vector<Ray> MakeRays(std::mt19937& random, int count)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<Ray> rays(count);
+		for (Ray& ray : rays)
+		{
+			ray.origin = XMFLOAT3(unit(random) * 40.0f, unit(random) * 40.0f, unit(random) * 40.0f);
+			XMFLOAT3 target(unit(random) * 15.0f, unit(random) * 15.0f, unit(random) * 15.0f);
+			ray.direction = XMFLOAT3(target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z);
+		}
+		return rays;
+	}
+}
+
+TEST(MeshBvhMatchesBruteForce)
+{
+	std::mt19937 random(4);
+	TriangleSoup mesh = MakeSoup(random, 3000);
+	MeshBvh bvh;
+	bvh.Build(mesh.vertices.data(), mesh.indices.data(), (unsigned int)mesh.indices.size());
+	CHECK(bvh.IsBuilt());
+	CHECK(bvh.GetTriangleCount() == 3000);
+
+	std::vector<Ray> rays = MakeRays(random, 3000);
+	CHECK(CountMismatches(bvh, mesh, rays, FLT_MAX) == 0);
+
+	// Short rays stop before most of what they'd hit
+	CHECK(CountMismatches(bvh, mesh, rays, 0.3f) == 0);
+
+	// And the closest hit's details match when it's the same triangle
+	int detailMismatches = 0;
+	for (const Ray& ray : rays)
+	{
+		RayHit expected;
+		RayHit actual;
+		if (BruteForce(mesh, ray, FLT_MAX, expected) && bvh.Intersect(ray.origin, ray.direction, FLT_MAX, actual) &&
+			expected.triangle == actual.triangle)
+		{
+			detailMismatches += fabsf(expected.u - actual.u) > 0.0001f || fabsf(expected.v - actual.v) > 0.0001f;
+		}
+	}
+	CHECK(detailMismatches == 0);
+}
+
+TEST(MeshBvhAxisAlignedRays)
+{
+	// A floor of unit tiles, so node bounds fall on whole numbers
+	const int tiles = 16;
+	TriangleSoup mesh;
+	for (int x = 0; x < tiles; x++)
+	{
+		for (int z = 0; z < tiles; z++)
+		{
+			XMFLOAT3 a((float)x, 0.0f, (float)z);
+			XMFLOAT3 b((float)x + 1, 0.0f, (float)z);
+			XMFLOAT3 c((float)x + 1, 0.0f, (float)z + 1);
+			XMFLOAT3 d((float)x, 0.0f, (float)z + 1);
+			mesh.AddTriangle(a, c, b);
+			mesh.AddTriangle(a, d, c);
+		}
+	}
+	MeshBvh bvh;
+	bvh.Build(mesh.vertices.data(), mesh.indices.data(), (unsigned int)mesh.indices.size());
+
+	// Straight down from on top of every tile edge, including the floor's
+	// own, which starts each ray on some node's slab planes with zero x
+	// and z directions. Then sideways along the floor's surface, which
+	// only grazes it, and straight down off its edge
+	std::vector<Ray> rays;
+	for (int x = 0; x <= tiles; x++)
+	{
+		for (int z = 0; z <= tiles * 2; z++)
+		{
+			Ray down = { XMFLOAT3((float)x, 5.0f, z * 0.5f), XMFLOAT3(0.0f, -1.0f, 0.0f) };
+			Ray flipped = { XMFLOAT3(z * 0.5f, 5.0f, (float)x), XMFLOAT3(-0.0f, -2.0f, -0.0f) };
+			rays.push_back(down);
+			rays.push_back(flipped);
+		}
+		Ray along = { XMFLOAT3(-1.0f, 0.0f, x + 0.5f), XMFLOAT3(1.0f, 0.0f, 0.0f) };
+		rays.push_back(along);
+	}
+	Ray off = { XMFLOAT3(tiles + 0.001f, 5.0f, 3.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) };
+	rays.push_back(off);
+	CHECK(CountMismatches(bvh, mesh, rays, FLT_MAX) == 0);
+
+	// Every downward ray lands on the floor, edge or not
+	int misses = 0;
+	for (const Ray& ray : rays)
+	{
+		RayHit hit;
+		if (ray.direction.y < 0.0f && ray.origin.x <= tiles)
+			misses += !bvh.Intersect(ray.origin, ray.direction, FLT_MAX, hit) || hit.distance * -ray.direction.y != 5.0f;
+	}
+	CHECK(misses == 0);
+}
+
+TEST(MeshBvhDepthIsBounded)
+{
+	// Small squares along x, each a fifth farther out than the last, so
+	// SAH splits keep peeling off the few farthest and the tree gets about
+	// as deep as it can. Each is a sliver below its diagonal, so a ray
+	// above it enters every box and hits nothing until the last square,
+	// which keeps the most on the traversal stack
+	TriangleSoup mesh;
+	float x = 1.0f;
+	unsigned int slivers = 0;
+	for (; x < 1e36f; x *= 1.2f, slivers++)
+		mesh.AddTriangle(XMFLOAT3(x, -1.0f, -1.0f), XMFLOAT3(x, 1.0f, 1.0f), XMFLOAT3(x, 1.0f, 0.9f));
+	mesh.AddTriangle(XMFLOAT3(x, -2.0f, -2.0f), XMFLOAT3(x, 2.0f, -2.0f), XMFLOAT3(x, 0.0f, 2.0f));
+
+	MeshBvh bvh;
+	bvh.Build(mesh.vertices.data(), mesh.indices.data(), (unsigned int)mesh.indices.size());
+	CHECK(bvh.GetDepth() > MESH_BVH_MAX_SAH_DEPTH / 2);
+	CHECK(bvh.GetDepth() <= MESH_BVH_MAX_DEPTH);
+
+	RayHit hit;
+	CHECK(bvh.Intersect(XMFLOAT3(0.0f, -0.5f, 0.5f), XMFLOAT3(1.0f, 0.0f, 0.0f), FLT_MAX, hit));
+	CHECK(hit.triangle == slivers && fabsf(hit.distance - x) <= x * 0.00001f);
+
+	std::mt19937 random(6);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Ray> rays(500);
+	for (Ray& ray : rays)
+	{
+		ray.origin = XMFLOAT3(0.0f, unit(random), unit(random));
+		ray.direction = XMFLOAT3(1.0f, unit(random) * 1e-30f, unit(random) * 1e-30f);
+	}
+	CHECK(CountMismatches(bvh, mesh, rays, FLT_MAX) == 0);
+}
+
+TEST(MeshBvhEmpty)
+{
+	MeshBvh bvh;
+	RayHit hit;
+	CHECK(!bvh.IsBuilt());
+	CHECK(!bvh.Intersect(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), FLT_MAX, hit));
+
+	// A single triangle makes a root that's a leaf
+	TriangleSoup mesh;
+	mesh.AddTriangle(XMFLOAT3(-1, -1, 2), XMFLOAT3(1, -1, 2), XMFLOAT3(0, 1, 2));
+	bvh.Build(mesh.vertices.data(), mesh.indices.data(), 3);
+	CHECK(bvh.GetDepth() == 0);
+	CHECK(bvh.Intersect(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), FLT_MAX, hit) && hit.distance == 2.0f);
+	CHECK(!bvh.Intersect(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), 1.5f, hit));
+	CHECK(!bvh.Intersect(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, -1), FLT_MAX, hit));
+
+	bvh.Build(mesh.vertices.data(), mesh.indices.data(), 0);
+	CHECK(!bvh.IsBuilt());
+}
+
+BENCHMARK(MeshBvhIntersect)
+{
+	std::mt19937 random(8);
+	TriangleSoup mesh = MakeSoup(random, BENCHMARK_TRIANGLES);
+	std::vector<Ray> rays = MakeRays(random, BENCHMARK_RAYS);
+
+	MeshBvh bvh;
+	double build = TimeBest(3, [&]()
+	{
+		bvh.Build(mesh.vertices.data(), mesh.indices.data(), (unsigned int)mesh.indices.size());
+	});
+
+	int hits = 0;
+	double closest = TimeBest(5, [&]()
+	{
+		hits = 0;
+		RayHit hit;
+		for (const Ray& ray : rays)
+			hits += bvh.Intersect(ray.origin, ray.direction, FLT_MAX, hit);
+	});
+	double any = TimeBest(5, [&]()
+	{
+		for (const Ray& ray : rays)
+			bvh.IntersectAny(ray.origin, ray.direction, FLT_MAX);
+	});
+	double bruteForce = TimeBest(1, [&]()
+	{
+		RayHit hit;
+		for (int i = 0; i < BENCHMARK_BRUTE_FORCE_RAYS; i++)
+			BruteForce(mesh, rays[i], FLT_MAX, hit);
+	});
+
+	double perRay = closest / rays.size();
+	double bruteForcePerRay = bruteForce / BENCHMARK_BRUTE_FORCE_RAYS;
+	printf("%u triangles, %u nodes, depth %u: build %.2f ms\n",
+		bvh.GetTriangleCount(), bvh.GetNodeCount(), bvh.GetDepth(), build * 1000);
+	printf("%zu rays, %d hit:\n", rays.size(), hits);
+	printf("  Closest hit: %.2f us per ray, %.0fx brute force\n", perRay * 1e6, bruteForcePerRay / perRay);
+	printf("  Any hit:     %.2f us per ray\n", any / rays.size() * 1e6);
+	printf("  Brute force: %.2f us per ray\n", bruteForcePerRay * 1e6);
+}
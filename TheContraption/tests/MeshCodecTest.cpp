@@ -0,0 +1,277 @@
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "MeshCodec.h"
+
+namespace
+{
+	// Laid out like the engine's Vertex, without needing DirectXMath for it
+	struct GridVertex
+	{
+		float position[3];
+		float normal[3];
+		float tangent[3];
+		float uv[2];
+	};
+
+	// Quads per side of the benchmark grid, about two million triangles
+	const int BENCHMARK_GRID_SIZE = 1000;
+
+	// Written past the end of every decode, to catch overruns
+	const uint8_t GUARD_BYTE = 0xAB;
+	const unsigned int GUARD_INDEX = 0xDEADBEEF;
+
+	std::vector<unsigned int> RandomIndices(size_t count, std::mt19937& random)
+	{
+		std::vector<unsigned int> indices(count);
+		for (unsigned int& index : indices)
+			index = random();
+		return indices;
+	}
+
+	std::vector<uint8_t> RandomBytes(size_t count, std::mt19937& random)
+	{
+		std::vector<uint8_t> bytes(count);
+		for (uint8_t& byte : bytes)
+			byte = static_cast<uint8_t>(random());
+		return bytes;
+	}
+
+	// --------------------------------------------------------
+	// A size x size grid of quads with its index buffer in
+	// row order, close to what MeshOptimizer leaves behind
+	// --------------------------------------------------------
+	void MakeGrid(int size, std::vector<GridVertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		vertices.clear();
+		for (int y = 0; y <= size; y++)
+		{
+			for (int x = 0; x <= size; x++)
+			{
+				float u = (float)x / size;
+				float v = (float)y / size;
+				GridVertex vertex = {
+					{ u * 10.0f, 0.25f * (u - v), v * 10.0f },
+					{ 0.0f, 1.0f, 0.0f },
+					{ 1.0f, 0.0f, 0.0f },
+					{ u, v } };
+				vertices.push_back(vertex);
+			}
+		}
+
+		indices.clear();
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				unsigned int a = y * (size + 1) + x;
+				unsigned int b = a + 1;
+				unsigned int c = b + size + 1;
+				unsigned int d = a + size + 1;
+				unsigned int quad[6] = { a, b, c, a, c, d };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	bool IndicesRoundTrip(const std::vector<unsigned int>& indices)
+	{
+		std::vector<uint8_t> encoded;
+		MeshCodec::EncodeIndices(indices.data(), indices.size(), encoded);
+
+		std::vector<unsigned int> decoded(indices.size() + 1, GUARD_INDEX);
+		return MeshCodec::DecodeIndices(encoded.data(), encoded.size(), decoded.data(), indices.size()) &&
+			std::equal(indices.begin(), indices.end(), decoded.begin()) &&
+			decoded.back() == GUARD_INDEX;
+	}
+
+	bool VerticesRoundTrip(const std::vector<uint8_t>& vertices, size_t stride)
+	{
+		std::vector<uint8_t> encoded;
+		size_t count = vertices.size() / stride;
+		if (!MeshCodec::EncodeVertices(vertices.data(), count, stride, encoded))
+			return false;
+
+		std::vector<uint8_t> decoded(vertices.size() + 1, GUARD_BYTE);
+		return MeshCodec::DecodeVertices(encoded.data(), encoded.size(), decoded.data(), count, stride) &&
+			std::equal(vertices.begin(), vertices.end(), decoded.begin()) &&
+			decoded.back() == GUARD_BYTE;
+	}
+}
+
+TEST(MeshCodecRoundTripsRandomData)
+{
+	// Random data is the worst case: every block at 8 bits, across
+	// empty, partial and exact multiples of a block and a chunk
+	std::mt19937 random(1);
+	const size_t counts[] = { 0, 1, 15, 16, 17, 255, 256, 257, 1000 };
+	const size_t strides[] = { 4, 12, 44, MESH_CODEC_MAX_STRIDE };
+	for (size_t count : counts)
+	{
+		CHECK(IndicesRoundTrip(RandomIndices(count, random)));
+		for (size_t stride : strides)
+			CHECK(VerticesRoundTrip(RandomBytes(count * stride, random), stride));
+	}
+}
+
+TEST(MeshCodecRoundTripsIndexWraparound)
+{
+	// Deltas to and from 0xFFFFFFFF wrap, and have to come back exactly
+	std::vector<unsigned int> indices(5000);
+	for (size_t i = 0; i < indices.size(); i++)
+		indices[i] = i % 7 == 0 ? 0xFFFFFFFFu : (unsigned int)i;
+	CHECK(IndicesRoundTrip(indices));
+
+	const unsigned int extremes[] = { 0, 0xFFFFFFFFu, 0, 0x80000000u, 0x7FFFFFFFu, 1, 0xFFFFFFFEu };
+	CHECK(IndicesRoundTrip(std::vector<unsigned int>(extremes, extremes + sizeof(extremes) / sizeof(extremes[0]))));
+}
+
+TEST(MeshCodecCompressesGrid)
+{
+	std::vector<GridVertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(64, vertices, indices);
+
+	std::vector<uint8_t> vertexBytes((uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size()));
+	CHECK(VerticesRoundTrip(vertexBytes, sizeof(GridVertex)));
+	CHECK(IndicesRoundTrip(indices));
+
+	// Smooth data is the point of the codec, so it had better shrink
+	std::vector<uint8_t> encoded;
+	MeshCodec::EncodeIndices(indices.data(), indices.size(), encoded);
+	CHECK(encoded.size() < indices.size() * sizeof(unsigned int) / 2);
+
+	encoded.clear();
+	MeshCodec::EncodeVertices(vertices.data(), vertices.size(), sizeof(GridVertex), encoded);
+	CHECK(encoded.size() < vertexBytes.size() / 2);
+}
+
+TEST(MeshCodecRejectsBadStrides)
+{
+	std::vector<uint8_t> bytes(512);
+	std::vector<uint8_t> encoded;
+	const size_t strides[] = { 0, 2, 6, 45, MESH_CODEC_MAX_STRIDE + 4 };
+	for (size_t stride : strides)
+	{
+		CHECK(!MeshCodec::EncodeVertices(bytes.data(), 1, stride, encoded));
+		CHECK(!MeshCodec::DecodeVertices(bytes.data(), bytes.size(), bytes.data(), 1, stride));
+	}
+	CHECK(encoded.empty());
+}
+
+TEST(MeshCodecRejectsWrongSizes)
+{
+	std::mt19937 random(2);
+	std::vector<unsigned int> indices = RandomIndices(1000, random);
+	std::vector<uint8_t> vertices = RandomBytes(1000 * 44, random);
+
+	std::vector<uint8_t> encodedIndices;
+	std::vector<uint8_t> encodedVertices;
+	MeshCodec::EncodeIndices(indices.data(), indices.size(), encodedIndices);
+	MeshCodec::EncodeVertices(vertices.data(), 1000, 44, encodedVertices);
+
+	// Every truncation has to fail, not read past the end
+	std::vector<unsigned int> decodedIndices(indices.size());
+	std::vector<uint8_t> decodedVertices(vertices.size());
+	int accepted = 0;
+	for (size_t size = 0; size < encodedIndices.size(); size++)
+	{
+		std::vector<uint8_t> truncated(encodedIndices.begin(), encodedIndices.begin() + size);
+		accepted += MeshCodec::DecodeIndices(truncated.data(), truncated.size(), decodedIndices.data(), indices.size());
+	}
+	for (size_t size = 0; size < encodedVertices.size(); size += 7)
+	{
+		std::vector<uint8_t> truncated(encodedVertices.begin(), encodedVertices.begin() + size);
+		accepted += MeshCodec::DecodeVertices(truncated.data(), truncated.size(), decodedVertices.data(), 1000, 44);
+	}
+	CHECK(accepted == 0);
+
+	// So does trailing data, or asking for a different count
+	encodedIndices.push_back(0);
+	encodedVertices.push_back(0);
+	CHECK(!MeshCodec::DecodeIndices(encodedIndices.data(), encodedIndices.size(), decodedIndices.data(), indices.size()));
+	CHECK(!MeshCodec::DecodeVertices(encodedVertices.data(), encodedVertices.size(), decodedVertices.data(), 1000, 44));
+	encodedIndices.pop_back();
+	encodedVertices.pop_back();
+	CHECK(!MeshCodec::DecodeIndices(encodedIndices.data(), encodedIndices.size(), decodedIndices.data(), indices.size() / 2));
+	CHECK(!MeshCodec::DecodeVertices(encodedVertices.data(), encodedVertices.size(), decodedVertices.data(), 500, 44));
+}
+
+TEST(MeshCodecSurvivesCorruption)
+{
+	std::vector<GridVertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(32, vertices, indices);
+
+	std::vector<uint8_t> encodedIndices;
+	std::vector<uint8_t> encodedVertices;
+	MeshCodec::EncodeIndices(indices.data(), indices.size(), encodedIndices);
+	MeshCodec::EncodeVertices(vertices.data(), vertices.size(), sizeof(GridVertex), encodedVertices);
+
+	// A width code past the last one is malformed outright
+	std::vector<uint8_t> corrupt = encodedIndices;
+	corrupt[0] |= 0x0F;
+	std::vector<unsigned int> decodedIndices(indices.size() + 1, GUARD_INDEX);
+	CHECK(!MeshCodec::DecodeIndices(corrupt.data(), corrupt.size(), decodedIndices.data(), indices.size()));
+
+	corrupt = encodedVertices;
+	corrupt[0] |= 0xF0;
+	std::vector<uint8_t> decodedVertices(vertices.size() * sizeof(GridVertex) + 1, GUARD_BYTE);
+	CHECK(!MeshCodec::DecodeVertices(corrupt.data(), corrupt.size(), decodedVertices.data(), vertices.size(), sizeof(GridVertex)));
+
+	// Other damage may still decode, there's no checksum, but it must
+	// never write past the output or read past the input
+	std::mt19937 random(3);
+	for (int i = 0; i < 2000; i++)
+	{
+		corrupt = encodedIndices;
+		corrupt[random() % corrupt.size()] ^= static_cast<uint8_t>(1 << (random() % 8));
+		MeshCodec::DecodeIndices(corrupt.data(), corrupt.size(), decodedIndices.data(), indices.size());
+		CHECK(decodedIndices.back() == GUARD_INDEX);
+
+		corrupt = encodedVertices;
+		corrupt[random() % corrupt.size()] ^= static_cast<uint8_t>(1 << (random() % 8));
+		MeshCodec::DecodeVertices(corrupt.data(), corrupt.size(), decodedVertices.data(), vertices.size(), sizeof(GridVertex));
+		CHECK(decodedVertices.back() == GUARD_BYTE);
+	}
+}
+
+BENCHMARK(MeshCodecThroughput)
+{
+	std::vector<GridVertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(BENCHMARK_GRID_SIZE, vertices, indices);
+	size_t vertexBytes = vertices.size() * sizeof(GridVertex);
+	size_t indexBytes = indices.size() * sizeof(unsigned int);
+
+	std::vector<uint8_t> encodedVertices;
+	std::vector<uint8_t> encodedIndices;
+	double encodeSeconds = TimeBest(3, [&]()
+	{
+		encodedVertices.clear();
+		encodedIndices.clear();
+		MeshCodec::EncodeVertices(vertices.data(), vertices.size(), sizeof(GridVertex), encodedVertices);
+		MeshCodec::EncodeIndices(indices.data(), indices.size(), encodedIndices);
+	});
+
+	// Decode speed is measured in output bytes, what the loader gets out of it
+	std::vector<GridVertex> decodedVertices(vertices.size());
+	std::vector<unsigned int> decodedIndices(indices.size());
+	double vertexSeconds = TimeBest(10, [&]()
+	{
+		MeshCodec::DecodeVertices(encodedVertices.data(), encodedVertices.size(), decodedVertices.data(), vertices.size(), sizeof(GridVertex));
+	});
+	double indexSeconds = TimeBest(10, [&]()
+	{
+		MeshCodec::DecodeIndices(encodedIndices.data(), encodedIndices.size(), decodedIndices.data(), indices.size());
+	});
+
+	printf("%zu vertices: %.1f MB -> %.1f MB (%.2f), decode %.2f GB/s\n",
+		vertices.size(), vertexBytes / 1e6, encodedVertices.size() / 1e6, (double)encodedVertices.size() / vertexBytes, vertexBytes / vertexSeconds / 1e9);
+	printf("%zu indices: %.1f MB -> %.1f MB (%.2f), decode %.2f GB/s\n",
+		indices.size(), indexBytes / 1e6, encodedIndices.size() / 1e6, (double)encodedIndices.size() / indexBytes, indexBytes / indexSeconds / 1e9);
+	printf("Encode both: %.0f MB/s\n", (vertexBytes + indexBytes) / encodeSeconds / 1e6);
+}
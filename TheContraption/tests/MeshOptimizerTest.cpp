@@ -0,0 +1,220 @@
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::array<unsigned int, 3> Triangle;
+
+	// Rings and segments of the benchmark sphere, about half a million triangles
+	const int BENCHMARK_RINGS = 500;
+	const int BENCHMARK_SEGMENTS = 500;
+
+	// --------------------------------------------------------
+	// A uv sphere, like most exporters write it: a row of
+	// triangles at a time, with a seam of repeated positions
+	// where the uvs wrap. Every vertex is different from every
+	// other one, so they can be told apart after reordering
+	// --------------------------------------------------------
+	void MakeSphere(int rings, int segments, MeshData& out)
+	{
+		out = MeshData();
+		for (int ring = 0; ring <= rings; ring++)
+		{
+			float v = (float)ring / rings;
+			float polar = v * XM_PI;
+			for (int segment = 0; segment <= segments; segment++)
+			{
+				float u = (float)segment / segments;
+				float azimuth = u * XM_2PI;
+
+				Vertex vertex = {};
+				vertex.Normal = XMFLOAT3(sinf(polar) * cosf(azimuth), cosf(polar), sinf(polar) * sinf(azimuth));
+				vertex.Position = vertex.Normal;
+				vertex.UV = XMFLOAT2(u, v);
+				out.vertices.push_back(vertex);
+			}
+		}
+
+		for (int ring = 0; ring < rings; ring++)
+		{
+			for (int segment = 0; segment < segments; segment++)
+			{
+				unsigned int a = ring * (segments + 1) + segment;
+				unsigned int b = a + 1;
+				unsigned int c = a + segments + 1;
+				unsigned int d = c + 1;
+				unsigned int quad[] = { a, b, d, a, d, c };
+				out.indices.insert(out.indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	// The same triangles in a random order, like a careless exporter's
+	void ShuffleTriangles(MeshData& data, unsigned int seed)
+	{
+		std::vector<Triangle> triangles(data.indices.size() / 3);
+		for (size_t t = 0; t < triangles.size(); t++)
+			triangles[t] = Triangle{ { data.indices[t * 3], data.indices[t * 3 + 1], data.indices[t * 3 + 2] } };
+
+		std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+		for (size_t t = 0; t < triangles.size(); t++)
+			std::copy(triangles[t].begin(), triangles[t].end(), data.indices.begin() + t * 3);
+	}
+
+	float Acmr(const MeshData& data, size_t indexStart, size_t indexCount)
+	{
+		return MeshOptimizer::AnalyzeVertexCache(&data.indices[indexStart], indexCount, data.vertices.size()).acmr;
+	}
+
+	std::string Key(const Vertex& vertex)
+	{
+		return std::string(reinterpret_cast<const char*>(&vertex), sizeof(Vertex));
+	}
+
+	// --------------------------------------------------------
+	// The triangles of a range of indices, in terms of the
+	// original mesh's vertices, each rotated to start at its
+	// lowest index so winding still counts but the first
+	// corner doesn't. Sorted, so two lists that are
+	// permutations of each other compare equal
+	// --------------------------------------------------------
+	std::vector<Triangle> SortedTriangles(const MeshData& data, size_t indexStart, size_t indexCount, const std::map<std::string, unsigned int>& original)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t i = indexStart; i + 3 <= indexStart + indexCount; i += 3)
+		{
+			Triangle triangle;
+			for (int c = 0; c < 3; c++)
+			{
+				std::map<std::string, unsigned int>::const_iterator found = original.find(Key(data.vertices[data.indices[i + c]]));
+				triangle[c] = found == original.end() ? ~0u : found->second;
+			}
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	std::map<std::string, unsigned int> IndexVertices(const MeshData& data)
+	{
+		std::map<std::string, unsigned int> original;
+		for (unsigned int i = 0; i < data.vertices.size(); i++)
+			original[Key(data.vertices[i])] = i;
+		return original;
+	}
+}
+
+TEST(MeshOptimizerLowersAcmr)
+{
+	const unsigned int seeds[] = { 0, 1 };
+	for (unsigned int seed : seeds)
+	{
+		// Exporter order first, then shuffled, which is as bad as it gets
+		MeshData input;
+		MakeSphere(40, 60, input);
+		if (seed > 0)
+			ShuffleTriangles(input, seed);
+		std::map<std::string, unsigned int> original = IndexVertices(input);
+		CHECK(original.size() == input.vertices.size());
+
+		MeshData optimized = input;
+		MeshOptimizer::Optimize(optimized);
+
+		float before = Acmr(input, 0, input.indices.size());
+		float after = Acmr(optimized, 0, optimized.indices.size());
+		CHECK(after < before);
+		// A regular grid can't do better than about 0.5 misses per
+		// triangle. Forsyth gets within reach of it
+		CHECK(after < 0.8f);
+
+		// Same triangles with the same winding, just reordered, and every
+		// vertex still used once in the order the GPU first asks for it
+		CHECK(optimized.indices.size() == input.indices.size());
+		CHECK(optimized.vertices.size() == input.vertices.size());
+		CHECK(SortedTriangles(optimized, 0, optimized.indices.size(), original) == SortedTriangles(input, 0, input.indices.size(), original));
+
+		unsigned int next = 0;
+		int outOfOrder = 0;
+		for (unsigned int index : optimized.indices)
+		{
+			if (index > next)
+				outOfOrder++;
+			else if (index == next)
+				next++;
+		}
+		CHECK(outOfOrder == 0);
+	}
+}
+
+TEST(MeshOptimizerKeepsSubmeshes)
+{
+	// Two submeshes over the same vertices, each with half the triangles,
+	// which may be reordered within their own range but not across it
+	MeshData input;
+	MakeSphere(30, 30, input);
+	ShuffleTriangles(input, 3);
+	unsigned int half = (unsigned int)input.indices.size() / 6 * 3;
+	Submesh first = { 0, half, 0 };
+	Submesh second = { half, (unsigned int)input.indices.size() - half, 1 };
+	input.submeshes.push_back(first);
+	input.submeshes.push_back(second);
+	std::map<std::string, unsigned int> original = IndexVertices(input);
+
+	MeshData optimized = input;
+	MeshOptimizer::Optimize(optimized);
+
+	for (const Submesh& submesh : input.submeshes)
+	{
+		CHECK(Acmr(optimized, submesh.indexStart, submesh.indexCount) < Acmr(input, submesh.indexStart, submesh.indexCount));
+		CHECK(SortedTriangles(optimized, submesh.indexStart, submesh.indexCount, original) ==
+			SortedTriangles(input, submesh.indexStart, submesh.indexCount, original));
+	}
+}
+
+TEST(MeshOptimizerAnalyzesCache)
+{
+	// One triangle misses three times, and the same one again hits
+	const unsigned int twice[] = { 0, 1, 2, 0, 1, 2 };
+	VertexCacheStats stats = MeshOptimizer::AnalyzeVertexCache(twice, 6, 3);
+	CHECK(stats.transformedVertices == 3);
+	CHECK(stats.acmr == 1.5f);
+	CHECK(stats.atvr == 1.0f);
+
+	// A cache of three has forgotten vertex 0 by the time it comes back
+	const unsigned int revisit[] = { 0, 1, 2, 3, 4, 5, 0, 4, 5 };
+	CHECK(MeshOptimizer::AnalyzeVertexCache(revisit, 9, 6, 3).transformedVertices == 7);
+	CHECK(MeshOptimizer::AnalyzeVertexCache(revisit, 9, 6, 16).transformedVertices == 6);
+
+	CHECK(MeshOptimizer::AnalyzeVertexCache(revisit, 2, 6).transformedVertices == 0);
+}
+
+BENCHMARK(MeshOptimizerOptimize)
+{
+	MeshData input;
+	MakeSphere(BENCHMARK_RINGS, BENCHMARK_SEGMENTS, input);
+	ShuffleTriangles(input, 1);
+
+	MeshData optimized;
+	double seconds = TimeBest(3, [&]()
+	{
+		optimized = input;
+		MeshOptimizer::Optimize(optimized);
+	});
+
+	VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(input.indices.data(), input.indices.size(), input.vertices.size());
+	VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(optimized.indices.data(), optimized.indices.size(), optimized.vertices.size());
+	printf("%zu triangles: %.2f ms\n", input.indices.size() / 3, seconds * 1000);
+	printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+}
@@ -0,0 +1,246 @@
+#include "TestFramework.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+#include "ObjParser.h"
+
+// Written with fopen, then read back through ObjParser's wide path
+#define BENCHMARK_FILE_NAME "ObjParserBenchmark.obj"
+
+namespace
+{
+	// Quads per side of the benchmark grid, about a million triangles
+	const int BENCHMARK_GRID_SIZE = 700;
+	const char* BENCHMARK_FILE_NARROW = BENCHMARK_FILE_NAME;
+	const wchar_t* BENCHMARK_FILE = L"" BENCHMARK_FILE_NAME;
+
+	// --------------------------------------------------------
+	// Writes a size x size grid of quads, with a position, uv
+	// and normal per grid point, like a scanned surface would have
+	// --------------------------------------------------------
+	void WriteGridObj(int size, std::string& out)
+	{
+		char line[256];
+		for (int y = 0; y <= size; y++)
+		{
+			for (int x = 0; x <= size; x++)
+			{
+				float u = (float)x / size;
+				float v = (float)y / size;
+				snprintf(line, sizeof(line),
+					"v %f %f %f\nvt %f %f\nvn %f %f %f\n",
+					u * 10.0f, 0.25f * (u - v), v * 10.0f, u, v, 0.0f, 1.0f, 0.0f);
+				out += line;
+			}
+		}
+
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				int a = y * (size + 1) + x + 1;
+				int b = a + 1;
+				int c = b + size + 1;
+				int d = a + size + 1;
+				snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c, d, d, d);
+				out += line;
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// A grid that also switches materials, leaves normals and
+	// uvs out and uses relative indices, so chunk boundaries
+	// land in the middle of everything the parser tracks
+	// --------------------------------------------------------
+	void WriteMixedObj(int size, std::string& out)
+	{
+		char line[256];
+		for (int y = 0; y <= size; y++)
+		{
+			for (int x = 0; x <= size; x++)
+			{
+				snprintf(line, sizeof(line), "v %d %d %d\nvt %f %f\nvn 0 1 0\n", x, (x * y) % 7, y, (float)x / size, (float)y / size);
+				out += line;
+			}
+		}
+
+		int vertexCount = (size + 1) * (size + 1);
+		for (int y = 0; y < size; y++)
+		{
+			snprintf(line, sizeof(line), "usemtl material%d\n", y % 3);
+			out += line;
+
+			for (int x = 0; x < size; x++)
+			{
+				int a = y * (size + 1) + x + 1;
+				int b = a + 1;
+				int c = b + size + 1;
+				if (x % 3 == 0)
+					snprintf(line, sizeof(line), "f %d %d %d\n", a, b, c);
+				else if (x % 3 == 1)
+					snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d # comment\n", a, a, a, b, b, b, c, c, c);
+				else
+					snprintf(line, sizeof(line), "f %d/%d %d/%d %d/%d\n", a - vertexCount - 1, a - vertexCount - 1, b - vertexCount - 1, b - vertexCount - 1, c - vertexCount - 1, c - vertexCount - 1);
+				out += line;
+			}
+		}
+	}
+
+	void Parse(const char* text, MeshData& out)
+	{
+		ObjParser::Parse(text, strlen(text), out);
+	}
+
+	bool SameVertex(const Vertex& a, const Vertex& b)
+	{
+		return memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+}
+
+TEST(ObjParserWeldsSharedCorners)
+{
+	MeshData mesh;
+	Parse(
+		"v 0 0 1\nv 1 0 1\nv 1 1 1\nv 0 1 1\n"
+		"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+		"vn 0 0 1\n"
+		"f 1/1/1 2/2/1 3/3/1 4/4/1\n", mesh);
+
+	// A quad is two triangles over its four corners
+	CHECK(mesh.vertices.size() == 4);
+	CHECK(mesh.indices.size() == 6);
+
+	// Converted to left handed: Z and V flip
+	CHECK(mesh.vertices[0].Position.z == -1.0f);
+	CHECK(mesh.vertices[0].Normal.z == -1.0f);
+	CHECK(mesh.vertices[0].UV.y == 1.0f);
+}
+
+TEST(ObjParserResolvesRelativeIndices)
+{
+	MeshData absolute;
+	MeshData relative;
+	Parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nf 1//1 2//1 3//1\n", absolute);
+	Parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nf -3//-1 -2//-1 -1//-1\n", relative);
+
+	CHECK(absolute.indices == relative.indices);
+	CHECK(absolute.vertices.size() == relative.vertices.size());
+	for (size_t i = 0; i < absolute.vertices.size() && i < relative.vertices.size(); i++)
+		CHECK(SameVertex(absolute.vertices[i], relative.vertices[i]));
+}
+
+TEST(ObjParserKeepsLongLines)
+{
+	// The old loader read lines into 100 characters and lost the rest
+	std::string text = "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n";
+	text += "f 1 2 3 4 # " + std::string(300, 'x') + "\n";
+	text += "v 2 2 2 " + std::string(300, ' ') + "\n";
+
+	MeshData mesh;
+	Parse(text.c_str(), mesh);
+	CHECK(mesh.vertices.size() == 4);
+	CHECK(mesh.indices.size() == 6);
+}
+
+TEST(ObjParserParsesGrid)
+{
+	const int size = 16;
+	std::string text;
+	WriteGridObj(size, text);
+
+	MeshData mesh;
+	Parse(text.c_str(), mesh);
+	CHECK(mesh.vertices.size() == (size_t)(size + 1) * (size + 1));
+	CHECK(mesh.indices.size() == (size_t)size * size * 6);
+	for (unsigned int index : mesh.indices)
+		CHECK(index < mesh.vertices.size());
+}
+
+TEST(ObjParserChunksMatchSerial)
+{
+	JobSystem::GetInstance().Initialize();
+
+	std::string text;
+	WriteMixedObj(200, text);
+
+	MeshData serial;
+	ObjParser::Parse(text.data(), text.size(), serial, 1);
+	CHECK(serial.submeshes.size() == 3);
+
+	// The output has to be identical however the file is split
+	const size_t chunkCounts[] = { 2, 3, 7, 64 };
+	for (size_t chunkCount : chunkCounts)
+	{
+		MeshData chunked;
+		ObjParser::Parse(text.data(), text.size(), chunked, chunkCount);
+
+		CHECK(chunked.vertices.size() == serial.vertices.size());
+		CHECK(chunked.vertices.size() == serial.vertices.size() &&
+			memcmp(chunked.vertices.data(), serial.vertices.data(), serial.vertices.size() * sizeof(Vertex)) == 0);
+		CHECK(chunked.indices == serial.indices);
+		CHECK(chunked.submeshes.size() == serial.submeshes.size());
+		for (size_t i = 0; i < chunked.submeshes.size() && i < serial.submeshes.size(); i++)
+		{
+			CHECK(chunked.submeshes[i].indexStart == serial.submeshes[i].indexStart);
+			CHECK(chunked.submeshes[i].indexCount == serial.submeshes[i].indexCount);
+			CHECK(chunked.submeshes[i].material == serial.submeshes[i].material);
+		}
+	}
+}
+
+BENCHMARK(ObjParserThroughput)
+{
+	JobSystem::GetInstance().Initialize();
+
+	std::string text;
+	WriteGridObj(BENCHMARK_GRID_SIZE, text);
+
+	FILE* file = fopen(BENCHMARK_FILE_NARROW, "wb");
+	if (!file)
+	{
+		printf("Couldn't write the benchmark file\n");
+		return;
+	}
+	fwrite(text.data(), 1, text.size(), file);
+	fclose(file);
+
+	// Straight from the file, so mapping it counts too
+	MeshData mesh;
+	double seconds = TimeBest(5, [&]() { ObjParser::ParseFile(BENCHMARK_FILE, mesh); });
+	remove(BENCHMARK_FILE_NARROW);
+
+	size_t triangles = mesh.indices.size() / 3;
+	printf("%.1f MB, %zu triangles: %.1f ms, %.0f MB/s, %.1f M triangles/s\n",
+		text.size() / 1e6, triangles, seconds * 1000, text.size() / seconds / 1e6, triangles / seconds / 1e6);
+}
+
+BENCHMARK(ObjParserScaling)
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	jobs.Initialize();
+
+	std::string text;
+	WriteGridObj(BENCHMARK_GRID_SIZE, text);
+
+	// One chunk per thread, doubling up to every thread the JobSystem has
+	std::vector<size_t> chunkCounts;
+	for (size_t chunkCount = 1; chunkCount < jobs.GetThreadCount(); chunkCount *= 2)
+		chunkCounts.push_back(chunkCount);
+	chunkCounts.push_back(jobs.GetThreadCount());
+
+	printf("%.1f MB, %u threads\n", text.size() / 1e6, jobs.GetThreadCount());
+	double serialSeconds = 0;
+	for (size_t chunkCount : chunkCounts)
+	{
+		MeshData mesh;
+		double seconds = TimeBest(5, [&]() { ObjParser::Parse(text.data(), text.size(), mesh, chunkCount); });
+		if (chunkCount == 1)
+			serialSeconds = seconds;
+
+		printf("%2zu chunks: %.1f ms, %.0f MB/s, %.2fx\n", chunkCount, seconds * 1000, text.size() / seconds / 1e6, serialSeconds / seconds);
+	}
+}
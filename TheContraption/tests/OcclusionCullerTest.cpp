@@ -0,0 +1,246 @@
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "JobSystem.h"
+#include "OcclusionCuller.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Depth the culler may be off from the exact one. It interpolates
+	// in floats from the tile corner, the reference in doubles per pixel
+	const double MAX_DEPTH_ERROR = 0.00005;
+	// Pixel centers closer than this to an edge could go either way,
+	// depending on rounding, so coverage isn't compared there
+	const double EDGE_TOLERANCE = 0.001;	// Pixels
+
+	const int PIXEL_COUNT = OCCLUSION_WIDTH * OCCLUSION_HEIGHT;
+
+	XMFLOAT4X4 MakeViewProjection()
+	{
+		XMMATRIX view = XMMatrixLookToLH(
+			XMVectorSet(0.0f, 1.0f, -6.0f, 0.0f),
+			XMVector3Normalize(XMVectorSet(0.05f, -0.1f, 1.0f, 0.0f)),
+			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(0.9f, 16.0f / 9.0f, 0.01f, 100.0f);
+
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, projection));
+		return viewProj;
+	}
+
+	XMFLOAT4X4 Identity()
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		return identity;
+	}
+
+	// Small triangles scattered around in front of the camera, some overlapping
+	void AddScatteredTriangles(std::mt19937& random, int count, float spread, float depth, float size, std::vector<XMFLOAT3>& corners)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		for (int i = 0; i < count; i++)
+		{
+			XMFLOAT3 center(unit(random) * spread, unit(random) * spread, unit(random) * spread + depth);
+			for (int c = 0; c < 3; c++)
+				corners.push_back(XMFLOAT3(center.x + unit(random) * size, center.y + unit(random) * size, center.z + unit(random) * size));
+		}
+	}
+
+	// --------------------------------------------------------
+	// Rasterizes the slow, obvious way to check the culler
+	// against: every pixel center of every triangle's bounds,
+	// in doubles, keeping the nearest depth. Follows the same
+	// rules, so triangles with a corner behind the near plane
+	// are left out. Pixels where a center sits right on an
+	// edge are flagged, as either answer is right there
+	// --------------------------------------------------------
+	void RasterizeReference(const std::vector<XMFLOAT3>& corners, const XMFLOAT4X4& world, const XMFLOAT4X4& viewProj,
+		std::vector<float>& depth, std::vector<bool>& onEdge)
+	{
+		depth.assign(PIXEL_COUNT, 1.0f);
+		onEdge.assign(PIXEL_COUNT, false);
+		XMMATRIX transform = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProj));
+
+		for (size_t t = 0; t + 3 <= corners.size(); t += 3)
+		{
+			double x[3], y[3], z[3];
+			bool behindNear = false;
+			for (int c = 0; c < 3; c++)
+			{
+				XMFLOAT4 clip;
+				XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corners[t + c]), transform));
+				behindNear |= clip.z < 0.0f;
+				x[c] = ((double)clip.x / clip.w * 0.5 + 0.5) * OCCLUSION_WIDTH;
+				y[c] = (0.5 - (double)clip.y / clip.w * 0.5) * OCCLUSION_HEIGHT;
+				z[c] = (double)clip.z / clip.w;
+			}
+
+			double area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+			if (behindNear || area == 0)
+				continue;
+
+			// How far a pixel center is inside each edge, in pixels, is its
+			// weight times the area over that edge's length
+			double edgeScale[3];
+			for (int e = 0; e < 3; e++)
+			{
+				int a = (e + 1) % 3;
+				int b = (e + 2) % 3;
+				edgeScale[e] = fabs(area) / sqrt((x[b] - x[a]) * (x[b] - x[a]) + (y[b] - y[a]) * (y[b] - y[a]));
+			}
+
+			int left = std::max(0, (int)floor(std::min({ x[0], x[1], x[2] })));
+			int right = std::min(OCCLUSION_WIDTH - 1, (int)ceil(std::max({ x[0], x[1], x[2] })));
+			int top = std::max(0, (int)floor(std::min({ y[0], y[1], y[2] })));
+			int bottom = std::min(OCCLUSION_HEIGHT - 1, (int)ceil(std::max({ y[0], y[1], y[2] })));
+			for (int py = top; py <= bottom; py++)
+			{
+				for (int px = left; px <= right; px++)
+				{
+					double cx = px + 0.5;
+					double cy = py + 0.5;
+					double weights[3] = {
+						((x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1])) / area,
+						((x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2])) / area,
+						((x[1] - x[0]) * (cy - y[0]) - (y[1] - y[0]) * (cx - x[0])) / area };
+
+					double inside = std::min({ weights[0] * edgeScale[0], weights[1] * edgeScale[1], weights[2] * edgeScale[2] });
+					if (fabs(inside) < EDGE_TOLERANCE)
+						onEdge[py * OCCLUSION_WIDTH + px] = true;
+					if (inside < 0)
+						continue;
+
+					float pixelDepth = (float)(weights[0] * z[0] + weights[1] * z[1] + weights[2] * z[2]);
+					float& pixel = depth[py * OCCLUSION_WIDTH + px];
+					pixel = std::min(pixel, pixelDepth);
+				}
+			}
+		}
+	}
+}
+
+TEST(OcclusionCullerMatchesReference)
+{
+	JobSystem::GetInstance().Initialize();
+
+	// Overlapping scattered triangles, plus one right at the near plane
+	// covering everything and one crossing it, which have to be left out
+	std::mt19937 random(5);
+	std::vector<XMFLOAT3> corners;
+	AddScatteredTriangles(random, 600, 4.0f, 4.0f, 1.6f, corners);
+	const XMFLOAT3 special[] = {
+		XMFLOAT3(-50.0f, -50.0f, -5.995f), XMFLOAT3(50.0f, -50.0f, -5.995f), XMFLOAT3(0.0f, 50.0f, -5.995f),
+		XMFLOAT3(-3.0f, -3.0f, -7.0f), XMFLOAT3(3.0f, -3.0f, 2.0f), XMFLOAT3(0.0f, 3.0f, 2.0f) };
+	corners.insert(corners.end(), special, special + 6);
+
+	XMFLOAT4X4 viewProj = MakeViewProjection();
+	XMFLOAT4X4 world = Identity();
+	OcclusionCuller culler;
+	culler.Begin(viewProj);
+	culler.AddOccluder(corners.data(), corners.size(), world);
+	culler.Rasterize();
+
+	std::vector<float> reference;
+	std::vector<bool> onEdge;
+	RasterizeReference(corners, world, viewProj, reference, onEdge);
+
+	// 1 is the far plane, which is what empty pixels keep
+	const float* depth = culler.GetDepth();
+	int coverageMismatches = 0;
+	int covered = 0;
+	double worstDepthError = 0;
+	for (int i = 0; i < PIXEL_COUNT; i++)
+	{
+		if (onEdge[i])
+			continue;
+
+		if ((depth[i] == 1.0f) != (reference[i] == 1.0f))
+			coverageMismatches++;
+		else if (reference[i] != 1.0f)
+		{
+			covered++;
+			worstDepthError = std::max(worstDepthError, fabs((double)depth[i] - reference[i]));
+		}
+	}
+
+	CHECK(coverageMismatches == 0);
+	CHECK(worstDepthError <= MAX_DEPTH_ERROR);
+	CHECK(covered > PIXEL_COUNT / 4 && covered < PIXEL_COUNT);
+}
+
+TEST(OcclusionCullerHidesBehindWall)
+{
+	JobSystem::GetInstance().Initialize();
+
+	const XMFLOAT3 wall[] = {
+		XMFLOAT3(-3.0f, -2.0f, 5.0f), XMFLOAT3(3.0f, -2.0f, 5.0f), XMFLOAT3(3.0f, 4.0f, 5.0f),
+		XMFLOAT3(-3.0f, -2.0f, 5.0f), XMFLOAT3(3.0f, 4.0f, 5.0f), XMFLOAT3(-3.0f, 4.0f, 5.0f) };
+
+	OcclusionCuller culler;
+	culler.Begin(MakeViewProjection());
+	culler.AddOccluder(wall, 6, Identity());
+	culler.Rasterize();
+	CHECK(culler.GetTriangleCount() == 2);
+
+	CHECK(!culler.IsBoxVisible(XMFLOAT3(-0.5f, 0.0f, 7.0f), XMFLOAT3(0.5f, 1.0f, 8.0f)));
+
+	// In front, through the wall, past its edge, around the camera and off screen
+	CHECK(culler.IsBoxVisible(XMFLOAT3(-0.5f, 0.0f, 3.0f), XMFLOAT3(0.5f, 1.0f, 4.0f)));
+	CHECK(culler.IsBoxVisible(XMFLOAT3(-0.5f, 0.0f, 4.5f), XMFLOAT3(0.5f, 1.0f, 5.5f)));
+	CHECK(culler.IsBoxVisible(XMFLOAT3(2.5f, 0.0f, 7.0f), XMFLOAT3(4.5f, 1.0f, 8.0f)));
+	CHECK(culler.IsBoxVisible(XMFLOAT3(-1.0f, 0.0f, -7.0f), XMFLOAT3(1.0f, 2.0f, -5.0f)));
+	CHECK(culler.IsBoxVisible(XMFLOAT3(-100.0f, 0.0f, 7.0f), XMFLOAT3(-99.0f, 1.0f, 8.0f)));
+
+	// Nothing rasterized hides nothing
+	culler.Begin(MakeViewProjection());
+	culler.Rasterize();
+	CHECK(culler.IsBoxVisible(XMFLOAT3(-0.5f, 0.0f, 7.0f), XMFLOAT3(0.5f, 1.0f, 8.0f)));
+}
+
+BENCHMARK(OcclusionCullerThroughput)
+{
+	JobSystem& jobs = JobSystem::GetInstance();
+	jobs.Initialize();
+
+	std::mt19937 random(5);
+	std::vector<XMFLOAT3> corners;
+	AddScatteredTriangles(random, 20000, 4.0f, 8.0f, 1.2f, corners);
+
+	XMFLOAT4X4 viewProj = MakeViewProjection();
+	XMFLOAT4X4 world = Identity();
+	OcclusionCuller culler;
+	double binSeconds = TimeBest(10, [&]()
+	{
+		culler.Begin(viewProj);
+		culler.AddOccluder(corners.data(), corners.size(), world);
+	});
+	double rasterSeconds = TimeBest(10, [&]() { culler.Rasterize(); });
+
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<XMFLOAT3> boxes;
+	for (int i = 0; i < 100000; i++)
+	{
+		XMFLOAT3 boxMin(unit(random) * 8.0f, unit(random) * 5.0f, unit(random) + 12.0f);
+		boxes.push_back(boxMin);
+		boxes.push_back(XMFLOAT3(boxMin.x + 0.3f, boxMin.y + 0.3f, boxMin.z + 0.3f));
+	}
+
+	int hidden = 0;
+	double testSeconds = TimeBest(5, [&]()
+	{
+		hidden = 0;
+		for (size_t i = 0; i < boxes.size(); i += 2)
+			hidden += !culler.IsBoxVisible(boxes[i], boxes[i + 1]);
+	});
+
+	printf("%zu triangles, %u threads: bin %.2f ms, rasterize %.2f ms\n",
+		culler.GetTriangleCount(), jobs.GetThreadCount(), binSeconds * 1000, rasterSeconds * 1000);
+	printf("%zu boxes, %d hidden: %.2f ms\n", boxes.size() / 2, hidden, testSeconds * 1000);
+}
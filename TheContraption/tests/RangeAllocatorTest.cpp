@@ -0,0 +1,202 @@
+#include "TestFramework.h"
+
+#include <random>
+#include <vector>
+
+#include "RangeAllocator.h"
+
+namespace
+{
+	struct Range
+	{
+		unsigned int offset;
+		unsigned int size;
+	};
+
+	// --------------------------------------------------------
+	// The free ranges a fully merging allocator has to end up
+	// with are exactly the runs of unused elements, so count
+	// those and find the longest
+	// --------------------------------------------------------
+	void CountFreeRuns(const std::vector<bool>& taken, unsigned int& runs, unsigned int& longest)
+	{
+		runs = 0;
+		longest = 0;
+		unsigned int current = 0;
+		for (size_t i = 0; i <= taken.size(); i++)
+		{
+			if (i < taken.size() && !taken[i])
+			{
+				current++;
+				continue;
+			}
+
+			if (current > 0)
+			{
+				runs++;
+				longest = std::max(longest, current);
+			}
+			current = 0;
+		}
+	}
+}
+
+TEST(RangeAllocatorBestFit)
+{
+	RangeAllocator allocator(100);
+	unsigned int a = allocator.Allocate(10);
+	unsigned int b = allocator.Allocate(20);
+	unsigned int c = allocator.Allocate(5);
+	unsigned int d = allocator.Allocate(30);
+	unsigned int e = allocator.Allocate(10);
+	CHECK(a == 0 && b == 10 && c == 30 && d == 35 && e == 65);
+	CHECK(allocator.GetUsed() == 75);
+
+	// Holes of 20 at 10, 30 at 35 and 25 at the end. Each takes the
+	// smallest one it fits in, not the first
+	allocator.Free(b, 20);
+	allocator.Free(d, 30);
+	CHECK(allocator.GetFreeRangeCount() == 3);
+	CHECK(allocator.Allocate(25) == 75);
+	CHECK(allocator.Allocate(18) == 10);
+	CHECK(allocator.Allocate(26) == 35);
+
+	// 2 and 4 left over, so nothing bigger fits
+	CHECK(allocator.GetLargestFreeRange() == 4);
+	CHECK(allocator.Allocate(5) == RANGE_ALLOCATOR_INVALID);
+	CHECK(allocator.Allocate(0) == RANGE_ALLOCATOR_INVALID);
+	CHECK(allocator.Allocate(4) == 61);
+	CHECK(allocator.Allocate(2) == 28);
+	CHECK(allocator.GetUsed() == 100);
+	CHECK(allocator.GetFreeRangeCount() == 0);
+	CHECK(allocator.GetFragmentation() == 0.0f);
+}
+
+TEST(RangeAllocatorMergesOnFree)
+{
+	// Freed in every order, four neighbors always end up one range again
+	const unsigned int orders[][4] = {
+		{ 0, 1, 2, 3 }, { 3, 2, 1, 0 }, { 1, 3, 0, 2 }, { 2, 0, 3, 1 }, { 1, 2, 0, 3 } };
+	for (const unsigned int* order : orders)
+	{
+		RangeAllocator allocator(40);
+		unsigned int offsets[4];
+		for (int i = 0; i < 4; i++)
+			offsets[i] = allocator.Allocate(10);
+
+		for (int i = 0; i < 4; i++)
+			allocator.Free(offsets[order[i]], 10);
+
+		CHECK(allocator.GetUsed() == 0);
+		CHECK(allocator.GetFreeRangeCount() == 1);
+		CHECK(allocator.GetLargestFreeRange() == 40);
+		CHECK(allocator.GetFragmentation() == 0.0f);
+	}
+
+	// Half of it freed in every other range is as broken up as it gets here
+	RangeAllocator allocator(40);
+	unsigned int offsets[4];
+	for (int i = 0; i < 4; i++)
+		offsets[i] = allocator.Allocate(10);
+	allocator.Free(offsets[0], 10);
+	allocator.Free(offsets[2], 10);
+	CHECK(allocator.GetFreeRangeCount() == 2);
+	CHECK(allocator.GetFragmentation() == 0.5f);
+}
+
+TEST(RangeAllocatorGrowKeepsAllocations)
+{
+	RangeAllocator allocator(30);
+	unsigned int a = allocator.Allocate(10);
+	unsigned int b = allocator.Allocate(10);
+	allocator.Free(a, 10);
+
+	// The new space joins the free range already running to the end
+	allocator.Grow(60);
+	CHECK(allocator.GetCapacity() == 60);
+	CHECK(allocator.GetUsed() == 10);
+	CHECK(allocator.GetFreeRangeCount() == 2);
+	CHECK(allocator.GetLargestFreeRange() == 40);
+	CHECK(allocator.Allocate(40) == 20);
+
+	// With nothing free at the end, it's a range of its own
+	allocator.Grow(70);
+	CHECK(allocator.GetFreeRangeCount() == 2);
+	CHECK(allocator.Allocate(10) == 0);
+	CHECK(allocator.Allocate(10) == 60);
+
+	// Shrinking isn't growing
+	allocator.Grow(50);
+	CHECK(allocator.GetCapacity() == 70);
+
+	allocator.Free(b, 10);
+	allocator.Reset(20);
+	CHECK(allocator.GetCapacity() == 20 && allocator.GetUsed() == 0 && allocator.GetLargestFreeRange() == 20);
+}
+
+TEST(RangeAllocatorMatchesReference)
+{
+	// Random allocations and frees, kept alongside which elements are
+	// taken. Ranges must never overlap, and after every step the free
+	// ranges have to be exactly the runs of free elements
+	const unsigned int capacity = 4096;
+	RangeAllocator allocator(capacity);
+	std::vector<bool> taken(capacity, false);
+	std::vector<Range> live;
+	std::mt19937 random(3);
+	std::uniform_int_distribution<unsigned int> size(1, 96);
+
+	int overlaps = 0;
+	int mismatches = 0;
+	unsigned int failedAllocations = 0;
+	for (int step = 0; step < 20000; step++)
+	{
+		if (live.empty() || random() % 5 < 3)
+		{
+			Range range;
+			range.size = size(random);
+			range.offset = allocator.Allocate(range.size);
+			if (range.offset == RANGE_ALLOCATOR_INVALID)
+			{
+				failedAllocations++;
+				continue;
+			}
+
+			if (range.offset + range.size > capacity)
+			{
+				overlaps++;
+				continue;
+			}
+			for (unsigned int i = range.offset; i < range.offset + range.size; i++)
+			{
+				overlaps += taken[i];
+				taken[i] = true;
+			}
+			live.push_back(range);
+		}
+		else
+		{
+			size_t which = random() % live.size();
+			Range range = live[which];
+			live[which] = live.back();
+			live.pop_back();
+
+			allocator.Free(range.offset, range.size);
+			for (unsigned int i = range.offset; i < range.offset + range.size; i++)
+				taken[i] = false;
+		}
+
+		unsigned int runs;
+		unsigned int longest;
+		CountFreeRuns(taken, runs, longest);
+		unsigned int used = (unsigned int)std::count(taken.begin(), taken.end(), true);
+		if (allocator.GetFreeRangeCount() != runs || allocator.GetLargestFreeRange() != longest || allocator.GetUsed() != used)
+			mismatches++;
+	}
+
+	CHECK(overlaps == 0);
+	CHECK(mismatches == 0);
+
+	// It has to have been full at times, or the above is too easy
+	CHECK(failedAllocations > 0);
+}
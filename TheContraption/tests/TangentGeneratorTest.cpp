@@ -0,0 +1,171 @@
+#include "TestFramework.h"
+
+#include <cmath>
+#include <vector>
+
+#include "JobSystem.h"
+#include "TangentGenerator.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Cosine of the largest angle a tangent or bitangent may be off by
+	const float MIN_ALIGNMENT = 0.999f;
+
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	XMFLOAT3 Normalize(const XMFLOAT3& v)
+	{
+		float length = sqrtf(Dot(v, v));
+		return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+	}
+
+	// --------------------------------------------------------
+	// A unit quad facing -z, wound clockwise from the front
+	// like the rest of the engine's meshes. The first triangle
+	// has u along +x and v down, as a texture is normally laid
+	// on. The second has its uvs mirrored across the diagonal
+	// they share, so the same texel sits on both sides of it
+	// --------------------------------------------------------
+	MeshData MakeQuad(bool mirrored)
+	{
+		const XMFLOAT3 positions[] = {
+			XMFLOAT3(0, 0, 0), XMFLOAT3(1, 0, 0), XMFLOAT3(1, 1, 0), XMFLOAT3(0, 1, 0) };
+		const XMFLOAT2 uvs[] = {
+			XMFLOAT2(0, 1), XMFLOAT2(1, 1), XMFLOAT2(1, 0), mirrored ? XMFLOAT2(1, 1) : XMFLOAT2(0, 0) };
+
+		MeshData data;
+		for (int i = 0; i < 4; i++)
+		{
+			Vertex v = {};
+			v.Position = positions[i];
+			v.Normal = XMFLOAT3(0, 0, -1);
+			v.UV = uvs[i];
+			data.vertices.push_back(v);
+		}
+
+		const unsigned int indices[] = { 0, 2, 1, 0, 3, 2 };
+		data.indices.assign(indices, indices + 6);
+		return data;
+	}
+
+	// --------------------------------------------------------
+	// Every corner's frame has to follow its own triangle's
+	// uvs: the tangent along +u, and the bitangent the shaders
+	// build, cross(T, N) * w, up the texture, which is -v since
+	// uvs start at the top left
+	// --------------------------------------------------------
+	int CountBadFrames(const MeshData& data)
+	{
+		int failures = 0;
+		for (size_t i = 0; i + 3 <= data.indices.size(); i += 3)
+		{
+			const Vertex& v0 = data.vertices[data.indices[i]];
+			const Vertex& v1 = data.vertices[data.indices[i + 1]];
+			const Vertex& v2 = data.vertices[data.indices[i + 2]];
+
+			// Solve the edges for the position derivatives along u and v
+			XMFLOAT3 e1 = Subtract(v1.Position, v0.Position);
+			XMFLOAT3 e2 = Subtract(v2.Position, v0.Position);
+			float s1 = v1.UV.x - v0.UV.x;
+			float t1 = v1.UV.y - v0.UV.y;
+			float s2 = v2.UV.x - v0.UV.x;
+			float t2 = v2.UV.y - v0.UV.y;
+			float r = 1.0f / (s1 * t2 - s2 * t1);
+			XMFLOAT3 alongU = Normalize(XMFLOAT3((e1.x * t2 - e2.x * t1) * r, (e1.y * t2 - e2.y * t1) * r, (e1.z * t2 - e2.z * t1) * r));
+			XMFLOAT3 alongV = Normalize(XMFLOAT3((e2.x * s1 - e1.x * s2) * r, (e2.y * s1 - e1.y * s2) * r, (e2.z * s1 - e1.z * s2) * r));
+			XMFLOAT3 up(-alongV.x, -alongV.y, -alongV.z);
+
+			for (int c = 0; c < 3; c++)
+			{
+				const Vertex& v = data.vertices[data.indices[i + c]];
+				XMFLOAT3 tangent(v.Tangent.x, v.Tangent.y, v.Tangent.z);
+				XMFLOAT3 bitangent = Cross(tangent, v.Normal);
+				failures += Dot(tangent, alongU) < MIN_ALIGNMENT;
+				failures += Dot(bitangent, up) * v.Tangent.w < MIN_ALIGNMENT;
+				failures += v.Tangent.w != 1.0f && v.Tangent.w != -1.0f;
+			}
+		}
+		return failures;
+	}
+}
+
+TEST(TangentGeneratorSplitsMirroredUvs)
+{
+	JobSystem::GetInstance().Initialize();
+
+	MeshData original = MakeQuad(true);
+	MeshData data = original;
+	TangentGenerator::Generate(data, TANGENT_MODE_MIKKTSPACE);
+
+	// The diagonal's two corners are split, so each side has its own
+	CHECK(data.vertices.size() == 6);
+	CHECK(data.indices.size() == 6);
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 3; j < 6; j++)
+			CHECK(data.indices[i] != data.indices[j]);
+	}
+
+	// Every corner still has the same position, normal and uv
+	for (size_t i = 0; i < data.indices.size(); i++)
+	{
+		const Vertex& before = original.vertices[original.indices[i]];
+		const Vertex& after = data.vertices[data.indices[i]];
+		CHECK(before.Position.x == after.Position.x && before.Position.y == after.Position.y);
+		CHECK(before.UV.x == after.UV.x && before.UV.y == after.UV.y);
+		CHECK(after.Normal.z == -1.0f);
+	}
+
+	// Right-handed on the side laid on normally, left-handed on the mirrored one
+	for (int i = 0; i < 3; i++)
+	{
+		CHECK(data.vertices[data.indices[i]].Tangent.w == 1.0f);
+		CHECK(data.vertices[data.indices[i + 3]].Tangent.w == -1.0f);
+	}
+	CHECK(CountBadFrames(data) == 0);
+}
+
+TEST(TangentGeneratorKeepsPlainUvs)
+{
+	JobSystem::GetInstance().Initialize();
+
+	// Nothing mirrored, nothing split, and every frame is right-handed
+	MeshData data = MakeQuad(false);
+	TangentGenerator::Generate(data, TANGENT_MODE_MIKKTSPACE);
+	CHECK(data.vertices.size() == 4);
+	for (const Vertex& v : data.vertices)
+		CHECK(v.Tangent.w == 1.0f);
+	CHECK(CountBadFrames(data) == 0);
+
+	data = MakeQuad(false);
+	TangentGenerator::Generate(data, TANGENT_MODE_FAST);
+	CHECK(data.vertices.size() == 4);
+	CHECK(CountBadFrames(data) == 0);
+}
+
+TEST(TangentGeneratorFastIgnoresMirroring)
+{
+	JobSystem::GetInstance().Initialize();
+
+	// Fast mode never splits, so it leaves w at 1 even where it's wrong
+	MeshData data = MakeQuad(true);
+	TangentGenerator::Generate(data, TANGENT_MODE_FAST);
+	CHECK(data.vertices.size() == 4);
+	for (const Vertex& v : data.vertices)
+		CHECK(v.Tangent.w == 1.0f);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+typedef void (*TestFunction)();
+
+/*
+	Just enough of a test framework to run the engine's CPU side code
+	headless, without pulling in a dependency.
+
+	TEST and BENCHMARK register a function under its name. Tests always
+	run, benchmarks only when asked for with --benchmark, since they
+	print timings rather than checking anything that can fail.
+*/
+struct TestCase
+{
+	const char* name;
+	TestFunction function;
+	bool benchmark;
+};
+
+/// <summary>
+/// Get every test and benchmark, in the order they were registered
+/// </summary>
+std::vector<TestCase>& GetTestCases();
+/// <summary>
+/// Get how many checks have failed so far
+/// </summary>
+int& GetFailureCount();
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, TestFunction function, bool benchmark)
+	{
+		TestCase test = { name, function, benchmark };
+		GetTestCases().push_back(test);
+	}
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, true); \
+	static void name()
+
+// Keeps going after a failure, so one run reports everything that's wrong
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			printf("%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+			GetFailureCount()++; \
+		} \
+	} while (0)
+
+/// <summary>
+/// Run work the given number of times and return the fastest run in seconds
+/// </summary>
+template<typename Work>
+double TimeBest(int runs, Work work)
+{
+	double best = 1e30;
+	for (int i = 0; i < runs; i++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		work();
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
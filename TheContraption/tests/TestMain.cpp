@@ -0,0 +1,60 @@
+#include "TestFramework.h"
+
+#include <cstring>
+
+std::vector<TestCase>& GetTestCases()
+{
+	// Built on first use, as registrations run during static initialization
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+int& GetFailureCount()
+{
+	static int failures = 0;
+	return failures;
+}
+
+// --------------------------------------------------------
+// Usage: ContraptionTests [--benchmark] [prefix]
+//
+// Runs every test whose name starts with the prefix, or
+// every benchmark instead with --benchmark
+// --------------------------------------------------------
+int main(int argc, char** argv)
+{
+	bool benchmarks = false;
+	const char* prefix = "";
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--benchmark") == 0)
+			benchmarks = true;
+		else
+			prefix = argv[i];
+	}
+
+	int run = 0;
+	for (const TestCase& test : GetTestCases())
+	{
+		if (test.benchmark != benchmarks || strncmp(test.name, prefix, strlen(prefix)) != 0)
+			continue;
+
+		int failuresBefore = GetFailureCount();
+		printf("[ RUN  ] %s\n", test.name);
+		fflush(stdout);
+		test.function();
+		printf(GetFailureCount() == failuresBefore ? "[  OK  ] %s\n" : "[ FAIL ] %s\n", test.name);
+		fflush(stdout);
+		run++;
+	}
+
+	// Most likely a typo in the prefix, which shouldn't pass quietly
+	if (run == 0)
+	{
+		printf("Nothing matches \"%s\"\n", prefix);
+		return 1;
+	}
+
+	printf("%d run, %d checks failed\n", run, GetFailureCount());
+	return GetFailureCount() == 0 ? 0 : 1;
+}
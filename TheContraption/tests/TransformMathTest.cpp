@@ -0,0 +1,207 @@
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "TransformMath.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Relative to the largest element of the reference, as the
+	// general inverse rounds differently from the cofactors
+	const float MAX_RELATIVE_ERROR = 0.00001f;
+	// Matrices per benchmark run, about a big scene's worth of transforms
+	const size_t BENCHMARK_MATRIX_COUNT = 100000;
+
+	struct Pieces
+	{
+		XMFLOAT3 position;
+		XMFLOAT3X3 basis;
+		XMFLOAT3 scale;
+	};
+
+	// --------------------------------------------------------
+	// Random transforms, cycling through uniform, non-uniform
+	// and mirrored (one or three negative axes) scales
+	// --------------------------------------------------------
+	std::vector<Pieces> MakePieces(size_t count)
+	{
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> size(0.1f, 10.0f);
+
+		std::vector<Pieces> pieces(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			Pieces& p = pieces[i];
+			p.position = XMFLOAT3(unit(random) * 100.0f, unit(random) * 100.0f, unit(random) * 100.0f);
+
+			XMVECTOR rotation = XMQuaternionNormalize(XMVectorSet(unit(random), unit(random), unit(random), unit(random)));
+			XMStoreFloat3x3(&p.basis, XMMatrixRotationQuaternion(rotation));
+
+			float s = size(random);
+			switch (i % 4)
+			{
+			case 0: p.scale = XMFLOAT3(s, s, s); break;
+			case 1: p.scale = XMFLOAT3(s, size(random), size(random)); break;
+			case 2: p.scale = XMFLOAT3(-s, size(random), size(random)); break;
+			default: p.scale = XMFLOAT3(-s, -s, -s); break;
+			}
+		}
+		return pieces;
+	}
+
+	XMMATRIX ReferenceInverseTranspose(FXMMATRIX m)
+	{
+		return XMMatrixTranspose(XMMatrixInverse(nullptr, m));
+	}
+
+	XMFLOAT4X4 ReferenceInverseTranspose(const XMFLOAT4X4& m)
+	{
+		XMFLOAT4X4 result;
+		XMStoreFloat4x4(&result, ReferenceInverseTranspose(XMLoadFloat4x4(&m)));
+		return result;
+	}
+
+	bool Close(const XMFLOAT4X4& a, const XMFLOAT4X4& reference)
+	{
+		float largest = 0.0f;
+		for (int i = 0; i < 16; i++)
+			largest = std::max(largest, fabsf((&reference.m[0][0])[i]));
+
+		for (int i = 0; i < 16; i++)
+		{
+			if (!(fabsf((&a.m[0][0])[i] - (&reference.m[0][0])[i]) <= MAX_RELATIVE_ERROR * largest))
+				return false;
+		}
+		return true;
+	}
+
+	bool Close(FXMMATRIX a, CXMMATRIX reference)
+	{
+		XMFLOAT4X4 a4;
+		XMFLOAT4X4 reference4;
+		XMStoreFloat4x4(&a4, a);
+		XMStoreFloat4x4(&reference4, reference);
+		return Close(a4, reference4);
+	}
+
+	// Parent times child, like the TransformSystem composes them
+	std::vector<XMFLOAT4X4> MakeWorlds(const std::vector<Pieces>& pieces)
+	{
+		std::vector<XMFLOAT4X4> worlds(pieces.size());
+		for (size_t i = 0; i < pieces.size(); i++)
+		{
+			const Pieces& child = pieces[i];
+			const Pieces& parent = pieces[(i * 7 + 3) % pieces.size()];
+			XMStoreFloat4x4(&worlds[i], XMMatrixMultiply(
+				TransformMath::Trs(child.position, child.basis, child.scale),
+				TransformMath::Trs(parent.position, parent.basis, parent.scale)));
+		}
+		return worlds;
+	}
+}
+
+TEST(TransformMathTrsMatchesInverse)
+{
+	int failures = 0;
+	for (const Pieces& p : MakePieces(1000))
+	{
+		XMMATRIX trs = TransformMath::Trs(p.position, p.basis, p.scale);
+		XMMATRIX expected = XMMatrixMultiply(XMMatrixMultiply(
+			XMMatrixScaling(p.scale.x, p.scale.y, p.scale.z),
+			XMLoadFloat3x3(&p.basis)),
+			XMMatrixTranslation(p.position.x, p.position.y, p.position.z));
+		failures += !Close(trs, expected);
+		failures += !Close(TransformMath::TrsInverseTranspose(p.position, p.basis, p.scale), ReferenceInverseTranspose(trs));
+	}
+	CHECK(failures == 0);
+}
+
+TEST(TransformMathAffineMatchesInverse)
+{
+	std::vector<XMFLOAT4X4> worlds = MakeWorlds(MakePieces(1000));
+	int failures = 0;
+	for (const XMFLOAT4X4& world : worlds)
+	{
+		XMMATRIX m = XMLoadFloat4x4(&world);
+		failures += !Close(TransformMath::AffineInverseTranspose(m), ReferenceInverseTranspose(m));
+	}
+	CHECK(failures == 0);
+}
+
+TEST(TransformMathBatchMatchesInverse)
+{
+	std::vector<XMFLOAT4X4> worlds = MakeWorlds(MakePieces(1000));
+
+	// Scattered indices, so every lane reads and writes somewhere different
+	std::vector<unsigned int> indices(worlds.size());
+	std::iota(indices.begin(), indices.end(), 0);
+	std::shuffle(indices.begin(), indices.end(), std::mt19937(5));
+
+	// Every count up to two groups of four and a scalar tail, then all of them
+	std::vector<size_t> counts;
+	for (size_t count = 0; count <= 11; count++)
+		counts.push_back(count);
+	counts.push_back(indices.size());
+
+	for (size_t count : counts)
+	{
+		XMFLOAT4X4 untouched;
+		memset(&untouched, 0xFF, sizeof(untouched));
+		std::vector<XMFLOAT4X4> results(worlds.size(), untouched);
+		TransformMath::AffineInverseTransposeBatch(worlds.data(), results.data(), indices.data(), count);
+
+		int failures = 0;
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			unsigned int index = indices[i];
+			if (i < count)
+				failures += !Close(results[index], ReferenceInverseTranspose(worlds[index]));
+			else
+				failures += memcmp(&results[index], &untouched, sizeof(untouched)) != 0;
+		}
+		CHECK(failures == 0);
+	}
+}
+
+BENCHMARK(TransformMathInverseTranspose)
+{
+	std::vector<Pieces> pieces = MakePieces(BENCHMARK_MATRIX_COUNT);
+	std::vector<XMFLOAT4X4> worlds = MakeWorlds(pieces);
+	std::vector<XMFLOAT4X4> results(worlds.size());
+	std::vector<unsigned int> indices(worlds.size());
+	std::iota(indices.begin(), indices.end(), 0);
+
+	double inverse = TimeBest(10, [&]()
+	{
+		for (size_t i = 0; i < worlds.size(); i++)
+			XMStoreFloat4x4(&results[i], ReferenceInverseTranspose(XMLoadFloat4x4(&worlds[i])));
+	});
+	double affine = TimeBest(10, [&]()
+	{
+		for (size_t i = 0; i < worlds.size(); i++)
+			XMStoreFloat4x4(&results[i], TransformMath::AffineInverseTranspose(XMLoadFloat4x4(&worlds[i])));
+	});
+	double batch = TimeBest(10, [&]()
+	{
+		TransformMath::AffineInverseTransposeBatch(worlds.data(), results.data(), indices.data(), indices.size());
+	});
+	double trs = TimeBest(10, [&]()
+	{
+		for (size_t i = 0; i < pieces.size(); i++)
+			XMStoreFloat4x4(&results[i], TransformMath::TrsInverseTranspose(pieces[i].position, pieces[i].basis, pieces[i].scale));
+	});
+
+	printf("%zu matrices, inverse transpose:\n", worlds.size());
+	printf("  XMMatrixInverse:        %.2f ms\n", inverse * 1000);
+	printf("  AffineInverseTranspose: %.2f ms, %.2fx\n", affine * 1000, inverse / affine);
+	printf("  Batch of four:          %.2f ms, %.2fx\n", batch * 1000, inverse / batch);
+	printf("  From the pieces:        %.2f ms, %.2fx\n", trs * 1000, inverse / trs);
+}
@@ -0,0 +1,140 @@
+#include "TestFramework.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "JobSystem.h"
+#include "TransformSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Roots in the test hierarchy, each with enough children for
+	// several jobs per level, and chains hanging off some of those
+	const int ROOTS = 4;
+	const int CHILDREN_PER_ROOT = TRANSFORM_PARALLEL_GRAIN * 3 + 7;
+	const int CHAIN_LENGTH = 12;
+
+	void Randomize(TransformSystem& transforms, unsigned int slot, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> size(0.5f, 2.0f);
+		transforms.SetPosition(slot, XMFLOAT3(unit(random) * 10.0f, unit(random) * 10.0f, unit(random) * 10.0f));
+		transforms.SetRotation(slot, XMFLOAT4(unit(random), unit(random), unit(random), unit(random)));
+
+		// Non-uniform and now and then mirrored, so every path through the math is used
+		XMFLOAT3 scale(size(random), size(random), size(random));
+		if (random() % 5 == 0)
+			scale.y = -scale.y;
+		transforms.SetScale(slot, scale);
+	}
+
+	std::vector<unsigned int> MakeHierarchy(std::mt19937& random)
+	{
+		TransformSystem& transforms = TransformSystem::GetInstance();
+		std::vector<unsigned int> slots;
+		for (int r = 0; r < ROOTS; r++)
+		{
+			unsigned int root = transforms.Create();
+			Randomize(transforms, root, random);
+			slots.push_back(root);
+
+			for (int c = 0; c < CHILDREN_PER_ROOT; c++)
+			{
+				unsigned int child = transforms.Create();
+				Randomize(transforms, child, random);
+				transforms.SetParent(child, root);
+				slots.push_back(child);
+
+				if (c % 50 != 0)
+					continue;
+
+				unsigned int parent = child;
+				for (int i = 0; i < CHAIN_LENGTH; i++)
+				{
+					unsigned int link = transforms.Create();
+					Randomize(transforms, link, random);
+					transforms.SetParent(link, parent);
+					slots.push_back(link);
+					parent = link;
+				}
+			}
+		}
+		return slots;
+	}
+
+	// Changing a root's value, even to what it already was, rebuilds everything under it
+	void DirtyEverything(const std::vector<unsigned int>& slots)
+	{
+		TransformSystem& transforms = TransformSystem::GetInstance();
+		for (unsigned int slot : slots)
+		{
+			if (transforms.GetParent(slot) == TRANSFORM_INVALID)
+				transforms.SetPosition(slot, transforms.GetPosition(slot));
+		}
+	}
+
+	void Update(bool deterministic, const std::vector<unsigned int>& slots, std::vector<XMFLOAT4X4>& worlds, std::vector<XMFLOAT4X4>& inverseTransposes)
+	{
+		TransformSystem& transforms = TransformSystem::GetInstance();
+		JobSystem::GetInstance().SetDeterministic(deterministic);
+		transforms.UpdateTransforms();
+		JobSystem::GetInstance().SetDeterministic(false);
+
+		worlds.clear();
+		inverseTransposes.clear();
+		for (unsigned int slot : slots)
+		{
+			worlds.push_back(transforms.GetWorldMatrix(slot));
+			inverseTransposes.push_back(transforms.GetWorldInverseTransposeMatrix(slot));
+		}
+	}
+
+	bool Same(const std::vector<XMFLOAT4X4>& a, const std::vector<XMFLOAT4X4>& b)
+	{
+		return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(XMFLOAT4X4)) == 0;
+	}
+}
+
+TEST(TransformSystemParallelMatchesDeterministic)
+{
+	JobSystem::GetInstance().Initialize();
+	TransformSystem& transforms = TransformSystem::GetInstance();
+	std::mt19937 random(12);
+	std::vector<unsigned int> slots = MakeHierarchy(random);
+
+	// The whole hierarchy one way, then rebuilt the other, has to come out bit for bit the same
+	std::vector<XMFLOAT4X4> serialWorlds, serialInverseTransposes;
+	std::vector<XMFLOAT4X4> parallelWorlds, parallelInverseTransposes;
+	Update(true, slots, serialWorlds, serialInverseTransposes);
+	DirtyEverything(slots);
+	Update(false, slots, parallelWorlds, parallelInverseTransposes);
+	CHECK(Same(serialWorlds, parallelWorlds));
+	CHECK(Same(serialInverseTransposes, parallelInverseTransposes));
+
+	// A frame's worth of changes, some of them reparenting whole
+	// subtrees, updated in parallel, then everything rebuilt serially
+	std::uniform_int_distribution<size_t> pick(0, slots.size() - 1);
+	for (int i = 0; i < 500; i++)
+		Randomize(transforms, slots[pick(random)], random);
+	for (int i = 0; i < 20; i++)
+	{
+		unsigned int child = slots[pick(random)];
+		unsigned int parent = slots[pick(random)];
+		if (transforms.GetParent(child) != TRANSFORM_INVALID && transforms.GetFirstChild(child) == TRANSFORM_INVALID && child != parent)
+			transforms.SetParent(child, parent);
+	}
+	Update(false, slots, parallelWorlds, parallelInverseTransposes);
+	DirtyEverything(slots);
+	Update(true, slots, serialWorlds, serialInverseTransposes);
+	CHECK(Same(serialWorlds, parallelWorlds));
+	CHECK(Same(serialInverseTransposes, parallelInverseTransposes));
+
+	for (unsigned int slot : slots)
+	{
+		if (transforms.GetParent(slot) == TRANSFORM_INVALID)
+			transforms.ReleaseHierarchy(slot);
+	}
+}
@@ -0,0 +1,272 @@
+#include "TestFramework.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "VertexCompression.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// The bounds VertexCompression documents, a bit of float slack aside
+	const double MAX_DIRECTION_ERROR = 0.0001;	// Radians
+	const double MAX_TANGENT_ERROR = 0.00015;	// Radians
+	const double HALF_RELATIVE_ERROR = 1.0 / 2048.0;
+	const double HALF_SMALLEST_STEP = 1.0 / 16777216.0;
+
+	XMFLOAT3 RandomDirection(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+		while (true)
+		{
+			float x = component(random);
+			float y = component(random);
+			float z = component(random);
+			float length = sqrtf(x * x + y * y + z * z);
+			if (length > 0.001f && length <= 1.0f)
+				return XMFLOAT3(x / length, y / length, z / length);
+		}
+	}
+
+	XMFLOAT4 RandomTangent(std::mt19937& random)
+	{
+		XMFLOAT3 direction = RandomDirection(random);
+		return XMFLOAT4(direction.x, direction.y, direction.z, random() % 2 ? 1.0f : -1.0f);
+	}
+
+	// Random vertices spread over an off center box, with the axes
+	// and octahedron folds, where encodings tend to break, mixed in.
+	// Tangents get either sign
+	std::vector<Vertex> MakeVertices(size_t count)
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		std::vector<Vertex> vertices(count);
+		for (Vertex& v : vertices)
+		{
+			v.Position = XMFLOAT3(unit(random) * 50.0f, unit(random) * 3.0f, unit(random) * 10.0f + 100.0f);
+			v.Normal = RandomDirection(random);
+			v.Tangent = RandomTangent(random);
+			v.UV = XMFLOAT2(unit(random) * 0.5f + 0.5f, unit(random) * 2.0f + 3.0f);
+		}
+
+		const XMFLOAT3 special[] = {
+			XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0),
+			XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1), XMFLOAT3(0.7071068f, 0, -0.7071068f), XMFLOAT3(0, -0.7071068f, -0.7071068f) };
+		for (size_t i = 0; i < sizeof(special) / sizeof(special[0]); i++)
+		{
+			vertices[i].Normal = special[i];
+			vertices[i].Tangent = XMFLOAT4(special[i].x, special[i].y, special[i].z, i % 2 ? 1.0f : -1.0f);
+		}
+
+		return vertices;
+	}
+
+	double AngleBetween(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+		double crossX = (double)a.y * b.z - (double)a.z * b.y;
+		double crossY = (double)a.z * b.x - (double)a.x * b.z;
+		double crossZ = (double)a.x * b.y - (double)a.y * b.x;
+		return atan2(sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot);
+	}
+
+	// Half a unorm16 step over the range, plus rounding in the float math around it
+	double UnormBound(float offset, float scale)
+	{
+		return scale / 65535.0 / 2.0 + 4.0 * FLT_EPSILON * (fabs(offset) + scale);
+	}
+
+	double HalfBound(float value)
+	{
+		return fabs(value) * HALF_RELATIVE_ERROR + HALF_SMALLEST_STEP;
+	}
+
+	void RoundTrip(VertexFormat format, const std::vector<Vertex>& vertices, VertexDequantization& dq, std::vector<Vertex>& decoded)
+	{
+		dq = VertexCompression::CalculateDequantization(format, vertices.data(), vertices.size());
+
+		std::vector<uint8_t> encoded;
+		VertexCompression::Encode(format, vertices.data(), vertices.size(), dq, encoded);
+		CHECK(encoded.size() == vertices.size() * VertexCompression::GetStride(format));
+
+		decoded.resize(vertices.size());
+		VertexCompression::Decode(format, encoded.data(), vertices.size(), dq, decoded.data());
+	}
+
+	XMFLOAT3 Direction(const XMFLOAT4& tangent)
+	{
+		return XMFLOAT3(tangent.x, tangent.y, tangent.z);
+	}
+
+	// Within the bounds, and the tangent's sign comes back exactly
+	void CheckDirections(const std::vector<Vertex>& vertices, const std::vector<Vertex>& decoded)
+	{
+		double worstNormal = 0;
+		double worstTangent = 0;
+		int signFailures = 0;
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			worstNormal = std::max(worstNormal, AngleBetween(vertices[i].Normal, decoded[i].Normal));
+			worstTangent = std::max(worstTangent, AngleBetween(Direction(vertices[i].Tangent), Direction(decoded[i].Tangent)));
+			signFailures += decoded[i].Tangent.w != vertices[i].Tangent.w;
+		}
+		CHECK(worstNormal < MAX_DIRECTION_ERROR);
+		CHECK(worstTangent < MAX_TANGENT_ERROR);
+		CHECK(signFailures == 0);
+	}
+}
+
+TEST(VertexCompressionStrides)
+{
+	CHECK(VertexCompression::GetStride(VERTEX_FORMAT_FULL) == 48);
+	CHECK(VertexCompression::GetStride(VERTEX_FORMAT_COMPACT_HALF_UV) == 24);
+	CHECK(VertexCompression::GetStride(VERTEX_FORMAT_COMPACT_UNORM_UV) == 24);
+	CHECK(VertexCompression::GetStride(VERTEX_FORMAT_QUANTIZED) == 20);
+}
+
+TEST(VertexCompressionFullIsExact)
+{
+	std::vector<Vertex> vertices = MakeVertices(1000);
+	VertexDequantization dq;
+	std::vector<Vertex> decoded;
+	RoundTrip(VERTEX_FORMAT_FULL, vertices, dq, decoded);
+
+	CHECK(memcmp(vertices.data(), decoded.data(), vertices.size() * sizeof(Vertex)) == 0);
+	CHECK(dq.positionOffset.x == 0.0f && dq.positionScale.x == 1.0f);
+	CHECK(dq.uvOffset.x == 0.0f && dq.uvScale.x == 1.0f);
+}
+
+TEST(VertexCompressionOctahedralBound)
+{
+	std::mt19937 random(7);
+	double worst = 0;
+	for (int i = 0; i < 200000; i++)
+	{
+		XMFLOAT3 direction = RandomDirection(random);
+		XMFLOAT3 decoded = VertexCompression::DecodeOctahedral(VertexCompression::EncodeOctahedral(direction));
+		worst = std::max(worst, AngleBetween(direction, decoded));
+
+		double length = sqrt((double)decoded.x * decoded.x + (double)decoded.y * decoded.y + (double)decoded.z * decoded.z);
+		CHECK(fabs(length - 1.0) <= 1e-5);
+	}
+	CHECK(worst < MAX_DIRECTION_ERROR);
+}
+
+TEST(VertexCompressionTangentBound)
+{
+	std::mt19937 random(9);
+	double worst = 0;
+	int signFailures = 0;
+	for (int i = 0; i < 200000; i++)
+	{
+		XMFLOAT4 tangent = RandomTangent(random);
+		XMFLOAT4 decoded = VertexCompression::DecodeTangent(VertexCompression::EncodeTangent(tangent));
+		worst = std::max(worst, AngleBetween(Direction(tangent), Direction(decoded)));
+		signFailures += decoded.w != tangent.w;
+	}
+	CHECK(worst < MAX_TANGENT_ERROR);
+	CHECK(signFailures == 0);
+
+	// Y at both ends still keeps the sign apart from it
+	const float ys[] = { -1.0f, 1.0f };
+	for (float y : ys)
+	{
+		CHECK(VertexCompression::DecodeTangent(VertexCompression::EncodeTangent(XMFLOAT4(0, y, 0, -1))).w == -1.0f);
+		CHECK(VertexCompression::DecodeTangent(VertexCompression::EncodeTangent(XMFLOAT4(0, y, 0, 1))).w == 1.0f);
+	}
+}
+
+TEST(VertexCompressionHalfUvBound)
+{
+	std::vector<Vertex> vertices = MakeVertices(200000);
+	VertexDequantization dq;
+	std::vector<Vertex> decoded;
+	RoundTrip(VERTEX_FORMAT_COMPACT_HALF_UV, vertices, dq, decoded);
+	CheckDirections(vertices, decoded);
+
+	int failures = 0;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& a = vertices[i];
+		const Vertex& b = decoded[i];
+		bool positionExact = a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z;
+		bool uvInBound =
+			fabs(a.UV.x - b.UV.x) <= HalfBound(a.UV.x) &&
+			fabs(a.UV.y - b.UV.y) <= HalfBound(a.UV.y);
+		failures += !positionExact || !uvInBound;
+	}
+	CHECK(failures == 0);
+}
+
+TEST(VertexCompressionUnormUvBound)
+{
+	std::vector<Vertex> vertices = MakeVertices(200000);
+	VertexDequantization dq;
+	std::vector<Vertex> decoded;
+	RoundTrip(VERTEX_FORMAT_COMPACT_UNORM_UV, vertices, dq, decoded);
+	CheckDirections(vertices, decoded);
+
+	int failures = 0;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& a = vertices[i];
+		const Vertex& b = decoded[i];
+		bool positionExact = a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z;
+		bool uvInBound =
+			fabs(a.UV.x - b.UV.x) <= UnormBound(dq.uvOffset.x, dq.uvScale.x) &&
+			fabs(a.UV.y - b.UV.y) <= UnormBound(dq.uvOffset.y, dq.uvScale.y);
+		failures += !positionExact || !uvInBound;
+	}
+	CHECK(failures == 0);
+}
+
+TEST(VertexCompressionQuantizedBound)
+{
+	std::vector<Vertex> vertices = MakeVertices(200000);
+	VertexDequantization dq;
+	std::vector<Vertex> decoded;
+	RoundTrip(VERTEX_FORMAT_QUANTIZED, vertices, dq, decoded);
+	CheckDirections(vertices, decoded);
+
+	int failures = 0;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& a = vertices[i];
+		const Vertex& b = decoded[i];
+		bool positionInBound =
+			fabs(a.Position.x - b.Position.x) <= UnormBound(dq.positionOffset.x, dq.positionScale.x) &&
+			fabs(a.Position.y - b.Position.y) <= UnormBound(dq.positionOffset.y, dq.positionScale.y) &&
+			fabs(a.Position.z - b.Position.z) <= UnormBound(dq.positionOffset.z, dq.positionScale.z);
+		bool uvInBound =
+			fabs(a.UV.x - b.UV.x) <= UnormBound(dq.uvOffset.x, dq.uvScale.x) &&
+			fabs(a.UV.y - b.UV.y) <= UnormBound(dq.uvOffset.y, dq.uvScale.y);
+		failures += !positionInBound || !uvInBound;
+	}
+	CHECK(failures == 0);
+}
+
+TEST(VertexCompressionFlatRange)
+{
+	// Every vertex in one spot has a zero range, which must not divide by it
+	std::vector<Vertex> vertices = MakeVertices(16);
+	for (Vertex& v : vertices)
+	{
+		v.Position = XMFLOAT3(1, 2, 3);
+		v.UV = XMFLOAT2(0.5f, 0.5f);
+	}
+
+	VertexDequantization dq;
+	std::vector<Vertex> decoded;
+	RoundTrip(VERTEX_FORMAT_QUANTIZED, vertices, dq, decoded);
+	for (const Vertex& v : decoded)
+	{
+		CHECK(v.Position.x == 1.0f && v.Position.y == 2.0f && v.Position.z == 3.0f);
+		CHECK(v.UV.x == 0.5f && v.UV.y == 0.5f);
+	}
+}